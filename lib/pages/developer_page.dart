@@ -1,3 +1,4 @@
+import 'dart:async';
 import 'dart:io';
 import 'package:fluent_ui/fluent_ui.dart' as fluent;
 import 'package:flutter/cupertino.dart';
@@ -11,6 +12,7 @@ import '../services/admin_service.dart';
 import '../services/notification_service.dart';
 import '../services/playback_state_service.dart';
 import '../services/player_service.dart';
+import '../services/rhythm_service.dart';
 import '../utils/theme_manager.dart';
 import 'lx_music_runtime_test_page.dart';
 
@@ -1387,6 +1389,10 @@ class _DeveloperPageState extends State<DeveloperPage> with SingleTickerProvider
             ),
           ),
         ),
+        if (Platform.isWindows) ...[
+          const SizedBox(height: 8),
+          const _RhythmStatsCard(),
+        ],
         const SizedBox(height: 8),
         FilledButton.icon(
           onPressed: () async {
@@ -2850,6 +2856,10 @@ class _DeveloperPageState extends State<DeveloperPage> with SingleTickerProvider
             ),
           ),
         ),
+        if (Platform.isWindows) ...[
+          const SizedBox(height: 8),
+          const _RhythmStatsCard(fluentStyle: true),
+        ],
         const SizedBox(height: 24),
         fluent.FilledButton(
           onPressed: () {
@@ -3740,3 +3750,115 @@ class _DeveloperPageState extends State<DeveloperPage> with SingleTickerProvider
   }
 }
 
+
+/// 节奏引擎自检统计：开关原生端统计，并实时显示采集、分析与通道发送的计数和耗时
+class _RhythmStatsCard extends StatefulWidget {
+  final bool fluentStyle;
+
+  const _RhythmStatsCard({this.fluentStyle = false});
+
+  @override
+  State<_RhythmStatsCard> createState() => _RhythmStatsCardState();
+}
+
+class _RhythmStatsCardState extends State<_RhythmStatsCard> {
+  StreamSubscription<RhythmEngineStats>? _subscription;
+  RhythmEngineStats? _stats;
+  bool _enabled = false;
+
+  @override
+  void initState() {
+    super.initState();
+    _subscription = RhythmService().statsStream.listen((stats) {
+      if (mounted) setState(() => _stats = stats);
+    });
+    RhythmService().getStats().then((stats) {
+      if (mounted && stats != null) {
+        setState(() {
+          _stats = stats;
+          _enabled = stats.enabled;
+        });
+      }
+    });
+  }
+
+  @override
+  void dispose() {
+    _subscription?.cancel();
+    super.dispose();
+  }
+
+  Future<void> _toggle(bool value) async {
+    setState(() => _enabled = value);
+    await RhythmService().setStatsEnabled(value);
+    final stats = await RhythmService().getStats();
+    if (mounted && stats != null) setState(() => _stats = stats);
+  }
+
+  String _timing(String label, RhythmTiming timing) {
+    String us(double value) => value.toStringAsFixed(1);
+    return '$label: ${timing.count} 次，平均 ${us(timing.meanUs)} µs，'
+        'p50 < ${us(timing.p50Us)} µs，p99 < ${us(timing.p99Us)} µs，最大 ${us(timing.maxUs)} µs';
+  }
+
+  List<String> _lines() {
+    final stats = _stats;
+    if (stats == null) return const ['暂无数据 (律动未启动)'];
+    if (!stats.compiledIn) return const ['原生端编译时未包含统计代码'];
+    return [
+      '数据包: ${stats.packetsCaptured}，丢弃采样: ${stats.samplesDropped}，缓冲区最高水位: ${stats.bufferHighWater}',
+      '分析帧: ${stats.framesAnalysed}，已发送: ${stats.framesSent}，未发送: ${stats.framesDropped}',
+      _timing('FFT', stats.fft),
+      _timing('频段映射', stats.bandMapping),
+      _timing('采集到发送', stats.captureToEmit),
+      _timing('通道发送', stats.channelSend),
+    ];
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    const title = Text('节奏引擎统计');
+    const subtitle = Text('记录采集、FFT、频段映射与通道发送的计数和耗时，律动运行时每秒刷新');
+    final details = Padding(
+      padding: const EdgeInsets.fromLTRB(16, 0, 16, 12),
+      child: Column(
+        crossAxisAlignment: CrossAxisAlignment.start,
+        children: [
+          for (final line in _lines())
+            Text(line, style: const TextStyle(fontFamily: 'monospace', fontSize: 12)),
+        ],
+      ),
+    );
+
+    if (widget.fluentStyle) {
+      return fluent.Card(
+        child: Column(
+          crossAxisAlignment: CrossAxisAlignment.start,
+          children: [
+            fluent.ListTile(
+              leading: const Icon(fluent.FluentIcons.diagnostic),
+              title: title,
+              subtitle: subtitle,
+              trailing: fluent.ToggleSwitch(checked: _enabled, onChanged: _toggle),
+            ),
+            if (_enabled) details,
+          ],
+        ),
+      );
+    }
+    return Card(
+      child: Column(
+        crossAxisAlignment: CrossAxisAlignment.start,
+        children: [
+          ListTile(
+            leading: const Icon(Icons.speed),
+            title: title,
+            subtitle: subtitle,
+            trailing: Switch.adaptive(value: _enabled, onChanged: _toggle),
+          ),
+          if (_enabled) details,
+        ],
+      ),
+    );
+  }
+}
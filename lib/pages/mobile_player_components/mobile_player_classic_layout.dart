@@ -236,6 +236,7 @@ class MobilePlayerClassicLayout extends StatelessWidget {
             WavySplitProgressBar(
               value: max > 0 ? (value / max).clamp(0.0, 1.0) : 0.0,
               isPlaying: player.isPlaying,
+              track: player.currentTrack,
               onChanged: (v) {
                 player.seek(Duration(milliseconds: (v * max).toInt()));
               },
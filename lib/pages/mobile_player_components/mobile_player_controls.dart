@@ -77,6 +77,7 @@ class MobilePlayerControls extends StatelessWidget {
                     ? (position.inMilliseconds / duration.inMilliseconds).clamp(0.0, 1.0)
                     : 0.0,
                 isPlaying: player.isPlaying,
+                track: player.currentTrack,
                 onChanged: (value) {
                   final seekTo = duration.inMilliseconds * value;
                   player.seek(Duration(milliseconds: seekTo.toInt()));
@@ -10,6 +10,7 @@ import '../models/song_detail.dart';
 import 'package:http/http.dart' as http;
 import 'package:path/path.dart' as path;
 import 'audio_quality_service.dart';
+import 'rhythm_service.dart';
 
 /// 缓存元数据模型
 class CacheMetadata {
@@ -540,6 +541,68 @@ class CacheService extends ChangeNotifier {
     );
   }
 
+  /// 离线分析已缓存的歌曲 (节拍、速度、响度、调性与首尾静音) 并生成波形，
+  /// 结果以 .rhythm 与 .peaks 文件保存在缓存目录中，随缓存一起删除
+  Future<RhythmTrackAnalysis?> analyzeCachedTrack(Track track) async {
+    // 节奏分析插件目前仅在 Windows 上注册
+    if (!Platform.isWindows) return null;
+    if (!_isInitialized || !isCached(track)) return null;
+
+    final cacheKey = _generateCacheKey(
+      track.id.toString(),
+      track.source,
+    );
+
+    return RhythmService().analyzeTrack(
+      path: _getCacheFilePath(cacheKey),
+      directory: _cacheDir!.path,
+      cacheKey: cacheKey,
+      encryptionKey: _encryptionKey,
+    );
+  }
+
+  /// 读取 [analyzeCachedTrack] 保存的分析结果，尚未分析过时返回 null
+  Future<RhythmTrackAnalysis?> readCachedAnalysis(Track track) async {
+    if (!Platform.isWindows || !_isInitialized) return null;
+
+    final cacheKey = _generateCacheKey(
+      track.id.toString(),
+      track.source,
+    );
+
+    return RhythmService().readTrackAnalysis(
+      directory: _cacheDir!.path,
+      cacheKey: cacheKey,
+    );
+  }
+
+  /// 获取已缓存歌曲的波形 (见 [RhythmService.queryWaveform])，
+  /// 尚未生成时先分析一次；未缓存或当前平台不支持时返回 null
+  Future<RhythmWaveform?> getCachedWaveform(Track track, int columns) async {
+    if (!Platform.isWindows) return null;
+    if (!_isInitialized || !isCached(track)) return null;
+
+    final cacheKey = _generateCacheKey(
+      track.id.toString(),
+      track.source,
+    );
+
+    final rhythm = RhythmService();
+    var waveform = await rhythm.queryWaveform(
+      directory: _cacheDir!.path,
+      cacheKey: cacheKey,
+      columns: columns,
+    );
+    if (waveform == null && await analyzeCachedTrack(track) != null) {
+      waveform = await rhythm.queryWaveform(
+        directory: _cacheDir!.path,
+        cacheKey: cacheKey,
+        columns: columns,
+      );
+    }
+    return waveform;
+  }
+
   /// 清除所有缓存
   Future<void> clearAllCache() async {
     if (!_isInitialized) return;
@@ -587,6 +650,14 @@ class CacheService extends ChangeNotifier {
         await cacheFile.delete();
       }
 
+      // 删除离线分析结果与波形
+      for (final extension in const ['rhythm', 'peaks']) {
+        final analysisFile = File('${_cacheDir!.path}/$cacheKey.$extension');
+        if (await analysisFile.exists()) {
+          await analysisFile.delete();
+        }
+      }
+
       // 从索引中移除
       _cacheIndex.remove(cacheKey);
       await _saveCacheIndex();
@@ -1,6 +1,503 @@
 import 'dart:async';
+import 'dart:typed_data';
 import 'package:flutter/services.dart';
 
+/// 原生节拍追踪检测到 (或按当前速度预测) 的一拍
+class RhythmBeat {
+  /// 采集时间 (微秒，与原生单调时钟同源)
+  final int timestampUs;
+
+  /// 起音强度 (相对自适应阈值，>= 1)；按速度预测、没有检测到起音的拍为 0
+  final double strength;
+
+  /// 该拍与当前速度网格的吻合程度 (0 ~ 1)
+  final double confidence;
+
+  /// 当时的速度估计 (BPM)，尚未估计出时为 0
+  final double bpm;
+
+  const RhythmBeat({
+    required this.timestampUs,
+    required this.strength,
+    required this.confidence,
+    required this.bpm,
+  });
+}
+
+/// EBU R128 响度与真峰值读数，每 100 ms 更新一次；尚未测得时为负无穷
+class RhythmLoudness {
+  /// 采集时间 (微秒，与原生单调时钟同源)
+  final int timestampUs;
+
+  /// 瞬时响度 (最近 400 ms，LUFS)
+  final double momentary;
+
+  /// 短期响度 (最近 3 秒，LUFS)
+  final double shortTerm;
+
+  /// 综合响度 (自上次重置以来经门限处理，LUFS)
+  final double integrated;
+
+  /// 自上次重置以来的真峰值 (4 倍过采样，dBTP)
+  final double truePeak;
+
+  const RhythmLoudness({
+    required this.timestampUs,
+    required this.momentary,
+    required this.shortTerm,
+    required this.integrated,
+    required this.truePeak,
+  });
+}
+
+/// 立体声模式下的一帧 (见 [RhythmService.setStereo])，与主频段帧同一分析窗口
+class RhythmStereo {
+  /// 采集时间 (微秒，与原生单调时钟同源)
+  final int timestampUs;
+
+  /// 'lr' 时两路为左/右声道，'ms' 时为中/侧信号
+  final String channels;
+
+  /// 左右声道的相位相关度 (-1 ~ 1)：1 为单声道，0 为互不相关，-1 为反相；静音时为 0
+  final double correlation;
+
+  /// 立体声宽度 (0 ~ 1)：侧信号能量占比，单声道为 0，互不相关的两声道约为 0.5
+  final double width;
+
+  /// 两路各自的频段值与峰值保持标记 (0 ~ 1)，频段划分与主频段流相同，增益沿用主频段
+  final Float32List firstBands;
+  final Float32List secondBands;
+  final Float32List firstPeaks;
+  final Float32List secondPeaks;
+
+  const RhythmStereo({
+    required this.timestampUs,
+    required this.channels,
+    required this.correlation,
+    required this.width,
+    required this.firstBands,
+    required this.secondBands,
+    required this.firstPeaks,
+    required this.secondPeaks,
+  });
+}
+
+/// 音色特征 (见 [RhythmService.setSpectralFeatures])，为自上一条以来各分析帧的平均值
+class RhythmFeatures {
+  /// 最近一帧的采集时间 (微秒，与原生单调时钟同源)
+  final int timestampUs;
+
+  /// 分析因静音暂停时推送的一条，此时各项均为 0
+  final bool silent;
+
+  /// 频谱质心 (Hz)：按幅度加权的平均频率，越高声音越明亮
+  final double centroid;
+
+  /// 频谱滚降点 (Hz)：85% 的幅度位于此频率以下
+  final double rolloff;
+
+  /// 频谱平坦度 (0 ~ 1)：接近 1 为噪声般的宽带声音，接近 0 为少数纯音
+  final double flatness;
+
+  /// 频谱通量：相对上一帧各频点幅度上升之和与总幅度之比，平稳时为 0，起音处变大
+  final double flux;
+
+  /// 过零率：时域信号每个采样的符号变化次数 (0 ~ 1)
+  final double zeroCrossingRate;
+
+  const RhythmFeatures({
+    required this.timestampUs,
+    required this.silent,
+    required this.centroid,
+    required this.rolloff,
+    required this.flatness,
+    required this.flux,
+    required this.zeroCrossingRate,
+  });
+}
+
+/// 音级轮廓与调性估计 (见 [RhythmService.setChroma])，约每 0.25 秒一条
+class RhythmChroma {
+  static const List<String> pitchClassNames = [
+    'C', 'C#', 'D', 'D#', 'E', 'F', 'F#', 'G', 'G#', 'A', 'A#', 'B'
+  ];
+
+  /// 最近一帧的采集时间 (微秒，与原生单调时钟同源)
+  final int timestampUs;
+
+  /// 分析因静音暂停时推送的一条，此时轮廓全为 0、调性未知
+  final bool silent;
+
+  /// 自上一条以来 C 到 B 十二个音级的能量，最强者为 1
+  final Float32List chroma;
+
+  /// 主音的音级 (0 为 C)，尚无音高信息时为 -1
+  final int tonic;
+
+  /// 'major' 或 'minor'
+  final String mode;
+
+  /// 平滑后的音级轮廓与该调 Krumhansl-Kessler 调性轮廓的相关度 (0 ~ 1)
+  final double confidence;
+
+  const RhythmChroma({
+    required this.timestampUs,
+    required this.silent,
+    required this.chroma,
+    required this.tonic,
+    required this.mode,
+    required this.confidence,
+  });
+
+  /// 例如 'A minor'；调性未知时为空字符串
+  String get keyName => tonic < 0 ? '' : '${pitchClassNames[tonic]} $mode';
+}
+
+/// 打击乐部分的频段 (见 [RhythmService.setPercussive])，每个分析帧一条
+class RhythmPercussive {
+  /// 该帧的采集时间 (微秒，与原生单调时钟同源)
+  final int timestampUs;
+
+  /// 分析因静音暂停时推送的一条，此时频段全为 0
+  final bool silent;
+
+  /// 只含鼓等打击乐的频段值，与 bandsStream 同一频段划分、增益与起落平滑
+  final Float32List bands;
+
+  /// 各频段的峰值保持标记 (0 ~ 1)
+  final Float32List peaks;
+
+  const RhythmPercussive({
+    required this.timestampUs,
+    required this.silent,
+    required this.bands,
+    required this.peaks,
+  });
+}
+
+/// 批量模式 (见 [RhythmService.setFrameBatching]) 下的一条消息：按时间顺序排列的连续分析帧，
+/// 一帧不漏。通常为设定的帧数；频段数改变 (见 [RhythmService.setBandLayout]) 时
+/// 当前批次提前结束，改变前的几帧单独成为一条较短的消息
+class RhythmFrameBatch {
+  /// 每帧的频段数
+  final int bandCount;
+
+  /// 各帧的采集时间 (微秒，与原生单调时钟同源)
+  final Int64List timestampsUs;
+
+  /// 各帧的频段值与峰值保持标记依次拼接，每帧 [bandCount] 个
+  final Float32List bands;
+  final Float32List peaks;
+
+  const RhythmFrameBatch({
+    required this.bandCount,
+    required this.timestampsUs,
+    required this.bands,
+    required this.peaks,
+  });
+
+  int get frameCount => timestampsUs.length;
+
+  /// 第 [index] 帧的频段值与峰值保持标记 (视图，不复制)
+  Float32List bandsAt(int index) =>
+      Float32List.sublistView(bands, index * bandCount, (index + 1) * bandCount);
+  Float32List peaksAt(int index) =>
+      Float32List.sublistView(peaks, index * bandCount, (index + 1) * bandCount);
+}
+
+/// 打击乐起音 (见 [RhythmService.setPercussive])，每次鼓点一条
+class RhythmOnset {
+  /// 起音所在分析窗口中心的采集时间 (微秒，与原生单调时钟同源)
+  final int timestampUs;
+
+  /// 打击乐通量与自适应阈值之比 (大于 1)
+  final double strength;
+
+  const RhythmOnset({
+    required this.timestampUs,
+    required this.strength,
+  });
+}
+
+/// 一项耗时统计 (微秒)。原生端按 2 的幂分桶记录，分位数取所在桶的上界，误差在 2 倍以内
+class RhythmTiming {
+  final int count;
+  final double meanUs;
+  final double p50Us;
+  final double p99Us;
+  final double maxUs;
+
+  const RhythmTiming({
+    this.count = 0,
+    this.meanUs = 0.0,
+    this.p50Us = 0.0,
+    this.p99Us = 0.0,
+    this.maxUs = 0.0,
+  });
+
+  factory RhythmTiming.fromMap(dynamic map) {
+    if (map is! Map) return const RhythmTiming();
+    double value(String key) => (map[key] as num?)?.toDouble() ?? 0.0;
+    return RhythmTiming(
+      count: (map['count'] as int?) ?? 0,
+      meanUs: value('meanUs'),
+      p50Us: value('p50Us'),
+      p99Us: value('p99Us'),
+      maxUs: value('maxUs'),
+    );
+  }
+}
+
+/// 原生节奏引擎的自检统计 (见 [RhythmService.setStatsEnabled])，计数自启用起累计
+class RhythmEngineStats {
+  /// 是否正在记录；[compiledIn] 为 false 时原生端编译时已移除统计代码
+  final bool enabled;
+  final bool compiledIn;
+
+  /// 采集到的数据包数
+  final int packetsCaptured;
+
+  /// 分析出的帧数、经平台通道发送的帧数，以及分析了却未发送 (两次轮询之间被覆盖或批量队列溢出) 的帧数
+  final int framesAnalysed;
+  final int framesSent;
+  final int framesDropped;
+
+  /// 因分析跟不上而被环形缓冲区丢弃的采样数，以及缓冲区的最高水位
+  final int samplesDropped;
+  final int bufferHighWater;
+
+  /// 每帧 FFT 耗时、每次频段映射耗时、从采集到发送的延迟、每次通道发送耗时
+  final RhythmTiming fft;
+  final RhythmTiming bandMapping;
+  final RhythmTiming captureToEmit;
+  final RhythmTiming channelSend;
+
+  const RhythmEngineStats({
+    this.enabled = false,
+    this.compiledIn = false,
+    this.packetsCaptured = 0,
+    this.framesAnalysed = 0,
+    this.framesSent = 0,
+    this.framesDropped = 0,
+    this.samplesDropped = 0,
+    this.bufferHighWater = 0,
+    this.fft = const RhythmTiming(),
+    this.bandMapping = const RhythmTiming(),
+    this.captureToEmit = const RhythmTiming(),
+    this.channelSend = const RhythmTiming(),
+  });
+
+  factory RhythmEngineStats.fromMap(Map<dynamic, dynamic> map) {
+    int count(String key) => (map[key] as int?) ?? 0;
+    return RhythmEngineStats(
+      enabled: map['enabled'] == true,
+      compiledIn: map['compiledIn'] == true,
+      packetsCaptured: count('packetsCaptured'),
+      framesAnalysed: count('framesAnalysed'),
+      framesSent: count('framesSent'),
+      framesDropped: count('framesDropped'),
+      samplesDropped: count('samplesDropped'),
+      bufferHighWater: count('bufferHighWater'),
+      fft: RhythmTiming.fromMap(map['fft']),
+      bandMapping: RhythmTiming.fromMap(map['bandMapping']),
+      captureToEmit: RhythmTiming.fromMap(map['captureToEmit']),
+      channelSend: RhythmTiming.fromMap(map['channelSend']),
+    );
+  }
+}
+
+/// 整首歌曲的离线分析结果 (见 [RhythmService.analyzeTrack])，与实时采集无关
+class RhythmTrackAnalysis {
+  /// 解码后的采样率 (Hz)
+  final int sampleRate;
+
+  /// 解码出的时长 (毫秒)
+  final int durationMs;
+
+  /// 被分析文件的字节数，可用于判断缓存文件是否已被替换
+  final int sourceSize;
+
+  /// 整首的速度 (BPM，按可信度加权的中位数)，无法估计时为 0
+  final double bpm;
+
+  /// 速度估计的平均可信度 (0 ~ 1)
+  final double tempoConfidence;
+
+  /// 各拍相对歌曲开头的时间 (毫秒)，只覆盖有声音的部分
+  final Int32List beatsMs;
+
+  /// 整首的综合响度 (LUFS) 与真峰值 (dBTP)，全静音时为负无穷
+  final double integratedLufs;
+  final double truePeakDbtp;
+
+  /// 整首的调性：主音音级 (0 为 C，未知为 -1)、'major' 或 'minor' 及可信度 (0 ~ 1)
+  final int tonic;
+  final String mode;
+  final double keyConfidence;
+
+  /// 开头与结尾的静音时长 (毫秒)；全静音时整首都算作开头静音
+  final int leadingSilenceMs;
+  final int trailingSilenceMs;
+
+  const RhythmTrackAnalysis({
+    required this.sampleRate,
+    required this.durationMs,
+    required this.sourceSize,
+    required this.bpm,
+    required this.tempoConfidence,
+    required this.beatsMs,
+    required this.integratedLufs,
+    required this.truePeakDbtp,
+    required this.tonic,
+    required this.mode,
+    required this.keyConfidence,
+    required this.leadingSilenceMs,
+    required this.trailingSilenceMs,
+  });
+
+  factory RhythmTrackAnalysis.fromMap(Map<dynamic, dynamic> map) {
+    int count(String key) => (map[key] as int?) ?? 0;
+    double value(String key) => (map[key] as num?)?.toDouble() ?? 0.0;
+    final beats = map['beatsMs'];
+    return RhythmTrackAnalysis(
+      sampleRate: count('sampleRate'),
+      durationMs: count('durationMs'),
+      sourceSize: count('sourceSize'),
+      bpm: value('bpm'),
+      tempoConfidence: value('tempoConfidence'),
+      beatsMs: beats is Int32List ? beats : Int32List(0),
+      integratedLufs: value('integratedLufs'),
+      truePeakDbtp: value('truePeakDbtp'),
+      tonic: (map['tonic'] as int?) ?? -1,
+      mode: (map['mode'] as String?) ?? 'major',
+      keyConfidence: value('keyConfidence'),
+      leadingSilenceMs: count('leadingSilenceMs'),
+      trailingSilenceMs: count('trailingSilenceMs'),
+    );
+  }
+
+  /// 例如 'A minor'；调性未知时为空字符串
+  String get keyName =>
+      tonic < 0 ? '' : '${RhythmChroma.pitchClassNames[tonic]} $mode';
+}
+
+/// 一段歌曲的波形 (见 [RhythmService.queryWaveform])：按时间均分成若干列，
+/// 每列为单声道混音的最小值、最大值与均方根 (满刻度 1)
+class RhythmWaveform {
+  /// 各列的最小值 (-1 ~ 0 附近)
+  final Float32List min;
+
+  /// 各列的最大值 (0 ~ 1 附近)
+  final Float32List max;
+
+  /// 各列的均方根 (0 ~ 1)
+  final Float32List rms;
+
+  const RhythmWaveform({required this.min, required this.max, required this.rms});
+
+  /// 原生消息：Float32List，依次为全部列的最小值、最大值与均方根
+  factory RhythmWaveform.fromPayload(Float32List payload) {
+    final columns = payload.length ~/ 3;
+    return RhythmWaveform(
+      min: Float32List.sublistView(payload, 0, columns),
+      max: Float32List.sublistView(payload, columns, 2 * columns),
+      rms: Float32List.sublistView(payload, 2 * columns, 3 * columns),
+    );
+  }
+
+  int get columns => rms.length;
+}
+
+/// 一路独立的频段订阅 (见 [RhythmService.subscribe])：拥有自己的频段划分、
+/// 平滑参数与最大推送频率，但与其他订阅共用同一路采集和同一次 FFT
+class RhythmSubscription {
+  RhythmSubscription._(this._service, this.id, this._centers);
+
+  final RhythmService _service;
+
+  /// 原生端分配的订阅编号
+  final int id;
+
+  List<double> _centers;
+
+  /// 各频段中心频率 (Hz)
+  List<double> get centers => _centers;
+
+  late final _controller = StreamController<List<double>>.broadcast(
+      onListen: _service._updateEventSubscription,
+      onCancel: _service._updateEventSubscription);
+
+  Float32List _bands = Float32List(0);
+  Float32List _peaks = Float32List(0);
+  int _lastFrameTimestampUs = 0;
+  bool _cancelled = false;
+
+  /// 本订阅的频段数据流，推送频率不超过订阅时指定的 maxRate
+  Stream<List<double>> get bandsStream => _controller.stream;
+
+  /// 最近一帧的频段值与峰值保持标记
+  Float32List get bands => _bands;
+  Float32List get peaks => _peaks;
+
+  /// 最近一帧的采集时间 (微秒，与原生单调时钟同源)
+  int get lastFrameTimestampUs => _lastFrameTimestampUs;
+
+  /// 修改本订阅的设置，参数含义同 [RhythmService.subscribe]；未传入的保持不变
+  Future<bool> update({
+    String? scale,
+    int? count,
+    double? maxRate,
+    double? attackMs,
+    double? releaseMs,
+    double? peakHoldMs,
+    double? peakFallPerSec,
+    bool? autoGain,
+  }) async {
+    if (_cancelled) return false;
+    try {
+      final result = await RhythmService._methodChannel.invokeMapMethod<String, dynamic>('updateSubscription', {
+        'id': id,
+        if (scale != null) 'scale': scale,
+        if (count != null) 'count': count,
+        if (maxRate != null) 'maxRate': maxRate,
+        if (attackMs != null) 'attackMs': attackMs,
+        if (releaseMs != null) 'releaseMs': releaseMs,
+        if (peakHoldMs != null) 'peakHoldMs': peakHoldMs,
+        if (peakFallPerSec != null) 'peakFallPerSec': peakFallPerSec,
+        if (autoGain != null) 'autoGain': autoGain,
+      });
+      final centers = result?['centers'];
+      if (centers is! Float32List) return false;
+      _centers = centers;
+      return true;
+    } catch (e) {
+      print('RhythmService Error updating subscription: $e');
+      return false;
+    }
+  }
+
+  /// 取消订阅并释放原生端的订阅槽位
+  Future<void> cancel() async {
+    if (_cancelled) return;
+    _cancelled = true;
+    _service._subscriptions.remove(id);
+    await _controller.close();
+    _service._updateEventSubscription();
+    try {
+      await RhythmService._methodChannel.invokeMethod('unsubscribe', {'id': id});
+    } catch (e) {
+      print('RhythmService Error cancelling subscription: $e');
+    }
+  }
+
+  void _add(Float32List bands, Float32List peaks, int timestampUs) {
+    _bands = bands;
+    _peaks = peaks;
+    _lastFrameTimestampUs = timestampUs;
+    _controller.add(bands);
+  }
+}
+
 /// 节奏律动服务 - 桥接 Windows 原生音频捕获
 class RhythmService {
   static final RhythmService _instance = RhythmService._internal();
@@ -10,32 +507,109 @@ class RhythmService {
 
   static const MethodChannel _methodChannel = MethodChannel('com.cyrene.music/rhythm_method');
   static const EventChannel _eventChannel = EventChannel('com.cyrene.music/rhythm_event');
+  static const EventChannel _beatChannel = EventChannel('com.cyrene.music/rhythm_beat');
 
   StreamSubscription? _subscription;
-  final _bandsController = StreamController<List<double>>.broadcast();
+  StreamSubscription? _beatSubscription;
+  // 仅在有订阅者时才订阅原生事件通道；两个通道都无人订阅时原生端会暂停采集。
+  // 频段、响度与统计共用同一个事件通道
+  late final _bandsController = StreamController<List<double>>.broadcast(
+      onListen: _updateEventSubscription, onCancel: _updateEventSubscription);
+  late final _loudnessController = StreamController<RhythmLoudness>.broadcast(
+      onListen: _listenLoudness, onCancel: _releaseLoudness);
+  late final _beatController = StreamController<RhythmBeat>.broadcast(
+      onListen: _listenBeats, onCancel: _releaseBeats);
+  late final _statsController = StreamController<RhythmEngineStats>.broadcast(
+      onListen: _updateEventSubscription, onCancel: _updateEventSubscription);
+  late final _stereoController = StreamController<RhythmStereo>.broadcast(
+      onListen: _updateEventSubscription, onCancel: _updateEventSubscription);
+  late final _featuresController = StreamController<RhythmFeatures>.broadcast(
+      onListen: _updateEventSubscription, onCancel: _updateEventSubscription);
+  late final _chromaController = StreamController<RhythmChroma>.broadcast(
+      onListen: _updateEventSubscription, onCancel: _updateEventSubscription);
+  late final _percussiveController = StreamController<RhythmPercussive>.broadcast(
+      onListen: _updateEventSubscription, onCancel: _updateEventSubscription);
+  late final _batchController = StreamController<RhythmFrameBatch>.broadcast(
+      onListen: _updateEventSubscription, onCancel: _updateEventSubscription);
+  // 起音与节拍共用节拍通道
+  late final _onsetController = StreamController<RhythmOnset>.broadcast(
+      onListen: _listenBeats, onCancel: _releaseBeats);
 
-  /// 实时频段数据流 (16 个频段)
+  // 按编号索引的独立频段订阅，其帧也经由频段事件通道送达
+  final Map<int, RhythmSubscription> _subscriptions = {};
+
+  /// 实时频段数据流 (默认 16 个线性频段，可通过 [setBandLayout] 修改)。
+  /// 增益、起落平滑均由原生分析线程完成，这里的值可直接用于绘制。
+  /// 输出持续静音超过静音超时 (见 [setSilenceTimeout]) 后推送一帧全零并暂停，直到再次有声音
   Stream<List<double>> get bandsStream => _bandsController.stream;
 
+  /// 批量帧流：批量模式 (见 [setFrameBatching]) 下推送每一个分析帧及其采集时间，
+  /// 可按时间戳逐帧回放；[bandsStream] 仍只推送每批的最后一帧
+  Stream<RhythmFrameBatch> get batchStream => _batchController.stream;
+
+  /// 节拍事件流 (频谱通量起音检测 + 速度追踪，由原生端复用已计算的 FFT 得出)。
+  /// 原生端只在节拍通道有订阅者时追踪节拍，重新订阅后速度需重新估计
+  Stream<RhythmBeat> get beatStream => _beatController.stream;
+
+  /// 响度流 (EBU R128 瞬时/短期/综合响度与真峰值，约每 100 ms 一次)。
+  /// 立体声输出的左右声道分别计权后求和。原生端只在本流有订阅者时运行响度计，
+  /// 重新订阅后综合响度与真峰值从头测量
+  Stream<RhythmLoudness> get loudnessStream => _loudnessController.stream;
+
+  /// 自检统计流：启用统计 (见 [setStatsEnabled]) 且正在采集时每秒推送一次
+  Stream<RhythmEngineStats> get statsStream => _statsController.stream;
+
+  /// 立体声流：启用立体声模式 (见 [setStereo]) 后每个分析帧推送一次
+  Stream<RhythmStereo> get stereoStream => _stereoController.stream;
+
+  /// 音色特征流：启用 (见 [setSpectralFeatures]) 后按设定的频率推送
+  Stream<RhythmFeatures> get featuresStream => _featuresController.stream;
+
+  /// 音级与调性流：启用 (见 [setChroma]) 后约每 0.25 秒推送一次
+  Stream<RhythmChroma> get chromaStream => _chromaController.stream;
+
+  /// 打击乐频段流：启用打击乐分离 (见 [setPercussive]) 后每个分析帧推送一次
+  Stream<RhythmPercussive> get percussiveStream => _percussiveController.stream;
+
+  /// 打击乐起音流：启用打击乐分离 (见 [setPercussive]) 后每次鼓点推送一次，
+  /// 不受贝斯、人声等持续音的影响
+  Stream<RhythmOnset> get onsetStream => _onsetController.stream;
+
+  /// 当前速度估计 (BPM)，约每 0.5 秒更新一次；尚未估计出时为 0
+  double _bpm = 0.0;
+  double get bpm => _bpm;
+
+  /// 速度估计的可信度 (0 ~ 1)
+  double _tempoConfidence = 0.0;
+  double get tempoConfidence => _tempoConfidence;
+
   bool _isStarted = false;
   bool get isStarted => _isStarted;
 
-  // 平滑处理后的数据
-  List<double> _smoothedBands = List.filled(16, 0.0);
-  static const double _lerpFactor = 0.2; // 平滑因子，越小越丝滑但延迟越高
+  /// 最近一帧的采集时间 (微秒，与原生单调时钟同源)，用于和播放位置对齐；
+  /// 仅在批量模式 (见 [setFrameBatching]) 下更新
+  int _lastFrameTimestampUs = 0;
+  int get lastFrameTimestampUs => _lastFrameTimestampUs;
+
+  // 最近一帧的频段值与峰值保持标记 (均为原生消息上的视图，不复制)
+  Float32List _bands = Float32List(16);
+  Float32List _peaks = Float32List(16);
+
+  /// 最近一帧各频段的峰值保持标记 (0 ~ 1)，与 bandsStream 的频段一一对应
+  Float32List get peaks => _peaks;
+
+  // 参与 bassIntensity 计算的低频频段数，由 setBandLayout 按中心频率确定
+  int _bassBandCount = 3;
+  static const double _bassCutoffHz = 250.0;
 
   /// 开始捕获
   Future<void> start() async {
     if (_isStarted) return;
     try {
       await _methodChannel.invokeMethod('start');
-      _subscription = _eventChannel.receiveBroadcastStream().listen((dynamic event) {
-        if (event is List) {
-          final List<double> rawBands = event.cast<double>();
-          _processBands(rawBands);
-        }
-      });
       _isStarted = true;
+      _updateEventSubscription();
+      if (_beatController.hasListener || _onsetController.hasListener) _listenBeats();
     } catch (e) {
       print('RhythmService Error starting: $e');
     }
@@ -46,32 +620,595 @@ class RhythmService {
     if (!_isStarted) return;
     try {
       await _methodChannel.invokeMethod('stop');
-      await _subscription?.cancel();
-      _subscription = null;
+      _cancelEvents();
+      _cancelBeats();
+      _bpm = 0.0;
+      _tempoConfidence = 0.0;
       _isStarted = false;
       
       // 重置数据
-      _smoothedBands = List.filled(16, 0.0);
-      _bandsController.add(_smoothedBands);
+      _bands = Float32List(_bands.length);
+      _peaks = Float32List(_peaks.length);
+      _bandsController.add(_bands);
     } catch (e) {
       print('RhythmService Error stopping: $e');
     }
   }
 
-  void _processBands(List<double> rawBands) {
-    if (rawBands.length != _smoothedBands.length) return;
+  /// 设置 FFT 点数 (32 ~ 16384 之间的 2 的幂) 和帧移 [hop] (1 ~ size，默认 size/2 即 50% 重叠)，
+  /// 原生端会在下一帧前重新规划
+  Future<bool> setFftSize(int size, {int hop = 0}) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setFftSize', {'size': size, 'hop': hop});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting FFT size: $e');
+      return false;
+    }
+  }
 
-    // 应用平滑算法
-    for (int i = 0; i < rawBands.length; i++) {
-      _smoothedBands[i] = _smoothedBands[i] + (rawBands[i] - _smoothedBands[i]) * _lerpFactor;
+  /// 设置分析模式：'fft' 为单一窗长的 FFT (默认)；'multires' 为多分辨率 (恒 Q) 频谱，
+  /// 每八度 24 个按十二平均律排列的频点，高频用短窗、低频用长窗，在相同帧移下低频分辨率更高。
+  /// 帧移仍由 [setFftSize] 决定。'filterbank' 为逐样本更新的谐振器组 (滑动 Goertzel)，
+  /// 每个频段一个谐振器，适合频段很少的可视化；当频段数多到 FFT 更快时 (原生端在本机实测两者)，或有频段订阅者时，
+  /// 引擎自动改用 FFT。切换后频段中心频率会改变，需重新调用 [setBandLayout] 获取。
+  Future<bool> setAnalysisMode(String mode) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setAnalysisMode', {'mode': mode});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting analysis mode: $e');
+      return false;
+    }
+  }
+
+  /// 设置 FFT 模式的降采样：[factor] 为 1 (不降采样，默认) / 2 / 4 / 8，0 为按设备采样率自动选择
+  /// (保留至少 4 kHz 的频带)。先经多相抗混叠滤波降采样，再做同等时长、同等频率间隔但小 [factor] 倍的 FFT，
+  /// 适合 96/192 kHz 输出设备。[treble] 为 true 时另以全采样率计算高频部分；否则频段只覆盖降采样后的通带。
+  /// 切换后频段中心频率可能改变，需重新调用 [setBandLayout] 获取。
+  Future<bool> setDecimation(int factor, {bool treble = false}) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setDecimation', {'factor': factor, 'treble': treble});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting decimation: $e');
+      return false;
+    }
+  }
+
+  /// 设置频段划分：[scale] 为 'linear' / 'log' / 'mel' / 'bark'，[count] 为 4 ~ 128。
+  /// 返回各频段中心频率 (Hz)，失败时返回 null
+  Future<List<double>?> setBandLayout(String scale, int count) async {
+    try {
+      final result = await _methodChannel.invokeMethod<Float32List>(
+          'setBandLayout', {'scale': scale, 'count': count});
+      if (result != null && result.isNotEmpty) {
+        int count = 1;
+        while (count < result.length && result[count] < _bassCutoffHz) {
+          count++;
+        }
+        _bassBandCount = count;
+      }
+      return result;
+    } catch (e) {
+      print('RhythmService Error setting band layout: $e');
+      return null;
+    }
+  }
+
+  /// 调整原生端的动态处理：起音/释放时间 (毫秒)、峰值保持时间 (毫秒)、
+  /// 峰值下落速度 (满刻度/秒) 与自动增益开关；未传入的参数保持不变
+  Future<bool> setDynamics({
+    double? attackMs,
+    double? releaseMs,
+    double? peakHoldMs,
+    double? peakFallPerSec,
+    bool? autoGain,
+  }) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setDynamics', {
+        if (attackMs != null) 'attackMs': attackMs,
+        if (releaseMs != null) 'releaseMs': releaseMs,
+        if (peakHoldMs != null) 'peakHoldMs': peakHoldMs,
+        if (peakFallPerSec != null) 'peakFallPerSec': peakFallPerSec,
+        if (autoGain != null) 'autoGain': autoGain,
+      });
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting dynamics: $e');
+      return false;
+    }
+  }
+
+  /// 设置批量推送：[frames] 为 0 时每个刷新周期推送最新一帧；
+  /// 大于 0 (最多 32) 时推送每一个分析帧，每条消息打包 [frames] 帧及其时间戳，
+  /// 凑满一批才发送 (频段数改变时除外)，整批经 [batchStream] 送达
+  Future<bool> setFrameBatching(int frames) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setFrameBatching', {'frames': frames});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting frame batching: $e');
+      return false;
+    }
+  }
+
+  /// 设置静音超时 (毫秒，0 ~ 60000，默认 1000)：输出持续静音这么久后，
+  /// 频段归零且原生分析暂停，不再占用 CPU，直到再次有声音
+  Future<bool> setSilenceTimeout(int ms) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setSilenceTimeout', {'ms': ms});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting silence timeout: $e');
+      return false;
+    }
+  }
+
+  /// 新建一路独立的频段订阅 (原生端最多同时 8 路，另计 [bandsStream])。
+  /// [scale] / [count] 同 [setBandLayout]；[maxRate] 为每秒最多推送的帧数，0 表示每个分析帧都推送；
+  /// 其余参数同 [setDynamics]，未传入时取默认值。所有订阅共用同一路采集与同一次 FFT，
+  /// 频段投影与平滑在原生分析线程上按订阅分别完成。失败时返回 null
+  Future<RhythmSubscription?> subscribe({
+    String scale = 'linear',
+    int count = 16,
+    double maxRate = 0.0,
+    double? attackMs,
+    double? releaseMs,
+    double? peakHoldMs,
+    double? peakFallPerSec,
+    bool? autoGain,
+  }) async {
+    try {
+      final result = await _methodChannel.invokeMapMethod<String, dynamic>('subscribe', {
+        'scale': scale,
+        'count': count,
+        'maxRate': maxRate,
+        if (attackMs != null) 'attackMs': attackMs,
+        if (releaseMs != null) 'releaseMs': releaseMs,
+        if (peakHoldMs != null) 'peakHoldMs': peakHoldMs,
+        if (peakFallPerSec != null) 'peakFallPerSec': peakFallPerSec,
+        if (autoGain != null) 'autoGain': autoGain,
+      });
+      final id = result?['id'];
+      final centers = result?['centers'];
+      if (id is! int || centers is! Float32List) return null;
+      final subscription = RhythmSubscription._(this, id, centers);
+      _subscriptions[id] = subscription;
+      return subscription;
+    } catch (e) {
+      print('RhythmService Error subscribing: $e');
+      return null;
+    }
+  }
+
+  /// 开关立体声模式：原生端额外采集侧信号，把中/侧两路打包进一次复数 FFT 同时分析，
+  /// 经 [stereoStream] 推送左右 ([channels] 为 'lr'，默认) 或中侧 ('ms') 两路频段、
+  /// 相位相关度与立体声宽度；主频段流不受影响。采集中开关会重启采集，速度与响度随之重置
+  Future<bool> setStereo(bool enabled, {String channels = 'lr'}) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setStereo', {'enabled': enabled, 'channels': channels});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting stereo: $e');
+      return false;
+    }
+  }
+
+  /// 开关音色特征：原生端从每帧已算好的频谱一次性求出质心、滚降点、平坦度与通量，
+  /// 并统计过零率，经 [featuresStream] 推送自上一条以来的平均值，每秒至多 [maxRate] 条
+  /// (0 为每帧一条)
+  Future<bool> setSpectralFeatures(bool enabled, {double maxRate = 0.0}) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>(
+          'setSpectralFeatures', {'enabled': enabled, 'maxRate': maxRate});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting spectral features: $e');
+      return false;
+    }
+  }
+
+  /// 开关音级与调性估计：原生端用预先算好的折叠表把每帧频谱的峰值归入十二个音级，
+  /// 平滑后与大小调轮廓求相关得出调性，经 [chromaStream] 推送。启用期间滤波器组模式
+  /// 改用 FFT；FFT 越大 (或使用多分辨率模式) 低音越准，调性越可靠
+  Future<bool> setChroma(bool enabled) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setChroma', {'enabled': enabled});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting chroma: $e');
+      return false;
+    }
+  }
+
+  /// 开关打击乐分离：原生端对每帧频谱沿时间与沿频率各取中值，把鼓等打击乐与持续音
+  /// 分开，经 [percussiveStream] 推送只含打击乐的频段，并经 [onsetStream] 推送鼓点。
+  /// 启用期间滤波器组模式改用 FFT
+  Future<bool> setPercussive(bool enabled) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setPercussive', {'enabled': enabled});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting percussive separation: $e');
+      return false;
+    }
+  }
+
+  /// 重置综合响度与真峰值 (例如切换曲目时)
+  Future<bool> resetLoudness() async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('resetLoudness');
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error resetting loudness: $e');
+      return false;
+    }
+  }
+
+  void _listenLoudness() {
+    _setLoudness(true);
+    _updateEventSubscription();
+  }
+
+  void _releaseLoudness() {
+    _setLoudness(false);
+    _updateEventSubscription();
+  }
+
+  // 响度计只在响度流有订阅者时运行
+  Future<void> _setLoudness(bool enabled) async {
+    try {
+      await _methodChannel.invokeMethod<bool>('setLoudness', {'enabled': enabled});
+    } catch (e) {
+      print('RhythmService Error setting loudness: $e');
+    }
+  }
+
+  // 频段、响度、统计、立体声、音色特征、音级、打击乐、批量帧或任一独立订阅有订阅者时订阅原生事件通道，都没有时取消
+  void _updateEventSubscription() {
+    if (!_bandsController.hasListener &&
+        !_loudnessController.hasListener &&
+        !_statsController.hasListener &&
+        !_stereoController.hasListener &&
+        !_featuresController.hasListener &&
+        !_chromaController.hasListener &&
+        !_percussiveController.hasListener &&
+        !_batchController.hasListener &&
+        !_subscriptions.values.any((s) => s._controller.hasListener)) {
+      _cancelEvents();
+      return;
+    }
+    if (!_isStarted || _subscription != null) return;
+    _subscription = _eventChannel.receiveBroadcastStream().listen((dynamic event) {
+      if (event is Float32List) {
+        _processBands(event);
+      } else if (event is Map) {
+        final type = event['type'];
+        if (type == 'subscriber') {
+          _processSubscriberFrame(event);
+        } else if (type == 'loudness') {
+          _processLoudness(event);
+        } else if (type == 'stats') {
+          _statsController.add(RhythmEngineStats.fromMap(event));
+        } else if (type == 'stereo') {
+          _processStereo(event);
+        } else if (type == 'features') {
+          _processFeatures(event);
+        } else if (type == 'chroma') {
+          _processChroma(event);
+        } else if (type == 'percussive') {
+          _processPercussive(event);
+        } else {
+          _processBatch(event);
+        }
+      }
+    });
+  }
+
+  void _cancelEvents() {
+    _subscription?.cancel();
+    _subscription = null;
+  }
+
+  void _listenBeats() {
+    if (!_isStarted || _beatSubscription != null) return;
+    _beatSubscription = _beatChannel.receiveBroadcastStream().listen(_processBeatEvent);
+  }
+
+  // 节拍与起音都无人订阅时才取消节拍通道
+  void _releaseBeats() {
+    if (!_beatController.hasListener && !_onsetController.hasListener) _cancelBeats();
+  }
+
+  void _cancelBeats() {
+    _beatSubscription?.cancel();
+    _beatSubscription = null;
+  }
+
+  /// 开关原生端的自检统计 (默认关闭，关闭时几乎没有开销)；已有计数保留。
+  /// 返回原生端是否编译了统计代码
+  Future<bool> setStatsEnabled(bool enabled) async {
+    try {
+      final result = await _methodChannel.invokeMethod<bool>('setStatsEnabled', {'enabled': enabled});
+      return result ?? false;
+    } catch (e) {
+      print('RhythmService Error setting stats: $e');
+      return false;
+    }
+  }
+
+  /// 获取自检统计的当前值
+  Future<RhythmEngineStats?> getStats() async {
+    try {
+      final result = await _methodChannel.invokeMapMethod<dynamic, dynamic>('getStats');
+      return result == null ? null : RhythmEngineStats.fromMap(result);
+    } catch (e) {
+      print('RhythmService Error getting stats: $e');
+      return null;
+    }
+  }
+
+  /// 获取采集环形缓冲区状态 (容量、高水位、溢出丢弃的采样数等)
+  Future<Map<String, int>> getBufferStats() async {
+    try {
+      final result = await _methodChannel.invokeMapMethod<String, int>('getBufferStats');
+      return result ?? const {};
+    } catch (e) {
+      print('RhythmService Error getting buffer stats: $e');
+      return const {};
+    }
+  }
+
+  /// 在原生后台线程上解码并分析 [path] 处的整首歌曲 (与实时采集无关，可同时分析多首)，
+  /// 结果同时写入 [directory] 下以 [cacheKey] 命名的 .rhythm 文件，之后可用
+  /// [readTrackAnalysis] 直接读取；同一次解码还生成 .peaks 波形文件 (见 [queryWaveform])。[encryptionKey] 非空时 [path] 为 .cyrene 缓存文件，
+  /// 原生端在内存中解密后再解码。失败时返回 null
+  Future<RhythmTrackAnalysis?> analyzeTrack({
+    required String path,
+    required String directory,
+    required String cacheKey,
+    String? encryptionKey,
+  }) async {
+    try {
+      final result = await _methodChannel.invokeMapMethod<dynamic, dynamic>('analyzeTrack', {
+        'path': path,
+        'directory': directory,
+        'cacheKey': cacheKey,
+        if (encryptionKey != null) 'encryptionKey': encryptionKey,
+      });
+      return result == null ? null : RhythmTrackAnalysis.fromMap(result);
+    } catch (e) {
+      print('RhythmService Error analyzing track: $e');
+      return null;
     }
+  }
+
+  /// 读取 [analyzeTrack] 为 [cacheKey] 保存的分析结果，尚未分析过时返回 null
+  Future<RhythmTrackAnalysis?> readTrackAnalysis({
+    required String directory,
+    required String cacheKey,
+  }) async {
+    try {
+      final result = await _methodChannel.invokeMapMethod<dynamic, dynamic>(
+          'readTrackAnalysis', {'directory': directory, 'cacheKey': cacheKey});
+      return result == null ? null : RhythmTrackAnalysis.fromMap(result);
+    } catch (e) {
+      print('RhythmService Error reading track analysis: $e');
+      return null;
+    }
+  }
+
+  /// 读取 [analyzeTrack] 为 [cacheKey] 生成的波形：把 [startMs] ~ [endMs]
+  /// (默认整首) 均分成 [columns] 列 (1 ~ 16384)。原生端从多级峰值金字塔中选取合适的一级，
+  /// 耗时只与列数有关，与时间范围无关，可在缩放、拖动时反复调用。尚未生成时返回 null
+  Future<RhythmWaveform?> queryWaveform({
+    required String directory,
+    required String cacheKey,
+    required int columns,
+    int startMs = 0,
+    int endMs = 0,
+  }) async {
+    try {
+      final result = await _methodChannel.invokeMethod<Float32List>('queryWaveform', {
+        'directory': directory,
+        'cacheKey': cacheKey,
+        'columns': columns,
+        'startMs': startMs,
+        'endMs': endMs,
+      });
+      return result == null ? null : RhythmWaveform.fromPayload(result);
+    } catch (e) {
+      print('RhythmService Error querying waveform: $e');
+      return null;
+    }
+  }
+
+  /// 单帧消息：Float32List，前半为各频段值，后半为对应的峰值标记
+  void _processBands(Float32List payload) {
+    final bandCount = payload.length ~/ 2;
+    if (bandCount == 0) return;
+    _bands = Float32List.sublistView(payload, 0, bandCount);
+    _peaks = Float32List.sublistView(payload, bandCount, 2 * bandCount);
+    _bandsController.add(_bands);
+  }
+
+  /// 批量消息：{bandCount, timestampsUs: Int64List, bands: Float32List, peaks: Float32List}，
+  /// 整批经 [batchStream] 推送，最后一帧另经 [bandsStream] 推送。频段数改变时一批可能不足设定帧数
+  void _processBatch(Map<dynamic, dynamic> event) {
+    final bandCount = event['bandCount'];
+    final timestamps = event['timestampsUs'];
+    final bands = event['bands'];
+    final peaks = event['peaks'];
+    if (bandCount is! int || timestamps is! Int64List || bands is! Float32List || peaks is! Float32List) return;
+    if (timestamps.isEmpty || bands.length != timestamps.length * bandCount || peaks.length != bands.length) return;
+
+    _batchController.add(RhythmFrameBatch(
+      bandCount: bandCount,
+      timestampsUs: timestamps,
+      bands: bands,
+      peaks: peaks,
+    ));
+    final offset = bands.length - bandCount;
+    _lastFrameTimestampUs = timestamps.last;
+    _bands = Float32List.sublistView(bands, offset);
+    _peaks = Float32List.sublistView(peaks, offset);
+    _bandsController.add(_bands);
+  }
 
-    _bandsController.add(List.from(_smoothedBands));
+  /// 独立订阅的帧：{type: 'subscriber', id, timestampUs, bands: Float32List, peaks: Float32List}
+  void _processSubscriberFrame(Map<dynamic, dynamic> event) {
+    final subscription = _subscriptions[event['id']];
+    final timestampUs = event['timestampUs'];
+    final bands = event['bands'];
+    final peaks = event['peaks'];
+    if (subscription == null || timestampUs is! int || bands is! Float32List || peaks is! Float32List) return;
+    subscription._add(bands, peaks, timestampUs);
   }
-  
-  /// 获取低频强度 (Bass) - 通常是前 3 个频段
+
+  /// 响度消息：{type: 'loudness', timestampUs, momentary, shortTerm, integrated, truePeak}
+  void _processLoudness(Map<dynamic, dynamic> event) {
+    final timestampUs = event['timestampUs'];
+    final momentary = event['momentary'];
+    final shortTerm = event['shortTerm'];
+    final integrated = event['integrated'];
+    final truePeak = event['truePeak'];
+    if (timestampUs is! int || momentary is! double || shortTerm is! double ||
+        integrated is! double || truePeak is! double) return;
+    _loudnessController.add(RhythmLoudness(
+      timestampUs: timestampUs,
+      momentary: momentary,
+      shortTerm: shortTerm,
+      integrated: integrated,
+      truePeak: truePeak,
+    ));
+  }
+
+  /// 立体声消息：{type: 'stereo', timestampUs, channels, correlation, width, bandCount,
+  /// bands: Float32List, peaks: Float32List}，bands/peaks 前半为第一路，后半为第二路
+  void _processStereo(Map<dynamic, dynamic> event) {
+    final timestampUs = event['timestampUs'];
+    final channels = event['channels'];
+    final correlation = event['correlation'];
+    final width = event['width'];
+    final bandCount = event['bandCount'];
+    final bands = event['bands'];
+    final peaks = event['peaks'];
+    if (timestampUs is! int || channels is! String || correlation is! double ||
+        width is! double || bandCount is! int || bands is! Float32List || peaks is! Float32List) return;
+    if (bands.length != 2 * bandCount || peaks.length != bands.length) return;
+    _stereoController.add(RhythmStereo(
+      timestampUs: timestampUs,
+      channels: channels,
+      correlation: correlation,
+      width: width,
+      firstBands: Float32List.sublistView(bands, 0, bandCount),
+      secondBands: Float32List.sublistView(bands, bandCount),
+      firstPeaks: Float32List.sublistView(peaks, 0, bandCount),
+      secondPeaks: Float32List.sublistView(peaks, bandCount),
+    ));
+  }
+
+  /// 音色特征消息：{type: 'features', timestampUs, silent, centroid, rolloff, flatness,
+  /// flux, zeroCrossingRate}
+  void _processFeatures(Map<dynamic, dynamic> event) {
+    final timestampUs = event['timestampUs'];
+    final silent = event['silent'];
+    final centroid = event['centroid'];
+    final rolloff = event['rolloff'];
+    final flatness = event['flatness'];
+    final flux = event['flux'];
+    final zeroCrossingRate = event['zeroCrossingRate'];
+    if (timestampUs is! int || silent is! bool || centroid is! double || rolloff is! double ||
+        flatness is! double || flux is! double || zeroCrossingRate is! double) return;
+    _featuresController.add(RhythmFeatures(
+      timestampUs: timestampUs,
+      silent: silent,
+      centroid: centroid,
+      rolloff: rolloff,
+      flatness: flatness,
+      flux: flux,
+      zeroCrossingRate: zeroCrossingRate,
+    ));
+  }
+
+  /// 音级消息：{type: 'chroma', timestampUs, silent, chroma: Float32List, tonic, mode, confidence}
+  void _processChroma(Map<dynamic, dynamic> event) {
+    final timestampUs = event['timestampUs'];
+    final silent = event['silent'];
+    final chroma = event['chroma'];
+    final tonic = event['tonic'];
+    final mode = event['mode'];
+    final confidence = event['confidence'];
+    if (timestampUs is! int || silent is! bool || chroma is! Float32List || chroma.length != 12 ||
+        tonic is! int || tonic > 11 || mode is! String || confidence is! double) return;
+    _chromaController.add(RhythmChroma(
+      timestampUs: timestampUs,
+      silent: silent,
+      chroma: chroma,
+      tonic: tonic,
+      mode: mode,
+      confidence: confidence,
+    ));
+  }
+
+  /// 打击乐消息：{type: 'percussive', timestampUs, silent, bands: Float32List,
+  /// peaks: Float32List}
+  void _processPercussive(Map<dynamic, dynamic> event) {
+    final timestampUs = event['timestampUs'];
+    final silent = event['silent'];
+    final bands = event['bands'];
+    final peaks = event['peaks'];
+    if (timestampUs is! int || silent is! bool || bands is! Float32List || peaks is! Float32List) return;
+    if (peaks.length != bands.length) return;
+    _percussiveController.add(RhythmPercussive(
+      timestampUs: timestampUs,
+      silent: silent,
+      bands: bands,
+      peaks: peaks,
+    ));
+  }
+
+  /// 节拍通道消息：{type: 'beat', timestampUs, strength, confidence, bpm}、
+  /// {type: 'tempo', bpm, confidence} 或 {type: 'onset', timestampUs, strength}
+  void _processBeatEvent(dynamic event) {
+    if (event is! Map) return;
+    final type = event['type'];
+    if (type == 'onset') {
+      final timestampUs = event['timestampUs'];
+      final strength = event['strength'];
+      if (timestampUs is! int || strength is! double) return;
+      _onsetController.add(RhythmOnset(timestampUs: timestampUs, strength: strength));
+      return;
+    }
+    final bpm = event['bpm'];
+    final confidence = event['confidence'];
+    if (bpm is! double || confidence is! double) return;
+    if (type == 'tempo') {
+      _bpm = bpm;
+      _tempoConfidence = confidence;
+    } else if (type == 'beat') {
+      final timestampUs = event['timestampUs'];
+      final strength = event['strength'];
+      if (timestampUs is! int || strength is! double) return;
+      _beatController.add(RhythmBeat(
+        timestampUs: timestampUs,
+        strength: strength,
+        confidence: confidence,
+        bpm: bpm,
+      ));
+    }
+  }
+
+  /// 获取低频强度 (Bass)：中心频率低于 250 Hz 的频段均值 (至少取第一个频段)；
+  /// 未设置频段划分时沿用前 3 个频段
   double get bassIntensity {
-    if (_smoothedBands.isEmpty) return 0.0;
-    return (_smoothedBands[0] + _smoothedBands[1] + _smoothedBands[2]) / 3.0;
+    final count = _bassBandCount < _bands.length ? _bassBandCount : _bands.length;
+    if (count == 0) return 0.0;
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+      sum += _bands[i];
+    }
+    return sum / count;
   }
-}
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
 import 'dart:math' as math;
 import 'package:flutter/material.dart';
+import '../models/track.dart';
+import '../services/cache_service.dart';
+import '../services/rhythm_service.dart';
 
 class WavySplitProgressBar extends StatefulWidget {
   final double value; // 0.0 to 1.0
@@ -10,6 +13,8 @@ class WavySplitProgressBar extends StatefulWidget {
   final double height;
   final double waveAmplitude;
   final double waveFrequency;
+  /// 当前歌曲；已缓存时进度条显示其真实波形，否则显示装饰波浪
+  final Track? track;
 
   const WavySplitProgressBar({
     super.key,
@@ -21,6 +26,7 @@ class WavySplitProgressBar extends StatefulWidget {
     this.height = 40.0,
     this.waveAmplitude = 4.0,
     this.waveFrequency = 0.12, // 增加频率让波浪更多
+    this.track,
   });
 
   @override
@@ -32,6 +38,10 @@ class _WavySplitProgressBarState extends State<WavySplitProgressBar>
   late AnimationController _phaseController;
   late AnimationController _amplitudeController;
 
+  // 波形列数，绘制时按宽度取样
+  static const int _waveformColumns = 256;
+  RhythmWaveform? _waveform;
+
   @override
   void initState() {
     super.initState();
@@ -45,11 +55,29 @@ class _WavySplitProgressBarState extends State<WavySplitProgressBar>
       duration: const Duration(milliseconds: 500),
       value: widget.isPlaying ? 1.0 : 0.0,
     );
+    _loadWaveform();
+  }
+
+  bool _isSameTrack(Track? a, Track? b) {
+    return a?.id == b?.id && a?.source == b?.source;
+  }
+
+  Future<void> _loadWaveform() async {
+    final track = widget.track;
+    _waveform = null;
+    if (track == null) return;
+    final waveform = await CacheService().getCachedWaveform(track, _waveformColumns);
+    // 加载期间可能已切换歌曲
+    if (!mounted || !_isSameTrack(track, widget.track)) return;
+    setState(() => _waveform = waveform);
   }
 
   @override
   void didUpdateWidget(WavySplitProgressBar oldWidget) {
     super.didUpdateWidget(oldWidget);
+    if (!_isSameTrack(widget.track, oldWidget.track)) {
+      _loadWaveform();
+    }
     if (widget.isPlaying != oldWidget.isPlaying) {
       if (widget.isPlaying) {
         _amplitudeController.forward();
@@ -106,6 +134,7 @@ class _WavySplitProgressBarState extends State<WavySplitProgressBar>
                     inactiveColor: inactiveColor,
                     waveAmplitude: widget.waveAmplitude,
                     waveFrequency: widget.waveFrequency,
+                    waveform: _waveform,
                   ),
                 );
               },
@@ -125,6 +154,7 @@ class _WavySplitPainter extends CustomPainter {
   final Color inactiveColor;
   final double waveAmplitude;
   final double waveFrequency;
+  final RhythmWaveform? waveform;
 
   _WavySplitPainter({
     required this.value,
@@ -134,6 +164,7 @@ class _WavySplitPainter extends CustomPainter {
     required this.inactiveColor,
     required this.waveAmplitude,
     required this.waveFrequency,
+    this.waveform,
   });
 
   @override
@@ -150,8 +181,12 @@ class _WavySplitPainter extends CustomPainter {
       ..strokeJoin = StrokeJoin.round
       ..strokeWidth = trackHeight;
 
-    // 1. 绘制已播放部分 (左侧)
-    if (progressX > 0) {
+    // 1. 绘制已播放部分 (左侧)：有波形时两侧均为真实波形，否则为装饰波浪
+    final waveform = this.waveform;
+    final hasWaveform = waveform != null && waveform.columns > 0;
+    if (hasWaveform) {
+      _paintWaveform(canvas, size, waveform!, progressX - thumbWidth / 2, progressX + gap);
+    } else if (progressX > 0) {
       canvas.save();
       // 裁剪区域，防止波浪由于 strokeWidth 或计算误差溢出到滑块右侧
       final clipRect = Rect.fromLTWH(0, centerY - waveAmplitude - 10, progressX - thumbWidth / 2, (waveAmplitude + 10) * 2);
@@ -187,7 +222,7 @@ class _WavySplitPainter extends CustomPainter {
     canvas.drawRRect(thumbRect, thumbPaint);
 
     // 绘制未播放部分 (右侧) - 保持 gap
-    if (progressX < size.width - gap) {
+    if (!hasWaveform && progressX < size.width - gap) {
       final startX = progressX + gap;
       paint.color = inactiveColor;
       paint.style = PaintingStyle.stroke;
@@ -195,9 +230,39 @@ class _WavySplitPainter extends CustomPainter {
     }
   }
 
+  /// 按列绘制波形，[playedEndX] 左侧用 activeColor、[unplayedStartX] 右侧用 inactiveColor：
+  /// 淡色竖线为峰值，实色竖线为均方根，暂停时随 amplitudeFactor 收拢一半
+  void _paintWaveform(Canvas canvas, Size size, RhythmWaveform waveform,
+      double playedEndX, double unplayedStartX) {
+    const step = 3.0;
+    final centerY = size.height / 2;
+    final scale = (size.height / 2 - 2) * (0.5 + 0.5 * amplitudeFactor);
+    final peakPaint = Paint()
+      ..strokeCap = StrokeCap.round
+      ..strokeWidth = 2.0;
+    final rmsPaint = Paint()
+      ..strokeCap = StrokeCap.round
+      ..strokeWidth = 2.0;
+
+    for (double x = step / 2; x < size.width; x += step) {
+      if (x >= playedEndX && x <= unplayedStartX) continue;
+      final color = x < playedEndX ? activeColor : inactiveColor;
+      peakPaint.color = color.withOpacity(color.opacity * 0.45);
+      rmsPaint.color = color;
+      final column = (x / size.width * waveform.columns).floor().clamp(0, waveform.columns - 1);
+      final top = math.max(waveform.max[column], 0.0) * scale;
+      final bottom = math.min(waveform.min[column], 0.0) * scale;
+      final rms = waveform.rms[column] * scale;
+      // 静音处保留一个点，保持进度可见
+      canvas.drawLine(Offset(x, centerY - top - 1), Offset(x, centerY - bottom + 1), peakPaint);
+      canvas.drawLine(Offset(x, centerY - rms - 1), Offset(x, centerY + rms + 1), rmsPaint);
+    }
+  }
+
   @override
   bool shouldRepaint(covariant _WavySplitPainter oldDelegate) {
     return oldDelegate.value != value ||
+        oldDelegate.waveform != waveform ||
         oldDelegate.phase != phase ||
         oldDelegate.amplitudeFactor != amplitudeFactor ||
         oldDelegate.activeColor != activeColor ||
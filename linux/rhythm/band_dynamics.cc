@@ -0,0 +1,101 @@
+#include "band_dynamics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+// One-pole smoothing coefficient for time constant |ms| over |dt_seconds|;
+// 1 (jump straight to the input) when the stage is disabled.
+float SmoothingCoefficient(float ms, double dt_seconds) {
+  if (ms <= 0.0f) return 1.0f;
+  return static_cast<float>(1.0 - std::exp(-dt_seconds * 1000.0 / ms));
+}
+
+}  // namespace
+
+void BandDynamics::SetConfig(const DynamicsConfig& config) {
+  config_ = config;
+  coefficients_.dt = -1.0;
+  if (!config_.auto_gain) gain_ = 1.0f;
+}
+
+void BandDynamics::Reset() {
+  count_ = 0;
+  gain_ = 1.0f;
+  agc_level_ = 0.0f;
+  std::fill(envelope_, envelope_ + BandMapper::kMaxBands, 0.0f);
+  std::fill(peak_, peak_ + BandMapper::kMaxBands, 0.0f);
+  std::fill(hold_seconds_, hold_seconds_ + BandMapper::kMaxBands, 0.0f);
+}
+
+void BandDynamics::UpdateCoefficients(double dt_seconds) {
+  // Frames usually arrive at a fixed interval, so the exponentials are only
+  // recomputed when it changes.
+  if (dt_seconds == coefficients_.dt) return;
+  coefficients_.dt = dt_seconds;
+  coefficients_.attack = SmoothingCoefficient(config_.attack_ms, dt_seconds);
+  coefficients_.release = SmoothingCoefficient(config_.release_ms, dt_seconds);
+  coefficients_.agc_attack =
+      SmoothingCoefficient(config_.agc_attack_ms, dt_seconds);
+  coefficients_.agc_release =
+      SmoothingCoefficient(config_.agc_release_ms, dt_seconds);
+}
+
+void BandDynamics::Process(const float* levels, size_t count,
+                           double dt_seconds, float* bands, float* peaks) {
+  count = std::min(count, BandMapper::kMaxBands);
+  if (count != count_) {
+    Reset();
+    count_ = count;
+  }
+  UpdateCoefficients(dt_seconds);
+
+  if (config_.auto_gain && count > 0) {
+    const float loudest = *std::max_element(levels, levels + count);
+    if (loudest >= config_.agc_gate) {
+      if (agc_level_ <= 0.0f) {
+        agc_level_ = loudest;
+      } else {
+        const float coefficient = loudest > agc_level_
+                                      ? coefficients_.agc_attack
+                                      : coefficients_.agc_release;
+        agc_level_ += (loudest - agc_level_) * coefficient;
+      }
+      gain_ = std::clamp(config_.agc_target / agc_level_,
+                         config_.agc_min_gain, config_.agc_max_gain);
+    }
+  }
+
+  const float dt = static_cast<float>(dt_seconds);
+  const float hold = config_.peak_hold_ms / 1000.0f;
+  for (size_t i = 0; i < count; i++) {
+    const float value = config_.clamp
+                            ? std::clamp(levels[i] * gain_, 0.0f, 1.0f)
+                            : levels[i] * gain_;
+    float& envelope = envelope_[i];
+    const float coefficient =
+        value > envelope ? coefficients_.attack : coefficients_.release;
+    envelope = coefficient >= 1.0f
+                   ? value
+                   : envelope + (value - envelope) * coefficient;
+    bands[i] = envelope;
+
+    float& peak = peak_[i];
+    if (config_.peak_fall_per_s <= 0.0f || envelope >= peak) {
+      peak = envelope;
+      hold_seconds_[i] = hold;
+    } else if (hold_seconds_[i] > 0.0f) {
+      hold_seconds_[i] -= dt;
+    } else {
+      peak = std::max(envelope, peak - config_.peak_fall_per_s * dt);
+    }
+    peaks[i] = peak;
+  }
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,106 @@
+#ifndef RHYTHM_BAND_DYNAMICS_H_
+#define RHYTHM_BAND_DYNAMICS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "band_mapper.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Time constants and limits for BandDynamics. Times are in milliseconds;
+// 0 disables the stage.
+struct DynamicsConfig {
+  // Envelope time constants for rising and falling band levels.
+  float attack_ms = 20.0f;
+  float release_ms = 120.0f;
+  // How long a peak marker stays put before falling, and how fast it falls
+  // (in full-scale units per second); a fall of 0 makes the markers follow
+  // the bands.
+  float peak_hold_ms = 300.0f;
+  float peak_fall_per_s = 1.5f;
+  // Slow automatic gain control towards |agc_target| for the loudest band.
+  bool auto_gain = true;
+  float agc_target = 0.8f;
+  float agc_attack_ms = 300.0f;
+  float agc_release_ms = 6000.0f;
+  float agc_min_gain = 0.01f;
+  float agc_max_gain = 8.0f;
+  // Frames whose loudest band is below this level leave the gain alone, so
+  // pauses and fade-outs are not amplified into noise.
+  float agc_gate = 0.02f;
+  // Whether levels are clamped to [0, 1]. Off only where the raw levels
+  // matter more than the display range, as in the benchmark's checksum.
+  bool clamp = true;
+
+  // Levels pass straight through, clamped to [0, 1].
+  static DynamicsConfig Passthrough() {
+    DynamicsConfig config;
+    config.attack_ms = 0.0f;
+    config.release_ms = 0.0f;
+    config.peak_hold_ms = 0.0f;
+    config.peak_fall_per_s = 0.0f;
+    config.auto_gain = false;
+    return config;
+  }
+
+  // Levels pass straight through unchanged, even above full scale.
+  static DynamicsConfig Unclamped() {
+    DynamicsConfig config = Passthrough();
+    config.clamp = false;
+    return config;
+  }
+};
+
+// Turns raw band levels into display values on the analysis thread:
+// automatic gain, clamping to [0, 1] unless disabled, per-band asymmetric
+// attack/release envelopes and peak-hold markers with a linear fall.
+// Smoothing follows the actual time between frames, so it looks the same at
+// any FFT size or hop.
+// Fixed-size state; never allocates.
+class BandDynamics {
+ public:
+  BandDynamics() { Reset(); }
+
+  void SetConfig(const DynamicsConfig& config);
+  const DynamicsConfig& config() const { return config_; }
+
+  // Forgets all envelopes, peaks and the gain.
+  void Reset();
+
+  // Processes |count| raw levels that arrived |dt_seconds| after the
+  // previous frame. Writes |count| envelope values to |bands| and peak
+  // markers to |peaks|. A change of |count| resets the state.
+  void Process(const float* levels, size_t count, double dt_seconds,
+               float* bands, float* peaks);
+
+  float gain() const { return gain_; }
+
+ private:
+  // Smoothing coefficients for the current frame interval.
+  struct Coefficients {
+    double dt = -1.0;
+    float attack = 1.0f;
+    float release = 1.0f;
+    float agc_attack = 1.0f;
+    float agc_release = 1.0f;
+  };
+
+  void UpdateCoefficients(double dt_seconds);
+
+  DynamicsConfig config_;
+  Coefficients coefficients_;
+  size_t count_ = 0;
+  float gain_ = 1.0f;
+  // Smoothed loudest-band level that the gain is derived from.
+  float agc_level_ = 0.0f;
+  float envelope_[BandMapper::kMaxBands];
+  float peak_[BandMapper::kMaxBands];
+  float hold_seconds_[BandMapper::kMaxBands];
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_BAND_DYNAMICS_H_
@@ -0,0 +1,250 @@
+#include "band_mapper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const char* const kScaleNames[] = {"linear", "log", "mel", "bark"};
+
+double HzToScale(BandScale scale, double hz) {
+  switch (scale) {
+    case BandScale::kLog:
+      return std::log2(hz);
+    case BandScale::kMel:
+      return 2595.0 * std::log10(1.0 + hz / 700.0);
+    case BandScale::kBark:
+      return 26.81 * hz / (1960.0 + hz) - 0.53;
+    case BandScale::kLinear:
+      break;
+  }
+  return hz;
+}
+
+double ScaleToHz(BandScale scale, double value) {
+  switch (scale) {
+    case BandScale::kLog:
+      return std::exp2(value);
+    case BandScale::kMel:
+      return 700.0 * (std::pow(10.0, value / 2595.0) - 1.0);
+    case BandScale::kBark:
+      return 1960.0 * (value + 0.53) / (26.28 - value);
+    case BandScale::kLinear:
+      break;
+  }
+  return value;
+}
+
+}  // namespace
+
+SpectrumGrid SpectrumGrid::Linear(size_t fft_size, uint32_t sample_rate) {
+  SpectrumGrid grid;
+  grid.spacing = Spacing::kLinear;
+  grid.bin_count = static_cast<uint32_t>(fft_size / 2 + 1);
+  grid.sample_rate = sample_rate;
+  grid.fft_size = static_cast<uint32_t>(fft_size);
+  return grid;
+}
+
+SpectrumGrid SpectrumGrid::Log(double min_hz, uint32_t bins_per_octave,
+                               size_t bin_count, uint32_t sample_rate) {
+  SpectrumGrid grid;
+  grid.spacing = Spacing::kLog;
+  grid.bin_count = static_cast<uint32_t>(bin_count);
+  grid.sample_rate = sample_rate;
+  grid.bins_per_octave = bins_per_octave;
+  grid.min_hz = min_hz;
+  return grid;
+}
+
+double SpectrumGrid::Position(double hz) const {
+  if (spacing == Spacing::kLog) {
+    return std::log2(hz / min_hz) * static_cast<double>(bins_per_octave);
+  }
+  return hz / (static_cast<double>(sample_rate) /
+               static_cast<double>(fft_size));
+}
+
+double SpectrumGrid::Frequency(double position) const {
+  if (spacing == Spacing::kLog) {
+    return min_hz *
+           std::exp2(position / static_cast<double>(bins_per_octave));
+  }
+  return position * (static_cast<double>(sample_rate) /
+                     static_cast<double>(fft_size));
+}
+
+const char* BandScaleName(BandScale scale) {
+  return kScaleNames[static_cast<size_t>(scale)];
+}
+
+bool ParseBandScale(const char* name, BandScale* scale) {
+  for (size_t i = 0; i < sizeof(kScaleNames) / sizeof(kScaleNames[0]); i++) {
+    if (std::strcmp(name, kScaleNames[i]) == 0) {
+      *scale = static_cast<BandScale>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool BandMapper::IsValidLayout(const BandLayout& layout) {
+  return layout.scale <= BandScale::kBark && layout.band_count >= kMinBands &&
+         layout.band_count <= kMaxBands;
+}
+
+bool BandMapper::Configure(const BandLayout& layout, size_t fft_size,
+                           uint32_t sample_rate) {
+  if (fft_size < 2) return false;
+  return Configure(layout, SpectrumGrid::Linear(fft_size, sample_rate));
+}
+
+bool BandMapper::Configure(const BandLayout& layout,
+                           const SpectrumGrid& grid) {
+  if (!IsValidLayout(layout) || grid.bin_count < 2 || grid.sample_rate == 0) {
+    return false;
+  }
+  layout_ = layout;
+  grid_ = grid;
+
+  const size_t band_count = layout.band_count;
+  const size_t last_bin = grid.bin_count - 1;
+  bands_.assign(band_count, Band());
+  weights_.clear();
+
+  if (layout.scale == BandScale::kLinear &&
+      grid.spacing == SpectrumGrid::Spacing::kLinear) {
+    // Unit weights keep the result bit-identical to a plain average.
+    const size_t per_band = std::max<size_t>(last_bin / band_count, 1);
+    weights_.assign(per_band, 1.0f);
+    for (size_t b = 0; b < band_count; b++) {
+      Band& band = bands_[b];
+      const size_t first = std::min(b * per_band, last_bin + 1 - per_band);
+      band.first_bin = static_cast<uint32_t>(first);
+      band.bin_count = static_cast<uint32_t>(per_band);
+      band.weight_offset = 0;
+      band.weight_sum = static_cast<float>(per_band);
+      band.center_hz = static_cast<float>(grid.Frequency(
+          band.first_bin + 0.5 * static_cast<double>(per_band)));
+      band.bandwidth_hz = static_cast<float>(
+          grid.Frequency(static_cast<double>(first + per_band)) -
+          grid.Frequency(static_cast<double>(first)));
+    }
+    QuantizeWeights();
+    return true;
+  }
+
+  const double top = grid.Frequency(static_cast<double>(last_bin));
+  const double high = std::min<double>(kMaxFrequency, top);
+  const double low = std::min<double>(kMinFrequency, high / 2);
+  const double scale_low = HzToScale(layout.scale, low);
+  const double scale_step =
+      (HzToScale(layout.scale, high) - scale_low) /
+      static_cast<double>(band_count + 1);
+
+  // Band edges as fractional bin positions.
+  std::vector<double> edges(band_count + 2);
+  for (size_t i = 0; i < edges.size(); i++) {
+    const double value = scale_low + scale_step * static_cast<double>(i);
+    edges[i] = std::max(grid.Position(ScaleToHz(layout.scale, value)), 0.0);
+  }
+
+  for (size_t b = 0; b < band_count; b++) {
+    const double lower = edges[b];
+    const double center = edges[b + 1];
+    const double upper = edges[b + 2];
+    Band& band = bands_[b];
+    band.center_hz = static_cast<float>(grid.Frequency(center));
+    band.bandwidth_hz = static_cast<float>(
+        0.5 * (grid.Frequency(upper) - grid.Frequency(lower)));
+    band.weight_offset = static_cast<uint32_t>(weights_.size());
+
+    const auto triangle = [&](size_t bin) {
+      const double x = static_cast<double>(bin);
+      const double weight = x <= center ? (x - lower) / (center - lower)
+                                        : (upper - x) / (upper - center);
+      return std::max(weight, 0.0);
+    };
+    const size_t first =
+        std::min(static_cast<size_t>(std::ceil(lower)), last_bin);
+    const size_t last =
+        std::min(static_cast<size_t>(std::floor(upper)), last_bin);
+    double sum = 0.0;
+    for (size_t bin = first; bin <= last; bin++) sum += triangle(bin);
+
+    if (sum > 1e-6) {
+      band.first_bin = static_cast<uint32_t>(first);
+      band.bin_count = static_cast<uint32_t>(last - first + 1);
+      for (size_t bin = first; bin <= last; bin++) {
+        weights_.push_back(static_cast<float>(triangle(bin)));
+      }
+      band.weight_sum = static_cast<float>(sum);
+    } else {
+      // Narrower than a bin: interpolate between the neighbours of the centre.
+      const size_t below = std::min(static_cast<size_t>(center), last_bin - 1);
+      const double fraction =
+          std::clamp(center - static_cast<double>(below), 0.0, 1.0);
+      band.first_bin = static_cast<uint32_t>(below);
+      band.bin_count = 2;
+      weights_.push_back(static_cast<float>(1.0 - fraction));
+      weights_.push_back(static_cast<float>(fraction));
+      band.weight_sum = 1.0f;
+    }
+  }
+  QuantizeWeights();
+  return true;
+}
+
+void BandMapper::QuantizeWeights() {
+  fixed_weights_.resize(weights_.size());
+  for (const Band& band : bands_) {
+    for (uint32_t i = 0; i < band.bin_count; i++) {
+      const size_t w = band.weight_offset + i;
+      fixed_weights_[w] = ToFixed<Q15>(weights_[w] / band.weight_sum);
+    }
+  }
+}
+
+void BandMapper::Apply(const float* magnitudes, float* bands) const {
+  for (size_t b = 0; b < bands_.size(); b++) {
+    const Band& band = bands_[b];
+    const float* bins = magnitudes + band.first_bin;
+    const float* weights = &weights_[band.weight_offset];
+    float sum = 0;
+    for (uint32_t i = 0; i < band.bin_count; i++) {
+      sum += bins[i] * weights[i];
+    }
+    bands[b] = sum / band.weight_sum;
+  }
+}
+
+template <typename Q>
+void BandMapper::ApplyFixed(const typename Q::Sample* magnitudes,
+                            float scale, float* bands) const {
+  using Product = typename Q::Product;
+  // The normalised weights of a band sum to one, so the total stays within
+  // the magnitudes' range and Product cannot overflow.
+  const float unit = std::ldexp(scale, -Q15::kFractionBits);
+  for (size_t b = 0; b < bands_.size(); b++) {
+    const Band& band = bands_[b];
+    const typename Q::Sample* bins = magnitudes + band.first_bin;
+    const Q15::Sample* weights = &fixed_weights_[band.weight_offset];
+    Product sum = 0;
+    for (uint32_t i = 0; i < band.bin_count; i++) {
+      sum += Product{bins[i]} * weights[i];
+    }
+    bands[b] = static_cast<float>(sum) * unit;
+  }
+}
+
+template void BandMapper::ApplyFixed<Q15>(const Q15::Sample*, float,
+                                          float*) const;
+template void BandMapper::ApplyFixed<Q31>(const Q31::Sample*, float,
+                                          float*) const;
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,153 @@
+#ifndef RHYTHM_BAND_MAPPER_H_
+#define RHYTHM_BAND_MAPPER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fixed_point.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Frequency scale along which bands are spaced.
+enum class BandScale : uint8_t {
+  // Equal-width bands over DC..Nyquist, each a plain average of its bins.
+  kLinear = 0,
+  // Equal width in octaves.
+  kLog = 1,
+  // Equal width in mel (O'Shaughnessy).
+  kMel = 2,
+  // Equal width in Bark (Traunmueller).
+  kBark = 3,
+};
+
+// Returns the lower-case name ("linear", "log", "mel", "bark").
+const char* BandScaleName(BandScale scale);
+// Parses a name produced by BandScaleName(). Returns false if unknown.
+bool ParseBandScale(const char* name, BandScale* scale);
+
+struct BandLayout {
+  BandScale scale = BandScale::kLinear;
+  uint32_t band_count = 16;
+
+  bool operator==(const BandLayout& other) const {
+    return scale == other.scale && band_count == other.band_count;
+  }
+  bool operator!=(const BandLayout& other) const { return !(*this == other); }
+};
+
+// Where in frequency the magnitudes a BandMapper reads lie.
+struct SpectrumGrid {
+  enum class Spacing : uint8_t {
+    // Bin k lies at k * sample_rate / fft_size, DC through Nyquist.
+    kLinear = 0,
+    // Bin k lies at min_hz * 2^(k / bins_per_octave).
+    kLog = 1,
+  };
+
+  // The fft_size / 2 + 1 bins of an |fft_size|-point real FFT.
+  static SpectrumGrid Linear(size_t fft_size, uint32_t sample_rate);
+  // |bin_count| bins, |bins_per_octave| to the octave, from |min_hz| up.
+  static SpectrumGrid Log(double min_hz, uint32_t bins_per_octave,
+                          size_t bin_count, uint32_t sample_rate);
+
+  // Fractional bin index of |hz|, and its inverse.
+  double Position(double hz) const;
+  double Frequency(double position) const;
+
+  bool operator==(const SpectrumGrid& other) const {
+    return spacing == other.spacing && bin_count == other.bin_count &&
+           sample_rate == other.sample_rate && fft_size == other.fft_size &&
+           bins_per_octave == other.bins_per_octave && min_hz == other.min_hz;
+  }
+  bool operator!=(const SpectrumGrid& other) const {
+    return !(*this == other);
+  }
+
+  Spacing spacing = Spacing::kLinear;
+  uint32_t bin_count = 0;
+  uint32_t sample_rate = 0;
+  // kLinear only.
+  uint32_t fft_size = 0;
+  // kLog only.
+  uint32_t bins_per_octave = 0;
+  double min_hz = 0.0;
+};
+
+// Maps spectrum magnitudes to bands through a precomputed sparse weight
+// matrix.
+//
+// For the non-linear scales band k is a triangle spanning band edges k to
+// k + 2, with edges spaced evenly on the scale between kMinFrequency and
+// kMaxFrequency (or the top of the grid). Only the bins under each triangle
+// are stored, so Apply() costs one multiply-add per covered bin and no
+// trigonometry or logarithms. A triangle narrower than a bin falls back to
+// interpolating between the two bins around its centre. Every band is
+// normalised by its total weight, so its value is a weighted average
+// magnitude. On a log grid the triangles are linear in bin index, that is in
+// log frequency.
+class BandMapper {
+ public:
+  static constexpr size_t kMinBands = 4;
+  static constexpr size_t kMaxBands = 128;
+  static constexpr float kMinFrequency = 20.0f;
+  static constexpr float kMaxFrequency = 20000.0f;
+
+  static bool IsValidLayout(const BandLayout& layout);
+
+  // Builds the weights for an |fft_size|-point spectrum at |sample_rate|.
+  // Allocates; call it when the configuration changes, not per frame.
+  // Returns false, leaving the mapper untouched, for an invalid layout.
+  bool Configure(const BandLayout& layout, size_t fft_size,
+                 uint32_t sample_rate);
+  // Same for any spectrum |grid| of at least two bins. Linear layouts keep
+  // their plain averages only on a linear grid.
+  bool Configure(const BandLayout& layout, const SpectrumGrid& grid);
+
+  // |magnitudes| holds grid().bin_count bins; writes band_count() values.
+  void Apply(const float* magnitudes, float* bands) const;
+  // Same for the fixed_magnitudes() of a FixedRealFftPlan<Q>, with integer
+  // multiply-adds and Q15 weights; |scale| is the plan's magnitude_scale().
+  template <typename Q>
+  void ApplyFixed(const typename Q::Sample* magnitudes, float scale,
+                  float* bands) const;
+
+  const BandLayout& layout() const { return layout_; }
+  size_t band_count() const { return bands_.size(); }
+  const SpectrumGrid& grid() const { return grid_; }
+  uint32_t sample_rate() const { return grid_.sample_rate; }
+
+  // Centre frequency of |band| in Hz.
+  float center_frequency(size_t band) const {
+    return bands_[band].center_hz;
+  }
+  // Width in Hz of the rectangle with the same area and peak as |band|'s
+  // weighting: half the base of a triangle, all of a linear band.
+  float bandwidth(size_t band) const { return bands_[band].bandwidth_hz; }
+
+ private:
+  struct Band {
+    uint32_t first_bin = 0;
+    uint32_t bin_count = 0;
+    // Offset of this band's weights in weights_.
+    uint32_t weight_offset = 0;
+    float weight_sum = 0.0f;
+    float center_hz = 0.0f;
+    float bandwidth_hz = 0.0f;
+  };
+
+  void QuantizeWeights();
+
+  BandLayout layout_;
+  SpectrumGrid grid_;
+  std::vector<Band> bands_;
+  std::vector<float> weights_;
+  // weights_ divided by their band's weight_sum, in Q15.
+  std::vector<Q15::Sample> fixed_weights_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_BAND_MAPPER_H_
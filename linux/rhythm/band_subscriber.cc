@@ -0,0 +1,64 @@
+#include "band_subscriber.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "rhythm_analyzer.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+bool BandSubscriber::Configure(const SubscriberConfig& config,
+                               const SpectrumGrid& grid) {
+  if (!mapper_.Configure(config.layout, grid)) return false;
+  config_ = config;
+  levels_.assign(mapper_.band_count(), 0.0f);
+  dynamics_.SetConfig(config.dynamics);
+  interval_ns_ = config.max_rate_hz > 0.0f
+                     ? std::llround(1e9 / config.max_rate_hz)
+                     : 0;
+  return true;
+}
+
+void BandSubscriber::Reset() {
+  dynamics_.Reset();
+  published_ = false;
+}
+
+bool BandSubscriber::Process(const float* magnitudes,
+                             const RhythmFrame& source, double dt_seconds) {
+  mapper_.Apply(magnitudes, levels_.data());
+  for (float& level : levels_) level *= RhythmAnalyzer::kLevelScale;
+
+  frame_.sequence = source.sequence;
+  frame_.sample_position = source.sample_position;
+  frame_.timestamp_ns = source.timestamp_ns;
+  frame_.silent = false;
+  frame_.band_count = static_cast<uint32_t>(levels_.size());
+  dynamics_.Process(levels_.data(), frame_.band_count, dt_seconds,
+                    frame_.bands, frame_.peaks);
+  frame_.gain = dynamics_.gain();
+
+  if (interval_ns_ > 0) {
+    if (published_ && frame_.timestamp_ns < next_due_ns_) return false;
+    next_due_ns_ += interval_ns_;
+    // The first frame, or the first after a gap, starts a new schedule.
+    if (!published_ || next_due_ns_ <= frame_.timestamp_ns) {
+      next_due_ns_ = frame_.timestamp_ns + interval_ns_;
+    }
+  }
+  published_ = true;
+  return true;
+}
+
+void BandSubscriber::Silence(const RhythmFrame& source) {
+  Reset();
+  frame_ = source;
+  frame_.band_count = static_cast<uint32_t>(levels_.size());
+  frame_.gain = dynamics_.gain();
+  std::fill(frame_.bands, frame_.bands + RhythmFrame::kMaxBands, 0.0f);
+  std::fill(frame_.peaks, frame_.peaks + RhythmFrame::kMaxBands, 0.0f);
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
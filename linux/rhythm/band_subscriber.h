@@ -0,0 +1,72 @@
+#ifndef RHYTHM_BAND_SUBSCRIBER_H_
+#define RHYTHM_BAND_SUBSCRIBER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "band_dynamics.h"
+#include "band_mapper.h"
+#include "rhythm_frame.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// What one consumer of the shared spectrum wants to receive.
+struct SubscriberConfig {
+  BandLayout layout;
+  DynamicsConfig dynamics;
+  // Most frames per second to publish; 0 publishes every analysed frame.
+  float max_rate_hz = 0.0f;
+};
+
+// Projects the engine's spectra onto one consumer's bands.
+//
+// Every analysed frame's magnitudes are mapped to this subscriber's layout
+// and run through its own BandDynamics, so the envelopes and peak markers
+// see every hop whatever the publication rate. Frames are then offered for
+// publication at no more than max_rate_hz on average: each due time is one
+// interval after the previous one rather than after the frame that met it,
+// so a rate that is not a multiple of the hop rate is still met.
+//
+// Configure() allocates; Process() does not.
+class BandSubscriber {
+ public:
+  // Rebuilds the band weights for spectra on |grid|. Keeps the envelopes
+  // unless the band count changes. Returns false for a layout
+  // BandMapper::IsValidLayout() rejects.
+  bool Configure(const SubscriberConfig& config, const SpectrumGrid& grid);
+
+  const SubscriberConfig& config() const { return config_; }
+  const SpectrumGrid& grid() const { return mapper_.grid(); }
+
+  // Forgets the envelopes and the rate limiter's schedule.
+  void Reset();
+
+  // Projects one frame of |magnitudes|. |source| supplies the frame's
+  // sequence, position and time; |dt_seconds| is the time since the previous
+  // frame. Returns true if frame() should be published.
+  bool Process(const float* magnitudes, const RhythmFrame& source,
+               double dt_seconds);
+
+  // Resets the envelopes and turns frame() into a silent copy of |source|,
+  // which is always due for publication.
+  void Silence(const RhythmFrame& source);
+
+  const RhythmFrame& frame() const { return frame_; }
+
+ private:
+  SubscriberConfig config_;
+  BandMapper mapper_;
+  BandDynamics dynamics_;
+  std::vector<float> levels_;
+  int64_t interval_ns_ = 0;
+  int64_t next_due_ns_ = 0;
+  bool published_ = false;
+  RhythmFrame frame_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_BAND_SUBSCRIBER_H_
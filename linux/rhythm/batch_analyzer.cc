@@ -0,0 +1,96 @@
+#include "batch_analyzer.h"
+
+#include <utility>
+
+#include "track_sidecar.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+size_t DefaultThreadCount() {
+  const size_t cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 1;
+}
+
+}  // namespace
+
+BatchAnalyzer::BatchAnalyzer(size_t threads)
+    : thread_count_(threads ? threads : DefaultThreadCount()) {}
+
+BatchAnalyzer::~BatchAnalyzer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    queue_.clear();
+  }
+  work_cv_.notify_all();
+  for (std::thread& thread : threads_) thread.join();
+}
+
+void BatchAnalyzer::Submit(TrackJob job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(job));
+    if (threads_.empty()) {
+      threads_.reserve(thread_count_);
+      for (size_t i = 0; i < thread_count_; i++) {
+        threads_.emplace_back(&BatchAnalyzer::WorkerLoop, this);
+      }
+    }
+  }
+  work_cv_.notify_one();
+}
+
+void BatchAnalyzer::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this] { return queue_.empty() && running_ == 0; });
+}
+
+size_t BatchAnalyzer::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size() + running_;
+}
+
+void BatchAnalyzer::WorkerLoop() {
+  TrackAnalyzer analyzer;
+  PeakPyramidWriter peaks;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    work_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    if (stopping_) return;
+    TrackJob job = std::move(queue_.front());
+    queue_.pop_front();
+    running_++;
+    lock.unlock();
+    Run(&analyzer, &peaks, &job);
+    lock.lock();
+    running_--;
+    if (queue_.empty() && running_ == 0) idle_cv_.notify_all();
+  }
+}
+
+void BatchAnalyzer::Run(TrackAnalyzer* analyzer, PeakPyramidWriter* peaks,
+                        TrackJob* job) {
+  std::string error;
+  TrackAnalysis analysis;
+  bool ok = false;
+  {
+    std::unique_ptr<PcmSource> source = job->open(&error);
+    const bool waveform = !job->peaks_path.empty();
+    ok = source &&
+         (!waveform || peaks->Begin(job->peaks_path,
+                                    source->format().sample_rate, &error)) &&
+         analyzer->Analyze(source.get(), &analysis, &error,
+                           waveform ? peaks : nullptr) &&
+         (!waveform || peaks->Finish(source->source_size(), &error)) &&
+         (job->sidecar_path.empty() ||
+          WriteTrackAnalysis(job->sidecar_path, analysis, &error));
+    peaks->Abandon();
+  }
+  if (job->done) job->done(ok ? &analysis : nullptr, error);
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,82 @@
+#ifndef RHYTHM_BATCH_ANALYZER_H_
+#define RHYTHM_BATCH_ANALYZER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pcm_source.h"
+#include "peak_pyramid.h"
+#include "track_analyzer.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// One track for BatchAnalyzer.
+struct TrackJob {
+  // Opens the track's decoder; called on the worker, so decoders that need
+  // per-thread setup can do it here. Returns null and fills |error| if the
+  // track cannot be opened.
+  std::function<std::unique_ptr<PcmSource>(std::string* error)> open;
+  // Where to write the analysis (see track_sidecar.h); empty to skip.
+  std::string sidecar_path;
+  // Where to write the waveform (see peak_pyramid.h), from the same decode;
+  // empty to skip.
+  std::string peaks_path;
+  // Called on the worker with the analysis, or with null and the error, once
+  // the source has been closed again.
+  std::function<void(const TrackAnalysis* analysis, const std::string& error)>
+      done;
+};
+
+// Offline analysis of queued tracks on a pool of worker threads, each with
+// its own TrackAnalyzer and PeakPyramidWriter, so a library is analysed in
+// parallel across cores while memory stays at one decoding block per worker.
+//
+// The workers start with the first Submit() and sleep on a condition
+// variable while the queue is empty.
+class BatchAnalyzer {
+ public:
+  // |threads| workers; 0 for one per core but one, which is left for
+  // playback and the UI (at least one).
+  explicit BatchAnalyzer(size_t threads = 0);
+  // Drops the jobs still queued without calling them back and waits for
+  // the running ones.
+  ~BatchAnalyzer();
+
+  BatchAnalyzer(const BatchAnalyzer&) = delete;
+  BatchAnalyzer& operator=(const BatchAnalyzer&) = delete;
+
+  size_t thread_count() const { return thread_count_; }
+
+  void Submit(TrackJob job);
+  // Blocks until every submitted job has been called back.
+  void Wait();
+  // Jobs queued or running.
+  size_t pending() const;
+
+ private:
+  void WorkerLoop();
+  static void Run(TrackAnalyzer* analyzer, PeakPyramidWriter* peaks,
+                  TrackJob* job);
+
+  const size_t thread_count_;
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable idle_cv_;
+  std::deque<TrackJob> queue_;
+  size_t running_ = 0;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_BATCH_ANALYZER_H_
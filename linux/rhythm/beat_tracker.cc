@@ -0,0 +1,260 @@
+#include "beat_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+// Peak picking: a peak must exceed kThresholdRatio times the mean of the
+// preceding kThresholdWindowSeconds plus kThresholdFloor times the decaying
+// maximum, and follow the previous onset by at least kMinOnsetGapNs.
+constexpr double kThresholdWindowSeconds = 0.3;
+constexpr float kThresholdRatio = 1.5f;
+constexpr float kThresholdFloor = 0.1f;
+constexpr double kMaxDecaySeconds = 3.0;
+constexpr int64_t kMinOnsetGapNs = 100000000;
+
+// Tempo needs this much history before the first estimate.
+constexpr double kMinTempoSeconds = 2.0;
+// Centre and width (in octaves) of the log-Gaussian tempo prior.
+constexpr double kPreferredBpm = 120.0;
+constexpr double kPriorOctaves = 1.0;
+// A new estimate within this ratio of the current one refines it; a more
+// distant one replaces it only if it is nearly as confident.
+constexpr float kSameTempoRatio = 0.08f;
+constexpr float kTempoSmoothing = 0.3f;
+
+// Beats: onsets within kBeatTolerance periods of the prediction lock to the
+// grid. Below kReanchorConfidence an off-grid onset moves the grid.
+constexpr double kBeatTolerance = 0.2;
+constexpr float kReanchorConfidence = 0.3f;
+
+uint64_t TempoIntervalFrames(double frame_period) {
+  if (frame_period <= 0.0) return 1;
+  const double frames =
+      std::round(BeatTracker::kTempoIntervalSeconds / frame_period);
+  return static_cast<uint64_t>(std::max(1.0, frames));
+}
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t rounded = 1;
+  while (rounded < value) rounded <<= 1;
+  return rounded;
+}
+
+}  // namespace
+
+void BeatTracker::Configure(size_t bin_count, double frame_period) {
+  frame_period_ = frame_period;
+  previous_.assign(bin_count, 0.0f);
+  const size_t history =
+      static_cast<size_t>(std::ceil(kHistorySeconds / frame_period)) + 2;
+  odf_.assign(RoundUpToPowerOfTwo(history), 0.0f);
+  times_.assign(odf_.size(), 0);
+  const size_t max_lag =
+      static_cast<size_t>(std::ceil(60.0 / (kMinBpm * frame_period)));
+  autocorrelation_.assign(max_lag + 2, 0.0f);
+  Reset();
+}
+
+void BeatTracker::Reset() {
+  std::fill(previous_.begin(), previous_.end(), 0.0f);
+  std::fill(odf_.begin(), odf_.end(), 0.0f);
+  std::fill(times_.begin(), times_.end(), 0);
+  frames_ = 0;
+  odf_max_ = 0.0f;
+  last_onset_ns_ = 0;
+  frames_until_tempo_ = TempoIntervalFrames(frame_period_);
+  tempo_updated_ = false;
+  tempo_ = TempoEstimate();
+  last_beat_ns_ = 0;
+  have_beat_ = false;
+}
+
+bool BeatTracker::Process(const float* magnitudes, int64_t timestamp_ns,
+                          BeatEvent* beat) {
+  tempo_updated_ = false;
+
+  // Half-wave rectified spectral flux, per bin so it does not depend on the
+  // FFT size. The first frame has nothing to compare with.
+  float flux = 0.0f;
+  for (size_t i = 0; i < previous_.size(); i++) {
+    flux += std::max(magnitudes[i] - previous_[i], 0.0f);
+    previous_[i] = magnitudes[i];
+  }
+  flux = frames_ > 0 ? flux / static_cast<float>(previous_.size()) : 0.0f;
+
+  odf_[Index(frames_)] = flux;
+  times_[Index(frames_)] = timestamp_ns;
+  frames_++;
+  const float decay =
+      static_cast<float>(std::exp(-frame_period_ / kMaxDecaySeconds));
+  odf_max_ = std::max(flux, odf_max_ * decay);
+
+  float strength = 0.0f;
+  const bool onset = frames_ >= 3 && PickOnset(&strength);
+
+  if (--frames_until_tempo_ == 0) {
+    UpdateTempo();
+    frames_until_tempo_ = TempoIntervalFrames(frame_period_);
+  }
+  return TrackBeat(onset, strength, beat);
+}
+
+bool BeatTracker::PickOnset(float* strength) {
+  const uint64_t candidate = frames_ - 2;
+  const float value = odf_[Index(candidate)];
+  if (value <= odf_[Index(candidate - 1)] ||
+      value < odf_[Index(frames_ - 1)]) {
+    return false;
+  }
+
+  const uint64_t window = std::min<uint64_t>(
+      std::max<uint64_t>(static_cast<uint64_t>(std::round(
+                             kThresholdWindowSeconds / frame_period_)),
+                         1),
+      candidate);
+  float sum = 0.0f;
+  for (uint64_t i = candidate - window; i < candidate; i++) {
+    sum += odf_[Index(i)];
+  }
+  const float threshold = kThresholdRatio * sum / static_cast<float>(window) +
+                          kThresholdFloor * odf_max_;
+  if (value <= threshold || threshold <= 0.0f) return false;
+
+  const int64_t time = times_[Index(candidate)];
+  if (last_onset_ns_ != 0 && time - last_onset_ns_ < kMinOnsetGapNs) {
+    return false;
+  }
+  last_onset_ns_ = time;
+  *strength = value / threshold;
+  return true;
+}
+
+void BeatTracker::UpdateTempo() {
+  const uint64_t history = std::min<uint64_t>(
+      frames_, static_cast<uint64_t>(kHistorySeconds / frame_period_));
+  const size_t max_lag = autocorrelation_.size() - 2;
+  const size_t min_lag = std::max<size_t>(
+      static_cast<size_t>(60.0 / (kMaxBpm * frame_period_)), 2);
+  if (static_cast<double>(history) * frame_period_ < kMinTempoSeconds ||
+      history <= 2 * max_lag) {
+    return;
+  }
+
+  const uint64_t first = frames_ - history;
+  double mean = 0.0;
+  for (uint64_t i = first; i < frames_; i++) mean += odf_[Index(i)];
+  mean /= static_cast<double>(history);
+
+  const auto correlate = [&](size_t lag) {
+    double sum = 0.0;
+    for (uint64_t i = first + lag; i < frames_; i++) {
+      sum += (odf_[Index(i)] - mean) * (odf_[Index(i - lag)] - mean);
+    }
+    return sum;
+  };
+  const double energy = correlate(0);
+  if (energy <= 0.0) return;
+
+  size_t best_lag = 0;
+  double best_score = 0.0;
+  for (size_t lag = min_lag - 1; lag <= max_lag + 1; lag++) {
+    const double value = correlate(lag) / energy;
+    autocorrelation_[lag] = static_cast<float>(value);
+    if (lag < min_lag || lag > max_lag) continue;
+    const double bpm = 60.0 / (static_cast<double>(lag) * frame_period_);
+    const double octaves = std::log2(bpm / kPreferredBpm) / kPriorOctaves;
+    const double score = value * std::exp(-0.5 * octaves * octaves);
+    if (score > best_score) {
+      best_score = score;
+      best_lag = lag;
+    }
+  }
+  if (best_lag == 0) return;
+
+  // Parabolic interpolation around the peak for sub-frame resolution.
+  const double left = autocorrelation_[best_lag - 1];
+  const double centre = autocorrelation_[best_lag];
+  const double right = autocorrelation_[best_lag + 1];
+  const double curvature = left - 2.0 * centre + right;
+  double lag = static_cast<double>(best_lag);
+  if (curvature < 0.0) {
+    lag += std::clamp(0.5 * (left - right) / curvature, -0.5, 0.5);
+  }
+
+  const float bpm = static_cast<float>(60.0 / (lag * frame_period_));
+  const float confidence = static_cast<float>(std::clamp(centre, 0.0, 1.0));
+  if (tempo_.bpm > 0.0f &&
+      std::fabs(bpm / tempo_.bpm - 1.0f) < kSameTempoRatio) {
+    tempo_.bpm += (bpm - tempo_.bpm) * kTempoSmoothing;
+    tempo_.confidence += (confidence - tempo_.confidence) * kTempoSmoothing;
+  } else if (tempo_.bpm <= 0.0f || confidence >= 0.8f * tempo_.confidence) {
+    tempo_.bpm = bpm;
+    tempo_.confidence = confidence;
+  } else {
+    tempo_.confidence *= 1.0f - kTempoSmoothing;
+  }
+  tempo_updated_ = true;
+}
+
+bool BeatTracker::TrackBeat(bool onset, float strength, BeatEvent* beat) {
+  const int64_t onset_ns = times_[Index(frames_ - 2)];
+  const int64_t now_ns = times_[Index(frames_ - 1)];
+  beat->bpm = tempo_.bpm;
+
+  if (tempo_.bpm <= 0.0f || !have_beat_) {
+    // No grid yet: every onset is a beat.
+    if (!onset) return false;
+    beat->timestamp_ns = onset_ns;
+    beat->strength = strength;
+    beat->confidence = 0.0f;
+    last_beat_ns_ = onset_ns;
+    have_beat_ = true;
+    return true;
+  }
+
+  const double period_ns = 60e9 / tempo_.bpm;
+  const double tolerance_ns = kBeatTolerance * period_ns;
+  const int64_t predicted_ns =
+      last_beat_ns_ + static_cast<int64_t>(period_ns);
+
+  if (onset) {
+    const double deviation = static_cast<double>(onset_ns - predicted_ns);
+    const bool on_grid = std::fabs(deviation) <= tolerance_ns;
+    if (on_grid || (tempo_.confidence < kReanchorConfidence &&
+                    static_cast<double>(onset_ns - last_beat_ns_) >
+                        period_ns / 2)) {
+      beat->timestamp_ns = onset_ns;
+      beat->strength = strength;
+      beat->confidence =
+          on_grid ? tempo_.confidence *
+                        static_cast<float>(1.0 - std::fabs(deviation) /
+                                                     tolerance_ns)
+                  : 0.0f;
+      last_beat_ns_ = onset_ns;
+      return true;
+    }
+  }
+
+  const double overdue = static_cast<double>(now_ns - predicted_ns);
+  if (overdue > 2.0 * period_ns) {
+    // Resuming after a gap; wait for the next onset to place the grid.
+    have_beat_ = false;
+    return false;
+  }
+  if (overdue > tolerance_ns) {
+    beat->timestamp_ns = predicted_ns;
+    beat->strength = 0.0f;
+    beat->confidence = 0.5f * tempo_.confidence;
+    last_beat_ns_ = predicted_ns;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
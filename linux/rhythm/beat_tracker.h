@@ -0,0 +1,97 @@
+#ifndef RHYTHM_BEAT_TRACKER_H_
+#define RHYTHM_BEAT_TRACKER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// A detected or predicted beat.
+struct BeatEvent {
+  // Capture time of the beat on the RhythmFrame clock.
+  int64_t timestamp_ns = 0;
+  // Onset strength relative to the adaptive threshold (>= 1 for detected
+  // onsets); 0 for beats predicted from the tempo with no onset.
+  float strength = 0.0f;
+  // How well the beat fits the tracked tempo, in [0, 1].
+  float confidence = 0.0f;
+  // Tempo estimate at the time of the beat; 0 until one is available.
+  float bpm = 0.0f;
+};
+
+// Running tempo estimate.
+struct TempoEstimate {
+  float bpm = 0.0f;
+  // Normalised autocorrelation at the chosen period, in [0, 1].
+  float confidence = 0.0f;
+};
+
+// Onset, beat and tempo tracking on top of the spectra the analyser already
+// computes.
+//
+// Each frame's half-wave rectified spectral flux forms an onset detection
+// function. Onsets are its local maxima above an adaptive threshold (a
+// multiple of the recent mean plus a fraction of a slowly decaying maximum).
+// Every kTempoIntervalSeconds the autocorrelation of the last few seconds of
+// the detection function, weighted towards 120 BPM, gives the tempo. Beats
+// are onsets that land near the next beat predicted from the tempo; when the
+// expected beat passes with no onset a predicted beat is emitted instead so
+// the grid keeps running through quiet passages.
+//
+// Configure() allocates; Process() does not.
+class BeatTracker {
+ public:
+  static constexpr float kMinBpm = 60.0f;
+  static constexpr float kMaxBpm = 200.0f;
+  static constexpr double kHistorySeconds = 6.0;
+  static constexpr double kTempoIntervalSeconds = 0.5;
+
+  // |bin_count| magnitudes arrive every |frame_period| seconds.
+  void Configure(size_t bin_count, double frame_period);
+  void Reset();
+
+  size_t bin_count() const { return previous_.size(); }
+  double frame_period() const { return frame_period_; }
+
+  // Feeds one frame of magnitudes captured at |timestamp_ns| (the centre of
+  // its window). Returns true and fills |beat| if a beat was found; beats are
+  // reported one frame late because a peak needs its right neighbour.
+  bool Process(const float* magnitudes, int64_t timestamp_ns, BeatEvent* beat);
+
+  // True once per tempo update, after which tempo() holds the new estimate.
+  bool tempo_updated() const { return tempo_updated_; }
+  const TempoEstimate& tempo() const { return tempo_; }
+
+  // Onset detection function value of the latest frame.
+  float flux() const { return odf_[Index(frames_ - 1)]; }
+
+ private:
+  size_t Index(uint64_t frame) const {
+    return static_cast<size_t>(frame) & (odf_.size() - 1);
+  }
+  bool PickOnset(float* strength);
+  void UpdateTempo();
+  bool TrackBeat(bool onset, float strength, BeatEvent* beat);
+
+  double frame_period_ = 0.0;
+  std::vector<float> previous_;
+  // Onset detection function and its frame times, indexed by frame number.
+  std::vector<float> odf_;
+  std::vector<int64_t> times_;
+  std::vector<float> autocorrelation_;
+  uint64_t frames_ = 0;
+  float odf_max_ = 0.0f;
+  int64_t last_onset_ns_ = 0;
+  uint64_t frames_until_tempo_ = 0;
+  bool tempo_updated_ = false;
+  TempoEstimate tempo_;
+  int64_t last_beat_ns_ = 0;
+  bool have_beat_ = false;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_BEAT_TRACKER_H_
@@ -0,0 +1,1469 @@
+// WAV-replay benchmark for the rhythm analysis core.
+//
+// Streams each WAV file through the same downmix -> ring -> analysis path the
+// capture backends use, in 10 ms packets of the file's own sample encoding,
+// and reports the cost per analysed frame, heap allocations per frame and a
+// checksum over every band output so that optimisations can be checked for
+// regressions without a capture device. The downmix alone is timed as well.
+// Band output is also compared against the scalar kernels. Band dynamics are
+// bypassed unless --dynamics is given, without even the clamp to [0, 1], so
+// the checksum tracks the raw analysis and loud input cannot make different
+// paths collide on saturated bands. --loudness turns on the loudness meter,
+// with left and right metered separately for a stereo file, and reports its
+// reading and the cost without it. --beats turns on beat tracking and reports
+// the beats, the final tempo estimate and the cost without it. --subscribers
+// adds that many band subscribers with assorted layouts and rates, whose cost
+// is included in ns/frame, and reports how many frames each published. --stats
+// turns on the engine's self-instrumentation, whose overhead then shows in
+// ns/frame, and prints its counters and timings. --mode multires analyses with
+// the multi-resolution spectrum and also times the plain FFT path at the same
+// hop for comparison, along with the bass resolution of each. --mode
+// filterbank prefers the resonator bank, which the engine only uses while it
+// is faster than the FFT; --crossover times the analyser alone in both modes
+// for a range of band counts and fails if the engine picks the slower one for
+// any of them. --decimate N (0 for automatic) decimates the FFT mode's input,
+// with --treble keeping the full-rate treble; it also times the undecimated
+// path for comparison and measures the decimation filter's passband and
+// stopband.
+// --fixed-point times the FFT and band mapping alone in float and in Q15
+// and Q31 fixed point, and reports how far the fixed-point bands stray from
+// the float ones; the sample format line shows which the build analyses in.
+// --stereo lr|ms replays through the engine's stereo mode, whose main
+// checksum must match the mono run's; it
+// reports a checksum over the stereo bands, the mean correlation and width,
+// and the mono cost for comparison.
+// --features turns on the spectral feature vector for every frame and
+// reports the mean and range of each feature, a checksum over them and the
+// cost without them, and checks the spectral_sums kernel against the scalar
+// one and its log2 against the C library's.
+// --chroma turns on chroma and key tracking and reports the mean chroma,
+// the key most readings agreed on and the final one, and the cost without
+// it.
+// --percussive turns on harmonic/percussive separation and reports the
+// cost of the separation alone and of the replay without it, the percussive
+// share of the band energy, the mean level of the lowest band with and
+// without the harmonic part, the percussive onsets and a checksum over the
+// percussive bands, and checks the running median against sorting.
+// --offline N runs the offline track analysis over the file streamed from
+// disk, on one worker and then as N tracks on the default pool, and reports
+// the time per track, the speed-up of the pool, the beat grid, tempo,
+// loudness, key and silence found, and checks that every run agrees and
+// that the sidecar record reads back unchanged. The single run also writes
+// the waveform pyramid, which is checked against a direct scan of the
+// downmix and whose queries are timed over the whole track and a one-second
+// window.
+//
+// Usage: rhythm_bench [--repeat N] [--fft-size N] [--hop N] [--kernels NAME]
+//                     [--mode fft|multires|filterbank] [--crossover]
+//                     [--decimate 0|1|2|4|8] [--treble] [--fixed-point]
+//                     [--scale linear|log|mel|bark] [--bands N] [--dynamics]
+//                     [--subscribers N] [--stats] [--stereo lr|ms]
+//                     [--beats] [--loudness] [--features] [--chroma]
+//                     [--percussive] [--offline N]
+//                     file.wav [file.wav ...]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "batch_analyzer.h"
+#include "downmix.h"
+#include "peak_pyramid.h"
+#include "rhythm_analyzer.h"
+#include "rhythm_engine.h"
+#include "track_analyzer.h"
+#include "track_sidecar.h"
+#include "wav_reader.h"
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using cyrene_music::rhythm::AnalysisFftPlan;
+using cyrene_music::rhythm::AnalysisMode;
+using cyrene_music::rhythm::BandLayout;
+using cyrene_music::rhythm::BandMapper;
+using cyrene_music::rhythm::BatchAnalyzer;
+using cyrene_music::rhythm::BeatEvent;
+using cyrene_music::rhythm::ChromaReading;
+using cyrene_music::rhythm::Decimation;
+using cyrene_music::rhythm::DownmixKernels;
+using cyrene_music::rhythm::Downmixer;
+using cyrene_music::rhythm::DynamicsConfig;
+using cyrene_music::rhythm::FftKernels;
+using cyrene_music::rhythm::HistogramSnapshot;
+using cyrene_music::rhythm::FixedRealFftPlan;
+using cyrene_music::rhythm::LoudnessReading;
+using cyrene_music::rhythm::PercussiveOnset;
+using cyrene_music::rhythm::PcmSource;
+using cyrene_music::rhythm::PeakColumn;
+using cyrene_music::rhythm::PeakPyramid;
+using cyrene_music::rhythm::PercussiveSeparator;
+using cyrene_music::rhythm::Q15;
+using cyrene_music::rhythm::Q31;
+using cyrene_music::rhythm::RealFftPlan;
+using cyrene_music::rhythm::RhythmAnalyzer;
+using cyrene_music::rhythm::RhythmEngine;
+using cyrene_music::rhythm::RhythmFrame;
+using cyrene_music::rhythm::RunningMedian;
+using cyrene_music::rhythm::SpectralFeatures;
+using cyrene_music::rhythm::StatsSnapshot;
+using cyrene_music::rhythm::StereoChannels;
+using cyrene_music::rhythm::StereoFrame;
+using cyrene_music::rhythm::SubscriberConfig;
+using cyrene_music::rhythm::TempoEstimate;
+using cyrene_music::rhythm::TrackAnalysis;
+using cyrene_music::rhythm::TrackJob;
+using cyrene_music::rhythm::WavFile;
+using cyrene_music::rhythm::WavFileSource;
+
+using FrameSink = std::function<void(const RhythmFrame&)>;
+
+// FNV-1a over the raw bit patterns of every band value.
+class Checksum {
+ public:
+  void Add(const RhythmFrame& frame) {
+    AddBands(frame.bands, frame.band_count);
+  }
+
+  void Add(const StereoFrame& frame) {
+    AddBands(frame.bands[0], frame.band_count);
+    AddBands(frame.bands[1], frame.band_count);
+  }
+
+  void Add(const float* values, uint32_t count) { AddBands(values, count); }
+
+  uint64_t value() const { return hash_; }
+
+ private:
+  void AddBands(const float* bands, uint32_t count) {
+    for (uint32_t band = 0; band < count; band++) {
+      uint32_t bits;
+      std::memcpy(&bits, &bands[band], sizeof(bits));
+      for (int i = 0; i < 4; i++) {
+        hash_ ^= (bits >> (i * 8)) & 0xFF;
+        hash_ *= 1099511628211ull;
+      }
+    }
+  }
+
+  uint64_t hash_ = 14695981039346656037ull;
+};
+
+// The spectral features in the order the benchmark reports them.
+constexpr size_t kFeatureCount = 5;
+const char* const kFeatureNames[kFeatureCount] = {
+    "centroid", "rolloff", "flatness", "flux", "zcr"};
+
+void FeatureValues(const SpectralFeatures& features, float* values) {
+  values[0] = features.centroid_hz;
+  values[1] = features.rolloff_hz;
+  values[2] = features.flatness;
+  values[3] = features.flux;
+  values[4] = features.zero_crossing_rate;
+}
+
+// Mean and range of one feature over a run.
+struct FeatureRange {
+  void Add(float value) {
+    sum += static_cast<double>(value);
+    min = count == 0 ? value : std::min(min, value);
+    max = count == 0 ? value : std::max(max, value);
+    count++;
+  }
+  double mean() const { return count ? sum / static_cast<double>(count) : 0.0; }
+
+  double sum = 0.0;
+  float min = 0.0f;
+  float max = 0.0f;
+  uint64_t count = 0;
+};
+
+struct RunResult {
+  uint64_t frames = 0;
+  uint64_t allocations = 0;
+  uint64_t elapsed_ns = 0;
+  uint64_t checksum = 0;
+  uint64_t beats = 0;
+  TempoEstimate tempo;
+  LoudnessReading loudness;
+  std::vector<uint64_t> subscriber_frames;
+  StatsSnapshot stats;
+  AnalysisMode active_mode = AnalysisMode::kFft;
+  uint64_t stereo_checksum = 0;
+  double mean_correlation = 0.0;
+  double mean_width = 0.0;
+  uint64_t features_checksum = 0;
+  FeatureRange features[kFeatureCount];
+  // Chroma readings, their summed chroma, how many named each key (major
+  // keys on C..B, then minor) and the last one.
+  uint64_t chroma_readings = 0;
+  double chroma[ChromaReading::kPitchClasses] = {};
+  uint64_t key_votes[2 * ChromaReading::kPitchClasses] = {};
+  ChromaReading last_chroma;
+  uint64_t percussive_checksum = 0;
+  uint64_t onsets = 0;
+};
+
+struct Options {
+  int repeat = 5;
+  size_t fft_size = RhythmAnalyzer::kDefaultFftSize;
+  // 0 selects the engine default of fft_size / 2.
+  size_t hop_size = 0;
+  AnalysisMode mode = AnalysisMode::kFft;
+  Decimation decimation;
+  const FftKernels* kernels = &cyrene_music::rhythm::SelectFftKernels();
+  const DownmixKernels* downmix_kernels =
+      &cyrene_music::rhythm::SelectDownmixKernels();
+  BandLayout layout;
+  DynamicsConfig dynamics = DynamicsConfig::Unclamped();
+  bool dynamics_enabled = false;
+  size_t subscribers = 0;
+  bool stats = false;
+  bool crossover = false;
+  bool fixed_point = false;
+  bool stereo = false;
+  StereoChannels stereo_channels = StereoChannels::kLeftRight;
+  bool features = false;
+  bool beats = false;
+  bool loudness = false;
+  bool chroma = false;
+  bool percussive = false;
+  size_t offline_tracks = 0;
+};
+
+// The |index|th benchmark subscriber: a mix of layouts and rates like the
+// player's own visualizers ask for.
+SubscriberConfig BenchSubscriber(size_t index) {
+  static const SubscriberConfig kConfigs[] = {
+      {{cyrene_music::rhythm::BandScale::kLog, 32}, DynamicsConfig(), 60.0f},
+      {{cyrene_music::rhythm::BandScale::kMel, 64}, DynamicsConfig(), 30.0f},
+      {{cyrene_music::rhythm::BandScale::kBark, 24}, DynamicsConfig(), 0.0f},
+      {{cyrene_music::rhythm::BandScale::kLinear, 8}, DynamicsConfig(),
+       20.0f},
+  };
+  return kConfigs[index % (sizeof(kConfigs) / sizeof(kConfigs[0]))];
+}
+
+// Streams a WAV file through a rhythm engine in capture-sized packets,
+// draining it synchronously after every packet instead of on the worker.
+// Everything is allocated up front so that Run() measures the steady state.
+class Replayer {
+ public:
+  Replayer(const WavFile& wav, const Options& options,
+           const FftKernels& kernels, const DownmixKernels& downmix_kernels)
+      : wav_(wav),
+        stereo_(options.stereo),
+        features_(options.features),
+        percussive_(options.percussive) {
+    downmixer_.Configure(wav.format);
+    downmixer_.SetKernels(downmix_kernels);
+    engine_.Configure(options.fft_size, options.hop_size);
+    engine_.SetAnalysisMode(options.mode);
+    engine_.SetDecimation(options.decimation);
+    engine_.SetBandLayout(options.layout);
+    engine_.SetDynamics(options.dynamics);
+    engine_.SetKernels(kernels);
+    engine_.SetSampleRate(wav.format.sample_rate);
+    engine_.stats().SetEnabled(options.stats);
+    engine_.SetStereo(options.stereo);
+    engine_.SetStereoInput(wav.format.channels >= 2);
+    engine_.SetStereoChannels(options.stereo_channels);
+    engine_.SetSpectralFeatures(options.features);
+    engine_.SetBeatTracking(options.beats);
+    engine_.SetLoudness(options.loudness);
+    engine_.SetChroma(options.chroma);
+    engine_.SetPercussive(options.percussive);
+    for (size_t i = 0; i < options.subscribers; i++) {
+      size_t id = 0;
+      if (!engine_.AddSubscriber(BenchSubscriber(i), &id)) break;
+      subscriber_ids_.push_back(id);
+    }
+    subscriber_frames_.resize(subscriber_ids_.size());
+    engine_.SetFrameCallback([this](const RhythmFrame& frame) {
+      // The matching stereo frame is published before the callback.
+      if (stereo_) {
+        StereoFrame stereo;
+        engine_.ReadStereoFrame(&stereo);
+        stereo_checksum_.Add(stereo);
+        correlation_sum_ += static_cast<double>(stereo.correlation);
+        width_sum_ += static_cast<double>(stereo.width);
+      }
+      // So are the features, here due with every frame.
+      if (features_) {
+        SpectralFeatures features;
+        engine_.ReadSpectralFeatures(&features);
+        float values[kFeatureCount];
+        FeatureValues(features, values);
+        features_checksum_.Add(values, kFeatureCount);
+        for (size_t i = 0; i < kFeatureCount; i++) {
+          feature_ranges_[i].Add(values[i]);
+        }
+      }
+      // And chroma, at its own low rate.
+      if (engine_.chroma_version() != chroma_version_) {
+        chroma_version_ = engine_.ReadChroma(&chroma_);
+        if (!chroma_.silent) AddChroma();
+      }
+      // And the percussive bands, with every frame.
+      if (percussive_) {
+        RhythmFrame percussive;
+        engine_.ReadPercussiveFrame(&percussive);
+        percussive_checksum_.Add(percussive);
+      }
+      if (on_frame_) on_frame_(frame);
+    });
+    // WASAPI delivers roughly 10 ms per packet.
+    packet_ = std::max<size_t>(wav.format.sample_rate / 100, 1);
+    mono_.resize(packet_);
+    side_.resize(packet_);
+    // Apply the configuration now rather than inside the timed region.
+    engine_.ProcessPending();
+    chroma_version_ = engine_.chroma_version();
+    for (size_t id : subscriber_ids_) {
+      subscriber_versions_.push_back(engine_.subscriber_frame_version(id));
+    }
+  }
+
+  // Calls |on_frame| for every analysed frame. Packets are stamped from a
+  // synthetic clock starting at zero so timestamps are reproducible.
+  void Run(FrameSink on_frame) {
+    on_frame_ = std::move(on_frame);
+    const size_t total_frames = wav_.frame_count();
+    for (size_t pos = 0; pos < total_frames; pos += packet_) {
+      const size_t frames = std::min(total_frames - pos, packet_);
+      const uint8_t* packet = &wav_.data[pos * wav_.format.block_align];
+      const int64_t time_ns = static_cast<int64_t>(
+          pos * 1000000000ull / wav_.format.sample_rate);
+      // As the capture thread does: the side signal goes along whenever the
+      // file has left and right, for the loudness meter.
+      if (engine_.side_input()) {
+        downmixer_.Process(packet, frames, mono_.data(), side_.data());
+        engine_.PushStereoSamples(mono_.data(), side_.data(), frames,
+                                  time_ns);
+      } else {
+        downmixer_.Process(packet, frames, mono_.data());
+        engine_.PushSamples(mono_.data(), frames, time_ns);
+      }
+      engine_.ProcessPending();
+      BeatEvent beat;
+      while (engine_.ReadBeats(&beat, 1) == 1) beats_++;
+      PercussiveOnset onset;
+      while (engine_.ReadPercussiveOnsets(&onset, 1) == 1) onsets_++;
+      // Each version step is one published frame.
+      for (size_t i = 0; i < subscriber_ids_.size(); i++) {
+        const uint64_t version =
+            engine_.subscriber_frame_version(subscriber_ids_[i]);
+        subscriber_frames_[i] += version - subscriber_versions_[i];
+        subscriber_versions_[i] = version;
+      }
+    }
+  }
+
+  // Frames published so far by each subscriber.
+  const std::vector<uint64_t>& subscriber_frames() const {
+    return subscriber_frames_;
+  }
+
+  AnalysisMode active_mode() const { return engine_.active_analysis_mode(); }
+
+  StatsSnapshot stats() const {
+    StatsSnapshot stats;
+    engine_.stats().Snapshot(&stats);
+    return stats;
+  }
+
+  uint64_t beats() const { return beats_; }
+  uint64_t stereo_checksum() const { return stereo_checksum_.value(); }
+  double correlation_sum() const { return correlation_sum_; }
+  double width_sum() const { return width_sum_; }
+  uint64_t features_checksum() const { return features_checksum_.value(); }
+  // Copies the chroma totals into |result|.
+  void GetChroma(RunResult* result) const {
+    result->chroma_readings = chroma_readings_;
+    std::copy(std::begin(chroma_sum_), std::end(chroma_sum_), result->chroma);
+    std::copy(std::begin(key_votes_), std::end(key_votes_),
+              result->key_votes);
+    result->last_chroma = chroma_;
+  }
+  uint64_t percussive_checksum() const {
+    return percussive_checksum_.value();
+  }
+  uint64_t onsets() const { return onsets_; }
+  const FeatureRange& feature_range(size_t i) const {
+    return feature_ranges_[i];
+  }
+  TempoEstimate tempo() const {
+    TempoEstimate tempo;
+    engine_.ReadTempo(&tempo);
+    return tempo;
+  }
+  LoudnessReading loudness() const {
+    LoudnessReading loudness;
+    engine_.ReadLoudness(&loudness);
+    return loudness;
+  }
+
+ private:
+  void AddChroma() {
+    chroma_readings_++;
+    for (size_t c = 0; c < ChromaReading::kPitchClasses; c++) {
+      chroma_sum_[c] += static_cast<double>(chroma_.chroma[c]);
+    }
+    if (chroma_.tonic >= 0) {
+      const size_t mode =
+          chroma_.mode == cyrene_music::rhythm::KeyMode::kMinor ? 1 : 0;
+      key_votes_[mode * ChromaReading::kPitchClasses +
+                 static_cast<size_t>(chroma_.tonic)]++;
+    }
+  }
+
+  const WavFile& wav_;
+  Downmixer downmixer_;
+  RhythmEngine engine_;
+  FrameSink on_frame_;
+  std::vector<float> mono_;
+  std::vector<float> side_;
+  bool stereo_ = false;
+  Checksum stereo_checksum_;
+  double correlation_sum_ = 0.0;
+  double width_sum_ = 0.0;
+  bool features_ = false;
+  Checksum features_checksum_;
+  FeatureRange feature_ranges_[kFeatureCount];
+  uint64_t chroma_version_ = 0;
+  ChromaReading chroma_;
+  uint64_t chroma_readings_ = 0;
+  double chroma_sum_[ChromaReading::kPitchClasses] = {};
+  uint64_t key_votes_[2 * ChromaReading::kPitchClasses] = {};
+  bool percussive_ = false;
+  Checksum percussive_checksum_;
+  uint64_t onsets_ = 0;
+  size_t packet_ = 0;
+  uint64_t beats_ = 0;
+  std::vector<size_t> subscriber_ids_;
+  std::vector<uint64_t> subscriber_versions_;
+  std::vector<uint64_t> subscriber_frames_;
+};
+
+RunResult ReplayOnce(const WavFile& wav, const Options& options) {
+  Replayer replayer(wav, options, *options.kernels, *options.downmix_kernels);
+  Checksum checksum;
+  RunResult result;
+
+  const uint64_t allocations_before = g_allocations.load();
+  const auto start = std::chrono::steady_clock::now();
+  replayer.Run([&](const RhythmFrame& frame) {
+    result.frames++;
+    checksum.Add(frame);
+  });
+  const auto end = std::chrono::steady_clock::now();
+
+  result.allocations = g_allocations.load() - allocations_before;
+  result.elapsed_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count());
+  result.checksum = checksum.value();
+  result.beats = replayer.beats();
+  result.tempo = replayer.tempo();
+  result.loudness = replayer.loudness();
+  result.subscriber_frames = replayer.subscriber_frames();
+  result.stats = replayer.stats();
+  result.active_mode = replayer.active_mode();
+  result.stereo_checksum = replayer.stereo_checksum();
+  const double frames =
+      static_cast<double>(std::max<uint64_t>(result.frames, 1));
+  result.mean_correlation = replayer.correlation_sum() / frames;
+  result.mean_width = replayer.width_sum() / frames;
+  result.features_checksum = replayer.features_checksum();
+  for (size_t i = 0; i < kFeatureCount; i++) {
+    result.features[i] = replayer.feature_range(i);
+  }
+  replayer.GetChroma(&result);
+  result.percussive_checksum = replayer.percussive_checksum();
+  result.onsets = replayer.onsets();
+  return result;
+}
+
+// Largest per-band difference between |kernels| and the scalar reference.
+float MaxDeviationFromScalar(const WavFile& wav, const Options& options) {
+  std::vector<float> reference;
+  Replayer scalar(wav, options, cyrene_music::rhythm::ScalarFftKernels(),
+                  cyrene_music::rhythm::ScalarDownmixKernels());
+  scalar.Run([&](const RhythmFrame& frame) {
+    reference.insert(reference.end(), frame.bands,
+                     frame.bands + frame.band_count);
+  });
+
+  size_t index = 0;
+  float deviation = 0.0f;
+  Replayer replayer(wav, options, *options.kernels, *options.downmix_kernels);
+  replayer.Run([&](const RhythmFrame& frame) {
+    for (uint32_t band = 0; band < frame.band_count; band++) {
+      deviation = std::max(deviation,
+                           std::fabs(frame.bands[band] - reference[index++]));
+    }
+  });
+  return deviation;
+}
+
+// Best time over |repeat| runs to downmix the whole file, in nanoseconds per
+// sample frame.
+double TimeDownmix(const WavFile& wav, const Options& options) {
+  Downmixer downmixer;
+  downmixer.Configure(wav.format);
+  downmixer.SetKernels(*options.downmix_kernels);
+  const size_t frames = wav.frame_count();
+  std::vector<float> mono(frames);
+  uint64_t best_ns = UINT64_MAX;
+  for (int i = 0; i < options.repeat; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    downmixer.Process(wav.data.data(), frames, mono.data());
+    const auto end = std::chrono::steady_clock::now();
+    best_ns = std::min(
+        best_ns, static_cast<uint64_t>(
+                     std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         end - start)
+                         .count()));
+  }
+  return frames ? static_cast<double>(best_ns) / static_cast<double>(frames)
+                : 0.0;
+}
+
+// Best ns/frame over |repeat| runs of |options|.
+double TimeReplay(const WavFile& wav, const Options& options) {
+  double best = 0.0;
+  for (int i = 0; i < options.repeat; i++) {
+    const RunResult run = ReplayOnce(wav, options);
+    const double ns = static_cast<double>(run.elapsed_ns) /
+                      static_cast<double>(std::max<uint64_t>(run.frames, 1));
+    if (i == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+// Frequency resolution and window length of |mode| around 60 Hz, where
+// kick drums and bass lines meet.
+void PrintBassResolution(const char* name, AnalysisMode mode,
+                         size_t fft_size, uint32_t sample_rate) {
+  const double window =
+      mode == AnalysisMode::kFft
+          ? static_cast<double>(fft_size) / static_cast<double>(sample_rate)
+          : cyrene_music::rhythm::MultiResolutionSpectrum::WindowSeconds(
+                60.0, sample_rate);
+  std::printf("  %-13s %.2f Hz at 60 Hz, %.0f ms window\n", name,
+              1.0 / window, window * 1000.0);
+}
+
+// Gain in dB of the decimator by |factor| for a full-scale sine at
+// |frequency| cycles per input sample, once the filter has settled.
+double DecimatorGain(size_t factor, double frequency) {
+  cyrene_music::rhythm::PolyphaseDecimator decimator;
+  decimator.Configure(factor);
+  std::vector<float> input(16384);
+  for (size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<float>(
+        std::sin(2.0 * 3.14159265358979323846 * frequency *
+                 static_cast<double>(i)));
+  }
+  std::vector<float> output(input.size() / factor + 1);
+  const size_t count =
+      decimator.Process(input.data(), input.size(), output.data());
+  double power = 0.0;
+  for (size_t i = count / 2; i < count; i++) {
+    power += static_cast<double>(output[i]) * static_cast<double>(output[i]);
+  }
+  return 10.0 * std::log10(power / static_cast<double>(count - count / 2) /
+                           0.5);
+}
+
+// The decimation in use, its cost against the full-rate FFT, and the
+// filter's gain at the passband edge and its worst over the stopband.
+void PrintDecimation(const WavFile& wav, const Options& options) {
+  const size_t factor = RhythmAnalyzer::DecimationFactor(
+      options.decimation, options.fft_size, options.hop_size,
+      wav.format.sample_rate);
+  std::printf("  decimation    %zux, %zu-point fft at %u Hz, treble %s\n",
+              factor, options.fft_size / factor,
+              wav.format.sample_rate / static_cast<uint32_t>(factor),
+              options.decimation.treble ? "full-rate" : "off");
+  if (factor == 1) return;
+  Options full = options;
+  full.decimation = Decimation();
+  std::printf("  full ns/frame %.1f\n", TimeReplay(wav, full));
+  const double nyquist = 0.5 / static_cast<double>(factor);
+  const double passband =
+      cyrene_music::rhythm::PolyphaseDecimator::kPassband * nyquist;
+  double stopband = -1000.0;
+  for (double f = 2.0 * nyquist - passband; f < 0.5; f += nyquist / 64.0) {
+    stopband = std::max(stopband, DecimatorGain(factor, f));
+  }
+  std::printf("  filter        %.2f dB at %.0f Hz, stopband <= %.1f dB\n",
+              DecimatorGain(factor, passband),
+              passband * static_cast<double>(wav.format.sample_rate),
+              stopband);
+}
+
+// Times the analyser alone on the file's downmixed audio in FFT and
+// filter-bank mode for a range of band counts, next to the mode the engine
+// picks for each when it prefers the filter bank. Returns false if the engine
+// picks the slower mode anywhere, unless the two are within kCrossoverTie of
+// each other, which is no more than timing noise.
+bool PrintCrossover(const WavFile& wav, const std::string& path,
+                    const Options& options) {
+  constexpr double kCrossoverTie = 0.01;
+  Downmixer downmixer;
+  downmixer.Configure(wav.format);
+  std::vector<float> mono(wav.frame_count());
+  downmixer.Process(wav.data.data(), mono.size(), mono.data());
+  const size_t packet = std::max<size_t>(wav.format.sample_rate / 100, 1);
+
+  bool agree = true;
+  for (uint32_t bands : {4u, 8u, 12u, 16u, 24u, 32u, 48u, 64u}) {
+    const BandLayout layout = {options.layout.scale, bands};
+    double ns[2] = {};
+    const AnalysisMode modes[2] = {AnalysisMode::kFft,
+                                   AnalysisMode::kFilterBank};
+    for (size_t m = 0; m < 2; m++) {
+      RhythmAnalyzer analyzer(options.fft_size, options.hop_size);
+      analyzer.SetKernels(*options.kernels);
+      analyzer.SetDecimation(options.decimation);
+      analyzer.SetBandLayout(layout, wav.format.sample_rate);
+      analyzer.SetMode(modes[m]);
+      for (int i = 0; i < options.repeat; i++) {
+        analyzer.Reset();
+        size_t frames = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t pos = 0; pos < mono.size(); pos += packet) {
+          frames += analyzer.PushSamples(
+              &mono[pos], std::min(packet, mono.size() - pos));
+        }
+        const auto end = std::chrono::steady_clock::now();
+        const double run =
+            static_cast<double>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end -
+                                                                     start)
+                    .count()) /
+            static_cast<double>(std::max<size_t>(frames, 1));
+        if (i == 0 || run < ns[m]) ns[m] = run;
+      }
+    }
+
+    RhythmEngine engine;
+    engine.Configure(options.fft_size, options.hop_size);
+    engine.SetKernels(*options.kernels);
+    engine.SetDecimation(options.decimation);
+    engine.SetSampleRate(wav.format.sample_rate);
+    engine.SetBandLayout(layout);
+    engine.SetAnalysisMode(AnalysisMode::kFilterBank);
+    engine.ProcessPending();
+    const bool bank =
+        engine.active_analysis_mode() == AnalysisMode::kFilterBank;
+    const bool bank_faster = ns[1] < ns[0];
+    std::printf("  crossover %-3u fft %.0f ns, bank %.0f ns/frame: %s is "
+                "faster, engine picks %s\n",
+                bands, ns[0], ns[1], bank_faster ? "bank" : "fft",
+                bank ? "bank" : "fft");
+    if (bank != bank_faster &&
+        std::fabs(ns[0] - ns[1]) > kCrossoverTie * std::min(ns[0], ns[1])) {
+      std::fprintf(stderr,
+                   "rhythm_bench: %s: the engine picks %s for %u bands, but "
+                   "%s is faster\n",
+                   path.c_str(), bank ? "bank" : "fft", bands,
+                   bank_faster ? "bank" : "fft");
+      agree = false;
+    }
+  }
+  return agree;
+}
+
+// Best ns/frame over |repeat| runs of |analyse| on every hop of |mono|,
+// which appends the frame's bands to |bands| on the first run.
+template <typename Analyse>
+double TimeBands(const std::vector<float>& mono, size_t fft_size, size_t hop,
+                 int repeat, std::vector<float>* bands, Analyse analyse) {
+  double best = 0.0;
+  for (int i = 0; i < repeat; i++) {
+    size_t frames = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos + fft_size <= mono.size(); pos += hop) {
+      analyse(&mono[pos], i == 0 ? bands : nullptr);
+      frames++;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const double ns =
+        static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+                .count()) /
+        static_cast<double>(std::max<size_t>(frames, 1));
+    if (i == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+// Band levels of |fixed| against |reference| in dB: the mean and the worst
+// difference over the bands within 60 dB of their frame's loudest, which
+// are the ones a visualiser can show.
+void PrintBandError(const char* name, double ns,
+                    const std::vector<float>& reference,
+                    const std::vector<float>& fixed, size_t band_count) {
+  double total = 0.0;
+  double worst = 0.0;
+  size_t counted = 0;
+  for (size_t frame = 0; frame + band_count <= reference.size();
+       frame += band_count) {
+    const float peak = *std::max_element(&reference[frame],
+                                         &reference[frame] + band_count);
+    for (size_t b = frame; b < frame + band_count; b++) {
+      if (reference[b] <= 0.0f || reference[b] < peak * 1e-3f) continue;
+      const double error = std::fabs(
+          20.0 * std::log10(std::max(static_cast<double>(fixed[b]), 1e-30) /
+                            static_cast<double>(reference[b])));
+      total += error;
+      worst = std::max(worst, error);
+      counted++;
+    }
+  }
+  std::printf("  %-13s %.1f ns/frame, band error mean %.3f dB, max %.2f dB\n",
+              name, ns, counted ? total / static_cast<double>(counted) : 0.0,
+              worst);
+}
+
+// Times the float and both fixed-point FFTs with their band mapping on the
+// file's downmixed audio, and compares the fixed-point bands with float's.
+void PrintFixedPoint(const WavFile& wav, const Options& options) {
+  Downmixer downmixer;
+  downmixer.Configure(wav.format);
+  std::vector<float> mono(wav.frame_count());
+  downmixer.Process(wav.data.data(), mono.size(), mono.data());
+  const size_t fft_size = options.fft_size;
+  const size_t hop = options.hop_size ? options.hop_size : fft_size / 2;
+  BandMapper mapper;
+  mapper.Configure(options.layout, fft_size, wav.format.sample_rate);
+  const size_t band_count = mapper.band_count();
+  std::vector<float> frame_bands(band_count);
+
+  const auto run_float = [&](const FftKernels& kernels,
+                             std::vector<float>* bands) {
+    RealFftPlan plan(fft_size);
+    plan.SetKernels(kernels);
+    return TimeBands(mono, fft_size, hop, options.repeat, bands,
+                     [&](const float* block, std::vector<float>* out) {
+                       plan.TransformWindowed(block);
+                       mapper.Apply(plan.magnitudes(), frame_bands.data());
+                       if (out) {
+                         out->insert(out->end(), frame_bands.begin(),
+                                     frame_bands.end());
+                       }
+                     });
+  };
+  const auto run_fixed = [&](auto* plan, std::vector<float>* bands) {
+    using Format = typename std::remove_pointer_t<decltype(plan)>::Format;
+    return TimeBands(mono, fft_size, hop, options.repeat, bands,
+                     [&](const float* block, std::vector<float>* out) {
+                       plan->TransformWindowed(block);
+                       mapper.ApplyFixed<Format>(plan->fixed_magnitudes(),
+                                                 plan->magnitude_scale(),
+                                                 frame_bands.data());
+                       if (out) {
+                         out->insert(out->end(), frame_bands.begin(),
+                                     frame_bands.end());
+                       }
+                     });
+  };
+
+  std::vector<float> reference;
+  std::vector<float> unused;
+  const double float_ns = run_float(*options.kernels, &reference);
+  std::printf("  float         %.1f ns/frame, %s kernels\n", float_ns,
+              options.kernels->name);
+  if (options.kernels != &cyrene_music::rhythm::ScalarFftKernels()) {
+    std::printf("  float scalar  %.1f ns/frame\n",
+                run_float(cyrene_music::rhythm::ScalarFftKernels(), &unused));
+  }
+  std::vector<float> bands;
+  FixedRealFftPlan<Q15> q15(fft_size);
+  const double q15_ns = run_fixed(&q15, &bands);
+  PrintBandError("q15", q15_ns, reference, bands, band_count);
+  bands.clear();
+  FixedRealFftPlan<Q31> q31(fft_size);
+  const double q31_ns = run_fixed(&q31, &bands);
+  PrintBandError("q31", q31_ns, reference, bands, band_count);
+}
+
+// Runs |kernels|' spectral_sums over a synthetic spectrum twice, so the flux
+// sees a previous frame, and compares every lane with the scalar kernel's;
+// also measures SpectralLog2() against std::log2 over many octaves.
+void PrintFeatureKernels(const FftKernels& kernels) {
+  using cyrene_music::rhythm::kSpectralSumCount;
+  using cyrene_music::rhythm::kSpectralSumLanes;
+  const size_t count = 1025;
+  std::vector<float> m(count);
+  std::vector<float> hz(count);
+  for (size_t k = 0; k < count; k++) {
+    hz[k] = static_cast<float>(k) * 23.4375f;
+    m[k] = static_cast<float>((k * 7919) % 1000) * 1e-3f /
+           static_cast<float>(k + 1);
+  }
+  m[3] = 0.0f;
+  const size_t size = kSpectralSumCount * kSpectralSumLanes;
+  auto run = [&](const FftKernels& table, std::vector<float>* sums) {
+    std::vector<float> previous(count, 0.0f);
+    sums->assign(size, 0.0f);
+    table.spectral_sums(m.data(), previous.data(), hz.data(), count,
+                        sums->data());
+    std::reverse(previous.begin(), previous.end());
+    sums->assign(size, 0.0f);
+    table.spectral_sums(m.data(), previous.data(), hz.data(), count,
+                        sums->data());
+  };
+  std::vector<float> reference;
+  std::vector<float> sums;
+  run(cyrene_music::rhythm::ScalarFftKernels(), &reference);
+  run(kernels, &sums);
+  const bool same =
+      std::memcmp(reference.data(), sums.data(), size * sizeof(float)) == 0;
+
+  double error = 0.0;
+  for (float x = 1e-6f; x < 1e6f; x *= 1.0001f) {
+    error = std::max(error, std::fabs(cyrene_music::rhythm::SpectralLog2(x) -
+                                      std::log2(static_cast<double>(x))));
+  }
+  std::printf("  feature sums  %s %s scalar, log2 error %.2g\n",
+              kernels.name, same ? "matches" : "DIFFERS FROM", error);
+}
+
+// "C# minor" for pitch class |tonic| and |mode|.
+std::string KeyName(int tonic, cyrene_music::rhythm::KeyMode mode) {
+  return std::string(cyrene_music::rhythm::PitchClassName(tonic)) + " " +
+         cyrene_music::rhythm::KeyModeName(mode);
+}
+
+void PrintChroma(const RunResult& result) {
+  const size_t classes = ChromaReading::kPitchClasses;
+  const double readings =
+      static_cast<double>(std::max<uint64_t>(result.chroma_readings, 1));
+  std::printf("  chroma       ");
+  for (size_t c = 0; c < classes; c++) {
+    std::printf(" %s %.2f", cyrene_music::rhythm::PitchClassName(
+                                static_cast<int>(c)),
+                result.chroma[c] / readings);
+  }
+  std::printf("\n");
+  const uint64_t* votes = result.key_votes;
+  const size_t best = static_cast<size_t>(
+      std::max_element(votes, votes + 2 * classes) - votes);
+  const cyrene_music::rhythm::KeyMode best_mode =
+      best < classes ? cyrene_music::rhythm::KeyMode::kMajor
+                     : cyrene_music::rhythm::KeyMode::kMinor;
+  std::printf("  key           %s in %.0f%% of %llu readings\n",
+              KeyName(static_cast<int>(best % classes), best_mode).c_str(),
+              100.0 * static_cast<double>(votes[best]) / readings,
+              static_cast<unsigned long long>(result.chroma_readings));
+  const ChromaReading& last = result.last_chroma;
+  std::printf("  final key     %s (confidence %.2f)\n",
+              KeyName(last.tonic, last.mode).c_str(),
+              static_cast<double>(last.confidence));
+}
+
+// Runs the analyser and a PercussiveSeparator over the file without
+// dynamics, which would clip the bands, and compares the percussive band
+// energy with the full one; also times the separation alone.
+void PrintPercussive(const WavFile& wav, const Options& options,
+                     const RunResult& result) {
+  Downmixer downmixer;
+  downmixer.Configure(wav.format);
+  std::vector<float> mono(wav.frame_count());
+  downmixer.Process(wav.data.data(), mono.size(), mono.data());
+  RhythmAnalyzer analyzer;
+  analyzer.Configure(options.fft_size, options.hop_size
+                                           ? options.hop_size
+                                           : options.fft_size / 2);
+  analyzer.SetMode(options.mode == AnalysisMode::kFilterBank
+                       ? AnalysisMode::kFft
+                       : options.mode);
+  analyzer.SetDecimation(options.decimation);
+  analyzer.SetBandLayout(options.layout, wav.format.sample_rate);
+  PercussiveSeparator separator;
+  separator.Configure(options.layout, analyzer.grid(),
+                      static_cast<double>(analyzer.hop_size()) /
+                          wav.format.sample_rate);
+
+  double band_sum = 0.0;
+  double percussive_sum = 0.0;
+  double bass_sum = 0.0;
+  double percussive_bass_sum = 0.0;
+  uint64_t frames = 0;
+  uint64_t elapsed_ns = 0;
+  PercussiveOnset onset;
+  const size_t hop = analyzer.hop_size();
+  for (size_t pos = 0; pos < mono.size(); pos += hop) {
+    if (analyzer.PushSamples(&mono[pos], std::min(hop, mono.size() - pos)) ==
+        0) {
+      continue;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    separator.Process(analyzer.magnitudes(), 0, &onset);
+    elapsed_ns += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    frames++;
+    const float* bands = analyzer.bands().data();
+    for (size_t i = 0; i < separator.band_count(); i++) {
+      band_sum += static_cast<double>(bands[i]);
+      percussive_sum += static_cast<double>(separator.bands()[i]);
+    }
+    bass_sum += static_cast<double>(bands[0]);
+    percussive_bass_sum += static_cast<double>(separator.bands()[0]);
+  }
+
+  const double count = static_cast<double>(std::max<uint64_t>(frames, 1));
+  std::printf("  separation    %.1f ns/frame, medians of %zu frames and "
+              "%zu bins\n",
+              static_cast<double>(elapsed_ns) / count,
+              separator.harmonic_frames(), separator.percussive_bins());
+  std::printf("  percussive    %.1f%% of band energy\n",
+              100.0 * percussive_sum / std::max(band_sum, 1e-30));
+  std::printf("  lowest band   %.3g, %.3g percussive (mean)\n",
+              bass_sum / count, percussive_bass_sum / count);
+  std::printf("  onsets        %llu\n",
+              static_cast<unsigned long long>(result.onsets));
+  std::printf("  perc sum      %016llx\n",
+              static_cast<unsigned long long>(result.percussive_checksum));
+}
+
+// Pushes pseudo-random values, ties included, through every window size
+// and compares each median with one found by sorting.
+void PrintRunningMedianCheck() {
+  uint32_t state = 1;
+  uint64_t windows = 0;
+  uint64_t mismatches = 0;
+  for (size_t size = 1; size <= RunningMedian::kMaxSize; size += 2) {
+    RunningMedian median;
+    median.Reset(size);
+    std::vector<float> window(size, 0.0f);
+    std::vector<float> sorted(size);
+    for (size_t n = 0; n < 2000; n++) {
+      state = state * 1664525u + 1013904223u;
+      const float value = static_cast<float>(state >> 24) / 16.0f;
+      window[n % size] = value;
+      const float result = median.Push(value);
+      sorted = window;
+      const auto middle =
+          sorted.begin() + static_cast<std::ptrdiff_t>(size / 2);
+      std::nth_element(sorted.begin(), middle, sorted.end());
+      windows++;
+      if (result != *middle) mismatches++;
+    }
+  }
+  std::printf("  median check  %llu of %llu windows differ from sorting\n",
+              static_cast<unsigned long long>(mismatches),
+              static_cast<unsigned long long>(windows));
+}
+
+bool SameAnalysis(const TrackAnalysis& a, const TrackAnalysis& b) {
+  return a.sample_rate == b.sample_rate && a.frame_count == b.frame_count &&
+         a.source_size == b.source_size && a.bpm == b.bpm &&
+         a.tempo_confidence == b.tempo_confidence &&
+         a.beats_ms == b.beats_ms && a.integrated_lufs == b.integrated_lufs &&
+         a.true_peak_dbtp == b.true_peak_dbtp && a.tonic == b.tonic &&
+         a.mode == b.mode && a.key_confidence == b.key_confidence &&
+         a.leading_silence_ms == b.leading_silence_ms &&
+         a.trailing_silence_ms == b.trailing_silence_ms;
+}
+
+// Analyses |tracks| copies of |path| on |analyzer| and returns the wall
+// time in ns; every result goes to |results|, and the first copy's
+// waveform to |peaks_path| unless it is empty.
+uint64_t AnalyzeCopies(BatchAnalyzer* analyzer, const std::string& path,
+                       const std::string& peaks_path, size_t tracks,
+                       std::vector<TrackAnalysis>* results, bool* ok) {
+  results->assign(tracks, TrackAnalysis());
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < tracks; i++) {
+    TrackJob job;
+    job.open = [path](std::string* error) -> std::unique_ptr<PcmSource> {
+      auto source = std::make_unique<WavFileSource>();
+      if (!source->Open(path, error)) return nullptr;
+      return source;
+    };
+    if (i == 0) job.peaks_path = peaks_path;
+    TrackAnalysis* result = &(*results)[i];
+    job.done = [result, ok](const TrackAnalysis* analysis,
+                            const std::string& error) {
+      if (analysis) {
+        *result = *analysis;
+      } else {
+        std::fprintf(stderr, "rhythm_bench: %s\n", error.c_str());
+        *ok = false;
+      }
+    };
+    analyzer->Submit(std::move(job));
+  }
+  analyzer->Wait();
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+// Checks the pyramid at |peaks_path| against the mono downmix of |wav|,
+// bucket by bucket at level 0 and as a whole at the top, and times queries.
+bool PrintWaveform(const WavFile& wav, const std::string& peaks_path) {
+  std::vector<uint8_t> bytes;
+  {
+    std::FILE* file = std::fopen(peaks_path.c_str(), "rb");
+    if (!file) {
+      std::fprintf(stderr, "rhythm_bench: cannot open %s\n",
+                   peaks_path.c_str());
+      return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    bytes.resize(static_cast<size_t>(std::ftell(file)));
+    std::fseek(file, 0, SEEK_SET);
+    const size_t read = std::fread(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+    bytes.resize(read);
+  }
+  PeakPyramid pyramid;
+  if (!pyramid.Open(bytes.data(), bytes.size())) {
+    std::fprintf(stderr, "rhythm_bench: %s is not a waveform pyramid\n",
+                 peaks_path.c_str());
+    return false;
+  }
+
+  Downmixer downmixer;
+  downmixer.Configure(wav.format);
+  std::vector<float> mono(wav.frame_count());
+  downmixer.Process(wav.data.data(), mono.size(), mono.data());
+  const auto scan = [&mono](size_t first, size_t last) {
+    PeakColumn column;
+    double power = 0.0;
+    column.min = column.max = mono[first];
+    for (size_t i = first; i < last; i++) {
+      column.min = std::min(column.min, mono[i]);
+      column.max = std::max(column.max, mono[i]);
+      power += static_cast<double>(mono[i]) * mono[i];
+    }
+    column.rms = static_cast<float>(
+        std::sqrt(power / static_cast<double>(last - first)));
+    return column;
+  };
+  const auto error = [](const PeakColumn& a, const PeakColumn& b) {
+    return std::max({std::fabs(a.min - b.min), std::fabs(a.max - b.max),
+                     std::fabs(a.rms - b.rms)});
+  };
+  float base_error = 0.0f;
+  const size_t width = cyrene_music::rhythm::kPeakBaseFrames;
+  for (uint64_t b = 0; b < pyramid.bucket_count(0); b++) {
+    const size_t first = static_cast<size_t>(b) * width;
+    base_error =
+        std::max(base_error, error(pyramid.bucket(0, b),
+                                   scan(first, std::min(first + width,
+                                                        mono.size()))));
+  }
+  const size_t top = pyramid.level_count() - 1;
+  const float top_error =
+      error(pyramid.bucket(top, 0), scan(0, mono.size()));
+
+  constexpr size_t kColumns = 1000;
+  constexpr int kQueries = 1000;
+  std::vector<PeakColumn> columns(kColumns);
+  const auto time_query = [&](uint64_t begin, uint64_t end) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kQueries; i++) {
+      pyramid.Query(begin, end, kColumns, columns.data());
+    }
+    return static_cast<double>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()) /
+           kQueries;
+  };
+  const uint64_t middle = pyramid.frame_count() / 2;
+  const double whole_ns = time_query(0, pyramid.frame_count());
+  const double window_ns = time_query(
+      middle, middle + wav.format.sample_rate);
+  const double minutes = static_cast<double>(pyramid.frame_count()) /
+                         wav.format.sample_rate / 60.0;
+  std::printf("  waveform      %zu bytes (%.0f KB/min), %zu levels, "
+              "level 0 within %.5f, top within %.5f\n",
+              bytes.size(),
+              static_cast<double>(bytes.size()) / 1024.0 / minutes,
+              pyramid.level_count(), static_cast<double>(base_error),
+              static_cast<double>(top_error));
+  std::printf("  peak query    %zu columns: %.1f us whole track, %.1f us "
+              "1 s window\n",
+              kColumns, whole_ns * 1e-3, window_ns * 1e-3);
+  return true;
+}
+
+bool PrintOffline(const WavFile& wav, const std::string& path,
+                  const Options& options) {
+  bool ok = true;
+  const std::string peaks_path =
+      (std::filesystem::temp_directory_path() / "rhythm_bench.peaks")
+          .string();
+  std::vector<TrackAnalysis> single;
+  BatchAnalyzer one(1);
+  const uint64_t single_ns =
+      AnalyzeCopies(&one, path, peaks_path, 1, &single, &ok);
+  std::vector<TrackAnalysis> batch;
+  BatchAnalyzer pool;
+  const uint64_t batch_ns = AnalyzeCopies(&pool, path, std::string(),
+                                          options.offline_tracks, &batch, &ok);
+  if (!ok) return false;
+  const TrackAnalysis& track = single[0];
+  size_t differing = 0;
+  for (const TrackAnalysis& analysis : batch) {
+    if (!SameAnalysis(analysis, track)) differing++;
+  }
+
+  const double tracks = static_cast<double>(options.offline_tracks);
+  std::printf("  offline       %.1f ms/track, %.0fx real time on one worker\n",
+              static_cast<double>(single_ns) * 1e-6,
+              track.duration_seconds() * 1e9 /
+                  static_cast<double>(std::max<uint64_t>(single_ns, 1)));
+  std::printf("  pool          %zu tracks, %zu worker%s: %.1f tracks/s, "
+              "%.2fx one worker, %zu differ\n",
+              options.offline_tracks, pool.thread_count(),
+              pool.thread_count() == 1 ? "" : "s",
+              tracks * 1e9 / static_cast<double>(std::max<uint64_t>(
+                                 batch_ns, 1)),
+              tracks * static_cast<double>(single_ns) /
+                  static_cast<double>(std::max<uint64_t>(batch_ns, 1)),
+              differing);
+  std::printf("  track tempo   %.1f bpm (confidence %.2f), %zu beats",
+              static_cast<double>(track.bpm),
+              static_cast<double>(track.tempo_confidence),
+              track.beats_ms.size());
+  if (track.beats_ms.size() > 1) {
+    const double span = track.beats_ms.back() - track.beats_ms.front();
+    std::printf(", %.1f bpm between first and last",
+                60000.0 * static_cast<double>(track.beats_ms.size() - 1) /
+                    span);
+  }
+  std::printf("\n");
+  std::printf("  track level   I %.1f LUFS, %.2f dBTP\n",
+              static_cast<double>(track.integrated_lufs),
+              static_cast<double>(track.true_peak_dbtp));
+  std::printf("  track key     %s (confidence %.2f)\n",
+              KeyName(track.tonic, track.mode).c_str(),
+              static_cast<double>(track.key_confidence));
+  std::printf("  silence       %u ms leading, %u ms trailing of %.0f ms\n",
+              track.leading_silence_ms, track.trailing_silence_ms,
+              track.duration_seconds() * 1000.0);
+  std::vector<uint8_t> record;
+  cyrene_music::rhythm::EncodeTrackAnalysis(track, &record);
+  TrackAnalysis decoded;
+  const bool round_trip =
+      cyrene_music::rhythm::DecodeTrackAnalysis(record.data(), record.size(),
+                                                &decoded) &&
+      SameAnalysis(decoded, track);
+  std::printf("  sidecar       %zu bytes, %s\n", record.size(),
+              round_trip ? "reads back unchanged" : "DIFFERS ON READ-BACK");
+  const bool waveform =
+      track.frame_count == 0 || PrintWaveform(wav, peaks_path);
+  std::remove(peaks_path.c_str());
+  return waveform;
+}
+
+void PrintHistogram(const char* name, const HistogramSnapshot& histogram) {
+  std::printf("  %-13s %llu, mean %.0f ns, p50 < %llu ns, p99 < %llu ns, "
+              "max %llu ns\n",
+              name, static_cast<unsigned long long>(histogram.count),
+              histogram.mean_ns(),
+              static_cast<unsigned long long>(histogram.Quantile(0.5)),
+              static_cast<unsigned long long>(histogram.Quantile(0.99)),
+              static_cast<unsigned long long>(histogram.max_ns));
+}
+
+bool BenchFile(const std::string& path, const Options& options) {
+  cyrene_music::rhythm::WavFile wav;
+  std::string error;
+  if (!cyrene_music::rhythm::ReadWavFile(path, &wav, &error)) {
+    std::fprintf(stderr, "rhythm_bench: %s\n", error.c_str());
+    return false;
+  }
+
+  RunResult best;
+  uint64_t checksum = 0;
+  for (int i = 0; i < options.repeat; i++) {
+    RunResult run = ReplayOnce(wav, options);
+    if (i == 0) {
+      checksum = run.checksum;
+      best = run;
+    } else {
+      if (run.checksum != checksum) {
+        std::fprintf(stderr, "rhythm_bench: %s: non-deterministic output\n",
+                     path.c_str());
+        return false;
+      }
+      if (run.elapsed_ns < best.elapsed_ns) best = run;
+    }
+  }
+
+  const double frames = best.frames ? static_cast<double>(best.frames) : 1.0;
+  std::printf("%s\n", path.c_str());
+  std::printf("  format        %u Hz, %u ch, %s\n", wav.format.sample_rate,
+              wav.format.channels,
+              cyrene_music::rhythm::SampleFormatName(wav.format.sample_format));
+  const size_t bins =
+      best.active_mode == AnalysisMode::kFilterBank
+          ? options.layout.band_count
+          : RhythmAnalyzer::GridFor(best.active_mode, options.fft_size,
+                                    wav.format.sample_rate,
+                                    options.decimation, options.hop_size)
+                .bin_count;
+  std::printf("  mode          %s, %s active, %zu bins\n",
+              cyrene_music::rhythm::AnalysisModeName(options.mode),
+              cyrene_music::rhythm::AnalysisModeName(best.active_mode), bins);
+  std::printf("  fft size      %zu\n", options.fft_size);
+  std::printf("  hop           %zu\n", options.hop_size ? options.hop_size
+                                                      : options.fft_size / 2);
+  std::printf("  bands         %u %s\n", options.layout.band_count,
+              cyrene_music::rhythm::BandScaleName(options.layout.scale));
+  std::printf("  dynamics      %s\n", options.dynamics_enabled ? "on" : "off");
+  std::printf("  kernels       %s\n", options.kernels->name);
+  std::printf("  samples       %s\n", AnalysisFftPlan::kFormat);
+  std::printf("  frames        %llu\n",
+              static_cast<unsigned long long>(best.frames));
+  std::printf("  downmix       %.2f ns/sample frame\n",
+              TimeDownmix(wav, options));
+  std::printf("  ns/frame      %.1f\n",
+              static_cast<double>(best.elapsed_ns) / frames);
+  if (options.crossover && !PrintCrossover(wav, path, options)) return false;
+  if (options.decimation != Decimation()) PrintDecimation(wav, options);
+  if (options.fixed_point) PrintFixedPoint(wav, options);
+  if (options.stereo) {
+    Options mono = options;
+    mono.stereo = false;
+    std::printf("  mono ns/frame %.1f\n", TimeReplay(wav, mono));
+    std::printf("  stereo        %s, correlation %.3f, width %.3f (mean)\n",
+                cyrene_music::rhythm::StereoChannelsName(
+                    options.stereo_channels),
+                best.mean_correlation, best.mean_width);
+    std::printf("  stereo sum    %016llx\n",
+                static_cast<unsigned long long>(best.stereo_checksum));
+  }
+  if (options.features) {
+    Options plain = options;
+    plain.features = false;
+    std::printf("  base ns/frame %.1f\n", TimeReplay(wav, plain));
+    for (size_t i = 0; i < kFeatureCount; i++) {
+      const FeatureRange& range = best.features[i];
+      std::printf("  %-13s %.4g mean, %.4g to %.4g\n", kFeatureNames[i],
+                  range.mean(), static_cast<double>(range.min),
+                  static_cast<double>(range.max));
+    }
+    std::printf("  features sum  %016llx\n",
+                static_cast<unsigned long long>(best.features_checksum));
+    PrintFeatureKernels(*options.kernels);
+  }
+  if (options.chroma) {
+    Options plain = options;
+    plain.chroma = false;
+    std::printf("  base ns/frame %.1f\n", TimeReplay(wav, plain));
+    PrintChroma(best);
+  }
+  if (options.percussive) {
+    Options plain = options;
+    plain.percussive = false;
+    std::printf("  base ns/frame %.1f\n", TimeReplay(wav, plain));
+    PrintPercussive(wav, options, best);
+    PrintRunningMedianCheck();
+  }
+  if (options.offline_tracks > 0 && !PrintOffline(wav, path, options)) {
+    return false;
+  }
+  if (options.mode == AnalysisMode::kMultiResolution) {
+    Options fft = options;
+    fft.mode = AnalysisMode::kFft;
+    std::printf("  fft ns/frame  %.1f\n", TimeReplay(wav, fft));
+    PrintBassResolution("bass res", options.mode, options.fft_size,
+                        wav.format.sample_rate);
+    PrintBassResolution("fft bass res", AnalysisMode::kFft, options.fft_size,
+                        wav.format.sample_rate);
+  }
+  std::printf("  allocs/frame  %.3f\n",
+              static_cast<double>(best.allocations) / frames);
+  if (options.beats) {
+    Options plain = options;
+    plain.beats = false;
+    std::printf("  base ns/frame %.1f\n", TimeReplay(wav, plain));
+    std::printf("  beats         %llu\n",
+                static_cast<unsigned long long>(best.beats));
+    std::printf("  tempo         %.1f bpm (confidence %.2f)\n",
+                static_cast<double>(best.tempo.bpm),
+                static_cast<double>(best.tempo.confidence));
+  }
+  if (options.loudness) {
+    Options plain = options;
+    plain.loudness = false;
+    std::printf("  base ns/frame %.1f\n", TimeReplay(wav, plain));
+    std::printf("  loudness      M %.1f  S %.1f  I %.1f LUFS, %.2f dBTP\n",
+                static_cast<double>(best.loudness.momentary_lufs),
+                static_cast<double>(best.loudness.short_term_lufs),
+                static_cast<double>(best.loudness.integrated_lufs),
+                static_cast<double>(best.loudness.true_peak_dbtp));
+  }
+  for (size_t i = 0; i < best.subscriber_frames.size(); i++) {
+    const SubscriberConfig config = BenchSubscriber(i);
+    std::printf("  subscriber %zu  %u %s at %.0f Hz: %llu frames\n", i,
+                config.layout.band_count,
+                cyrene_music::rhythm::BandScaleName(config.layout.scale),
+                static_cast<double>(config.max_rate_hz),
+                static_cast<unsigned long long>(best.subscriber_frames[i]));
+  }
+  if (options.stats) {
+    std::printf("  packets       %llu\n",
+                static_cast<unsigned long long>(best.stats.packets_captured));
+    PrintHistogram("fft", best.stats.fft);
+    PrintHistogram("band mapping", best.stats.band_mapping);
+  }
+  std::printf("  checksum      %016llx\n",
+              static_cast<unsigned long long>(checksum));
+  std::printf("  scalar dev    %.3g\n",
+              static_cast<double>(MaxDeviationFromScalar(wav, options)));
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      options.repeat = std::atoi(argv[++i]);
+      if (options.repeat < 1) options.repeat = 1;
+    } else if (std::strcmp(argv[i], "--fft-size") == 0 && i + 1 < argc) {
+      options.fft_size = static_cast<size_t>(std::atoi(argv[++i]));
+      if (!cyrene_music::rhythm::RealFftPlan::IsValidSize(options.fft_size)) {
+        std::fprintf(stderr, "rhythm_bench: invalid --fft-size\n");
+        return 2;
+      }
+    } else if (std::strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+      options.hop_size = static_cast<size_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+      if (!cyrene_music::rhythm::ParseAnalysisMode(argv[++i], &options.mode)) {
+        std::fprintf(stderr, "rhythm_bench: unknown --mode %s\n", argv[i]);
+        return 2;
+      }
+    } else if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+      if (!cyrene_music::rhythm::ParseBandScale(argv[++i],
+                                                &options.layout.scale)) {
+        std::fprintf(stderr, "rhythm_bench: unknown --scale %s\n", argv[i]);
+        return 2;
+      }
+    } else if (std::strcmp(argv[i], "--bands") == 0 && i + 1 < argc) {
+      options.layout.band_count = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--dynamics") == 0) {
+      options.dynamics = DynamicsConfig();
+      options.dynamics_enabled = true;
+    } else if (std::strcmp(argv[i], "--subscribers") == 0 && i + 1 < argc) {
+      options.subscribers = static_cast<size_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--stats") == 0) {
+      options.stats = true;
+    } else if (std::strcmp(argv[i], "--crossover") == 0) {
+      options.crossover = true;
+    } else if (std::strcmp(argv[i], "--decimate") == 0 && i + 1 < argc) {
+      options.decimation.factor = static_cast<uint32_t>(std::atoi(argv[++i]));
+      if (options.decimation.factor != 0 &&
+          !cyrene_music::rhythm::PolyphaseDecimator::IsValidFactor(
+              options.decimation.factor)) {
+        std::fprintf(stderr, "rhythm_bench: --decimate must be 0, 1, 2, 4 "
+                             "or 8\n");
+        return 2;
+      }
+    } else if (std::strcmp(argv[i], "--treble") == 0) {
+      options.decimation.treble = true;
+    } else if (std::strcmp(argv[i], "--fixed-point") == 0) {
+      options.fixed_point = true;
+    } else if (std::strcmp(argv[i], "--stereo") == 0 && i + 1 < argc) {
+      options.stereo = true;
+      if (!cyrene_music::rhythm::ParseStereoChannels(
+              argv[++i], &options.stereo_channels)) {
+        std::fprintf(stderr, "rhythm_bench: unknown --stereo %s\n", argv[i]);
+        return 2;
+      }
+    } else if (std::strcmp(argv[i], "--features") == 0) {
+      options.features = true;
+    } else if (std::strcmp(argv[i], "--beats") == 0) {
+      options.beats = true;
+    } else if (std::strcmp(argv[i], "--loudness") == 0) {
+      options.loudness = true;
+    } else if (std::strcmp(argv[i], "--chroma") == 0) {
+      options.chroma = true;
+    } else if (std::strcmp(argv[i], "--percussive") == 0) {
+      options.percussive = true;
+    } else if (std::strcmp(argv[i], "--offline") == 0 && i + 1 < argc) {
+      options.offline_tracks = static_cast<size_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--kernels") == 0 && i + 1 < argc) {
+      options.kernels = cyrene_music::rhythm::FindFftKernels(argv[++i]);
+      options.downmix_kernels =
+          cyrene_music::rhythm::FindDownmixKernels(argv[i]);
+      if (!options.kernels || !options.downmix_kernels) {
+        std::fprintf(stderr, "rhythm_bench: %s kernels unavailable\n",
+                     argv[i]);
+        return 2;
+      }
+    } else {
+      files.emplace_back(argv[i]);
+    }
+  }
+  if (!RhythmAnalyzer::IsValidConfig(options.fft_size, options.hop_size)) {
+    std::fprintf(stderr, "rhythm_bench: --hop must be in [1, fft size]\n");
+    return 2;
+  }
+  if (!cyrene_music::rhythm::BandMapper::IsValidLayout(options.layout)) {
+    std::fprintf(stderr, "rhythm_bench: --bands must be in [4, 128]\n");
+    return 2;
+  }
+  if (files.empty()) {
+    std::fprintf(stderr,
+                 "usage: rhythm_bench [--repeat N] [--fft-size N] [--hop N] "
+                 "[--kernels scalar|sse2|avx2|neon] "
+                 "[--mode fft|multires|filterbank] [--crossover] "
+                 "[--decimate 0|1|2|4|8] [--treble] [--fixed-point] "
+                 "[--scale linear|log|mel|bark] [--bands N] [--dynamics] "
+                 "[--subscribers N] [--stats] [--stereo lr|ms] "
+                 "[--beats] [--loudness] [--features] [--chroma] "
+                 "[--percussive] [--offline N] "
+                 "file.wav...\n");
+    return 2;
+  }
+
+  bool ok = true;
+  for (const auto& file : files) {
+    ok = BenchFile(file, options) && ok;
+  }
+  return ok ? 0 : 1;
+}
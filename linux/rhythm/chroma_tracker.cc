@@ -0,0 +1,190 @@
+#include "chroma_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const char* const kModeNames[] = {"major", "minor"};
+const char* const kPitchClassNames[] = {"C",  "C#", "D",  "D#", "E",  "F",
+                                        "F#", "G",  "G#", "A",  "A#", "B"};
+
+// Krumhansl-Kessler probe-tone ratings from the tonic up.
+const float kMajorProfile[] = {6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f,
+                               2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f};
+const float kMinorProfile[] = {6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f,
+                               2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f};
+
+// Subtracts the mean of |values| and scales them to unit norm. Returns
+// false, leaving them zero-mean, if they are all equal.
+bool Standardize(float* values, size_t count) {
+  double mean = 0.0;
+  for (size_t i = 0; i < count; i++) mean += values[i];
+  mean /= static_cast<double>(count);
+  double norm = 0.0;
+  for (size_t i = 0; i < count; i++) {
+    values[i] = static_cast<float>(values[i] - mean);
+    norm += static_cast<double>(values[i]) * values[i];
+  }
+  if (norm <= 0.0) return false;
+  const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+  for (size_t i = 0; i < count; i++) values[i] *= scale;
+  return true;
+}
+
+}  // namespace
+
+const char* KeyModeName(KeyMode mode) {
+  return kModeNames[static_cast<size_t>(mode)];
+}
+
+const char* PitchClassName(int pitch_class) {
+  return pitch_class >= 0 && pitch_class < 12 ? kPitchClassNames[pitch_class]
+                                              : "?";
+}
+
+ChromaTracker::ChromaTracker() {
+  for (size_t tonic = 0; tonic < kPitchClasses; tonic++) {
+    for (size_t step = 0; step < kPitchClasses; step++) {
+      const size_t pitch_class = (tonic + step) % kPitchClasses;
+      profiles_[tonic][pitch_class] = kMajorProfile[step];
+      profiles_[kPitchClasses + tonic][pitch_class] = kMinorProfile[step];
+    }
+  }
+  for (float* profile : profiles_) Standardize(profile, kPitchClasses);
+}
+
+void ChromaTracker::Configure(const SpectrumGrid& grid, double frame_period) {
+  if (frame_period != frame_period_) {
+    frame_period_ = frame_period;
+    smoothing_ =
+        static_cast<float>(std::exp(-frame_period / kKeySmoothingSeconds));
+    frames_per_reading_ = std::max<uint64_t>(
+        static_cast<uint64_t>(std::llround(kIntervalSeconds / frame_period)),
+        1);
+  }
+  if (grid == grid_) return;
+  grid_ = grid;
+
+  const double max_width = std::exp2(kMaxBinSemitones / 12.0) - 1.0;
+  size_t first = grid.bin_count;
+  size_t end = 0;
+  for (size_t k = 1; k + 1 < grid.bin_count; k++) {
+    const double hz = grid.Frequency(static_cast<double>(k));
+    if (hz < kMinHz || hz > kMaxHz) continue;
+    const double width = grid.Frequency(static_cast<double>(k + 1)) - hz;
+    if (width > hz * max_width) continue;
+    first = std::min(first, k);
+    end = k + 1;
+  }
+  first_bin_ = first;
+  const size_t count = end > first ? end - first : 0;
+  note_.resize(count);
+  slope_.resize(count);
+  auto note = [&](size_t k) {
+    // MIDI note number: C is a multiple of 12.
+    return 69.0 + 12.0 * std::log2(grid.Frequency(static_cast<double>(k)) /
+                                   440.0);
+  };
+  for (size_t i = 0; i < count; i++) {
+    const size_t k = first + i;
+    note_[i] = static_cast<float>(note(k));
+    slope_[i] = static_cast<float>(0.5 * (note(k + 1) - note(k - 1)));
+  }
+  Reset();
+}
+
+void ChromaTracker::Reset() {
+  std::fill(std::begin(chroma_sum_), std::end(chroma_sum_), 0.0f);
+  std::fill(std::begin(smoothed_), std::end(smoothed_), 0.0f);
+  frames_until_reading_ = frames_per_reading_;
+  reading_ = ChromaReading();
+}
+
+bool ChromaTracker::Process(const float* magnitudes, int64_t timestamp_ns) {
+  // One extra slot so that B's upper share, which belongs to C, needs no
+  // wrap-around in the loop.
+  float chroma[kPitchClasses + 1] = {};
+  const size_t count = note_.size();
+  for (size_t i = 0; i < count; i++) {
+    // The table never covers the first or last bin.
+    const float* bin = magnitudes + first_bin_ + i;
+    const float a = bin[-1], b = bin[0], c = bin[1];
+    if (!(b > a && b >= c)) continue;
+    // Vertex of the parabola through the peak and its neighbours.
+    const float offset = 0.5f * (a - c) / (a - 2.0f * b + c);
+    const float pitch = note_[i] + offset * slope_[i];
+    const float lower = std::floor(pitch);
+    const float upper_share = pitch - lower;
+    const size_t pitch_class = static_cast<size_t>(lower) % kPitchClasses;
+    const float power = b * b;
+    const float upper = power * upper_share;
+    chroma[pitch_class] += power - upper;
+    chroma[pitch_class + 1] += upper;
+  }
+  chroma[0] += chroma[kPitchClasses];
+
+  float total = 0.0f;
+  for (size_t c = 0; c < kPitchClasses; c++) total += chroma[c];
+  if (total > 0.0f) {
+    const float share = (1.0f - smoothing_) / total;
+    for (size_t c = 0; c < kPitchClasses; c++) {
+      chroma_sum_[c] += chroma[c];
+      smoothed_[c] = smoothing_ * smoothed_[c] + share * chroma[c];
+    }
+  }
+
+  if (--frames_until_reading_ > 0) return false;
+  frames_until_reading_ = frames_per_reading_;
+
+  reading_.timestamp_ns = timestamp_ns;
+  reading_.silent = false;
+  const float peak =
+      *std::max_element(std::begin(chroma_sum_), std::end(chroma_sum_));
+  for (size_t c = 0; c < kPitchClasses; c++) {
+    reading_.chroma[c] = peak > 0.0f ? chroma_sum_[c] / peak : 0.0f;
+    chroma_sum_[c] = 0.0f;
+  }
+  MatchKey(smoothed_, &reading_);
+  return true;
+}
+
+void ChromaTracker::MatchKey(const float* chroma,
+                             ChromaReading* reading) const {
+  float values[kPitchClasses];
+  std::copy(chroma, chroma + kPitchClasses, values);
+  if (!Standardize(values, kPitchClasses)) {
+    reading->tonic = -1;
+    reading->mode = KeyMode::kMajor;
+    reading->confidence = 0.0f;
+    return;
+  }
+  size_t best = 0;
+  float best_correlation = -2.0f;
+  for (size_t key = 0; key < 2 * kPitchClasses; key++) {
+    float correlation = 0.0f;
+    for (size_t c = 0; c < kPitchClasses; c++) {
+      correlation += profiles_[key][c] * values[c];
+    }
+    if (correlation > best_correlation) {
+      best_correlation = correlation;
+      best = key;
+    }
+  }
+  reading->tonic = static_cast<int8_t>(best % kPitchClasses);
+  reading->mode = best < kPitchClasses ? KeyMode::kMajor : KeyMode::kMinor;
+  reading->confidence = std::max(best_correlation, 0.0f);
+}
+
+void ChromaTracker::Silence(int64_t timestamp_ns) {
+  Reset();
+  reading_.timestamp_ns = timestamp_ns;
+  reading_.silent = true;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
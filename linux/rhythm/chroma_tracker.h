@@ -0,0 +1,118 @@
+#ifndef RHYTHM_CHROMA_TRACKER_H_
+#define RHYTHM_CHROMA_TRACKER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "band_mapper.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+enum class KeyMode : uint8_t {
+  kMajor = 0,
+  kMinor = 1,
+};
+
+// Returns the lower-case name ("major", "minor").
+const char* KeyModeName(KeyMode mode);
+// Returns the name of pitch class |pitch_class| (0 = "C" ... 11 = "B").
+const char* PitchClassName(int pitch_class);
+
+// Pitch-class profile and key of the recent audio.
+struct ChromaReading {
+  static constexpr size_t kPitchClasses = 12;
+
+  // Capture time of the latest frame folded in.
+  int64_t timestamp_ns = 0;
+  // Set on the reading published when analysis is suspended for silence.
+  bool silent = false;
+  // Energy per pitch class from C over the frames since the previous
+  // reading, scaled so that the strongest is 1; all 0 for silence.
+  float chroma[kPitchClasses] = {};
+  // Tonic pitch class (0 = C) and mode of the estimated key; -1 until there
+  // is any pitched energy.
+  int8_t tonic = -1;
+  KeyMode mode = KeyMode::kMajor;
+  // Correlation of the smoothed chroma with that key's profile, in [0, 1].
+  float confidence = 0.0f;
+};
+
+// Chroma and key tracking on top of the spectra the analyser already
+// computes.
+//
+// A fold table built once per spectrum grid holds the pitch of every bin
+// between kMinHz and kMaxHz no wider than kMaxBinSemitones, and how fast
+// the pitch changes from bin to bin. Only spectral peaks are folded: each
+// peak's pitch is refined by a parabola through it and its neighbours, and
+// its power is split between the two nearest pitch classes in proportion
+// to how close it lies to each. A linear FFT therefore contributes from a
+// few hundred hertz up at the default size (lower for larger FFTs), where
+// upper partials weigh more and the key is more often off by a fifth; the
+// multi-resolution spectrum folds from kMinHz.
+//
+// The frame's chroma, normalised to unit sum, feeds an exponential average
+// with a kKeySmoothingSeconds time constant. Every kIntervalSeconds that
+// average is correlated with the 24 rotations of the Krumhansl-Kessler
+// major and minor profiles and the best match is the key.
+//
+// Configure() allocates when the grid changes; Process() does not.
+class ChromaTracker {
+ public:
+  static constexpr size_t kPitchClasses = ChromaReading::kPitchClasses;
+  static constexpr double kMinHz = 55.0;
+  static constexpr double kMaxHz = 5000.0;
+  static constexpr double kMaxBinSemitones = 2.0;
+  static constexpr double kIntervalSeconds = 0.25;
+  static constexpr double kKeySmoothingSeconds = 8.0;
+
+  ChromaTracker();
+
+  // |grid| magnitudes arrive every |frame_period| seconds. Rebuilds the
+  // fold table and resets only if |grid| differs from the current one.
+  void Configure(const SpectrumGrid& grid, double frame_period);
+  void Reset();
+
+  const SpectrumGrid& grid() const { return grid_; }
+  // Bins the fold table covers; 0 if the grid resolves no semitones.
+  size_t folded_bins() const { return note_.size(); }
+
+  // Folds one frame of magnitudes captured at |timestamp_ns|. Returns true
+  // once per reading interval, after which reading() holds the new values.
+  bool Process(const float* magnitudes, int64_t timestamp_ns);
+
+  // Resets and turns reading() into a silent reading at |timestamp_ns|.
+  void Silence(int64_t timestamp_ns);
+
+  const ChromaReading& reading() const { return reading_; }
+
+  // Sets the key of |reading| to the best match for |chroma|, twelve
+  // pitch-class energies on any scale; the rest of |reading| is left alone.
+  // Lets a caller pick the key of a profile gathered in its own way, such
+  // as a whole track's.
+  void MatchKey(const float* chroma, ChromaReading* reading) const;
+
+ private:
+
+  SpectrumGrid grid_;
+  double frame_period_ = 0.0;
+  // Fold table over bins [first_bin_, first_bin_ + folded_bins()): each
+  // bin's pitch as a MIDI note number and its change per bin.
+  size_t first_bin_ = 0;
+  std::vector<float> note_;
+  std::vector<float> slope_;
+  // Zero-mean, unit-norm key profiles: major keys on C..B, then minor.
+  float profiles_[2 * kPitchClasses][kPitchClasses] = {};
+  float smoothing_ = 0.0f;
+  uint64_t frames_per_reading_ = 1;
+  uint64_t frames_until_reading_ = 1;
+  float chroma_sum_[kPitchClasses] = {};
+  float smoothed_[kPitchClasses] = {};
+  ChromaReading reading_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_CHROMA_TRACKER_H_
@@ -0,0 +1,50 @@
+#include "cpu_features.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+CpuFeatures DetectCpuFeatures() {
+  CpuFeatures features;
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  int regs[4] = {0, 0, 0, 0};
+  __cpuid(regs, 0);
+  const int max_leaf = regs[0];
+  __cpuid(regs, 1);
+  features.sse2 = (regs[3] & (1 << 26)) != 0;
+  const bool osxsave = (regs[2] & (1 << 27)) != 0;
+  const bool avx = (regs[2] & (1 << 28)) != 0;
+  if (max_leaf >= 7 && osxsave && avx) {
+    // XMM and YMM state must both be enabled by the OS.
+    const bool ymm_enabled = (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(regs, 7, 0);
+    features.avx2 = ymm_enabled && (regs[1] & (1 << 5)) != 0;
+  }
+#elif (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  features.sse2 = __builtin_cpu_supports("sse2");
+  features.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+  // Advanced SIMD is mandatory on AArch64 and opted into at compile time on
+  // 32-bit ARM, so there is nothing to probe.
+  features.neon = true;
+#endif
+  return features;
+}
+
+}  // namespace
+
+const CpuFeatures& GetCpuFeatures() {
+  static const CpuFeatures features = DetectCpuFeatures();
+  return features;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
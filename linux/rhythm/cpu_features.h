@@ -0,0 +1,21 @@
+#ifndef RHYTHM_CPU_FEATURES_H_
+#define RHYTHM_CPU_FEATURES_H_
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Instruction set extensions usable by the analysis kernels on this machine.
+// AVX2 is only reported when the OS also saves the YMM state.
+struct CpuFeatures {
+  bool sse2 = false;
+  bool avx2 = false;
+  bool neon = false;
+};
+
+// Detected once on first use; safe to call from any thread.
+const CpuFeatures& GetCpuFeatures();
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_CPU_FEATURES_H_
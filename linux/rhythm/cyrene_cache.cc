@@ -0,0 +1,55 @@
+#include "cyrene_cache.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace cyrene_music {
+namespace rhythm {
+
+bool ReadCyreneAudio(const std::string& path, const std::string& key,
+                     std::vector<uint8_t>* audio, std::string* error) {
+  if (key.empty()) {
+    *error = "no key to decrypt " + path;
+    return false;
+  }
+  std::ifstream file(std::filesystem::u8path(path),
+                     std::ios::binary | std::ios::ate);
+  if (!file) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  const uint64_t size = static_cast<uint64_t>(file.tellg());
+  file.seekg(0);
+  uint8_t header[4];
+  if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+    *error = path + " is not a cache entry";
+    return false;
+  }
+  const uint64_t metadata_size = (static_cast<uint32_t>(header[0]) << 24) |
+                                 (static_cast<uint32_t>(header[1]) << 16) |
+                                 (static_cast<uint32_t>(header[2]) << 8) |
+                                 header[3];
+  const uint64_t audio_offset = sizeof(header) + metadata_size;
+  if (audio_offset > size) {
+    *error = path + " is truncated";
+    return false;
+  }
+
+  audio->resize(static_cast<size_t>(size - audio_offset));
+  file.seekg(static_cast<std::streamoff>(audio_offset));
+  if (!file.read(reinterpret_cast<char*>(audio->data()),
+                 static_cast<std::streamsize>(audio->size()))) {
+    *error = "cannot read " + path;
+    return false;
+  }
+  const size_t key_size = key.size();
+  size_t k = 0;
+  for (uint8_t& byte : *audio) {
+    byte ^= static_cast<uint8_t>(key[k]);
+    if (++k == key_size) k = 0;
+  }
+  return true;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
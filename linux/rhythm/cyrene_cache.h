@@ -0,0 +1,23 @@
+#ifndef RHYTHM_CYRENE_CACHE_H_
+#define RHYTHM_CYRENE_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Reads the audio out of the .cyrene cache entry at |path| (UTF-8) as the
+// player's cache service writes it: a 4-byte big-endian metadata length,
+// that many bytes of JSON metadata, then the encoded audio file XORed with
+// |key| repeated from its first byte. Fills |audio| with the decrypted file
+// (MP3, FLAC, ...) for a platform decoder. Returns false and fills |error|
+// if the file is missing or truncated, or |key| is empty.
+bool ReadCyreneAudio(const std::string& path, const std::string& key,
+                     std::vector<uint8_t>* audio, std::string* error);
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_CYRENE_CACHE_H_
@@ -0,0 +1,237 @@
+#include "downmix.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+uint16_t ReadLe16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLe32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Relative weight of one speaker position in the mono downmix.
+float SpeakerWeight(uint32_t speaker) {
+  switch (speaker) {
+    case kSpeakerFrontLeft:
+    case kSpeakerFrontRight:
+    case kSpeakerFrontCenter:
+    case kSpeakerFrontLeftOfCenter:
+    case kSpeakerFrontRightOfCenter:
+      return 1.0f;
+    case kSpeakerBackLeft:
+    case kSpeakerBackRight:
+    case kSpeakerBackCenter:
+    case kSpeakerSideLeft:
+    case kSpeakerSideRight:
+      return 0.70710678f;
+    default:
+      // LFE and the height channels.
+      return 0.5f;
+  }
+}
+
+// Which side of the listener a speaker position is on: 1 for left, -1 for
+// right, 0 for centred.
+float SpeakerSide(uint32_t speaker) {
+  switch (speaker) {
+    case kSpeakerFrontLeft:
+    case kSpeakerFrontLeftOfCenter:
+    case kSpeakerBackLeft:
+    case kSpeakerSideLeft:
+    case kSpeakerTopFrontLeft:
+    case kSpeakerTopBackLeft:
+      return 1.0f;
+    case kSpeakerFrontRight:
+    case kSpeakerFrontRightOfCenter:
+    case kSpeakerBackRight:
+    case kSpeakerSideRight:
+    case kSpeakerTopFrontRight:
+    case kSpeakerTopBackRight:
+      return -1.0f;
+    default:
+      return 0.0f;
+  }
+}
+
+}  // namespace
+
+const char* SampleFormatName(SampleFormat format) {
+  switch (format) {
+    case SampleFormat::kInt16:
+      return "int16";
+    case SampleFormat::kInt24:
+      return "int24";
+    case SampleFormat::kInt32:
+      return "int32";
+    case SampleFormat::kFloat32:
+      return "float32";
+  }
+  return "unknown";
+}
+
+size_t SampleFormatBytes(SampleFormat format) {
+  switch (format) {
+    case SampleFormat::kInt16:
+      return 2;
+    case SampleFormat::kInt24:
+      return 3;
+    case SampleFormat::kInt32:
+    case SampleFormat::kFloat32:
+      return 4;
+  }
+  return 0;
+}
+
+bool ParseWaveFormat(const uint8_t* bytes, size_t size, AudioFormat* out) {
+  if (size < 16) return false;
+  uint16_t format_tag = ReadLe16(bytes);
+  const uint16_t bits = ReadLe16(bytes + 14);
+  AudioFormat format;
+  format.channels = ReadLe16(bytes + 2);
+  format.sample_rate = ReadLe32(bytes + 4);
+  format.block_align = ReadLe16(bytes + 12);
+  if (format_tag == kWaveFormatExtensible) {
+    if (size < 40) return false;
+    format.channel_mask = ReadLe32(bytes + 20);
+    // The first two bytes of the sub-format GUID carry the format tag.
+    format_tag = ReadLe16(bytes + 24);
+  }
+
+  if (format_tag == kWaveFormatFloat && bits == 32) {
+    format.sample_format = SampleFormat::kFloat32;
+  } else if (format_tag == kWaveFormatPcm && bits == 16) {
+    format.sample_format = SampleFormat::kInt16;
+  } else if (format_tag == kWaveFormatPcm && bits == 24) {
+    format.sample_format = SampleFormat::kInt24;
+  } else if (format_tag == kWaveFormatPcm && bits == 32) {
+    format.sample_format = SampleFormat::kInt32;
+  } else {
+    return false;
+  }
+  if (format.channels == 0 ||
+      format.block_align <
+          format.channels * SampleFormatBytes(format.sample_format)) {
+    return false;
+  }
+  *out = format;
+  return true;
+}
+
+void DefaultDownmixWeights(const AudioFormat& format, float* weights) {
+  uint32_t mask = format.channel_mask;
+  float sum = 0.0f;
+  for (size_t c = 0; c < format.channels; c++) {
+    // Channels take the mask's speaker positions in bit order; any beyond
+    // the mask have none.
+    const uint32_t speaker = mask & (~mask + 1);
+    mask &= mask - 1;
+    weights[c] = speaker ? SpeakerWeight(speaker) : 1.0f;
+    sum += weights[c];
+  }
+  for (size_t c = 0; c < format.channels; c++) weights[c] /= sum;
+}
+
+void SideWeights(const AudioFormat& format, const float* weights,
+                 float* side) {
+  uint32_t mask = format.channel_mask;
+  for (size_t c = 0; c < format.channels; c++) {
+    const uint32_t speaker = mask & (~mask + 1);
+    mask &= mask - 1;
+    float position = 0.0f;
+    if (format.channel_mask != 0) {
+      position = SpeakerSide(speaker);
+    } else if (format.channels == 2) {
+      position = c == 0 ? 1.0f : -1.0f;
+    }
+    side[c] = position * weights[c];
+  }
+}
+
+Downmixer::Downmixer() : kernels_(&SelectDownmixKernels()) {
+  std::fill(weights_, weights_ + kMaxChannels, 0.0f);
+  std::fill(side_weights_, side_weights_ + kMaxChannels, 0.0f);
+}
+
+bool Downmixer::Configure(const AudioFormat& format, const float* weights) {
+  if (format.channels == 0 || format.channels > kMaxChannels ||
+      format.block_align <
+          format.channels * SampleFormatBytes(format.sample_format)) {
+    return false;
+  }
+  format_ = format;
+  if (weights) {
+    std::copy(weights, weights + format.channels, weights_);
+  } else {
+    DefaultDownmixWeights(format, weights_);
+  }
+  SideWeights(format, weights_, side_weights_);
+  block_.assign(kBlockFrames * format.channels, 0.0f);
+  return true;
+}
+
+void Downmixer::Process(const void* data, size_t frames, float* mono) {
+  Process(data, frames, mono, nullptr);
+}
+
+void Downmixer::Process(const void* data, size_t frames, float* mono,
+                        float* side) {
+  const size_t channels = format_.channels;
+  const size_t sample_bytes = SampleFormatBytes(format_.sample_format);
+  const bool packed = format_.block_align == channels * sample_bytes;
+  if (packed && format_.sample_format == SampleFormat::kFloat32) {
+    const float* in = static_cast<const float*>(data);
+    kernels_->mix(in, frames, channels, weights_, mono);
+    if (side) kernels_->mix(in, frames, channels, side_weights_, side);
+    return;
+  }
+
+  const uint8_t* in = static_cast<const uint8_t*>(data);
+  for (size_t done = 0; done < frames; done += kBlockFrames) {
+    const size_t count = std::min(frames - done, kBlockFrames);
+    const uint8_t* block = in + done * format_.block_align;
+    if (packed) {
+      ConvertToFloat(block, count * channels, block_.data());
+    } else {
+      // Padded frames are converted one at a time.
+      for (size_t i = 0; i < count; i++) {
+        ConvertToFloat(block + i * format_.block_align, channels,
+                       block_.data() + i * channels);
+      }
+    }
+    kernels_->mix(block_.data(), count, channels, weights_, mono + done);
+    if (side) {
+      kernels_->mix(block_.data(), count, channels, side_weights_,
+                    side + done);
+    }
+  }
+}
+
+void Downmixer::ConvertToFloat(const uint8_t* in, size_t count,
+                               float* out) const {
+  switch (format_.sample_format) {
+    case SampleFormat::kInt16:
+      kernels_->int16_to_float(in, count, out);
+      break;
+    case SampleFormat::kInt24:
+      kernels_->int24_to_float(in, count, out);
+      break;
+    case SampleFormat::kInt32:
+      kernels_->int32_to_float(in, count, out);
+      break;
+    case SampleFormat::kFloat32:
+      std::memcpy(out, in, count * sizeof(float));
+      break;
+  }
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,128 @@
+#ifndef RHYTHM_DOWNMIX_H_
+#define RHYTHM_DOWNMIX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "downmix_kernels.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// WAVEFORMATEX format tags.
+constexpr uint16_t kWaveFormatPcm = 0x0001;
+constexpr uint16_t kWaveFormatFloat = 0x0003;
+constexpr uint16_t kWaveFormatExtensible = 0xFFFE;
+
+// Speaker positions in a WAVEFORMATEXTENSIBLE channel mask. Channels appear
+// in the stream in the order of their bits.
+constexpr uint32_t kSpeakerFrontLeft = 0x1;
+constexpr uint32_t kSpeakerFrontRight = 0x2;
+constexpr uint32_t kSpeakerFrontCenter = 0x4;
+constexpr uint32_t kSpeakerLowFrequency = 0x8;
+constexpr uint32_t kSpeakerBackLeft = 0x10;
+constexpr uint32_t kSpeakerBackRight = 0x20;
+constexpr uint32_t kSpeakerFrontLeftOfCenter = 0x40;
+constexpr uint32_t kSpeakerFrontRightOfCenter = 0x80;
+constexpr uint32_t kSpeakerBackCenter = 0x100;
+constexpr uint32_t kSpeakerSideLeft = 0x200;
+constexpr uint32_t kSpeakerSideRight = 0x400;
+// kSpeakerTopCenter (0x800) and above are the height channels.
+constexpr uint32_t kSpeakerTopCenter = 0x800;
+constexpr uint32_t kSpeakerTopFrontLeft = 0x1000;
+constexpr uint32_t kSpeakerTopFrontRight = 0x4000;
+constexpr uint32_t kSpeakerTopBackLeft = 0x8000;
+constexpr uint32_t kSpeakerTopBackRight = 0x20000;
+
+// Interleaved sample encodings the downmix can read. 24-bit audio in a
+// 32-bit container is left-justified and reads as kInt32.
+enum class SampleFormat : uint8_t {
+  kInt16,
+  kInt24,
+  kInt32,
+  kFloat32,
+};
+
+const char* SampleFormatName(SampleFormat format);
+size_t SampleFormatBytes(SampleFormat format);
+
+// A capture or file format, resolved from WAVEFORMATEX(TENSIBLE).
+struct AudioFormat {
+  SampleFormat sample_format = SampleFormat::kFloat32;
+  uint16_t channels = 0;
+  uint32_t sample_rate = 0;
+  // Bytes per interleaved frame; may exceed channels * sample size.
+  uint16_t block_align = 0;
+  // Speaker mask of a WAVEFORMATEXTENSIBLE format, otherwise 0.
+  uint32_t channel_mask = 0;
+};
+
+// Parses the little-endian WAVEFORMATEX (or WAVEFORMATEXTENSIBLE) structure
+// in |bytes|, as found in a WAV fmt chunk or returned by
+// IAudioClient::GetMixFormat(). Returns false for encodings the downmix
+// cannot read.
+bool ParseWaveFormat(const uint8_t* bytes, size_t size, AudioFormat* out);
+
+// Fills |weights| (one per channel) with the default mono downmix: front
+// channels at full weight, surrounds at -3 dB and the LFE and height
+// channels at -6 dB, normalised to sum to one. Channels without a speaker
+// position, or all channels when there is no mask, are weighted equally.
+void DefaultDownmixWeights(const AudioFormat& format, float* weights);
+
+// Fills |side| (one per channel) with the weights of the side signal that
+// goes with the mono downmix |weights|: +weight for speakers on the left,
+// -weight for those on the right and 0 for centred ones, so that
+// mono + side and mono - side are the left and right fold-downs. Without a
+// channel mask only a two-channel format is taken as left and right.
+void SideWeights(const AudioFormat& format, const float* weights,
+                 float* side);
+
+// Turns interleaved capture packets of any supported format into mono float
+// samples: integers are converted in blocks to floats and every frame is
+// reduced to the weighted sum of its channels, both with the fastest
+// kernels the CPU supports. Configure() allocates; Process() does not.
+class Downmixer {
+ public:
+  static constexpr size_t kMaxChannels = 32;
+
+  Downmixer();
+
+  // Prepares for |format|. |weights| holds one weight per channel, or is
+  // null for DefaultDownmixWeights(). Returns false if the format has no
+  // channels, more than kMaxChannels or a frame smaller than its samples.
+  bool Configure(const AudioFormat& format, const float* weights = nullptr);
+
+  // Selects the kernel table; intended for benchmarking.
+  void SetKernels(const DownmixKernels& kernels) { kernels_ = &kernels; }
+  const DownmixKernels& kernels() const { return *kernels_; }
+
+  const AudioFormat& format() const { return format_; }
+  const float* weights() const { return weights_; }
+  const float* side_weights() const { return side_weights_; }
+
+  // Downmixes |frames| interleaved frames at |data| into |mono|, which must
+  // hold |frames| samples. Float input must be 4-byte aligned.
+  void Process(const void* data, size_t frames, float* mono);
+  // Same, and also writes the side signal (see SideWeights()) to |side|,
+  // which must hold |frames| samples too.
+  void Process(const void* data, size_t frames, float* mono, float* side);
+
+ private:
+  // Frames converted to float per block before mixing.
+  static constexpr size_t kBlockFrames = 256;
+
+  void ConvertToFloat(const uint8_t* in, size_t count, float* out) const;
+
+  const DownmixKernels* kernels_;
+  AudioFormat format_;
+  float weights_[kMaxChannels];
+  float side_weights_[kMaxChannels];
+  // One block of converted samples, kBlockFrames * channels.
+  std::vector<float> block_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_DOWNMIX_H_
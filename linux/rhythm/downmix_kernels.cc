@@ -0,0 +1,91 @@
+#include "downmix_kernels.h"
+
+#include <cstring>
+
+#include "cpu_features.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+// Scale factors are powers of two, so every converter is exact up to the
+// rounding of the integer to float conversion itself.
+constexpr float kInt16Scale = 1.0f / 32768.0f;
+constexpr float kInt32Scale = 1.0f / 2147483648.0f;
+
+void ScalarInt16ToFloat(const uint8_t* in, size_t count, float* out) {
+  for (size_t i = 0; i < count; i++, in += 2) {
+    const int16_t value =
+        static_cast<int16_t>(static_cast<uint16_t>(in[0] | (in[1] << 8)));
+    out[i] = static_cast<float>(value) * kInt16Scale;
+  }
+}
+
+// 24-bit samples are shifted into the top of an int32, which keeps the
+// conversion exact and shares the int32 scale.
+void ScalarInt24ToFloat(const uint8_t* in, size_t count, float* out) {
+  for (size_t i = 0; i < count; i++, in += 3) {
+    const int32_t value = static_cast<int32_t>(
+        (static_cast<uint32_t>(in[0]) << 8) |
+        (static_cast<uint32_t>(in[1]) << 16) |
+        (static_cast<uint32_t>(in[2]) << 24));
+    out[i] = static_cast<float>(value) * kInt32Scale;
+  }
+}
+
+void ScalarInt32ToFloat(const uint8_t* in, size_t count, float* out) {
+  for (size_t i = 0; i < count; i++, in += 4) {
+    uint32_t bits;
+    std::memcpy(&bits, in, sizeof(bits));
+    out[i] = static_cast<float>(static_cast<int32_t>(bits)) * kInt32Scale;
+  }
+}
+
+void ScalarMix(const float* in, size_t frames, size_t channels,
+               const float* weights, float* out) {
+  if (channels == 1) {
+    for (size_t i = 0; i < frames; i++) out[i] = weights[0] * in[i];
+    return;
+  }
+  if (channels == 2) {
+    for (size_t i = 0; i < frames; i++) {
+      out[i] = weights[0] * in[2 * i] + weights[1] * in[2 * i + 1];
+    }
+    return;
+  }
+  for (size_t i = 0; i < frames; i++, in += channels) {
+    float sum = weights[0] * in[0];
+    for (size_t c = 1; c < channels; c++) sum += weights[c] * in[c];
+    out[i] = sum;
+  }
+}
+
+const DownmixKernels kScalarKernels = {
+    "scalar", ScalarInt16ToFloat, ScalarInt24ToFloat, ScalarInt32ToFloat,
+    ScalarMix,
+};
+
+}  // namespace
+
+const DownmixKernels& ScalarDownmixKernels() { return kScalarKernels; }
+
+const DownmixKernels& SelectDownmixKernels() {
+  const CpuFeatures& cpu = GetCpuFeatures();
+  if (cpu.avx2 && Avx2DownmixKernels()) return *Avx2DownmixKernels();
+  if (cpu.sse2 && Sse2DownmixKernels()) return *Sse2DownmixKernels();
+  if (cpu.neon && NeonDownmixKernels()) return *NeonDownmixKernels();
+  return kScalarKernels;
+}
+
+const DownmixKernels* FindDownmixKernels(const char* name) {
+  const CpuFeatures& cpu = GetCpuFeatures();
+  if (std::strcmp(name, "scalar") == 0) return &kScalarKernels;
+  if (std::strcmp(name, "sse2") == 0 && cpu.sse2) return Sse2DownmixKernels();
+  if (std::strcmp(name, "avx2") == 0 && cpu.avx2) return Avx2DownmixKernels();
+  if (std::strcmp(name, "neon") == 0 && cpu.neon) return NeonDownmixKernels();
+  return nullptr;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,46 @@
+#ifndef RHYTHM_DOWNMIX_KERNELS_H_
+#define RHYTHM_DOWNMIX_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Inner loops of the capture downmix, one table per instruction set.
+// Integer samples are little-endian and need no particular alignment. Every
+// implementation performs the same floating-point operations in the same
+// order as the scalar one, so all tables give bit-identical output.
+struct DownmixKernels {
+  const char* name;
+
+  // Convert |count| signed samples to floats in [-1, 1).
+  void (*int16_to_float)(const uint8_t* in, size_t count, float* out);
+  void (*int24_to_float)(const uint8_t* in, size_t count, float* out);
+  void (*int32_to_float)(const uint8_t* in, size_t count, float* out);
+
+  // out[i] = sum over c of weights[c] * in[i * channels + c], summed from
+  // the first channel to the last.
+  void (*mix)(const float* in, size_t frames, size_t channels,
+              const float* weights, float* out);
+};
+
+const DownmixKernels& ScalarDownmixKernels();
+
+// The SIMD tables return nullptr when the kernel was not compiled for this
+// target. They do not check the running CPU; see SelectDownmixKernels().
+const DownmixKernels* Sse2DownmixKernels();
+const DownmixKernels* Avx2DownmixKernels();
+const DownmixKernels* NeonDownmixKernels();
+
+// Returns the fastest kernel table supported by the running CPU.
+const DownmixKernels& SelectDownmixKernels();
+
+// Looks a kernel table up by name ("scalar", "sse2", "avx2", "neon").
+// Returns nullptr if it is unknown, not compiled in or not supported.
+const DownmixKernels* FindDownmixKernels(const char* name);
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_DOWNMIX_KERNELS_H_
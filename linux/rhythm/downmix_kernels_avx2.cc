@@ -0,0 +1,131 @@
+#include "downmix_kernels.h"
+
+// Built with -mavx2 (/arch:AVX2 on MSVC); only reached after GetCpuFeatures()
+// has confirmed AVX2 support, so nothing here may run on older CPUs.
+#if defined(__AVX2__)
+#define RHYTHM_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+#if defined(RHYTHM_HAVE_AVX2)
+
+namespace {
+
+void Avx2Int16ToFloat(const uint8_t* in, size_t count, float* out) {
+  const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+  size_t k = 0;
+  for (; k + 8 <= count; k += 8) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * k));
+    const __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+    _mm256_storeu_ps(out + k, _mm256_mul_ps(x, scale));
+  }
+  if (k < count) {
+    ScalarDownmixKernels().int16_to_float(in + 2 * k, count - k, out + k);
+  }
+}
+
+// Each 128-bit lane holds 16 bytes starting at one group of four packed
+// samples; the shuffle moves every sample's three bytes to the top of a
+// 32-bit lane, as the scalar converter does.
+void Avx2Int24ToFloat(const uint8_t* in, size_t count, float* out) {
+  const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+  const __m256i spread = _mm256_setr_epi8(
+      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+  size_t k = 0;
+  // The second lane's load reads four bytes past the eight samples.
+  for (; k + 10 <= count; k += 8) {
+    const uint8_t* p = in + 3 * k;
+    const __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+    const __m256 x = _mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, spread));
+    _mm256_storeu_ps(out + k, _mm256_mul_ps(x, scale));
+  }
+  if (k < count) {
+    ScalarDownmixKernels().int24_to_float(in + 3 * k, count - k, out + k);
+  }
+}
+
+void Avx2Int32ToFloat(const uint8_t* in, size_t count, float* out) {
+  const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+  size_t k = 0;
+  for (; k + 8 <= count; k += 8) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 4 * k));
+    _mm256_storeu_ps(out + k, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+  }
+  if (k < count) {
+    ScalarDownmixKernels().int32_to_float(in + 4 * k, count - k, out + k);
+  }
+}
+
+void Avx2Mix(const float* in, size_t frames, size_t channels,
+             const float* weights, float* out) {
+  size_t i = 0;
+  if (channels == 1) {
+    const __m256 w = _mm256_set1_ps(weights[0]);
+    for (; i + 8 <= frames; i += 8) {
+      _mm256_storeu_ps(out + i, _mm256_mul_ps(w, _mm256_loadu_ps(in + i)));
+    }
+  } else if (channels == 2) {
+    const __m256 w0 = _mm256_set1_ps(weights[0]);
+    const __m256 w1 = _mm256_set1_ps(weights[1]);
+    for (; i + 8 <= frames; i += 8) {
+      const __m256 a = _mm256_loadu_ps(in + 2 * i);
+      const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+      // The in-lane shuffles leave frames in 0 1 4 5 2 3 6 7 order; the
+      // mix is per frame, so only the result needs putting back in order.
+      const __m256 left = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      const __m256 right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+      const __m256 mixed =
+          _mm256_add_ps(_mm256_mul_ps(w0, left), _mm256_mul_ps(w1, right));
+      _mm256_storeu_ps(out + i,
+                       _mm256_castpd_ps(_mm256_permute4x64_pd(
+                           _mm256_castps_pd(mixed), _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+  } else {
+    // Eight frames at a time, one channel per step, so each lane sums its
+    // channels in the same order as the scalar loop.
+    const int stride = static_cast<int>(channels);
+    const __m256i offsets =
+        _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                           _mm256_set1_epi32(stride));
+    for (; i + 8 <= frames; i += 8) {
+      const float* f = in + i * channels;
+      __m256 sum = _mm256_mul_ps(_mm256_set1_ps(weights[0]),
+                                 _mm256_i32gather_ps(f, offsets, 4));
+      for (size_t c = 1; c < channels; c++) {
+        const __m256 x = _mm256_i32gather_ps(f + c, offsets, 4);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[c]), x));
+      }
+      _mm256_storeu_ps(out + i, sum);
+    }
+  }
+  if (i < frames) {
+    ScalarDownmixKernels().mix(in + i * channels, frames - i, channels,
+                               weights, out + i);
+  }
+}
+
+const DownmixKernels kAvx2Kernels = {
+    "avx2", Avx2Int16ToFloat, Avx2Int24ToFloat, Avx2Int32ToFloat, Avx2Mix,
+};
+
+}  // namespace
+
+const DownmixKernels* Avx2DownmixKernels() { return &kAvx2Kernels; }
+
+#else
+
+const DownmixKernels* Avx2DownmixKernels() { return nullptr; }
+
+#endif  // RHYTHM_HAVE_AVX2
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,124 @@
+#include "downmix_kernels.h"
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define RHYTHM_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+#if defined(RHYTHM_HAVE_NEON)
+
+namespace {
+
+void NeonInt16ToFloat(const uint8_t* in, size_t count, float* out) {
+  const float scale = 1.0f / 32768.0f;
+  size_t k = 0;
+  for (; k + 8 <= count; k += 8) {
+    const int16x8_t v = vreinterpretq_s16_u8(vld1q_u8(in + 2 * k));
+    const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+    const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+    vst1q_f32(out + k, vmulq_n_f32(lo, scale));
+    vst1q_f32(out + k + 4, vmulq_n_f32(hi, scale));
+  }
+  if (k < count) {
+    ScalarDownmixKernels().int16_to_float(in + 2 * k, count - k, out + k);
+  }
+}
+
+// vld3 splits eight packed samples into their low, middle and high bytes,
+// which are reassembled at the top of 32-bit lanes as in the scalar loop.
+void NeonInt24ToFloat(const uint8_t* in, size_t count, float* out) {
+  const float scale = 1.0f / 2147483648.0f;
+  size_t k = 0;
+  for (; k + 8 <= count; k += 8) {
+    const uint8x8x3_t bytes = vld3_u8(in + 3 * k);
+    // (high << 24) | (middle << 16) | (low << 8), built from 16-bit halves.
+    const uint16x8_t lo16 =
+        vorrq_u16(vshll_n_u8(bytes.val[1], 8), vmovl_u8(bytes.val[0]));
+    const uint16x8_t hi16 = vmovl_u8(bytes.val[2]);
+    const uint32x4_t a = vorrq_u32(
+        vshlq_n_u32(vmovl_u16(vget_low_u16(hi16)), 24),
+        vshlq_n_u32(vmovl_u16(vget_low_u16(lo16)), 8));
+    const uint32x4_t b = vorrq_u32(
+        vshlq_n_u32(vmovl_u16(vget_high_u16(hi16)), 24),
+        vshlq_n_u32(vmovl_u16(vget_high_u16(lo16)), 8));
+    vst1q_f32(out + k,
+              vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(a)), scale));
+    vst1q_f32(out + k + 4,
+              vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(b)), scale));
+  }
+  if (k < count) {
+    ScalarDownmixKernels().int24_to_float(in + 3 * k, count - k, out + k);
+  }
+}
+
+void NeonInt32ToFloat(const uint8_t* in, size_t count, float* out) {
+  const float scale = 1.0f / 2147483648.0f;
+  size_t k = 0;
+  for (; k + 4 <= count; k += 4) {
+    const int32x4_t v = vreinterpretq_s32_u8(vld1q_u8(in + 4 * k));
+    vst1q_f32(out + k, vmulq_n_f32(vcvtq_f32_s32(v), scale));
+  }
+  if (k < count) {
+    ScalarDownmixKernels().int32_to_float(in + 4 * k, count - k, out + k);
+  }
+}
+
+// {p[0], p[stride], p[2 * stride], p[3 * stride]}
+inline float32x4_t Gather4(const float* p, size_t stride) {
+  float32x4_t x = vdupq_n_f32(p[0]);
+  x = vsetq_lane_f32(p[stride], x, 1);
+  x = vsetq_lane_f32(p[2 * stride], x, 2);
+  return vsetq_lane_f32(p[3 * stride], x, 3);
+}
+
+void NeonMix(const float* in, size_t frames, size_t channels,
+             const float* weights, float* out) {
+  size_t i = 0;
+  if (channels == 1) {
+    for (; i + 4 <= frames; i += 4) {
+      vst1q_f32(out + i, vmulq_n_f32(vld1q_f32(in + i), weights[0]));
+    }
+  } else if (channels == 2) {
+    for (; i + 4 <= frames; i += 4) {
+      const float32x4x2_t v = vld2q_f32(in + 2 * i);
+      vst1q_f32(out + i, vaddq_f32(vmulq_n_f32(v.val[0], weights[0]),
+                                   vmulq_n_f32(v.val[1], weights[1])));
+    }
+  } else {
+    // Four frames at a time, one channel per step, so each lane sums its
+    // channels in the same order as the scalar loop.
+    for (; i + 4 <= frames; i += 4) {
+      const float* f = in + i * channels;
+      float32x4_t sum = vmulq_n_f32(Gather4(f, channels), weights[0]);
+      for (size_t c = 1; c < channels; c++) {
+        sum = vaddq_f32(sum, vmulq_n_f32(Gather4(f + c, channels),
+                                         weights[c]));
+      }
+      vst1q_f32(out + i, sum);
+    }
+  }
+  if (i < frames) {
+    ScalarDownmixKernels().mix(in + i * channels, frames - i, channels,
+                               weights, out + i);
+  }
+}
+
+const DownmixKernels kNeonKernels = {
+    "neon", NeonInt16ToFloat, NeonInt24ToFloat, NeonInt32ToFloat, NeonMix,
+};
+
+}  // namespace
+
+const DownmixKernels* NeonDownmixKernels() { return &kNeonKernels; }
+
+#else
+
+const DownmixKernels* NeonDownmixKernels() { return nullptr; }
+
+#endif  // RHYTHM_HAVE_NEON
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,110 @@
+#include "downmix_kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RHYTHM_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+#if defined(RHYTHM_HAVE_SSE2)
+
+namespace {
+
+void Sse2Int16ToFloat(const uint8_t* in, size_t count, float* out) {
+  const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+  const __m128i zero = _mm_setzero_si128();
+  size_t k = 0;
+  for (; k + 8 <= count; k += 8) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * k));
+    // Interleaving below zeros puts each sample in the top half of a lane;
+    // the arithmetic shift then sign-extends it.
+    const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(zero, v), 16);
+    const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(zero, v), 16);
+    _mm_storeu_ps(out + k, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(out + k + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  if (k < count) {
+    ScalarDownmixKernels().int16_to_float(in + 2 * k, count - k, out + k);
+  }
+}
+
+// SSE2 has no byte shuffle, so packed 24-bit samples use the scalar loop.
+void Sse2Int24ToFloat(const uint8_t* in, size_t count, float* out) {
+  ScalarDownmixKernels().int24_to_float(in, count, out);
+}
+
+void Sse2Int32ToFloat(const uint8_t* in, size_t count, float* out) {
+  const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+  size_t k = 0;
+  for (; k + 4 <= count; k += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * k));
+    _mm_storeu_ps(out + k, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+  }
+  if (k < count) {
+    ScalarDownmixKernels().int32_to_float(in + 4 * k, count - k, out + k);
+  }
+}
+
+void Sse2Mix(const float* in, size_t frames, size_t channels,
+             const float* weights, float* out) {
+  size_t i = 0;
+  if (channels == 1) {
+    const __m128 w = _mm_set1_ps(weights[0]);
+    for (; i + 4 <= frames; i += 4) {
+      _mm_storeu_ps(out + i, _mm_mul_ps(w, _mm_loadu_ps(in + i)));
+    }
+  } else if (channels == 2) {
+    const __m128 w0 = _mm_set1_ps(weights[0]);
+    const __m128 w1 = _mm_set1_ps(weights[1]);
+    for (; i + 4 <= frames; i += 4) {
+      const __m128 a = _mm_loadu_ps(in + 2 * i);
+      const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+      const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+      _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(w0, left),
+                                        _mm_mul_ps(w1, right)));
+    }
+  } else {
+    // Four frames at a time, one channel per step, so each lane sums its
+    // channels in the same order as the scalar loop.
+    for (; i + 4 <= frames; i += 4) {
+      const float* f = in + i * channels;
+      const size_t c3 = 3 * channels;
+      const size_t c2 = 2 * channels;
+      __m128 sum = _mm_mul_ps(_mm_set1_ps(weights[0]),
+                              _mm_set_ps(f[c3], f[c2], f[channels], f[0]));
+      for (size_t c = 1; c < channels; c++) {
+        const __m128 x =
+            _mm_set_ps(f[c3 + c], f[c2 + c], f[channels + c], f[c]);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[c]), x));
+      }
+      _mm_storeu_ps(out + i, sum);
+    }
+  }
+  if (i < frames) {
+    ScalarDownmixKernels().mix(in + i * channels, frames - i, channels,
+                               weights, out + i);
+  }
+}
+
+const DownmixKernels kSse2Kernels = {
+    "sse2", Sse2Int16ToFloat, Sse2Int24ToFloat, Sse2Int32ToFloat, Sse2Mix,
+};
+
+}  // namespace
+
+const DownmixKernels* Sse2DownmixKernels() { return &kSse2Kernels; }
+
+#else
+
+const DownmixKernels* Sse2DownmixKernels() { return nullptr; }
+
+#endif  // RHYTHM_HAVE_SSE2
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,147 @@
+#include "fft_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu_features.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+void ScalarButterflyPass(float* re, float* im, size_t n, size_t half,
+                         const float* wr, const float* wi) {
+  for (size_t i = 0; i < n; i += 2 * half) {
+    float* ar = re + i;
+    float* ai = im + i;
+    float* br = ar + half;
+    float* bi = ai + half;
+    for (size_t j = 0; j < half; j++) {
+      const float tr = br[j] * wr[j] - bi[j] * wi[j];
+      const float ti = br[j] * wi[j] + bi[j] * wr[j];
+      br[j] = ar[j] - tr;
+      bi[j] = ai[j] - ti;
+      ar[j] = ar[j] + tr;
+      ai[j] = ai[j] + ti;
+    }
+  }
+}
+
+void ScalarSplit(const float* zr, const float* zi, size_t m, const float* wr,
+                 const float* wi, float* xr, float* xi) {
+  SplitTail(zr, zi, m, wr, wi, xr, xi, 1);
+}
+
+void ScalarMagnitude(const float* re, const float* im, size_t count,
+                     float* out) {
+  for (size_t k = 0; k < count; k++) {
+    out[k] = std::sqrt(re[k] * re[k] + im[k] * im[k]);
+  }
+}
+
+void ScalarResonate(const float* x, size_t count, size_t lanes,
+                    const float* pr, const float* pi, float* yr, float* yi,
+                    float* power) {
+  for (size_t lane = 0; lane < lanes; lane++) {
+    const float a = pr[lane], b = pi[lane];
+    float re = yr[lane], im = yi[lane], sum = power[lane];
+    for (size_t n = 0; n < count; n++) {
+      const float next_re = x[n] + (a * re - b * im);
+      const float next_im = b * re + a * im;
+      re = next_re;
+      im = next_im;
+      sum += re * re + im * im;
+    }
+    yr[lane] = re;
+    yi[lane] = im;
+    power[lane] = sum;
+  }
+}
+
+void ScalarFir32(const float* x, const float* taps, size_t tap_count,
+                 float* sums) {
+  for (size_t k = 0; k < tap_count; k++) {
+    for (size_t j = 0; j < 32; j++) sums[j] += taps[k] * x[k + j];
+  }
+}
+
+void ScalarSpectralSums(const float* m, float* previous, const float* hz,
+                        size_t count, float* sums) {
+  SpectralSumsTail(m, previous, hz, count, sums, 0);
+}
+
+const FftKernels kScalarKernels = {
+    "scalar",        1,              ScalarButterflyPass, ScalarSplit,
+    ScalarMagnitude, ScalarResonate, ScalarFir32,         ScalarSpectralSums,
+};
+
+}  // namespace
+
+void SplitTail(const float* zr, const float* zi, size_t m, const float* wr,
+               const float* wi, float* xr, float* xi, size_t first) {
+  for (size_t k = first; k < m; k++) {
+    const float ar = zr[k], ai = zi[k];
+    const float br = zr[m - k], bi = zi[m - k];
+    const float er = 0.5f * (ar + br);
+    const float ei = 0.5f * (ai - bi);
+    const float odd_r = 0.5f * (ai + bi);
+    const float odd_i = 0.5f * (br - ar);
+    xr[k] = er + (wr[k] * odd_r - wi[k] * odd_i);
+    xi[k] = ei + (wr[k] * odd_i + wi[k] * odd_r);
+  }
+}
+
+void SpectralSumsTail(const float* m, float* previous, const float* hz,
+                      size_t count, float* sums, size_t first) {
+  for (size_t k = first; k < count; k++) {
+    float* lane = sums + k % kSpectralSumLanes;
+    const float x = m[k];
+    lane[kSpectralSumLanes * kSumMagnitude] += x;
+    lane[kSpectralSumLanes * kSumWeightedHz] += x * hz[k];
+    lane[kSpectralSumLanes * kSumPower] += x * x;
+    lane[kSpectralSumLanes * kSumLog] += SpectralLog2(x);
+    lane[kSpectralSumLanes * kSumFlux] += std::max(x - previous[k], 0.0f);
+    previous[k] = x;
+  }
+}
+
+float SpectralLog2(float x) {
+  x = std::max(x, kSpectralLogFloor);
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  const float exponent =
+      static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+  bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+  float mantissa;
+  std::memcpy(&mantissa, &bits, sizeof(mantissa));
+  const float s = (mantissa - 1.0f) / (mantissa + 1.0f);
+  const float s2 = s * s;
+  const float* c = kSpectralLog2Series;
+  return exponent +
+         s * (c[0] + s2 * (c[1] + s2 * (c[2] + s2 * (c[3] + s2 * c[4]))));
+}
+
+const FftKernels& ScalarFftKernels() { return kScalarKernels; }
+
+const FftKernels& SelectFftKernels() {
+  const CpuFeatures& cpu = GetCpuFeatures();
+  if (cpu.avx2 && Avx2FftKernels()) return *Avx2FftKernels();
+  if (cpu.sse2 && Sse2FftKernels()) return *Sse2FftKernels();
+  if (cpu.neon && NeonFftKernels()) return *NeonFftKernels();
+  return kScalarKernels;
+}
+
+const FftKernels* FindFftKernels(const char* name) {
+  const CpuFeatures& cpu = GetCpuFeatures();
+  if (std::strcmp(name, "scalar") == 0) return &kScalarKernels;
+  if (std::strcmp(name, "sse2") == 0 && cpu.sse2) return Sse2FftKernels();
+  if (std::strcmp(name, "avx2") == 0 && cpu.avx2) return Avx2FftKernels();
+  if (std::strcmp(name, "neon") == 0 && cpu.neon) return NeonFftKernels();
+  return nullptr;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,111 @@
+#ifndef RHYTHM_FFT_KERNELS_H_
+#define RHYTHM_FFT_KERNELS_H_
+
+#include <cstddef>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Inner loops of the FFT and the other spectral analysers, one table per
+// instruction set. All data is in split format (separate real and imaginary
+// arrays). Every implementation performs
+// the same floating-point operations in the same order as the scalar one, so
+// results agree to within rounding of the final square root.
+struct FftKernels {
+  const char* name;
+
+  // Minimum butterfly span the vector pass supports; narrower passes (the
+  // first stages of every transform) always use the scalar kernel.
+  size_t min_span;
+
+  // One radix-2 decimation-in-time pass over |n| points with butterfly span
+  // |half|. |wr|/|wi| hold the |half| twiddles of this stage.
+  void (*butterfly_pass)(float* re, float* im, size_t n, size_t half,
+                         const float* wr, const float* wi);
+
+  // Real-FFT split step. Given the M-point transform Z of the even/odd packed
+  // real signal, writes bins 1..M-1 of the 2M-point real transform to
+  // |xr|/|xi|. |wr|/|wi| hold exp(-i*pi*k/M) for k in [0, M].
+  void (*split)(const float* zr, const float* zi, size_t m, const float* wr,
+                const float* wi, float* xr, float* xi);
+
+  // out[k] = sqrt(re[k]^2 + im[k]^2) for k in [0, count).
+  void (*magnitude)(const float* re, const float* im, size_t count,
+                    float* out);
+
+  // Runs |lanes| (a multiple of 8) complex one-pole resonators
+  // y = x + p * y over the |count| samples of |x|, each lane with its own
+  // pole |pr|/|pi| and state |yr|/|yi|, and adds every output's power
+  // |y|^2 to the lane's |power|.
+  void (*resonate)(const float* x, size_t count, size_t lanes,
+                   const float* pr, const float* pi, float* yr, float* yi,
+                   float* power);
+
+  // 32 consecutive outputs of an FIR filter: adds taps[k] * x[k + j] to
+  // sums[j] for every k below |tap_count|, in order of k, for j from 0 to
+  // 31.
+  void (*fir32)(const float* x, const float* taps, size_t tap_count,
+                float* sums);
+
+  // The sums behind the spectral features of |count| magnitudes |m| at
+  // frequencies |hz|. Bin k adds m, m * hz, m^2, SpectralLog2(m) and
+  // max(m - previous[k], 0) to lane k % kSpectralSumLanes of the matching
+  // SpectralSum row of |sums|, then sets previous[k] to m.
+  void (*spectral_sums)(const float* m, float* previous, const float* hz,
+                        size_t count, float* sums);
+};
+
+// Rows of FftKernels::spectral_sums' output, kSpectralSumLanes floats each.
+enum SpectralSum : size_t {
+  kSumMagnitude = 0,
+  kSumWeightedHz = 1,
+  kSumPower = 2,
+  kSumLog = 3,
+  kSumFlux = 4,
+  kSpectralSumCount = 5,
+};
+constexpr size_t kSpectralSumLanes = 8;
+
+// Magnitudes below this count as this in the log sum, so that empty bins
+// stay finite.
+constexpr float kSpectralLogFloor = 1e-10f;
+// 2 / ln 2 times 1, 1/3, 1/5, 1/7 and 1/9: log2 of a mantissa u in [1, 2)
+// is the odd series in s = (u - 1) / (u + 1) with these coefficients.
+constexpr float kSpectralLog2Series[5] = {
+    2.8853900817779268f, 0.9617966939259756f, 0.5770780163555854f,
+    0.41219858311113243f, 0.3205988979753252f};
+
+// log2(max(x, kSpectralLogFloor)) for finite x, to within 3e-6: the
+// exponent plus the series above for the mantissa, evaluated in the same
+// order by every spectral_sums kernel.
+float SpectralLog2(float x);
+
+const FftKernels& ScalarFftKernels();
+
+// Scalar split step over bins [first, m); used by the SIMD kernels for the
+// bins left over after their vector loop.
+void SplitTail(const float* zr, const float* zi, size_t m, const float* wr,
+               const float* wi, float* xr, float* xi, size_t first);
+
+// Scalar spectral_sums over bins [first, count), which must start on a
+// lane boundary; used by the SIMD kernels like SplitTail().
+void SpectralSumsTail(const float* m, float* previous, const float* hz,
+                      size_t count, float* sums, size_t first);
+
+// The SIMD tables return nullptr when the kernel was not compiled for this
+// target. They do not check the running CPU; see SelectFftKernels().
+const FftKernels* Sse2FftKernels();
+const FftKernels* Avx2FftKernels();
+const FftKernels* NeonFftKernels();
+
+// Returns the fastest kernel table supported by the running CPU.
+const FftKernels& SelectFftKernels();
+
+// Looks a kernel table up by name ("scalar", "sse2", "avx2", "neon").
+// Returns nullptr if it is unknown, not compiled in or not supported.
+const FftKernels* FindFftKernels(const char* name);
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_FFT_KERNELS_H_
@@ -0,0 +1,221 @@
+#include "fft_kernels.h"
+
+// Built with -mavx2 (/arch:AVX2 on MSVC); only reached after GetCpuFeatures()
+// has confirmed AVX2 support, so nothing here may run on older CPUs.
+#if defined(__AVX2__)
+#define RHYTHM_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+#if defined(RHYTHM_HAVE_AVX2)
+
+namespace {
+
+inline __m256 Reverse(__m256 v) {
+  return _mm256_permutevar8x32_ps(v,
+                                  _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+void Avx2ButterflyPass(float* re, float* im, size_t n, size_t half,
+                       const float* wr, const float* wi) {
+  for (size_t i = 0; i < n; i += 2 * half) {
+    float* ar = re + i;
+    float* ai = im + i;
+    float* br = ar + half;
+    float* bi = ai + half;
+    for (size_t j = 0; j < half; j += 8) {
+      const __m256 vwr = _mm256_loadu_ps(wr + j);
+      const __m256 vwi = _mm256_loadu_ps(wi + j);
+      const __m256 vbr = _mm256_loadu_ps(br + j);
+      const __m256 vbi = _mm256_loadu_ps(bi + j);
+      const __m256 var = _mm256_loadu_ps(ar + j);
+      const __m256 vai = _mm256_loadu_ps(ai + j);
+      const __m256 tr =
+          _mm256_sub_ps(_mm256_mul_ps(vbr, vwr), _mm256_mul_ps(vbi, vwi));
+      const __m256 ti =
+          _mm256_add_ps(_mm256_mul_ps(vbr, vwi), _mm256_mul_ps(vbi, vwr));
+      _mm256_storeu_ps(br + j, _mm256_sub_ps(var, tr));
+      _mm256_storeu_ps(bi + j, _mm256_sub_ps(vai, ti));
+      _mm256_storeu_ps(ar + j, _mm256_add_ps(var, tr));
+      _mm256_storeu_ps(ai + j, _mm256_add_ps(vai, ti));
+    }
+  }
+}
+
+void Avx2Split(const float* zr, const float* zi, size_t m, const float* wr,
+               const float* wi, float* xr, float* xi) {
+  const __m256 half = _mm256_set1_ps(0.5f);
+  size_t k = 1;
+  for (; k + 8 <= m; k += 8) {
+    const __m256 ar = _mm256_loadu_ps(zr + k);
+    const __m256 ai = _mm256_loadu_ps(zi + k);
+    const __m256 br = Reverse(_mm256_loadu_ps(zr + m - k - 7));
+    const __m256 bi = Reverse(_mm256_loadu_ps(zi + m - k - 7));
+    const __m256 er = _mm256_mul_ps(half, _mm256_add_ps(ar, br));
+    const __m256 ei = _mm256_mul_ps(half, _mm256_sub_ps(ai, bi));
+    const __m256 odd_r = _mm256_mul_ps(half, _mm256_add_ps(ai, bi));
+    const __m256 odd_i = _mm256_mul_ps(half, _mm256_sub_ps(br, ar));
+    const __m256 vwr = _mm256_loadu_ps(wr + k);
+    const __m256 vwi = _mm256_loadu_ps(wi + k);
+    const __m256 tr =
+        _mm256_sub_ps(_mm256_mul_ps(vwr, odd_r), _mm256_mul_ps(vwi, odd_i));
+    const __m256 ti =
+        _mm256_add_ps(_mm256_mul_ps(vwr, odd_i), _mm256_mul_ps(vwi, odd_r));
+    _mm256_storeu_ps(xr + k, _mm256_add_ps(er, tr));
+    _mm256_storeu_ps(xi + k, _mm256_add_ps(ei, ti));
+  }
+  SplitTail(zr, zi, m, wr, wi, xr, xi, k);
+}
+
+void Avx2Magnitude(const float* re, const float* im, size_t count,
+                   float* out) {
+  size_t k = 0;
+  for (; k + 8 <= count; k += 8) {
+    const __m256 r = _mm256_loadu_ps(re + k);
+    const __m256 i = _mm256_loadu_ps(im + k);
+    const __m256 power =
+        _mm256_add_ps(_mm256_mul_ps(r, r), _mm256_mul_ps(i, i));
+    _mm256_storeu_ps(out + k, _mm256_sqrt_ps(power));
+  }
+  if (k < count) {
+    ScalarFftKernels().magnitude(re + k, im + k, count - k, out + k);
+  }
+}
+
+// One vector of eight resonators, one step of the recurrence.
+inline void Avx2ResonateStep(__m256 v, __m256 a, __m256 b, __m256* re,
+                             __m256* im, __m256* sum) {
+  const __m256 next_re = _mm256_add_ps(
+      v, _mm256_sub_ps(_mm256_mul_ps(a, *re), _mm256_mul_ps(b, *im)));
+  *im = _mm256_add_ps(_mm256_mul_ps(b, *re), _mm256_mul_ps(a, *im));
+  *re = next_re;
+  *sum = _mm256_add_ps(*sum, _mm256_add_ps(_mm256_mul_ps(*re, *re),
+                                           _mm256_mul_ps(*im, *im)));
+}
+
+// Sixteen resonators per pass where there are that many, so that two
+// independent recurrences overlap.
+void Avx2Resonate(const float* x, size_t count, size_t lanes,
+                  const float* pr, const float* pi, float* yr, float* yi,
+                  float* power) {
+  size_t lane = 0;
+  for (; lane + 16 <= lanes; lane += 16) {
+    const __m256 a0 = _mm256_loadu_ps(pr + lane);
+    const __m256 a1 = _mm256_loadu_ps(pr + lane + 8);
+    const __m256 b0 = _mm256_loadu_ps(pi + lane);
+    const __m256 b1 = _mm256_loadu_ps(pi + lane + 8);
+    __m256 re0 = _mm256_loadu_ps(yr + lane);
+    __m256 re1 = _mm256_loadu_ps(yr + lane + 8);
+    __m256 im0 = _mm256_loadu_ps(yi + lane);
+    __m256 im1 = _mm256_loadu_ps(yi + lane + 8);
+    __m256 sum0 = _mm256_loadu_ps(power + lane);
+    __m256 sum1 = _mm256_loadu_ps(power + lane + 8);
+    for (size_t n = 0; n < count; n++) {
+      const __m256 v = _mm256_set1_ps(x[n]);
+      Avx2ResonateStep(v, a0, b0, &re0, &im0, &sum0);
+      Avx2ResonateStep(v, a1, b1, &re1, &im1, &sum1);
+    }
+    _mm256_storeu_ps(yr + lane, re0);
+    _mm256_storeu_ps(yr + lane + 8, re1);
+    _mm256_storeu_ps(yi + lane, im0);
+    _mm256_storeu_ps(yi + lane + 8, im1);
+    _mm256_storeu_ps(power + lane, sum0);
+    _mm256_storeu_ps(power + lane + 8, sum1);
+  }
+  if (lane < lanes) {
+    const __m256 a = _mm256_loadu_ps(pr + lane);
+    const __m256 b = _mm256_loadu_ps(pi + lane);
+    __m256 re = _mm256_loadu_ps(yr + lane);
+    __m256 im = _mm256_loadu_ps(yi + lane);
+    __m256 sum = _mm256_loadu_ps(power + lane);
+    for (size_t n = 0; n < count; n++) {
+      Avx2ResonateStep(_mm256_set1_ps(x[n]), a, b, &re, &im, &sum);
+    }
+    _mm256_storeu_ps(yr + lane, re);
+    _mm256_storeu_ps(yi + lane, im);
+    _mm256_storeu_ps(power + lane, sum);
+  }
+}
+
+// Four independent sums, so that the additions overlap.
+void Avx2Fir32(const float* x, const float* taps, size_t tap_count,
+               float* sums) {
+  __m256 sum[4];
+  for (size_t i = 0; i < 4; i++) sum[i] = _mm256_loadu_ps(sums + 8 * i);
+  for (size_t k = 0; k < tap_count; k++) {
+    const __m256 tap = _mm256_set1_ps(taps[k]);
+    for (size_t i = 0; i < 4; i++) {
+      sum[i] = _mm256_add_ps(
+          sum[i], _mm256_mul_ps(tap, _mm256_loadu_ps(x + k + 8 * i)));
+    }
+  }
+  for (size_t i = 0; i < 4; i++) _mm256_storeu_ps(sums + 8 * i, sum[i]);
+}
+
+// SpectralLog2() of eight values.
+inline __m256 Log2(__m256 x) {
+  const __m256i bits = _mm256_castps_si256(
+      _mm256_max_ps(x, _mm256_set1_ps(kSpectralLogFloor)));
+  const __m256 exponent = _mm256_cvtepi32_ps(
+      _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+  const __m256 mantissa = _mm256_castsi256_ps(
+      _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                      _mm256_set1_epi32(0x3F800000)));
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 s = _mm256_div_ps(_mm256_sub_ps(mantissa, one),
+                                 _mm256_add_ps(mantissa, one));
+  const __m256 s2 = _mm256_mul_ps(s, s);
+  __m256 series = _mm256_set1_ps(kSpectralLog2Series[4]);
+  for (int i = 3; i >= 0; i--) {
+    series = _mm256_add_ps(_mm256_set1_ps(kSpectralLog2Series[i]),
+                           _mm256_mul_ps(s2, series));
+  }
+  return _mm256_add_ps(exponent, _mm256_mul_ps(s, series));
+}
+
+// One vector of eight lanes per sum.
+void Avx2SpectralSums(const float* m, float* previous, const float* hz,
+                      size_t count, float* sums) {
+  __m256 sum[kSpectralSumCount];
+  for (size_t q = 0; q < kSpectralSumCount; q++) {
+    sum[q] = _mm256_loadu_ps(sums + kSpectralSumLanes * q);
+  }
+  const __m256 zero = _mm256_setzero_ps();
+  size_t k = 0;
+  for (; k + kSpectralSumLanes <= count; k += kSpectralSumLanes) {
+    const __m256 x = _mm256_loadu_ps(m + k);
+    const __m256 rise = _mm256_sub_ps(x, _mm256_loadu_ps(previous + k));
+    sum[kSumMagnitude] = _mm256_add_ps(sum[kSumMagnitude], x);
+    sum[kSumWeightedHz] = _mm256_add_ps(
+        sum[kSumWeightedHz], _mm256_mul_ps(x, _mm256_loadu_ps(hz + k)));
+    sum[kSumPower] = _mm256_add_ps(sum[kSumPower], _mm256_mul_ps(x, x));
+    sum[kSumLog] = _mm256_add_ps(sum[kSumLog], Log2(x));
+    sum[kSumFlux] = _mm256_add_ps(sum[kSumFlux], _mm256_max_ps(rise, zero));
+    _mm256_storeu_ps(previous + k, x);
+  }
+  for (size_t q = 0; q < kSpectralSumCount; q++) {
+    _mm256_storeu_ps(sums + kSpectralSumLanes * q, sum[q]);
+  }
+  SpectralSumsTail(m, previous, hz, count, sums, k);
+}
+
+const FftKernels kAvx2Kernels = {
+    "avx2",        8,            Avx2ButterflyPass, Avx2Split,
+    Avx2Magnitude, Avx2Resonate, Avx2Fir32,         Avx2SpectralSums,
+};
+
+}  // namespace
+
+const FftKernels* Avx2FftKernels() { return &kAvx2Kernels; }
+
+#else
+
+const FftKernels* Avx2FftKernels() { return nullptr; }
+
+#endif  // RHYTHM_HAVE_AVX2
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,229 @@
+#include "fft_kernels.h"
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define RHYTHM_HAVE_NEON 1
+#include <arm_neon.h>
+
+#include <cmath>
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+#if defined(RHYTHM_HAVE_NEON)
+
+namespace {
+
+inline float32x4_t Reverse(float32x4_t v) {
+  const float32x4_t swapped = vrev64q_f32(v);
+  return vcombine_f32(vget_high_f32(swapped), vget_low_f32(swapped));
+}
+
+void NeonButterflyPass(float* re, float* im, size_t n, size_t half,
+                       const float* wr, const float* wi) {
+  for (size_t i = 0; i < n; i += 2 * half) {
+    float* ar = re + i;
+    float* ai = im + i;
+    float* br = ar + half;
+    float* bi = ai + half;
+    for (size_t j = 0; j < half; j += 4) {
+      const float32x4_t vwr = vld1q_f32(wr + j);
+      const float32x4_t vwi = vld1q_f32(wi + j);
+      const float32x4_t vbr = vld1q_f32(br + j);
+      const float32x4_t vbi = vld1q_f32(bi + j);
+      const float32x4_t var = vld1q_f32(ar + j);
+      const float32x4_t vai = vld1q_f32(ai + j);
+      const float32x4_t tr =
+          vsubq_f32(vmulq_f32(vbr, vwr), vmulq_f32(vbi, vwi));
+      const float32x4_t ti =
+          vaddq_f32(vmulq_f32(vbr, vwi), vmulq_f32(vbi, vwr));
+      vst1q_f32(br + j, vsubq_f32(var, tr));
+      vst1q_f32(bi + j, vsubq_f32(vai, ti));
+      vst1q_f32(ar + j, vaddq_f32(var, tr));
+      vst1q_f32(ai + j, vaddq_f32(vai, ti));
+    }
+  }
+}
+
+void NeonSplit(const float* zr, const float* zi, size_t m, const float* wr,
+               const float* wi, float* xr, float* xi) {
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  size_t k = 1;
+  for (; k + 4 <= m; k += 4) {
+    const float32x4_t ar = vld1q_f32(zr + k);
+    const float32x4_t ai = vld1q_f32(zi + k);
+    const float32x4_t br = Reverse(vld1q_f32(zr + m - k - 3));
+    const float32x4_t bi = Reverse(vld1q_f32(zi + m - k - 3));
+    const float32x4_t er = vmulq_f32(half, vaddq_f32(ar, br));
+    const float32x4_t ei = vmulq_f32(half, vsubq_f32(ai, bi));
+    const float32x4_t odd_r = vmulq_f32(half, vaddq_f32(ai, bi));
+    const float32x4_t odd_i = vmulq_f32(half, vsubq_f32(br, ar));
+    const float32x4_t vwr = vld1q_f32(wr + k);
+    const float32x4_t vwi = vld1q_f32(wi + k);
+    const float32x4_t tr =
+        vsubq_f32(vmulq_f32(vwr, odd_r), vmulq_f32(vwi, odd_i));
+    const float32x4_t ti =
+        vaddq_f32(vmulq_f32(vwr, odd_i), vmulq_f32(vwi, odd_r));
+    vst1q_f32(xr + k, vaddq_f32(er, tr));
+    vst1q_f32(xi + k, vaddq_f32(ei, ti));
+  }
+  SplitTail(zr, zi, m, wr, wi, xr, xi, k);
+}
+
+void NeonMagnitude(const float* re, const float* im, size_t count,
+                   float* out) {
+  size_t k = 0;
+  for (; k + 4 <= count; k += 4) {
+    const float32x4_t r = vld1q_f32(re + k);
+    const float32x4_t i = vld1q_f32(im + k);
+    const float32x4_t power = vaddq_f32(vmulq_f32(r, r), vmulq_f32(i, i));
+#if defined(__aarch64__) || defined(_M_ARM64)
+    vst1q_f32(out + k, vsqrtq_f32(power));
+#else
+    // ARMv7 NEON has no exact vector square root; the estimate instructions
+    // would break agreement with the scalar kernel.
+    vst1q_f32(out + k, power);
+    for (size_t j = k; j < k + 4; j++) out[j] = std::sqrt(out[j]);
+#endif
+  }
+  if (k < count) {
+    ScalarFftKernels().magnitude(re + k, im + k, count - k, out + k);
+  }
+}
+
+// Two vectors of four resonators per pass, so that two independent
+// recurrences overlap. Separate multiplies and adds rather than vmlaq/vfmaq,
+// which would round differently from the scalar kernel.
+void NeonResonate(const float* x, size_t count, size_t lanes,
+                  const float* pr, const float* pi, float* yr, float* yi,
+                  float* power) {
+  for (size_t lane = 0; lane < lanes; lane += 8) {
+    const float32x4_t a0 = vld1q_f32(pr + lane);
+    const float32x4_t a1 = vld1q_f32(pr + lane + 4);
+    const float32x4_t b0 = vld1q_f32(pi + lane);
+    const float32x4_t b1 = vld1q_f32(pi + lane + 4);
+    float32x4_t re0 = vld1q_f32(yr + lane);
+    float32x4_t re1 = vld1q_f32(yr + lane + 4);
+    float32x4_t im0 = vld1q_f32(yi + lane);
+    float32x4_t im1 = vld1q_f32(yi + lane + 4);
+    float32x4_t sum0 = vld1q_f32(power + lane);
+    float32x4_t sum1 = vld1q_f32(power + lane + 4);
+    for (size_t n = 0; n < count; n++) {
+      const float32x4_t v = vdupq_n_f32(x[n]);
+      const float32x4_t next_re0 = vaddq_f32(
+          v, vsubq_f32(vmulq_f32(a0, re0), vmulq_f32(b0, im0)));
+      const float32x4_t next_re1 = vaddq_f32(
+          v, vsubq_f32(vmulq_f32(a1, re1), vmulq_f32(b1, im1)));
+      im0 = vaddq_f32(vmulq_f32(b0, re0), vmulq_f32(a0, im0));
+      im1 = vaddq_f32(vmulq_f32(b1, re1), vmulq_f32(a1, im1));
+      re0 = next_re0;
+      re1 = next_re1;
+      sum0 = vaddq_f32(sum0,
+                       vaddq_f32(vmulq_f32(re0, re0), vmulq_f32(im0, im0)));
+      sum1 = vaddq_f32(sum1,
+                       vaddq_f32(vmulq_f32(re1, re1), vmulq_f32(im1, im1)));
+    }
+    vst1q_f32(yr + lane, re0);
+    vst1q_f32(yr + lane + 4, re1);
+    vst1q_f32(yi + lane, im0);
+    vst1q_f32(yi + lane + 4, im1);
+    vst1q_f32(power + lane, sum0);
+    vst1q_f32(power + lane + 4, sum1);
+  }
+}
+
+// Eight independent sums, so that the additions overlap.
+void NeonFir32(const float* x, const float* taps, size_t tap_count,
+               float* sums) {
+  float32x4_t sum[8];
+  for (size_t i = 0; i < 8; i++) sum[i] = vld1q_f32(sums + 4 * i);
+  for (size_t k = 0; k < tap_count; k++) {
+    const float32x4_t tap = vdupq_n_f32(taps[k]);
+    for (size_t i = 0; i < 8; i++) {
+      sum[i] = vaddq_f32(sum[i], vmulq_f32(tap, vld1q_f32(x + k + 4 * i)));
+    }
+  }
+  for (size_t i = 0; i < 8; i++) vst1q_f32(sums + 4 * i, sum[i]);
+}
+
+// SpectralLog2() of four values.
+inline float32x4_t Log2(float32x4_t x) {
+  const uint32x4_t bits =
+      vreinterpretq_u32_f32(vmaxq_f32(x, vdupq_n_f32(kSpectralLogFloor)));
+  const float32x4_t exponent = vcvtq_f32_s32(vsubq_s32(
+      vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+  const float32x4_t mantissa = vreinterpretq_f32_u32(vorrq_u32(
+      vandq_u32(bits, vdupq_n_u32(0x007FFFFF)), vdupq_n_u32(0x3F800000)));
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t above = vsubq_f32(mantissa, one);
+  const float32x4_t below = vaddq_f32(mantissa, one);
+#if defined(__aarch64__) || defined(_M_ARM64)
+  const float32x4_t s = vdivq_f32(above, below);
+#else
+  // ARMv7 NEON has no exact vector division; see NeonMagnitude().
+  float quotient[4];
+  vst1q_f32(quotient, above);
+  float divisor[4];
+  vst1q_f32(divisor, below);
+  for (size_t j = 0; j < 4; j++) quotient[j] /= divisor[j];
+  const float32x4_t s = vld1q_f32(quotient);
+#endif
+  const float32x4_t s2 = vmulq_f32(s, s);
+  float32x4_t series = vdupq_n_f32(kSpectralLog2Series[4]);
+  for (int i = 3; i >= 0; i--) {
+    series = vaddq_f32(vdupq_n_f32(kSpectralLog2Series[i]),
+                       vmulq_f32(s2, series));
+  }
+  return vaddq_f32(exponent, vmulq_f32(s, series));
+}
+
+// Two vectors of four lanes per sum.
+void NeonSpectralSums(const float* m, float* previous, const float* hz,
+                      size_t count, float* sums) {
+  float32x4_t sum[kSpectralSumCount][2];
+  for (size_t q = 0; q < kSpectralSumCount; q++) {
+    for (size_t h = 0; h < 2; h++) {
+      sum[q][h] = vld1q_f32(sums + kSpectralSumLanes * q + 4 * h);
+    }
+  }
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  size_t k = 0;
+  for (; k + kSpectralSumLanes <= count; k += kSpectralSumLanes) {
+    for (size_t h = 0; h < 2; h++) {
+      const size_t j = k + 4 * h;
+      const float32x4_t x = vld1q_f32(m + j);
+      const float32x4_t rise = vsubq_f32(x, vld1q_f32(previous + j));
+      sum[kSumMagnitude][h] = vaddq_f32(sum[kSumMagnitude][h], x);
+      sum[kSumWeightedHz][h] = vaddq_f32(sum[kSumWeightedHz][h],
+                                         vmulq_f32(x, vld1q_f32(hz + j)));
+      sum[kSumPower][h] = vaddq_f32(sum[kSumPower][h], vmulq_f32(x, x));
+      sum[kSumLog][h] = vaddq_f32(sum[kSumLog][h], Log2(x));
+      sum[kSumFlux][h] = vaddq_f32(sum[kSumFlux][h], vmaxq_f32(rise, zero));
+      vst1q_f32(previous + j, x);
+    }
+  }
+  for (size_t q = 0; q < kSpectralSumCount; q++) {
+    for (size_t h = 0; h < 2; h++) {
+      vst1q_f32(sums + kSpectralSumLanes * q + 4 * h, sum[q][h]);
+    }
+  }
+  SpectralSumsTail(m, previous, hz, count, sums, k);
+}
+
+const FftKernels kNeonKernels = {
+    "neon",        4,            NeonButterflyPass, NeonSplit,
+    NeonMagnitude, NeonResonate, NeonFir32,         NeonSpectralSums,
+};
+
+}  // namespace
+
+const FftKernels* NeonFftKernels() { return &kNeonKernels; }
+
+#else
+
+const FftKernels* NeonFftKernels() { return nullptr; }
+
+#endif  // RHYTHM_HAVE_NEON
+
+}  // namespace rhythm
+}  // namespace cyrene_music
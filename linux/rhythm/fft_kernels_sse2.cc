@@ -0,0 +1,208 @@
+#include "fft_kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RHYTHM_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+#if defined(RHYTHM_HAVE_SSE2)
+
+namespace {
+
+inline __m128 Reverse(__m128 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+void Sse2ButterflyPass(float* re, float* im, size_t n, size_t half,
+                       const float* wr, const float* wi) {
+  for (size_t i = 0; i < n; i += 2 * half) {
+    float* ar = re + i;
+    float* ai = im + i;
+    float* br = ar + half;
+    float* bi = ai + half;
+    for (size_t j = 0; j < half; j += 4) {
+      const __m128 vwr = _mm_loadu_ps(wr + j);
+      const __m128 vwi = _mm_loadu_ps(wi + j);
+      const __m128 vbr = _mm_loadu_ps(br + j);
+      const __m128 vbi = _mm_loadu_ps(bi + j);
+      const __m128 var = _mm_loadu_ps(ar + j);
+      const __m128 vai = _mm_loadu_ps(ai + j);
+      const __m128 tr = _mm_sub_ps(_mm_mul_ps(vbr, vwr), _mm_mul_ps(vbi, vwi));
+      const __m128 ti = _mm_add_ps(_mm_mul_ps(vbr, vwi), _mm_mul_ps(vbi, vwr));
+      _mm_storeu_ps(br + j, _mm_sub_ps(var, tr));
+      _mm_storeu_ps(bi + j, _mm_sub_ps(vai, ti));
+      _mm_storeu_ps(ar + j, _mm_add_ps(var, tr));
+      _mm_storeu_ps(ai + j, _mm_add_ps(vai, ti));
+    }
+  }
+}
+
+void Sse2Split(const float* zr, const float* zi, size_t m, const float* wr,
+               const float* wi, float* xr, float* xi) {
+  const __m128 half = _mm_set1_ps(0.5f);
+  size_t k = 1;
+  for (; k + 4 <= m; k += 4) {
+    const __m128 ar = _mm_loadu_ps(zr + k);
+    const __m128 ai = _mm_loadu_ps(zi + k);
+    const __m128 br = Reverse(_mm_loadu_ps(zr + m - k - 3));
+    const __m128 bi = Reverse(_mm_loadu_ps(zi + m - k - 3));
+    const __m128 er = _mm_mul_ps(half, _mm_add_ps(ar, br));
+    const __m128 ei = _mm_mul_ps(half, _mm_sub_ps(ai, bi));
+    const __m128 odd_r = _mm_mul_ps(half, _mm_add_ps(ai, bi));
+    const __m128 odd_i = _mm_mul_ps(half, _mm_sub_ps(br, ar));
+    const __m128 vwr = _mm_loadu_ps(wr + k);
+    const __m128 vwi = _mm_loadu_ps(wi + k);
+    const __m128 tr =
+        _mm_sub_ps(_mm_mul_ps(vwr, odd_r), _mm_mul_ps(vwi, odd_i));
+    const __m128 ti =
+        _mm_add_ps(_mm_mul_ps(vwr, odd_i), _mm_mul_ps(vwi, odd_r));
+    _mm_storeu_ps(xr + k, _mm_add_ps(er, tr));
+    _mm_storeu_ps(xi + k, _mm_add_ps(ei, ti));
+  }
+  SplitTail(zr, zi, m, wr, wi, xr, xi, k);
+}
+
+void Sse2Magnitude(const float* re, const float* im, size_t count,
+                   float* out) {
+  size_t k = 0;
+  for (; k + 4 <= count; k += 4) {
+    const __m128 r = _mm_loadu_ps(re + k);
+    const __m128 i = _mm_loadu_ps(im + k);
+    const __m128 power = _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i));
+    _mm_storeu_ps(out + k, _mm_sqrt_ps(power));
+  }
+  if (k < count) {
+    ScalarFftKernels().magnitude(re + k, im + k, count - k, out + k);
+  }
+}
+
+// Two vectors of four resonators per pass, so that two independent
+// recurrences overlap.
+void Sse2Resonate(const float* x, size_t count, size_t lanes,
+                  const float* pr, const float* pi, float* yr, float* yi,
+                  float* power) {
+  for (size_t lane = 0; lane < lanes; lane += 8) {
+    const __m128 a0 = _mm_loadu_ps(pr + lane);
+    const __m128 a1 = _mm_loadu_ps(pr + lane + 4);
+    const __m128 b0 = _mm_loadu_ps(pi + lane);
+    const __m128 b1 = _mm_loadu_ps(pi + lane + 4);
+    __m128 re0 = _mm_loadu_ps(yr + lane);
+    __m128 re1 = _mm_loadu_ps(yr + lane + 4);
+    __m128 im0 = _mm_loadu_ps(yi + lane);
+    __m128 im1 = _mm_loadu_ps(yi + lane + 4);
+    __m128 sum0 = _mm_loadu_ps(power + lane);
+    __m128 sum1 = _mm_loadu_ps(power + lane + 4);
+    for (size_t n = 0; n < count; n++) {
+      const __m128 v = _mm_set1_ps(x[n]);
+      const __m128 next_re0 = _mm_add_ps(
+          v, _mm_sub_ps(_mm_mul_ps(a0, re0), _mm_mul_ps(b0, im0)));
+      const __m128 next_re1 = _mm_add_ps(
+          v, _mm_sub_ps(_mm_mul_ps(a1, re1), _mm_mul_ps(b1, im1)));
+      im0 = _mm_add_ps(_mm_mul_ps(b0, re0), _mm_mul_ps(a0, im0));
+      im1 = _mm_add_ps(_mm_mul_ps(b1, re1), _mm_mul_ps(a1, im1));
+      re0 = next_re0;
+      re1 = next_re1;
+      sum0 = _mm_add_ps(
+          sum0, _mm_add_ps(_mm_mul_ps(re0, re0), _mm_mul_ps(im0, im0)));
+      sum1 = _mm_add_ps(
+          sum1, _mm_add_ps(_mm_mul_ps(re1, re1), _mm_mul_ps(im1, im1)));
+    }
+    _mm_storeu_ps(yr + lane, re0);
+    _mm_storeu_ps(yr + lane + 4, re1);
+    _mm_storeu_ps(yi + lane, im0);
+    _mm_storeu_ps(yi + lane + 4, im1);
+    _mm_storeu_ps(power + lane, sum0);
+    _mm_storeu_ps(power + lane + 4, sum1);
+  }
+}
+
+// Eight independent sums, so that the additions overlap.
+void Sse2Fir32(const float* x, const float* taps, size_t tap_count,
+               float* sums) {
+  __m128 sum[8];
+  for (size_t i = 0; i < 8; i++) sum[i] = _mm_loadu_ps(sums + 4 * i);
+  for (size_t k = 0; k < tap_count; k++) {
+    const __m128 tap = _mm_set1_ps(taps[k]);
+    for (size_t i = 0; i < 8; i++) {
+      sum[i] =
+          _mm_add_ps(sum[i], _mm_mul_ps(tap, _mm_loadu_ps(x + k + 4 * i)));
+    }
+  }
+  for (size_t i = 0; i < 8; i++) _mm_storeu_ps(sums + 4 * i, sum[i]);
+}
+
+// SpectralLog2() of four values.
+inline __m128 Log2(__m128 x) {
+  const __m128i bits =
+      _mm_castps_si128(_mm_max_ps(x, _mm_set1_ps(kSpectralLogFloor)));
+  const __m128 exponent = _mm_cvtepi32_ps(
+      _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+  const __m128 mantissa = _mm_castsi128_ps(
+      _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                   _mm_set1_epi32(0x3F800000)));
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 s =
+      _mm_div_ps(_mm_sub_ps(mantissa, one), _mm_add_ps(mantissa, one));
+  const __m128 s2 = _mm_mul_ps(s, s);
+  __m128 series = _mm_set1_ps(kSpectralLog2Series[4]);
+  for (int i = 3; i >= 0; i--) {
+    series = _mm_add_ps(_mm_set1_ps(kSpectralLog2Series[i]),
+                        _mm_mul_ps(s2, series));
+  }
+  return _mm_add_ps(exponent, _mm_mul_ps(s, series));
+}
+
+// Two vectors of four lanes per sum.
+void Sse2SpectralSums(const float* m, float* previous, const float* hz,
+                      size_t count, float* sums) {
+  __m128 sum[kSpectralSumCount][2];
+  for (size_t q = 0; q < kSpectralSumCount; q++) {
+    for (size_t h = 0; h < 2; h++) {
+      sum[q][h] = _mm_loadu_ps(sums + kSpectralSumLanes * q + 4 * h);
+    }
+  }
+  const __m128 zero = _mm_setzero_ps();
+  size_t k = 0;
+  for (; k + kSpectralSumLanes <= count; k += kSpectralSumLanes) {
+    for (size_t h = 0; h < 2; h++) {
+      const size_t j = k + 4 * h;
+      const __m128 x = _mm_loadu_ps(m + j);
+      const __m128 rise = _mm_sub_ps(x, _mm_loadu_ps(previous + j));
+      sum[kSumMagnitude][h] = _mm_add_ps(sum[kSumMagnitude][h], x);
+      sum[kSumWeightedHz][h] = _mm_add_ps(
+          sum[kSumWeightedHz][h], _mm_mul_ps(x, _mm_loadu_ps(hz + j)));
+      sum[kSumPower][h] = _mm_add_ps(sum[kSumPower][h], _mm_mul_ps(x, x));
+      sum[kSumLog][h] = _mm_add_ps(sum[kSumLog][h], Log2(x));
+      sum[kSumFlux][h] = _mm_add_ps(sum[kSumFlux][h], _mm_max_ps(rise, zero));
+      _mm_storeu_ps(previous + j, x);
+    }
+  }
+  for (size_t q = 0; q < kSpectralSumCount; q++) {
+    for (size_t h = 0; h < 2; h++) {
+      _mm_storeu_ps(sums + kSpectralSumLanes * q + 4 * h, sum[q][h]);
+    }
+  }
+  SpectralSumsTail(m, previous, hz, count, sums, k);
+}
+
+const FftKernels kSse2Kernels = {
+    "sse2",        4,            Sse2ButterflyPass, Sse2Split,
+    Sse2Magnitude, Sse2Resonate, Sse2Fir32,         Sse2SpectralSums,
+};
+
+}  // namespace
+
+const FftKernels* Sse2FftKernels() { return &kSse2Kernels; }
+
+#else
+
+const FftKernels* Sse2FftKernels() { return nullptr; }
+
+#endif  // RHYTHM_HAVE_SSE2
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,139 @@
+#include "fft_plan.h"
+
+#include <cmath>
+#include <utility>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+const double kPi = 3.14159265358979323846;
+}  // namespace
+
+FftPlan::FftPlan(size_t size) : kernels_(&SelectFftKernels()) {
+  if (!Reset(size)) Reset(512);
+}
+
+bool FftPlan::IsValidSize(size_t size) {
+  return size >= kMinSize && size <= kMaxSize && (size & (size - 1)) == 0;
+}
+
+bool FftPlan::Reset(size_t size) {
+  if (!IsValidSize(size)) return false;
+  if (size == size_) return true;
+  size_ = size;
+
+  bit_reverse_.resize(size);
+  swaps_.clear();
+  bit_reverse_[0] = 0;
+  for (size_t i = 1, j = 0; i < size; i++) {
+    size_t bit = size >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    bit_reverse_[i] = static_cast<uint32_t>(j);
+    if (i < j) {
+      swaps_.push_back(static_cast<uint32_t>(i));
+      swaps_.push_back(static_cast<uint32_t>(j));
+    }
+  }
+
+  // Twiddles are evaluated in double per index instead of by repeated
+  // multiplication, so every entry is correctly rounded. Each stage gets its
+  // own contiguous run so the vector kernels can load them directly.
+  twiddle_re_.resize(size - 1);
+  twiddle_im_.resize(size - 1);
+  for (size_t half = 1; half < size; half <<= 1) {
+    for (size_t j = 0; j < half; j++) {
+      const double angle =
+          -kPi * static_cast<double>(j) / static_cast<double>(half);
+      twiddle_re_[half - 1 + j] = static_cast<float>(std::cos(angle));
+      twiddle_im_[half - 1 + j] = static_cast<float>(std::sin(angle));
+    }
+  }
+  return true;
+}
+
+void FftPlan::Transform(float* re, float* im) const {
+  for (size_t s = 0; s < swaps_.size(); s += 2) {
+    std::swap(re[swaps_[s]], re[swaps_[s + 1]]);
+    std::swap(im[swaps_[s]], im[swaps_[s + 1]]);
+  }
+  TransformBitReversed(re, im);
+}
+
+void FftPlan::TransformBitReversed(float* re, float* im) const {
+  const FftKernels& scalar = ScalarFftKernels();
+  for (size_t half = 1; half < size_; half <<= 1) {
+    const FftKernels& pass = half >= kernels_->min_span ? *kernels_ : scalar;
+    pass.butterfly_pass(re, im, size_, half, &twiddle_re_[half - 1],
+                        &twiddle_im_[half - 1]);
+  }
+}
+
+RealFftPlan::RealFftPlan(size_t size) {
+  if (!Reset(size)) Reset(1024);
+}
+
+bool RealFftPlan::IsValidSize(size_t size) {
+  return size >= kMinSize && size <= kMaxSize && (size & (size - 1)) == 0;
+}
+
+void RealFftPlan::SetKernels(const FftKernels& kernels) {
+  half_.SetKernels(kernels);
+}
+
+bool RealFftPlan::Reset(size_t size) {
+  if (!IsValidSize(size)) return false;
+  if (size == size_) return true;
+  size_ = size;
+  const size_t m = size / 2;
+  half_.Reset(m);
+
+  // Hanning window
+  window_.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    window_[i] = static_cast<float>(
+        0.5 * (1.0 - std::cos(2.0 * kPi * static_cast<double>(i) /
+                              static_cast<double>(size - 1))));
+  }
+
+  split_re_.resize(m + 1);
+  split_im_.resize(m + 1);
+  for (size_t k = 0; k <= m; k++) {
+    const double angle = -kPi * static_cast<double>(k) / static_cast<double>(m);
+    split_re_[k] = static_cast<float>(std::cos(angle));
+    split_im_[k] = static_cast<float>(std::sin(angle));
+  }
+
+  z_re_.assign(m, 0.0f);
+  z_im_.assign(m, 0.0f);
+  x_re_.assign(m + 1, 0.0f);
+  x_im_.assign(m + 1, 0.0f);
+  magnitudes_.assign(m + 1, 0.0f);
+  return true;
+}
+
+void RealFftPlan::TransformWindowed(const float* input) {
+  const size_t m = size_ / 2;
+  const uint32_t* reverse = half_.bit_reverse().data();
+
+  // Window, pack even/odd samples as real/imaginary parts and scatter them
+  // into bit-reversed order in a single pass.
+  for (size_t n = 0; n < m; n++) {
+    z_re_[reverse[n]] = input[2 * n] * window_[2 * n];
+    z_im_[reverse[n]] = input[2 * n + 1] * window_[2 * n + 1];
+  }
+  half_.TransformBitReversed(z_re_.data(), z_im_.data());
+
+  x_re_[0] = z_re_[0] + z_im_[0];
+  x_im_[0] = 0.0f;
+  x_re_[m] = z_re_[0] - z_im_[0];
+  x_im_[m] = 0.0f;
+  const FftKernels& kernels = half_.kernels();
+  kernels.split(z_re_.data(), z_im_.data(), m, split_re_.data(),
+                split_im_.data(), x_re_.data(), x_im_.data());
+  kernels.magnitude(x_re_.data(), x_im_.data(), m + 1, magnitudes_.data());
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,112 @@
+#ifndef RHYTHM_FFT_PLAN_H_
+#define RHYTHM_FFT_PLAN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fft_kernels.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Precomputed radix-2 complex FFT plan over split real/imaginary arrays.
+//
+// Per-stage twiddle factors and the bit-reversal permutation are built once
+// in Reset(); transforming afterwards only reads those tables, so the
+// steady-state path never touches the heap and always produces the same
+// output for the same input and kernel table.
+class FftPlan {
+ public:
+  static constexpr size_t kMinSize = 16;
+  static constexpr size_t kMaxSize = 16384;
+
+  explicit FftPlan(size_t size = 512);
+
+  // Rebuilds every table for |size|. Returns false, leaving the current plan
+  // untouched, when |size| is not a power of two in [kMinSize, kMaxSize].
+  bool Reset(size_t size);
+
+  static bool IsValidSize(size_t size);
+
+  // Selects the butterfly kernels. Defaults to SelectFftKernels().
+  void SetKernels(const FftKernels& kernels) { kernels_ = &kernels; }
+  const FftKernels& kernels() const { return *kernels_; }
+
+  size_t size() const { return size_; }
+
+  // bit_reverse()[i] is the position of natural-order element i in the
+  // bit-reversed order that TransformBitReversed() expects.
+  const std::vector<uint32_t>& bit_reverse() const { return bit_reverse_; }
+
+  // Forward transform of size() natural-order values, in place.
+  void Transform(float* re, float* im) const;
+
+  // Forward transform of input that has already been permuted into
+  // bit-reversed order, in place. Output is in natural order.
+  void TransformBitReversed(float* re, float* im) const;
+
+ private:
+  size_t size_ = 0;
+  const FftKernels* kernels_;
+  std::vector<uint32_t> bit_reverse_;
+  // Index pairs (i, j) with i < j that the bit-reversal permutation swaps.
+  std::vector<uint32_t> swaps_;
+  // Twiddles of the stage with butterfly span h start at offset h - 1.
+  std::vector<float> twiddle_re_;
+  std::vector<float> twiddle_im_;
+};
+
+// FFT of real input: the N samples are packed into an N/2-point complex
+// transform and separated again with a split step, which halves the work of
+// the complex transform. Also owns the Hann window and the output buffers.
+class RealFftPlan {
+ public:
+  static constexpr size_t kMinSize = 2 * FftPlan::kMinSize;
+  static constexpr size_t kMaxSize = FftPlan::kMaxSize;
+  // Sample format, as FixedRealFftPlan's.
+  static constexpr const char* kFormat = "float";
+
+  explicit RealFftPlan(size_t size = 1024);
+
+  // Rebuilds the plan for |size| real samples. Returns false, leaving the
+  // current plan untouched, when |size| is not a valid plan size.
+  bool Reset(size_t size);
+
+  static bool IsValidSize(size_t size);
+
+  void SetKernels(const FftKernels& kernels);
+  const FftKernels& kernels() const { return half_.kernels(); }
+
+  size_t size() const { return size_; }
+  // Number of non-redundant output bins, DC through Nyquist.
+  size_t bin_count() const { return size_ / 2 + 1; }
+  const std::vector<float>& window() const { return window_; }
+
+  // Applies the window to |input| (size() samples), transforms it and
+  // computes the magnitude of every bin. Results stay valid until the next
+  // call.
+  void TransformWindowed(const float* input);
+
+  const float* spectrum_re() const { return x_re_.data(); }
+  const float* spectrum_im() const { return x_im_.data(); }
+  const float* magnitudes() const { return magnitudes_.data(); }
+
+ private:
+  size_t size_ = 0;
+  FftPlan half_;
+  std::vector<float> window_;
+  // exp(-i*pi*k/M) for k in [0, M], M = size_ / 2.
+  std::vector<float> split_re_;
+  std::vector<float> split_im_;
+  std::vector<float> z_re_;
+  std::vector<float> z_im_;
+  std::vector<float> x_re_;
+  std::vector<float> x_im_;
+  std::vector<float> magnitudes_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_FFT_PLAN_H_
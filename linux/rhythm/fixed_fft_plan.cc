@@ -0,0 +1,208 @@
+#include "fixed_fft_plan.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+}  // namespace
+
+template <typename Q>
+FixedRealFftPlan<Q>::FixedRealFftPlan(size_t size) {
+  if (!Reset(size)) Reset(1024);
+}
+
+template <typename Q>
+bool FixedRealFftPlan<Q>::Reset(size_t size) {
+  if (!IsValidSize(size)) return false;
+  if (size == size_) return true;
+  size_ = size;
+  const size_t m = size / 2;
+
+  bit_reverse_.resize(m);
+  bit_reverse_[0] = 0;
+  for (size_t i = 1, j = 0; i < m; i++) {
+    size_t bit = m >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    bit_reverse_[i] = static_cast<uint32_t>(j);
+  }
+
+  window_.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    window_[i] = ToFixed<Q>(
+        0.5 * (1.0 - std::cos(2.0 * kPi * static_cast<double>(i) /
+                              static_cast<double>(size - 1))));
+  }
+
+  twiddle_re_.resize(m - 1);
+  twiddle_im_.resize(m - 1);
+  for (size_t half = 1; half < m; half <<= 1) {
+    for (size_t j = 0; j < half; j++) {
+      const double angle =
+          -kPi * static_cast<double>(j) / static_cast<double>(half);
+      twiddle_re_[half - 1 + j] = ToFixed<Q>(std::cos(angle));
+      twiddle_im_[half - 1 + j] = ToFixed<Q>(std::sin(angle));
+    }
+  }
+
+  split_re_.resize(m + 1);
+  split_im_.resize(m + 1);
+  for (size_t k = 0; k <= m; k++) {
+    const double angle = -kPi * static_cast<double>(k) / static_cast<double>(m);
+    split_re_[k] = ToFixed<Q>(std::cos(angle));
+    split_im_[k] = ToFixed<Q>(std::sin(angle));
+  }
+
+  z_re_.assign(m, 0);
+  z_im_.assign(m, 0);
+  fixed_magnitudes_.assign(m + 1, 0);
+  magnitudes_.assign(m + 1, 0.0f);
+  magnitude_scale_ = 0.0f;
+  return true;
+}
+
+template <typename Q>
+void FixedRealFftPlan<Q>::TransformWindowed(const float* input) {
+  constexpr int kBits = Q::kFractionBits;
+  const size_t m = size_ / 2;
+
+  // Block floating point: scale the input by the power of two that brings
+  // its peak into [1/4, 1/2) before quantising it, so quiet passages keep
+  // the format's full precision and loud ones cannot clip.
+  float peak = 0.0f;
+  for (size_t n = 0; n < size_; n++) {
+    peak = std::max(peak, std::fabs(input[n]));
+  }
+  int exponent = 0;
+  if (peak > 0.0f) std::frexp(peak, &exponent);
+  const int input_shift = std::clamp(-exponent - 1, -kMaxInputShift,
+                                     kMaxInputShift);
+  const float scale = std::ldexp(1.0f, kBits + input_shift);
+  const auto quantize = [scale](float x) {
+    const float scaled = x * scale;
+    return static_cast<Product>(scaled + (scaled < 0.0f ? -0.5f : 0.5f));
+  };
+
+  // Window, and pack even/odd samples as real/imaginary parts in
+  // bit-reversed order, as RealFftPlan does.
+  for (size_t n = 0; n < m; n++) {
+    z_re_[bit_reverse_[n]] = static_cast<Sample>(
+        RoundShift<Q>(quantize(input[2 * n]) * window_[2 * n], kBits));
+    z_im_[bit_reverse_[n]] = static_cast<Sample>(RoundShift<Q>(
+        quantize(input[2 * n + 1]) * window_[2 * n + 1], kBits));
+  }
+  int halvings = Butterflies();
+
+  // Two-segment approximation of sqrt(hi^2 + lo^2), hi >= lo >= 0:
+  // max(hi + 5/32 lo, 27/32 hi + 71/128 lo).
+  const Product max = (Product{1} << kBits) - 1;
+  const auto magnitude = [max](Product re, Product im) {
+    const Product a = re < 0 ? -re : re;
+    const Product b = im < 0 ? -im : im;
+    const Product hi = std::max(a, b);
+    const Product lo = std::min(a, b);
+    return static_cast<Sample>(std::min(
+        RoundShift<Q>(std::max(128 * hi + 20 * lo, 108 * hi + 71 * lo), 7),
+        max));
+  };
+
+  // Split step, as SplitTail() in fft_kernels.cc, halved once more if its
+  // input is large enough to overflow, with the magnitude of each bin
+  // computed straight away.
+  const int split = Peak() >= limit() ? 1 : 0;
+  halvings += split;
+  fixed_magnitudes_[0] =
+      magnitude(RoundShift<Q>(Product{z_re_[0]} + z_im_[0], split), 0);
+  fixed_magnitudes_[m] =
+      magnitude(RoundShift<Q>(Product{z_re_[0]} - z_im_[0], split), 0);
+  for (size_t k = 1; k < m; k++) {
+    const Product ar = z_re_[k], ai = z_im_[k];
+    const Product br = z_re_[m - k], bi = z_im_[m - k];
+    const Product er = RoundShift<Q>(ar + br, 1 + split);
+    const Product ei = RoundShift<Q>(ai - bi, 1 + split);
+    const Product odd_r = RoundShift<Q>(ai + bi, 1 + split);
+    const Product odd_i = RoundShift<Q>(br - ar, 1 + split);
+    const Product wr = split_re_[k], wi = split_im_[k];
+    const Product xr = er + RoundShift<Q>(wr * odd_r - wi * odd_i, kBits);
+    const Product xi = ei + RoundShift<Q>(wr * odd_i + wi * odd_r, kBits);
+    fixed_magnitudes_[k] = magnitude(xr, xi);
+  }
+
+  magnitude_scale_ = std::ldexp(1.0f, halvings - input_shift - kBits);
+  for (size_t k = 0; k <= m; k++) {
+    magnitudes_[k] =
+        static_cast<float>(fixed_magnitudes_[k]) * magnitude_scale_;
+  }
+}
+
+// Largest magnitude of any real or imaginary part in z_.
+template <typename Q>
+typename Q::Product FixedRealFftPlan<Q>::Peak() const {
+  Sample low = 0;
+  Sample high = 0;
+  for (size_t i = 0; i < z_re_.size(); i++) {
+    low = std::min({low, z_re_[i], z_im_[i]});
+    high = std::max({high, z_re_[i], z_im_[i]});
+  }
+  return std::max(-Product{low}, Product{high});
+}
+
+// Radix-2 decimation-in-time passes over the bit-reversed z_, as
+// ScalarButterflyPass() in fft_kernels.cc. A butterfly's outputs can grow
+// to 1 + sqrt(2) times its largest input part, so a pass halves them when
+// that part has reached limit(). Returns the number of passes that did.
+template <typename Q>
+int FixedRealFftPlan<Q>::Butterflies() {
+  constexpr int kBits = Q::kFractionBits;
+  const size_t m = size_ / 2;
+  int halvings = 0;
+  for (size_t half = 1; half < m; half <<= 1) {
+    const int shift = Peak() >= limit() ? 1 : 0;
+    halvings += shift;
+    if (half == 1) {
+      // The only twiddle is 1, which Q cannot hold exactly anyway.
+      for (size_t i = 0; i < m; i += 2) {
+        const Product ar = z_re_[i], ai = z_im_[i];
+        const Product br = z_re_[i + 1], bi = z_im_[i + 1];
+        z_re_[i] = static_cast<Sample>(RoundShift<Q>(ar + br, shift));
+        z_im_[i] = static_cast<Sample>(RoundShift<Q>(ai + bi, shift));
+        z_re_[i + 1] = static_cast<Sample>(RoundShift<Q>(ar - br, shift));
+        z_im_[i + 1] = static_cast<Sample>(RoundShift<Q>(ai - bi, shift));
+      }
+      continue;
+    }
+    const Sample* wr = &twiddle_re_[half - 1];
+    const Sample* wi = &twiddle_im_[half - 1];
+    for (size_t i = 0; i < m; i += 2 * half) {
+      Sample* ar = &z_re_[i];
+      Sample* ai = &z_im_[i];
+      Sample* br = ar + half;
+      Sample* bi = ai + half;
+      for (size_t j = 0; j < half; j++) {
+        const Product a_re = ar[j], a_im = ai[j];
+        const Product b_re = br[j], b_im = bi[j];
+        const Product tr =
+            RoundShift<Q>(b_re * wr[j] - b_im * wi[j], kBits);
+        const Product ti =
+            RoundShift<Q>(b_re * wi[j] + b_im * wr[j], kBits);
+        ar[j] = static_cast<Sample>(RoundShift<Q>(a_re + tr, shift));
+        ai[j] = static_cast<Sample>(RoundShift<Q>(a_im + ti, shift));
+        br[j] = static_cast<Sample>(RoundShift<Q>(a_re - tr, shift));
+        bi[j] = static_cast<Sample>(RoundShift<Q>(a_im - ti, shift));
+      }
+    }
+  }
+  return halvings;
+}
+
+template class FixedRealFftPlan<Q15>;
+template class FixedRealFftPlan<Q31>;
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,109 @@
+#ifndef RHYTHM_FIXED_FFT_PLAN_H_
+#define RHYTHM_FIXED_FFT_PLAN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fft_kernels.h"
+#include "fft_plan.h"
+#include "fixed_point.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// RealFftPlan in fixed point, for targets where integer arithmetic is
+// cheaper than float: Q is Q15 or Q31, and the public interface matches the
+// parts of RealFftPlan that the analyser uses, so either can be dropped in.
+//
+// Input is windowed and transformed in Q with the same packed half-size
+// complex FFT and split step, as block floating point: the input is scaled
+// by a power of two that brings its peak near full scale before it is
+// quantised, and each butterfly pass halves its outputs only when they could
+// otherwise overflow. Quiet input therefore keeps the format's precision;
+// magnitude_scale() accounts for the shifts. Magnitudes use a two-segment
+// max/min approximation (within 1.2 %, 0.1 dB) instead of a square root.
+// magnitudes() converts them back to the float path's scale;
+// fixed_magnitudes() are the raw values, for BandMapper::ApplyFixed().
+//
+// The transform is plain integer C++, not FftKernels: integer arithmetic is
+// exact, so the compiler is free to vectorise it and every ISA agrees.
+template <typename Q>
+class FixedRealFftPlan {
+ public:
+  using Format = Q;
+  using Sample = typename Q::Sample;
+
+  static constexpr size_t kMinSize = RealFftPlan::kMinSize;
+  static constexpr size_t kMaxSize = RealFftPlan::kMaxSize;
+  static constexpr const char* kFormat = Q::kName;
+
+  explicit FixedRealFftPlan(size_t size = 1024);
+
+  // Rebuilds the plan for |size| real samples. Returns false, leaving the
+  // current plan untouched, when |size| is not a valid plan size.
+  bool Reset(size_t size);
+
+  static bool IsValidSize(size_t size) {
+    return RealFftPlan::IsValidSize(size);
+  }
+
+  // Kept for interface parity; the transform does not use them.
+  void SetKernels(const FftKernels& kernels) { kernels_ = &kernels; }
+  const FftKernels& kernels() const { return *kernels_; }
+
+  size_t size() const { return size_; }
+  // Number of non-redundant output bins, DC through Nyquist.
+  size_t bin_count() const { return size_ / 2 + 1; }
+
+  // Converts |input| (size() samples) to Q, windows and transforms it and
+  // computes the magnitude of every bin. Results stay valid until the next
+  // call.
+  void TransformWindowed(const float* input);
+
+  const float* magnitudes() const { return magnitudes_.data(); }
+  const Sample* fixed_magnitudes() const { return fixed_magnitudes_.data(); }
+  // Factor from fixed_magnitudes() to magnitudes(); changes per transform.
+  float magnitude_scale() const { return magnitude_scale_; }
+
+ private:
+  using Product = typename Q::Product;
+
+  // Bounds the input scaling for near-silent blocks.
+  static constexpr int kMaxInputShift = 64;
+
+  // Largest real or imaginary part a butterfly pass or the split step can
+  // take without overflowing: 0.35, as (1 + sqrt(2)) * 0.35 < 1 and
+  // 2 * sqrt(2) * 0.35 < 1.
+  static constexpr Product limit() {
+    return (Product{7} << Q::kFractionBits) / 20;
+  }
+
+  Product Peak() const;
+  int Butterflies();
+
+  const FftKernels* kernels_ = &SelectFftKernels();
+  size_t size_ = 0;
+  std::vector<uint32_t> bit_reverse_;
+  // Hann window, as RealFftPlan's.
+  std::vector<Sample> window_;
+  // Twiddles of the stage with half-span h at [h - 1, 2h - 1), as FftPlan.
+  std::vector<Sample> twiddle_re_;
+  std::vector<Sample> twiddle_im_;
+  // exp(-i*pi*k/M) for k in [0, M], M = size_ / 2.
+  std::vector<Sample> split_re_;
+  std::vector<Sample> split_im_;
+  std::vector<Sample> z_re_;
+  std::vector<Sample> z_im_;
+  std::vector<Sample> fixed_magnitudes_;
+  std::vector<float> magnitudes_;
+  float magnitude_scale_ = 0.0f;
+};
+
+extern template class FixedRealFftPlan<Q15>;
+extern template class FixedRealFftPlan<Q31>;
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_FIXED_FFT_PLAN_H_
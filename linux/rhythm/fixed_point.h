@@ -0,0 +1,54 @@
+#ifndef RHYTHM_FIXED_POINT_H_
+#define RHYTHM_FIXED_POINT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Building with RHYTHM_FIXED_POINT=15 or 31 runs the analyser's FFT path in
+// Q15 or Q31 instead of float; see RhythmAnalyzer. Both formats are always
+// compiled, so either can be benchmarked against float in any build.
+#ifndef RHYTHM_FIXED_POINT
+#define RHYTHM_FIXED_POINT 0
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Signed fractions in [-1, 1) with kFractionBits fraction bits, stored in
+// Sample. Product holds the full product of two samples and any sum of two
+// such products.
+struct Q15 {
+  using Sample = int16_t;
+  using Product = int32_t;
+  static constexpr int kFractionBits = 15;
+  static constexpr const char* kName = "q15";
+};
+
+struct Q31 {
+  using Sample = int32_t;
+  using Product = int64_t;
+  static constexpr int kFractionBits = 31;
+  static constexpr const char* kName = "q31";
+};
+
+// Nearest representable value to |x|, saturating at either end.
+template <typename Q>
+typename Q::Sample ToFixed(double x) {
+  using Sample = typename Q::Sample;
+  const double one = std::ldexp(1.0, Q::kFractionBits);
+  const double scaled = std::clamp(std::nearbyint(x * one), -one, one - 1.0);
+  return static_cast<Sample>(scaled);
+}
+
+// |product| shifted right by |bits|, rounding half up.
+template <typename Q>
+typename Q::Product RoundShift(typename Q::Product product, int bits) {
+  using Product = typename Q::Product;
+  return (product + ((Product{1} << bits) >> 1)) >> bits;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_FIXED_POINT_H_
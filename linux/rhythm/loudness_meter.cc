@@ -0,0 +1,267 @@
+#include "loudness_meter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// BS.1770 loudness of a mean square.
+float Loudness(double mean_square) {
+  if (mean_square <= 0.0) return -std::numeric_limits<float>::infinity();
+  return static_cast<float>(-0.691 + 10.0 * std::log10(mean_square));
+}
+
+// Zeroth-order modified Bessel function, for the Kaiser window.
+double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+}  // namespace
+
+void LoudnessMeter::Configure(uint32_t sample_rate, size_t channels) {
+  sample_rate_ = sample_rate;
+  channel_count_ = std::min(std::max<size_t>(channels, 1), kMaxChannels);
+  block_size_ = std::max<size_t>(
+      static_cast<size_t>(std::lround(sample_rate * kBlockSeconds)), 1);
+
+  // K-weighting: the BS.1770 high shelf and RLB high-pass, re-derived for
+  // |sample_rate| through the bilinear transform. At 48 kHz these reproduce
+  // the coefficients tabulated in the standard.
+  const double fs = static_cast<double>(sample_rate);
+  Biquad shelf;
+  Biquad high_pass;
+  {
+    const double f0 = 1681.974450955533;
+    const double gain_db = 3.999843853973347;
+    const double q = 0.7071752369554196;
+    const double k = std::tan(kPi * f0 / fs);
+    const double vh = std::pow(10.0, gain_db / 20.0);
+    const double vb = std::pow(vh, 0.4996667741545416);
+    const double a0 = 1.0 + k / q + k * k;
+    shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf.b1 = 2.0 * (k * k - vh) / a0;
+    shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf.a2 = (1.0 - k / q + k * k) / a0;
+  }
+  {
+    const double f0 = 38.13547087602444;
+    const double q = 0.5003270373238773;
+    const double k = std::tan(kPi * f0 / fs);
+    const double a0 = 1.0 + k / q + k * k;
+    high_pass.b0 = 1.0;
+    high_pass.b1 = -2.0;
+    high_pass.b2 = 1.0;
+    high_pass.a1 = 2.0 * (k * k - 1.0) / a0;
+    high_pass.a2 = (1.0 - k / q + k * k) / a0;
+  }
+  for (Channel& channel : channels_) {
+    channel.shelf = shelf;
+    channel.high_pass = high_pass;
+  }
+
+  // True-peak interpolator: a Kaiser-windowed sinc low-pass at the original
+  // Nyquist frequency, split into kOversampling phases that each have unit
+  // gain at DC.
+  const size_t length = kOversampling * kPhaseTaps;
+  const double centre = 0.5 * static_cast<double>(length - 1);
+  const double beta = 5.0;
+  tap_gain_ = 0.0f;
+  for (size_t phase = 0; phase < kOversampling; phase++) {
+    double taps[kPhaseTaps];
+    double sum = 0.0;
+    for (size_t j = 0; j < kPhaseTaps; j++) {
+      const size_t n = kOversampling * (kPhaseTaps - 1 - j) + phase;
+      const double t = (static_cast<double>(n) - centre) /
+                       static_cast<double>(kOversampling);
+      const double r = (static_cast<double>(n) - centre) / centre;
+      const double window =
+          BesselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) /
+          BesselI0(beta);
+      taps[j] = window * std::sin(kPi * t) / (kPi * t);
+      sum += taps[j];
+    }
+    float gain = 0.0f;
+    for (size_t j = 0; j < kPhaseTaps; j++) {
+      taps_[phase][j] = static_cast<float>(taps[j] / sum);
+      gain += std::fabs(taps_[phase][j]);
+    }
+    tap_gain_ = std::max(tap_gain_, gain);
+  }
+
+  for (size_t bin = 0; bin < kHistogramBins; bin++) {
+    const double centre_lufs =
+        kAbsoluteGateLufs + (static_cast<double>(bin) + 0.5) * kHistogramStepLu;
+    bin_energy_[bin] = std::pow(10.0, (centre_lufs + 0.691) / 10.0);
+  }
+  Reset();
+}
+
+void LoudnessMeter::Reset() {
+  for (Channel& channel : channels_) {
+    channel.shelf.z1 = channel.shelf.z2 = 0.0;
+    channel.high_pass.z1 = channel.high_pass.z2 = 0.0;
+    std::fill(channel.peak_input, channel.peak_input + kPhaseTaps - 1, 0.0f);
+  }
+  block_sum_ = 0.0;
+  block_samples_ = 0;
+  std::fill(blocks_, blocks_ + kShortTermBlocks, 0.0);
+  block_count_ = 0;
+  peak_ = 0.0f;
+  std::fill(histogram_, histogram_ + kHistogramBins, 0u);
+  reading_ = LoudnessReading();
+}
+
+bool LoudnessMeter::Process(const float* left, const float* right,
+                            size_t count) {
+  const bool stereo = channel_count_ == 2;
+  bool completed = false;
+  while (count > 0) {
+    const size_t n = std::min(count, block_size_ - block_samples_);
+    Weight(left, stereo ? right : nullptr, n);
+    TrackPeak(&channels_[0], left, n);
+    if (stereo) TrackPeak(&channels_[1], right, n);
+    block_samples_ += n;
+    if (block_samples_ == block_size_) {
+      CompleteBlock();
+      completed = true;
+    }
+    left += n;
+    if (stereo) right += n;
+    count -= n;
+  }
+  return completed;
+}
+
+// |right| is null for a single channel.
+void LoudnessMeter::Weight(const float* left, const float* right,
+                           size_t count) {
+  Channel& l = channels_[0];
+  double sum = 0.0;
+  if (!right) {
+    for (size_t i = 0; i < count; i++) {
+      const double weighted = l.high_pass.Process(l.shelf.Process(left[i]));
+      sum += weighted * weighted;
+    }
+  } else {
+    // Both channels per iteration: each biquad is a serial dependency
+    // chain, and the two chains run side by side.
+    Channel& r = channels_[1];
+    for (size_t i = 0; i < count; i++) {
+      const double wl = l.high_pass.Process(l.shelf.Process(left[i]));
+      const double wr = r.high_pass.Process(r.shelf.Process(right[i]));
+      sum += wl * wl + wr * wr;
+    }
+  }
+  block_sum_ += sum;
+}
+
+void LoudnessMeter::TrackPeak(Channel* channel, const float* samples,
+                              size_t count) {
+  const size_t kHistory = kPhaseTaps - 1;
+  while (count > 0) {
+    const size_t n = std::min(count, kPeakChunk);
+    float* input = channel->peak_input;
+    std::copy(samples, samples + n, input + kHistory);
+
+    float loudest = 0.0f;
+    for (size_t i = 0; i < kHistory + n; i++) {
+      loudest = std::max(loudest, std::fabs(input[i]));
+    }
+    if (loudest * tap_gain_ > peak_) {
+      // One phase at a time with the samples innermost, which vectorises.
+      // Each phase's outputs fall between the inputs at a fixed fraction of
+      // a sample, about six samples behind input[i + kHistory].
+      float peak = 0.0f;
+      for (size_t i = 0; i < n; i++) {
+        peak = std::max(peak, std::fabs(input[i + kHistory]));
+      }
+      float* output = peak_output_;
+      for (size_t p = 0; p < kOversampling; p++) {
+        const float* taps = taps_[p];
+        for (size_t i = 0; i < n; i++) output[i] = taps[0] * input[i];
+        for (size_t j = 1; j < kPhaseTaps; j++) {
+          for (size_t i = 0; i < n; i++) output[i] += taps[j] * input[i + j];
+        }
+        for (size_t i = 0; i < n; i++) {
+          peak = std::max(peak, std::fabs(output[i]));
+        }
+      }
+      peak_ = std::max(peak_, peak);
+    }
+
+    std::copy(input + n, input + n + kHistory, input);
+    samples += n;
+    count -= n;
+  }
+}
+
+void LoudnessMeter::CompleteBlock() {
+  blocks_[block_count_ % kShortTermBlocks] =
+      block_sum_ / static_cast<double>(block_size_);
+  block_count_++;
+  block_sum_ = 0.0;
+  block_samples_ = 0;
+
+  // Mean square over the last |blocks| blocks, or -1 until there are that
+  // many.
+  const auto window_mean = [this](size_t blocks) {
+    if (block_count_ < blocks) return -1.0;
+    double sum = 0.0;
+    for (size_t i = 1; i <= blocks; i++) {
+      sum += blocks_[(block_count_ - i) % kShortTermBlocks];
+    }
+    return sum / static_cast<double>(blocks);
+  };
+
+  const double momentary = window_mean(kMomentaryBlocks);
+  reading_.momentary_lufs = Loudness(momentary);
+  if (reading_.momentary_lufs > kAbsoluteGateLufs) {
+    const double bin =
+        (reading_.momentary_lufs - kAbsoluteGateLufs) / kHistogramStepLu;
+    histogram_[std::min(static_cast<size_t>(bin), kHistogramBins - 1)]++;
+    reading_.integrated_lufs = IntegratedLoudness();
+  }
+  reading_.short_term_lufs = Loudness(window_mean(kShortTermBlocks));
+  reading_.true_peak_dbtp =
+      peak_ > 0.0f ? 20.0f * std::log10(peak_)
+                   : -std::numeric_limits<float>::infinity();
+}
+
+float LoudnessMeter::IntegratedLoudness() const {
+  double count = 0.0;
+  double energy = 0.0;
+  for (size_t bin = 0; bin < kHistogramBins; bin++) {
+    count += histogram_[bin];
+    energy += histogram_[bin] * bin_energy_[bin];
+  }
+  if (count == 0.0) return -std::numeric_limits<float>::infinity();
+
+  // Only bins centred above the relative gate count towards the result.
+  const double gate = Loudness(energy / count) + kRelativeGateLu;
+  const double first =
+      std::ceil((gate - kAbsoluteGateLufs) / kHistogramStepLu - 0.5);
+  count = 0.0;
+  energy = 0.0;
+  for (size_t bin = static_cast<size_t>(std::max(first, 0.0));
+       bin < kHistogramBins; bin++) {
+    count += histogram_[bin];
+    energy += histogram_[bin] * bin_energy_[bin];
+  }
+  return count > 0.0 ? Loudness(energy / count)
+                     : -std::numeric_limits<float>::infinity();
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
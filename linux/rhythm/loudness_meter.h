@@ -0,0 +1,144 @@
+#ifndef RHYTHM_LOUDNESS_METER_H_
+#define RHYTHM_LOUDNESS_METER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Loudness per EBU R128 / ITU-R BS.1770-4. Levels are -infinity until
+// enough audio has been measured.
+struct LoudnessReading {
+  // Capture time of the end of the latest 100 ms block.
+  int64_t timestamp_ns = 0;
+  // Mean K-weighted loudness over the last 400 ms and 3 s.
+  float momentary_lufs = -std::numeric_limits<float>::infinity();
+  float short_term_lufs = -std::numeric_limits<float>::infinity();
+  // Gated loudness of everything since the last reset.
+  float integrated_lufs = -std::numeric_limits<float>::infinity();
+  // Highest 4x-oversampled sample magnitude since the last reset, in dBTP.
+  float true_peak_dbtp = -std::numeric_limits<float>::infinity();
+};
+
+// Incremental loudness and true-peak meter for one or two channels.
+//
+// Every sample goes through the two K-weighting biquads and a 4x polyphase
+// interpolator, so the work per sample is constant. The interpolator is
+// skipped for runs of samples too quiet to raise the true peak, which after
+// the first loud passage is nearly all of them. Mean squares are kept
+// per 100 ms block; momentary and short-term loudness average the last 4
+// and 30 blocks. Each 400 ms momentary window is a gating block for the
+// integrated loudness: blocks above the -70 LUFS absolute gate are counted
+// in a 0.1 LU histogram, from which the relative gate (-10 LU) and the
+// gated mean are derived without keeping the blocks themselves.
+//
+// Each channel is filtered on its own and has BS.1770 weight 1: the block
+// mean squares of left and right are summed and the true peak is the higher
+// of the two. Two channels are filtered in one pass so that their biquads
+// overlap. Configure() sets up filters for a sample rate and channel count;
+// nothing allocates.
+class LoudnessMeter {
+ public:
+  static constexpr double kBlockSeconds = 0.1;
+  static constexpr double kAbsoluteGateLufs = -70.0;
+  static constexpr double kRelativeGateLu = -10.0;
+  static constexpr size_t kMaxChannels = 2;
+
+  LoudnessMeter() { Configure(48000); }
+
+  // |channels| is clamped to 1..kMaxChannels.
+  void Configure(uint32_t sample_rate, size_t channels = 1);
+  // Forgets all history, including the integrated loudness and true peak.
+  void Reset();
+
+  uint32_t sample_rate() const { return sample_rate_; }
+  size_t channels() const { return channel_count_; }
+
+  // Samples left until the current 100 ms block completes.
+  size_t samples_until_next_block() const {
+    return block_size_ - block_samples_;
+  }
+
+  // Measures |count| samples of a single channel. Returns true if a block
+  // completed, after which reading() holds new values; its timestamp is left
+  // to the caller.
+  bool Process(const float* samples, size_t count) {
+    return Process(samples, nullptr, count);
+  }
+  // Same for two channels; |right| is ignored when configured for one.
+  bool Process(const float* left, const float* right, size_t count);
+
+  const LoudnessReading& reading() const { return reading_; }
+
+ private:
+  // Transposed direct form II.
+  struct Biquad {
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    double z1 = 0.0, z2 = 0.0;
+
+    double Process(double x) {
+      const double y = b0 * x + z1;
+      z1 = b1 * x - a1 * y + z2;
+      z2 = b2 * x - a2 * y;
+      return y;
+    }
+  };
+
+  static constexpr size_t kMomentaryBlocks = 4;
+  static constexpr size_t kShortTermBlocks = 30;
+  // 4x oversampling with 12 taps per phase.
+  static constexpr size_t kOversampling = 4;
+  static constexpr size_t kPhaseTaps = 12;
+  // Samples interpolated per pass.
+  static constexpr size_t kPeakChunk = 64;
+  // Histogram of gating blocks from -70 to +30 LUFS in 0.1 LU steps.
+  static constexpr size_t kHistogramBins = 1000;
+  static constexpr double kHistogramStepLu = 0.1;
+
+  // Filter state and interpolator history of one channel.
+  struct Channel {
+    Biquad shelf;
+    Biquad high_pass;
+    // The previous kPhaseTaps - 1 samples followed by the current pass.
+    float peak_input[kPhaseTaps - 1 + kPeakChunk];
+  };
+
+  void Weight(const float* left, const float* right, size_t count);
+  void TrackPeak(Channel* channel, const float* samples, size_t count);
+  void CompleteBlock();
+  float IntegratedLoudness() const;
+
+  uint32_t sample_rate_ = 0;
+  size_t block_size_ = 1;
+  size_t channel_count_ = 1;
+  Channel channels_[kMaxChannels];
+  // Weighted squares of every channel in the current block.
+  double block_sum_ = 0.0;
+  size_t block_samples_ = 0;
+
+  // Mean squares of the last kShortTermBlocks blocks, oldest overwritten.
+  double blocks_[kShortTermBlocks];
+  uint64_t block_count_ = 0;
+
+  // Interpolator taps by phase, oldest sample first.
+  float taps_[kOversampling][kPhaseTaps];
+  // Largest gain of any phase for an input of constant magnitude; bounds
+  // how far the interpolated signal can exceed its input.
+  float tap_gain_ = 1.0f;
+  // One phase of interpolated output for the current pass.
+  float peak_output_[kPeakChunk];
+  float peak_ = 0.0f;
+
+  uint32_t histogram_[kHistogramBins];
+  // Mean square at the centre of each histogram bin.
+  double bin_energy_[kHistogramBins];
+
+  LoudnessReading reading_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_LOUDNESS_METER_H_
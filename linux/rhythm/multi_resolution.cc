@@ -0,0 +1,217 @@
+#include "multi_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Reference pitch of the output grid.
+const double kConcertA = 440.0;
+
+// Level whose octave holds |hz|: 0 above sample_rate / 8, then one level
+// per octave below.
+size_t LevelFor(double hz, uint32_t sample_rate) {
+  const double octaves =
+      std::ceil(std::log2(static_cast<double>(sample_rate) / hz));
+  return octaves > 3.0 ? static_cast<size_t>(octaves) - 3 : 0;
+}
+
+}  // namespace
+
+SpectrumGrid MultiResolutionSpectrum::GridFor(uint32_t sample_rate) {
+  const double steps = std::floor(
+      kBinsPerOctave * std::log2(BandMapper::kMinFrequency / kConcertA));
+  const double min_hz = kConcertA * std::exp2(steps / kBinsPerOctave);
+  // Level 0 interpolates up to its second-highest bin.
+  const double top = static_cast<double>(sample_rate) *
+                     static_cast<double>(kWindowSize / 2 - 1) /
+                     static_cast<double>(kWindowSize);
+  const double max_hz = std::min<double>(BandMapper::kMaxFrequency, top);
+  const double octaves = std::max(std::log2(max_hz / min_hz), 0.0);
+  const size_t bin_count =
+      static_cast<size_t>(std::floor(kBinsPerOctave * octaves)) + 1;
+  return SpectrumGrid::Log(min_hz, kBinsPerOctave,
+                           std::max<size_t>(bin_count, 2), sample_rate);
+}
+
+double MultiResolutionSpectrum::WindowSeconds(double hz,
+                                              uint32_t sample_rate) {
+  const size_t deepest = std::min(
+      LevelFor(GridFor(sample_rate).min_hz, sample_rate), kMaxLevels - 1);
+  const size_t level = std::min(LevelFor(hz, sample_rate), deepest);
+  return static_cast<double>(kWindowSize << level) /
+         static_cast<double>(sample_rate);
+}
+
+bool MultiResolutionSpectrum::Configure(uint32_t sample_rate,
+                                        size_t hop_size) {
+  if (sample_rate == 0 || hop_size == 0) return false;
+  grid_ = GridFor(sample_rate);
+  hop_size_ = hop_size;
+
+  // Blackman-windowed half-band sinc, normalised to unity gain at DC.
+  double sum = 0.0;
+  for (size_t k = 0; k < kHalfBandPairs; k++) {
+    const double n = static_cast<double>(2 * k + 1);
+    const double window = 0.42 + 0.5 * std::cos(kPi * n / 16.0) +
+                          0.08 * std::cos(2.0 * kPi * n / 16.0);
+    const double tap = std::sin(kPi * n / 2.0) / (kPi * n) * window;
+    half_band_[k] = static_cast<float>(tap);
+    sum += tap;
+  }
+  for (float& tap : half_band_) tap = static_cast<float>(tap * 0.25 / sum);
+
+  const size_t level_count = std::min(
+      LevelFor(grid_.min_hz, sample_rate) + 1, kMaxLevels);
+  const size_t stride = kWindowSize / 2 + 1;
+  levels_.assign(level_count, Level());
+  for (size_t l = 0; l < level_count; l++) {
+    Level& level = levels_[l];
+    level.history.assign(2 * kWindowSize, 0.0f);
+    level.interval =
+        std::clamp(hop_size >> l, kWindowSize / 8, kWindowSize / 2);
+    level.first_bin = kWindowSize / 2;
+    level.last_bin = 0;
+  }
+
+  taps_.assign(grid_.bin_count, Tap());
+  for (size_t k = 0; k < taps_.size(); k++) {
+    const double hz = grid_.Frequency(static_cast<double>(k));
+    const size_t l = std::min(LevelFor(hz, sample_rate), level_count - 1);
+    const double position = hz * static_cast<double>(kWindowSize) *
+                            std::exp2(static_cast<double>(l)) /
+                            static_cast<double>(sample_rate);
+    const size_t below =
+        std::min(static_cast<size_t>(position), kWindowSize / 2 - 1);
+    Level& level = levels_[l];
+    level.first_bin = std::min(level.first_bin, below);
+    level.last_bin = std::max(level.last_bin, below + 1);
+    taps_[k].offset = static_cast<uint32_t>(l * stride + below);
+    taps_[k].fraction = static_cast<float>(
+        std::clamp(position - static_cast<double>(below), 0.0, 1.0));
+  }
+  for (Level& level : levels_) {
+    if (level.last_bin < level.first_bin) level.first_bin = level.last_bin;
+    level.power.assign(level.last_bin - level.first_bin + 1, 0.0f);
+  }
+
+  level_magnitudes_.assign(level_count * stride, 0.0f);
+  magnitudes_.assign(grid_.bin_count, 0.0f);
+  Reset();
+  return true;
+}
+
+void MultiResolutionSpectrum::Reset() {
+  for (Level& level : levels_) {
+    std::fill(std::begin(level.delay), std::end(level.delay), 0.0f);
+    level.delay_pos = 0;
+    level.odd = false;
+    std::fill(level.history.begin(), level.history.end(), 0.0f);
+    level.write_pos = 0;
+    level.until_transform = level.interval;
+    std::fill(level.power.begin(), level.power.end(), 0.0f);
+    level.transforms = 0;
+  }
+  std::fill(level_magnitudes_.begin(), level_magnitudes_.end(), 0.0f);
+  std::fill(magnitudes_.begin(), magnitudes_.end(), 0.0f);
+  transforms_ = 0;
+}
+
+void MultiResolutionSpectrum::PushSamples(const float* samples,
+                                          size_t count) {
+  while (count > 0) {
+    const size_t block = std::min(count, kBlockSize);
+    const float* input = samples;
+    size_t available = block;
+    for (size_t l = 0; l < levels_.size() && available > 0; l++) {
+      if (l > 0) {
+        float* output = scratch_[l & 1];
+        available = Decimate(&levels_[l], input, available, output);
+        input = output;
+      }
+      Append(&levels_[l], input, available);
+    }
+    samples += block;
+    count -= block;
+  }
+}
+
+// Filters |count| samples of the level above into |level| and writes every
+// second result to |output|. Returns the number written.
+size_t MultiResolutionSpectrum::Decimate(Level* level, const float* input,
+                                         size_t count, float* output) const {
+  const size_t center = kHalfBandTaps / 2;
+  size_t produced = 0;
+  for (size_t i = 0; i < count; i++) {
+    level->delay[level->delay_pos] = input[i];
+    level->delay[level->delay_pos + kHalfBandTaps] = input[i];
+    if (++level->delay_pos == kHalfBandTaps) level->delay_pos = 0;
+    level->odd = !level->odd;
+    if (level->odd) continue;
+
+    const float* x = &level->delay[level->delay_pos];
+    float sum = 0.5f * x[center];
+    for (size_t k = 0; k < kHalfBandPairs; k++) {
+      sum += half_band_[k] * (x[center - 1 - 2 * k] + x[center + 1 + 2 * k]);
+    }
+    output[produced++] = sum;
+  }
+  return produced;
+}
+
+void MultiResolutionSpectrum::Append(Level* level, const float* samples,
+                                     size_t count) {
+  while (count > 0) {
+    const size_t take = std::min(
+        {count, level->until_transform, kWindowSize - level->write_pos});
+    const auto pos = static_cast<std::ptrdiff_t>(level->write_pos);
+    std::copy(samples, samples + take, level->history.begin() + pos);
+    std::copy(samples, samples + take,
+              level->history.begin() + pos +
+                  static_cast<std::ptrdiff_t>(kWindowSize));
+    level->write_pos = (level->write_pos + take) & (kWindowSize - 1);
+    level->until_transform -= take;
+    samples += take;
+    count -= take;
+    if (level->until_transform > 0) continue;
+
+    plan_.TransformWindowed(&level->history[level->write_pos]);
+    const float* magnitudes = plan_.magnitudes() + level->first_bin;
+    for (size_t b = 0; b < level->power.size(); b++) {
+      level->power[b] += magnitudes[b] * magnitudes[b];
+    }
+    level->transforms++;
+    transforms_++;
+    level->until_transform = level->interval;
+  }
+}
+
+void MultiResolutionSpectrum::Update() {
+  const float scale =
+      static_cast<float>(kReferenceFftSize) / static_cast<float>(kWindowSize);
+  const size_t stride = kWindowSize / 2 + 1;
+  for (size_t l = 0; l < levels_.size(); l++) {
+    Level& level = levels_[l];
+    if (level.transforms == 0) continue;
+    const float mean = 1.0f / static_cast<float>(level.transforms);
+    float* magnitudes = &level_magnitudes_[l * stride + level.first_bin];
+    for (size_t b = 0; b < level.power.size(); b++) {
+      magnitudes[b] = scale * std::sqrt(level.power[b] * mean);
+      level.power[b] = 0.0f;
+    }
+    level.transforms = 0;
+  }
+  for (size_t k = 0; k < taps_.size(); k++) {
+    const float* pair = &level_magnitudes_[taps_[k].offset];
+    const float fraction = taps_[k].fraction;
+    magnitudes_[k] = pair[0] + fraction * (pair[1] - pair[0]);
+  }
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
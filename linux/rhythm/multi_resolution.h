@@ -0,0 +1,132 @@
+#ifndef RHYTHM_MULTI_RESOLUTION_H_
+#define RHYTHM_MULTI_RESOLUTION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "band_mapper.h"
+#include "fft_kernels.h"
+#include "fft_plan.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Constant-Q spectrum from an octave decimation chain.
+//
+// Level 0 is the input; each further level is the one above it half-band
+// filtered and decimated by two, so all levels share one chain and every
+// sample is filtered once per level. Every level runs the same
+// kWindowSize-point FFT at its own rate, which makes the window 2^level
+// times longer in time and the bins 2^level times narrower: short windows
+// for the highs, long ones for the lows. Level 0 covers everything above
+// sample_rate / 8 and each further level the octave below the one above,
+// well inside its decimation filter's passband; the last level also
+// reaches down to the lowest bin.
+//
+// The output is kBinsPerOctave log-spaced bins per octave, on the A440
+// equal-tempered grid from just below BandMapper::kMinFrequency to
+// BandMapper::kMaxFrequency, interpolated from the level that covers each.
+// A level transforms every hop / 2^level of its own samples, but no more
+// often than every kWindowSize / 8 and no less than every kWindowSize / 2;
+// the power of all transforms since the last Update() is averaged, so the
+// highs see every sample of the hop while the deepest levels update only
+// every few hops and hold their values in between.
+//
+// Configure() allocates; PushSamples() and Update() do not.
+class MultiResolutionSpectrum {
+ public:
+  static constexpr size_t kWindowSize = 128;
+  static constexpr uint32_t kBinsPerOctave = 24;
+  static constexpr size_t kMaxLevels = 12;
+  // Magnitudes are scaled as if from an FFT of this size, so that band
+  // levels match the FFT mode at its default size.
+  static constexpr size_t kReferenceFftSize = 1024;
+
+  // The bins Configure() produces for |sample_rate|.
+  static SpectrumGrid GridFor(uint32_t sample_rate);
+  // Length in seconds of the window behind the output at |hz|; its
+  // reciprocal is the frequency resolution there.
+  static double WindowSeconds(double hz, uint32_t sample_rate);
+
+  // Plans the levels for |sample_rate| and a frame every |hop_size| samples
+  // and clears all state. Returns false if either is 0.
+  bool Configure(uint32_t sample_rate, size_t hop_size);
+
+  // Overrides the automatically selected FFT kernels (benchmarking only).
+  void SetKernels(const FftKernels& kernels) { plan_.SetKernels(kernels); }
+
+  void Reset();
+
+  // Runs |count| samples through the decimation chain and every transform
+  // that falls due.
+  void PushSamples(const float* samples, size_t count);
+
+  // Turns the power gathered since the previous call into magnitudes().
+  void Update();
+
+  const float* magnitudes() const { return magnitudes_.data(); }
+  size_t bin_count() const { return magnitudes_.size(); }
+  const SpectrumGrid& grid() const { return grid_; }
+  uint32_t sample_rate() const { return grid_.sample_rate; }
+  size_t hop_size() const { return hop_size_; }
+  size_t level_count() const { return levels_.size(); }
+
+  // Transforms run since Configure(), across all levels.
+  uint64_t transforms() const { return transforms_; }
+
+ private:
+  // Half-band filter of 4 * kHalfBandPairs - 1 taps; only the centre and
+  // the odd taps, which pair up symmetrically, are non-zero.
+  static constexpr size_t kHalfBandPairs = 8;
+  static constexpr size_t kHalfBandTaps = 4 * kHalfBandPairs - 1;
+  // Samples decimated per pass through the chain.
+  static constexpr size_t kBlockSize = 256;
+
+  struct Level {
+    // Input from the level above, oldest first at delay[delay_pos] (a
+    // mirrored ring like the history); unused on level 0.
+    float delay[2 * kHalfBandTaps] = {};
+    size_t delay_pos = 0;
+    bool odd = false;
+    // Mirrored ring of the latest kWindowSize samples at this level's rate.
+    std::vector<float> history;
+    size_t write_pos = 0;
+    size_t interval = 0;
+    size_t until_transform = 0;
+    // Bins of the level's FFT that output bins read, and the power summed
+    // over them by the transforms since the last Update().
+    size_t first_bin = 0;
+    size_t last_bin = 0;
+    std::vector<float> power;
+    uint32_t transforms = 0;
+  };
+
+  // An output bin, interpolated between two adjacent entries of
+  // level_magnitudes_.
+  struct Tap {
+    uint32_t offset = 0;
+    float fraction = 0.0f;
+  };
+
+  size_t Decimate(Level* level, const float* input, size_t count,
+                  float* output) const;
+  void Append(Level* level, const float* samples, size_t count);
+
+  RealFftPlan plan_{kWindowSize};
+  SpectrumGrid grid_;
+  size_t hop_size_ = 0;
+  float half_band_[kHalfBandPairs] = {};
+  std::vector<Level> levels_;
+  // kWindowSize / 2 + 1 magnitudes per level.
+  std::vector<float> level_magnitudes_;
+  std::vector<Tap> taps_;
+  std::vector<float> magnitudes_;
+  float scratch_[2][kBlockSize] = {};
+  uint64_t transforms_ = 0;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_MULTI_RESOLUTION_H_
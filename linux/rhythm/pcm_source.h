@@ -0,0 +1,37 @@
+#ifndef RHYTHM_PCM_SOURCE_H_
+#define RHYTHM_PCM_SOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "downmix.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Decoded audio pulled block by block for offline analysis: a WAV file
+// (WavFileSource) here, the platform's decoder in the runners.
+class PcmSource {
+ public:
+  virtual ~PcmSource() = default;
+
+  // Encoding of the frames Read() returns; fixed once the source is open.
+  virtual const AudioFormat& format() const = 0;
+
+  // Reads up to |max_frames| interleaved frames into |data|, which must hold
+  // max_frames * format().block_align bytes and be 4-byte aligned, and sets
+  // |frames| to the number read, 0 at the end of the stream. Returns false
+  // and fills |error| if decoding fails.
+  virtual bool Read(void* data, size_t max_frames, size_t* frames,
+                    std::string* error) = 0;
+
+  // Size in bytes of the file behind the source, so that a stored analysis
+  // can tell that the file changed; 0 if unknown.
+  virtual uint64_t source_size() const { return 0; }
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_PCM_SOURCE_H_
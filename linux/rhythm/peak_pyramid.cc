@@ -0,0 +1,312 @@
+#include "peak_pyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const uint8_t kMagic[4] = {'C', 'Y', 'R', 'P'};
+
+// Level 0 buckets written at once, and level buckets read back at once by
+// PeakPyramidWriter; even, so that merged pairs never straddle two blocks.
+constexpr size_t kBlockBuckets = 8192;
+
+void PutLe(uint64_t value, size_t bytes, uint8_t* out) {
+  for (size_t i = 0; i < bytes; i++) {
+    out[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint64_t GetLe(const uint8_t* in, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    value |= static_cast<uint64_t>(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+void EncodeBucket(const PeakColumn& bucket, uint8_t* out) {
+  const auto sample = [](float value) {
+    return static_cast<uint16_t>(static_cast<int16_t>(
+        std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f)));
+  };
+  PutLe(sample(bucket.min), 2, out);
+  PutLe(sample(bucket.max), 2, out + 2);
+  PutLe(static_cast<uint16_t>(
+            std::lround(std::min(bucket.rms, 1.0f) * 65535.0f)),
+        2, out + 4);
+}
+
+PeakColumn DecodeBucket(const uint8_t* in) {
+  PeakColumn bucket;
+  bucket.min = static_cast<int16_t>(GetLe(in, 2)) / 32767.0f;
+  bucket.max = static_cast<int16_t>(GetLe(in + 2, 2)) / 32767.0f;
+  bucket.rms = static_cast<float>(GetLe(in + 4, 2)) / 65535.0f;
+  return bucket;
+}
+
+// Buckets per level of a pyramid over |frame_count| frames, written to
+// |counts|; returns the level count, 0 for an empty track.
+size_t CountLevels(uint64_t frame_count,
+                   uint64_t counts[PeakPyramid::kMaxLevels]) {
+  if (frame_count == 0) return 0;
+  uint64_t count = (frame_count + kPeakBaseFrames - 1) / kPeakBaseFrames;
+  size_t levels = 0;
+  for (;;) {
+    counts[levels++] = count;
+    if (count <= 1) return levels;
+    count = (count + 1) / 2;
+  }
+}
+
+// Frames in bucket |index| of |level|; only the last one is short.
+uint64_t BucketFrames(uint64_t frame_count, size_t level, uint64_t index) {
+  const uint64_t width = static_cast<uint64_t>(kPeakBaseFrames) << level;
+  return std::min(width, frame_count - index * width);
+}
+
+// Folds |bucket|, covering |frames| frames, into |total|, which covers
+// |*total_frames|.
+void MergeBucket(const PeakColumn& bucket, uint64_t frames, PeakColumn* total,
+                 uint64_t* total_frames) {
+  if (*total_frames == 0) {
+    *total = bucket;
+  } else {
+    const double power = static_cast<double>(total->rms) * total->rms *
+                             static_cast<double>(*total_frames) +
+                         static_cast<double>(bucket.rms) * bucket.rms *
+                             static_cast<double>(frames);
+    total->min = std::min(total->min, bucket.min);
+    total->max = std::max(total->max, bucket.max);
+    total->rms = static_cast<float>(
+        std::sqrt(power / static_cast<double>(*total_frames + frames)));
+  }
+  *total_frames += frames;
+}
+
+}  // namespace
+
+PeakPyramidWriter::PeakPyramidWriter() {
+  pending_.reserve(kBlockBuckets * kPeakBucketBytes);
+  block_.reserve(kBlockBuckets * kPeakBucketBytes);
+}
+
+PeakPyramidWriter::~PeakPyramidWriter() { Abandon(); }
+
+bool PeakPyramidWriter::Begin(const std::string& path, uint32_t sample_rate,
+                              std::string* error) {
+  Abandon();
+  path_ = path;
+  sample_rate_ = sample_rate;
+  frames_ = 0;
+  filled_ = 0;
+  sum_squares_ = 0.0;
+  pending_.clear();
+  temporary_ = std::filesystem::u8path(path);
+  temporary_ += ".tmp";
+  file_.clear();
+  file_.open(temporary_, std::ios::in | std::ios::out | std::ios::binary |
+                             std::ios::trunc);
+  // The header is written last, once the level count is known.
+  const char header[kPeakHeaderBytes] = {};
+  if (!file_ || !file_.write(header, sizeof(header))) {
+    *error = "cannot write " + path + ".tmp";
+    Abandon();
+    return false;
+  }
+  return true;
+}
+
+void PeakPyramidWriter::Process(const float* mono, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const float value = mono[i];
+    if (filled_ == 0) {
+      min_ = value;
+      max_ = value;
+    } else {
+      min_ = std::min(min_, value);
+      max_ = std::max(max_, value);
+    }
+    sum_squares_ += static_cast<double>(value) * value;
+    if (++filled_ == kPeakBaseFrames) CloseBucket();
+  }
+  frames_ += count;
+}
+
+void PeakPyramidWriter::CloseBucket() {
+  PeakColumn bucket;
+  bucket.min = min_;
+  bucket.max = max_;
+  bucket.rms = static_cast<float>(std::sqrt(sum_squares_ / filled_));
+  pending_.resize(pending_.size() + kPeakBucketBytes);
+  EncodeBucket(bucket, pending_.data() + pending_.size() - kPeakBucketBytes);
+  filled_ = 0;
+  sum_squares_ = 0.0;
+  if (pending_.size() >= kBlockBuckets * kPeakBucketBytes) FlushBuckets();
+}
+
+void PeakPyramidWriter::FlushBuckets() {
+  file_.write(reinterpret_cast<const char*>(pending_.data()),
+              static_cast<std::streamsize>(pending_.size()));
+  pending_.clear();
+}
+
+void PeakPyramidWriter::BuildLevel(size_t level, uint64_t offset,
+                                   uint64_t count) {
+  // The level above is appended right behind this one.
+  uint64_t write_offset = offset + count * kPeakBucketBytes;
+  for (uint64_t first = 0; first < count; first += kBlockBuckets) {
+    const size_t buckets =
+        static_cast<size_t>(std::min<uint64_t>(kBlockBuckets, count - first));
+    block_.resize(buckets * kPeakBucketBytes);
+    file_.seekg(static_cast<std::streamoff>(offset + first * kPeakBucketBytes));
+    file_.read(reinterpret_cast<char*>(block_.data()),
+               static_cast<std::streamsize>(block_.size()));
+    for (size_t i = 0; i < buckets; i += 2) {
+      PeakColumn merged;
+      uint64_t frames = 0;
+      for (size_t j = i; j < std::min(i + 2, buckets); j++) {
+        MergeBucket(DecodeBucket(block_.data() + j * kPeakBucketBytes),
+                    BucketFrames(frames_, level, first + j), &merged,
+                    &frames);
+      }
+      pending_.resize(pending_.size() + kPeakBucketBytes);
+      EncodeBucket(merged,
+                   pending_.data() + pending_.size() - kPeakBucketBytes);
+    }
+    file_.seekp(static_cast<std::streamoff>(write_offset));
+    write_offset += pending_.size();
+    FlushBuckets();
+  }
+}
+
+bool PeakPyramidWriter::Finish(uint64_t source_size, std::string* error) {
+  if (!active()) {
+    *error = "no waveform is being written";
+    return false;
+  }
+  if (filled_ > 0) CloseBucket();
+  FlushBuckets();
+
+  uint64_t counts[PeakPyramid::kMaxLevels];
+  const size_t levels = CountLevels(frames_, counts);
+  uint64_t offset = kPeakHeaderBytes;
+  for (size_t level = 0; level + 1 < levels; level++) {
+    BuildLevel(level, offset, counts[level]);
+    offset += counts[level] * kPeakBucketBytes;
+  }
+
+  uint8_t header[kPeakHeaderBytes] = {};
+  std::memcpy(header, kMagic, sizeof(kMagic));
+  PutLe(kPeakVersion, 2, header + 4);
+  PutLe(levels, 2, header + 6);
+  PutLe(sample_rate_, 4, header + 8);
+  PutLe(kPeakBaseFrames, 4, header + 12);
+  PutLe(frames_, 8, header + 16);
+  PutLe(source_size, 8, header + 24);
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file_.flush();
+  const bool written = !file_.fail();
+  file_.close();
+  std::error_code ignored;
+  if (!written) {
+    *error = "cannot write " + path_ + ".tmp";
+    std::filesystem::remove(temporary_, ignored);
+    return false;
+  }
+  // Replaces an existing pyramid on Windows too.
+  std::error_code renamed;
+  std::filesystem::rename(temporary_, std::filesystem::u8path(path_),
+                          renamed);
+  if (renamed) {
+    *error = "cannot replace " + path_ + ": " + renamed.message();
+    std::filesystem::remove(temporary_, ignored);
+    return false;
+  }
+  return true;
+}
+
+void PeakPyramidWriter::Abandon() {
+  if (!active()) return;
+  file_.close();
+  std::error_code ignored;
+  std::filesystem::remove(temporary_, ignored);
+}
+
+bool PeakPyramid::Open(const uint8_t* data, size_t size) {
+  data_ = nullptr;
+  level_count_ = 0;
+  if (size < kPeakHeaderBytes ||
+      std::memcmp(data, kMagic, sizeof(kMagic)) != 0 ||
+      GetLe(data + 4, 2) != kPeakVersion ||
+      GetLe(data + 12, 4) != kPeakBaseFrames) {
+    return false;
+  }
+  const uint64_t frame_count = GetLe(data + 16, 8);
+  uint64_t counts[kMaxLevels];
+  const size_t levels = CountLevels(frame_count, counts);
+  if (GetLe(data + 6, 2) != levels) return false;
+  uint64_t offset = kPeakHeaderBytes;
+  for (size_t level = 0; level < levels; level++) {
+    if ((size - offset) / kPeakBucketBytes < counts[level]) return false;
+    counts_[level] = counts[level];
+    offsets_[level] = offset;
+    offset += counts[level] * kPeakBucketBytes;
+  }
+
+  data_ = data;
+  sample_rate_ = static_cast<uint32_t>(GetLe(data + 8, 4));
+  frame_count_ = frame_count;
+  source_size_ = GetLe(data + 24, 8);
+  level_count_ = levels;
+  return true;
+}
+
+PeakColumn PeakPyramid::bucket(size_t level, uint64_t index) const {
+  return DecodeBucket(data_ + offsets_[level] + index * kPeakBucketBytes);
+}
+
+size_t PeakPyramid::Query(uint64_t begin, uint64_t end, size_t columns,
+                          PeakColumn* out) const {
+  end = std::min(end, frame_count_);
+  if (columns == 0 || begin >= end) return 0;
+  const uint64_t span = end - begin;
+  const double column_frames =
+      static_cast<double>(span) / static_cast<double>(columns);
+  // A column then spans less than two buckets, so it touches at most three.
+  size_t level = 0;
+  while (level + 1 < level_count_ &&
+         static_cast<double>(bucket_frames(level + 1)) <= column_frames) {
+    level++;
+  }
+  const uint64_t width = bucket_frames(level);
+  const uint64_t count = counts_[level];
+  for (size_t c = 0; c < columns; c++) {
+    const uint64_t first =
+        begin + static_cast<uint64_t>(column_frames * static_cast<double>(c));
+    const uint64_t last = c + 1 == columns
+                              ? end
+                              : begin + static_cast<uint64_t>(
+                                            column_frames *
+                                            static_cast<double>(c + 1));
+    const uint64_t first_bucket = std::min(first / width, count - 1);
+    const uint64_t end_bucket = std::min(
+        std::max((last + width - 1) / width, first_bucket + 1), count);
+    PeakColumn column;
+    uint64_t frames = 0;
+    for (uint64_t i = first_bucket; i < end_bucket; i++) {
+      MergeBucket(bucket(level, i), BucketFrames(frame_count_, level, i),
+                  &column, &frames);
+    }
+    out[c] = column;
+  }
+  return columns;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,139 @@
+#ifndef RHYTHM_PEAK_PYRAMID_H_
+#define RHYTHM_PEAK_PYRAMID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// A waveform overview of a whole track for the seek bar, stored next to the
+// cached audio as <cache key>.peaks. The little-endian file is a
+// kPeakHeaderBytes header followed by the levels of the pyramid:
+//
+//   0  "CYRP" magic               4  u16 version, u16 level count
+//   8  u32 sample rate           12  u32 frames per level 0 bucket
+//  16  u64 frame count           24  u64 source size
+//  32  zero up to kPeakHeaderBytes
+//  64  level 0 buckets, then level 1, ...
+//
+// A bucket is kPeakBucketBytes: the i16 minimum and maximum of the mono
+// downmix, full scale 32767, and its u16 RMS, full scale 65535. A level k
+// bucket spans kPeakBaseFrames << k frames, the last one possibly fewer, so
+// level k holds ceil(frame count / (kPeakBaseFrames << k)) buckets; the top
+// level is the first with a single bucket. Each level starts where the one
+// below ends, so a reader finds any bucket without an index and can use the
+// file memory-mapped as it is.
+constexpr uint16_t kPeakVersion = 1;
+constexpr size_t kPeakHeaderBytes = 64;
+constexpr size_t kPeakBucketBytes = 6;
+constexpr uint32_t kPeakBaseFrames = 512;
+constexpr char kPeakExtension[] = ".peaks";
+
+// One bucket, or one column of PeakPyramid::Query(), at full scale 1.
+struct PeakColumn {
+  float min = 0.0f;
+  float max = 0.0f;
+  float rms = 0.0f;
+};
+
+// Writes a pyramid from a stream of mono samples. Level 0 goes to a
+// temporary file as its buckets fill; Finish() then builds each level from
+// the one below by reading it back in blocks, so memory stays at a few
+// blocks however long the track is. The finished file is renamed over the
+// target, so a reader never sees half a pyramid.
+//
+// TrackAnalyzer::Analyze() can feed one alongside the analysis, so the
+// track is decoded once for both.
+class PeakPyramidWriter {
+ public:
+  PeakPyramidWriter();
+  // Abandon()s an unfinished pyramid.
+  ~PeakPyramidWriter();
+
+  PeakPyramidWriter(const PeakPyramidWriter&) = delete;
+  PeakPyramidWriter& operator=(const PeakPyramidWriter&) = delete;
+
+  // Starts a pyramid for |path| (UTF-8) at |sample_rate|. Returns false and
+  // fills |error| if the temporary file cannot be created.
+  bool Begin(const std::string& path, uint32_t sample_rate,
+             std::string* error);
+  void Process(const float* mono, size_t count);
+  // Builds the upper levels, writes the header with |source_size| and
+  // replaces |path|. Returns false and fills |error| if any write failed.
+  bool Finish(uint64_t source_size, std::string* error);
+  // Drops the pyramid under construction; no-op if there is none.
+  void Abandon();
+
+  bool active() const { return file_.is_open(); }
+
+ private:
+  // Encodes the level 0 bucket being filled.
+  void CloseBucket();
+  void FlushBuckets();
+  // Appends level |level| + 1, read back from |offset|, to the file.
+  void BuildLevel(size_t level, uint64_t offset, uint64_t count);
+
+  std::string path_;
+  std::filesystem::path temporary_;
+  std::fstream file_;
+  uint32_t sample_rate_ = 0;
+  uint64_t frames_ = 0;
+  // The level 0 bucket being filled.
+  float min_ = 0.0f;
+  float max_ = 0.0f;
+  double sum_squares_ = 0.0;
+  uint32_t filled_ = 0;
+  // Encoded buckets not written yet, and the block read back by
+  // BuildLevel().
+  std::vector<uint8_t> pending_;
+  std::vector<uint8_t> block_;
+};
+
+// Read-only view of a pyramid file's bytes, which are not copied.
+class PeakPyramid {
+ public:
+  // More than 64-bit frame counts could need.
+  static constexpr size_t kMaxLevels = 64;
+
+  // Points the view at |size| bytes at |data|, which must outlive it.
+  // Returns false unless they hold a complete pyramid of kPeakVersion.
+  bool Open(const uint8_t* data, size_t size);
+
+  uint32_t sample_rate() const { return sample_rate_; }
+  uint64_t frame_count() const { return frame_count_; }
+  uint64_t source_size() const { return source_size_; }
+  size_t level_count() const { return level_count_; }
+  uint64_t bucket_count(size_t level) const { return counts_[level]; }
+  uint64_t bucket_frames(size_t level) const {
+    return static_cast<uint64_t>(kPeakBaseFrames) << level;
+  }
+  PeakColumn bucket(size_t level, uint64_t index) const;
+
+  // Fills |columns| columns of |out| with frames [|begin|, |end|) split
+  // evenly, clamped to the track, and returns how many were filled (0 if
+  // the range is empty). Reads at most three buckets per column from the
+  // coarsest level whose buckets are no wider than a column, so the cost
+  // depends only on |columns|. Columns narrower than a level 0 bucket
+  // repeat it.
+  size_t Query(uint64_t begin, uint64_t end, size_t columns,
+               PeakColumn* out) const;
+
+ private:
+  const uint8_t* data_ = nullptr;
+  uint32_t sample_rate_ = 0;
+  uint64_t frame_count_ = 0;
+  uint64_t source_size_ = 0;
+  size_t level_count_ = 0;
+  uint64_t counts_[kMaxLevels] = {};
+  uint64_t offsets_[kMaxLevels] = {};
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_PEAK_PYRAMID_H_
@@ -0,0 +1,146 @@
+#include "percussive_separator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "rhythm_analyzer.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+// Onsets: the flux must rise through kThresholdRatio times its mean over
+// about kThresholdWindowSeconds plus kThresholdFloor times its maximum
+// decaying over kMaxDecaySeconds.
+constexpr double kThresholdWindowSeconds = 0.3;
+constexpr float kThresholdRatio = 1.5f;
+constexpr float kThresholdFloor = 0.1f;
+constexpr double kMaxDecaySeconds = 3.0;
+// And the frame must be at least this percussive, so that a sustained
+// sound whose partials flicker from frame to frame raises none.
+constexpr float kMinOnsetShare = 0.4f;
+
+// The odd window length nearest |length|, between 3 and |limit| (at least
+// 1).
+size_t OddWindow(double length, size_t limit) {
+  size_t window = std::min(
+      static_cast<size_t>(std::max(std::round(length), 3.0)), limit);
+  if (window % 2 == 0) window--;
+  return std::max<size_t>(window, 1);
+}
+
+}  // namespace
+
+bool PercussiveSeparator::Configure(const BandLayout& layout,
+                                    const SpectrumGrid& grid,
+                                    double frame_period) {
+  if (frame_period == frame_period_ && grid == mapper_.grid() &&
+      layout == mapper_.layout()) {
+    return true;
+  }
+  if (!mapper_.Configure(layout, grid)) return false;
+  frame_period_ = frame_period;
+  const size_t count = grid.bin_count;
+
+  harmonic_frames_ =
+      OddWindow(kHarmonicSeconds / frame_period, RunningMedian::kMaxSize);
+  const double bins =
+      grid.spacing == SpectrumGrid::Spacing::kLog
+          ? kPercussiveOctaves * grid.bins_per_octave
+          : kPercussiveHz * grid.fft_size / grid.sample_rate;
+  percussive_bins_ = OddWindow(bins, RunningMedian::kMaxSize);
+
+  harmonic_.resize(count);
+  weights_.resize(count);
+  double span = 0.0;
+  for (size_t k = 0; k < count; k++) {
+    const double width = grid.Frequency(static_cast<double>(k + 1)) -
+                         grid.Frequency(static_cast<double>(k));
+    weights_[k] = static_cast<float>(width);
+    span += width;
+  }
+  for (float& weight : weights_) weight = static_cast<float>(weight / span);
+  percussive_.assign(count, 0.0f);
+  bands_.assign(mapper_.band_count(), 0.0f);
+  mean_weight_ = static_cast<float>(
+      1.0 - std::exp(-frame_period / kThresholdWindowSeconds));
+  max_decay_ = static_cast<float>(std::exp(-frame_period / kMaxDecaySeconds));
+  Reset();
+  return true;
+}
+
+void PercussiveSeparator::Reset() {
+  primed_ = false;
+  std::fill(percussive_.begin(), percussive_.end(), 0.0f);
+  std::fill(bands_.begin(), bands_.end(), 0.0f);
+  flux_mean_ = 0.0f;
+  flux_max_ = 0.0f;
+  above_ = false;
+  last_onset_ns_ = 0;
+}
+
+bool PercussiveSeparator::Process(const float* magnitudes,
+                                  int64_t timestamp_ns,
+                                  PercussiveOnset* onset) {
+  const size_t count = percussive_.size();
+  if (count == 0) return false;
+  // Starting every time median from the first frame keeps a sustained
+  // sound that is already playing from reading as percussive.
+  const bool primed = primed_;
+  if (!primed) {
+    for (size_t k = 0; k < count; k++) {
+      harmonic_[k].Reset(harmonic_frames_, magnitudes[k]);
+    }
+    primed_ = true;
+  }
+
+  // Slide the frequency window up from the one centred on bin 0, which the
+  // zeros below the spectrum fill half.
+  const size_t half = percussive_bins_ / 2;
+  vertical_.Reset(percussive_bins_);
+  for (size_t k = 0; k < std::min(half, count); k++) {
+    vertical_.Push(magnitudes[k]);
+  }
+  float flux = 0.0f;
+  float total_sum = 0.0f;
+  float percussive_sum = 0.0f;
+  for (size_t k = 0; k < count; k++) {
+    const float p =
+        vertical_.Push(k + half < count ? magnitudes[k + half] : 0.0f);
+    const float h = harmonic_[k].Push(magnitudes[k]);
+    const float p2 = p * p;
+    const float total = p2 + h * h;
+    const float value = total > 0.0f ? magnitudes[k] * p2 / total : 0.0f;
+    const float weight = weights_[k];
+    flux += weight * std::max(value - percussive_[k], 0.0f);
+    percussive_[k] = value;
+    total_sum += weight * magnitudes[k];
+    percussive_sum += weight * value;
+  }
+  mapper_.Apply(percussive_.data(), bands_.data());
+  for (float& band : bands_) band *= RhythmAnalyzer::kLevelScale;
+  if (!primed) return false;
+
+  const float threshold =
+      kThresholdRatio * flux_mean_ + kThresholdFloor * flux_max_;
+  const bool above = flux > threshold && threshold > 0.0f &&
+                     percussive_sum >= kMinOnsetShare * total_sum;
+  const bool rising = above && !above_;
+  above_ = above;
+  flux_mean_ += mean_weight_ * (flux - flux_mean_);
+  flux_max_ = std::max(flux, flux_max_ * max_decay_);
+  if (!rising) return false;
+  const int64_t min_gap_ns =
+      static_cast<int64_t>(kMinOnsetGapSeconds * 1e9);
+  if (last_onset_ns_ != 0 && timestamp_ns - last_onset_ns_ < min_gap_ns) {
+    return false;
+  }
+  last_onset_ns_ = timestamp_ns;
+  onset->timestamp_ns = timestamp_ns;
+  onset->strength = flux / threshold;
+  return true;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,107 @@
+#ifndef RHYTHM_PERCUSSIVE_SEPARATOR_H_
+#define RHYTHM_PERCUSSIVE_SEPARATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "band_mapper.h"
+#include "running_median.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// An onset in the percussive part of the spectrum.
+struct PercussiveOnset {
+  // Capture time on the RhythmFrame clock (the centre of the frame's
+  // window).
+  int64_t timestamp_ns = 0;
+  // Percussive flux relative to the adaptive threshold, > 1.
+  float strength = 0.0f;
+};
+
+// Streaming harmonic/percussive separation by median filtering.
+//
+// Sustained sounds are smooth along time and peaky along frequency; drums
+// are the opposite. Each bin's median over the last kHarmonicSeconds of
+// frames estimates its harmonic part, and each frame's median over about
+// kPercussiveHz of neighbouring bins (kPercussiveOctaves on a log grid)
+// its percussive part. A bin keeps P^2 / (H^2 + P^2) of its magnitude as
+// percussive. Both medians are RunningMedian windows: one per bin over a
+// ring of past frames, and one sliding up the current frame with zeros
+// beyond its ends (reflecting the spectrum there would count a bass note's
+// peak twice and pass it as percussive). A frame costs
+// O(bins * log(window)) and adds no latency, since the time median is
+// causal: a new hit lies outside the harmonic estimate until it has lasted
+// half the window.
+//
+// The percussive magnitudes are mapped to bands, and their half-wave
+// rectified flux, integrated over frequency, gives onsets: the frames where
+// it rises through an adaptive threshold (a multiple of its recent mean
+// plus a fraction of a slowly decaying maximum) while a good part of the
+// frame is percussive, at most one per kMinOnsetGapSeconds. In the bass a
+// short FFT window makes even a steady note flicker, which the second
+// condition keeps from firing. The multi-resolution spectrum, whose deeper
+// levels hold their values between updates, separates as well but raises
+// more spurious onsets.
+//
+// Configure() allocates when the grid or layout changes; the rest does not.
+class PercussiveSeparator {
+ public:
+  static constexpr double kHarmonicSeconds = 0.2;
+  static constexpr double kPercussiveHz = 500.0;
+  static constexpr double kPercussiveOctaves = 0.5;
+  static constexpr double kMinOnsetGapSeconds = 0.1;
+
+  // |grid| magnitudes arrive every |frame_period| seconds and are mapped to
+  // |layout|. Resets unless nothing changed. Returns false, leaving the
+  // separator untouched, for an invalid layout.
+  bool Configure(const BandLayout& layout, const SpectrumGrid& grid,
+                 double frame_period);
+  void Reset();
+
+  const SpectrumGrid& grid() const { return mapper_.grid(); }
+  const BandLayout& layout() const { return mapper_.layout(); }
+  // Median window lengths, in frames and in bins.
+  size_t harmonic_frames() const { return harmonic_frames_; }
+  size_t percussive_bins() const { return percussive_bins_; }
+
+  // Separates one frame of magnitudes whose window is centred on
+  // |timestamp_ns|. Returns true and fills |onset| if it starts an onset.
+  bool Process(const float* magnitudes, int64_t timestamp_ns,
+               PercussiveOnset* onset);
+
+  // Percussive band levels of the latest frame, on the analyser's scale.
+  const float* bands() const { return bands_.data(); }
+  size_t band_count() const { return bands_.size(); }
+  // Percussive magnitudes of the latest frame.
+  const float* magnitudes() const { return percussive_.data(); }
+
+ private:
+  BandMapper mapper_;
+  double frame_period_ = 0.0;
+  size_t harmonic_frames_ = 1;
+  size_t percussive_bins_ = 1;
+  // One time median per bin; primed with the first frame after a reset.
+  std::vector<RunningMedian> harmonic_;
+  bool primed_ = false;
+  RunningMedian vertical_;
+  std::vector<float> percussive_;
+  // Share of the spectrum's width in Hz each bin stands for, so that onsets
+  // do not depend on the grid: on a log grid the bass bins, whose long
+  // windows blur a hit over several frames, count for little.
+  std::vector<float> weights_;
+  std::vector<float> bands_;
+  // Onset detection.
+  float flux_mean_ = 0.0f;
+  float flux_max_ = 0.0f;
+  float mean_weight_ = 0.0f;
+  float max_decay_ = 0.0f;
+  bool above_ = false;
+  int64_t last_onset_ns_ = 0;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_PERCUSSIVE_SEPARATOR_H_
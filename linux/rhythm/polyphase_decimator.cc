@@ -0,0 +1,138 @@
+#include "polyphase_decimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Kaiser window shape for about 74 dB of stopband attenuation.
+const double kKaiserBeta = 7.3;
+
+// Modified Bessel function of the first kind, order 0.
+double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  const double quarter = x * x / 4.0;
+  for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+    term *= quarter / (static_cast<double>(k) * static_cast<double>(k));
+    sum += term;
+  }
+  return sum;
+}
+
+}  // namespace
+
+bool PolyphaseDecimator::IsValidFactor(size_t factor) {
+  return factor == 1 || factor == 2 || factor == 4 || factor == 8;
+}
+
+bool PolyphaseDecimator::Configure(size_t factor) {
+  if (!IsValidFactor(factor)) return false;
+  factor_ = factor;
+  // An even length puts the centre between two taps, so the sinc below
+  // never divides by zero.
+  static_assert(kTapsPerPhase % 2 == 0, "odd prototype length");
+  const size_t length = kTapsPerPhase * factor;
+  // Cutoff halfway between the passband edge and the start of the
+  // stopband, in cycles per input sample: the output Nyquist frequency.
+  const double cutoff = 0.5 / static_cast<double>(factor);
+  const double middle = static_cast<double>(length - 1) / 2.0;
+  std::vector<double> prototype(length);
+  double sum = 0.0;
+  for (size_t n = 0; n < length; n++) {
+    const double t = static_cast<double>(n) - middle;
+    const double sinc = std::sin(2.0 * kPi * cutoff * t) / (kPi * t);
+    const double x = t / middle;
+    const double window =
+        BesselI0(kKaiserBeta * std::sqrt(std::max(1.0 - x * x, 0.0))) /
+        BesselI0(kKaiserBeta);
+    prototype[n] = sinc * window;
+    sum += prototype[n];
+  }
+  taps_.assign(length, 0.0f);
+  for (size_t p = 0; p < factor; p++) {
+    for (size_t k = 0; k < kTapsPerPhase; k++) {
+      taps_[p * kTapsPerPhase + kTapsPerPhase - 1 - k] =
+          static_cast<float>(prototype[k * factor + p] / sum);
+    }
+  }
+  rows_.assign(factor * kRowSize, 0.0f);
+  Reset();
+  return true;
+}
+
+void PolyphaseDecimator::Reset() {
+  std::fill(rows_.begin(), rows_.end(), 0.0f);
+  fill_ = 0;
+  groups_ = 0;
+}
+
+size_t PolyphaseDecimator::Process(const float* input, size_t count,
+                                   float* output) {
+  if (factor_ == 1) {
+    std::copy(input, input + count, output);
+    return count;
+  }
+  size_t produced = 0;
+  size_t i = 0;
+  while (i < count) {
+    if (fill_ == 0 && count - i >= factor_) {
+      // Whole groups: deal each branch its samples in one strided pass.
+      const size_t groups =
+          std::min((count - i) / factor_, kBlock - groups_);
+      for (size_t p = 0; p < factor_; p++) {
+        float* row = &rows_[p * kRowSize + kTapsPerPhase - 1 + groups_];
+        const float* samples = input + i + factor_ - 1 - p;
+        for (size_t g = 0; g < groups; g++) row[g] = samples[g * factor_];
+      }
+      groups_ += groups;
+      i += groups * factor_;
+    } else {
+      const size_t branch = factor_ - 1 - fill_;
+      rows_[branch * kRowSize + kTapsPerPhase - 1 + groups_] = input[i++];
+      if (++fill_ < factor_) continue;
+      fill_ = 0;
+      groups_++;
+    }
+    if (groups_ == kBlock) {
+      Filter(output + produced);
+      produced += kBlock;
+    }
+  }
+  if (groups_ > 0) {
+    produced += groups_;
+    Filter(output + produced - groups_);
+  }
+  return produced;
+}
+
+// Computes the groups_ outputs of the block, then keeps the last
+// kTapsPerPhase - 1 samples of every row, and any part of the next group
+// already received, for the next block.
+void PolyphaseDecimator::Filter(float* output) {
+  // kLanes outputs at a time. The last pass may compute some outputs past
+  // groups_ from stale samples; they stay inside the rows and are dropped.
+  for (size_t m = 0; m < groups_; m += kLanes) {
+    float sums[kLanes] = {};
+    for (size_t p = 0; p < factor_; p++) {
+      kernels_->fir32(&rows_[p * kRowSize + m], &taps_[p * kTapsPerPhase],
+                      kTapsPerPhase, sums);
+    }
+    const size_t valid = std::min(kLanes, groups_ - m);
+    std::copy(sums, sums + valid, output + m);
+  }
+  const size_t keep = kTapsPerPhase - 1 + (fill_ > 0 ? 1 : 0);
+  for (size_t p = 0; p < factor_; p++) {
+    float* row = &rows_[p * kRowSize];
+    std::copy(row + groups_, row + groups_ + keep, row);
+  }
+  groups_ = 0;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
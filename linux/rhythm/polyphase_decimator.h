@@ -0,0 +1,87 @@
+#ifndef RHYTHM_POLYPHASE_DECIMATOR_H_
+#define RHYTHM_POLYPHASE_DECIMATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fft_kernels.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Anti-aliased downsampling by 2, 4 or 8.
+//
+// A Kaiser-windowed sinc low-pass of kTapsPerPhase * factor() taps, split
+// into factor() polyphase branches of kTapsPerPhase taps: input samples are
+// dealt round-robin to the branches, and each output is the sum of every
+// branch filtering its own stream, so only the samples that are kept are
+// ever computed. Outputs are computed 32 at a time by FftKernels::fir32,
+// one tap at a time across all of them, so the vector kernels agree exactly
+// with the scalar one.
+//
+// The passband reaches kPassband of the output Nyquist frequency; the
+// stopband starts where content would alias back into it, at 2 - kPassband,
+// and is attenuated by at least 74 dB. rhythm_bench measures both edges.
+//
+// Configure() allocates; Process() does not.
+class PolyphaseDecimator {
+ public:
+  static constexpr size_t kTapsPerPhase = 24;
+  static constexpr size_t kMaxFactor = 8;
+  static constexpr double kPassband = 0.8;
+
+  // 1, 2, 4 and 8 are valid; 1 passes samples through unchanged.
+  static bool IsValidFactor(size_t factor);
+
+  // Designs the filter for |factor| and clears all state. Returns false,
+  // keeping the current configuration, for an invalid factor.
+  bool Configure(size_t factor);
+
+  // Overrides the automatically selected kernels (benchmarking only).
+  void SetKernels(const FftKernels& kernels) { kernels_ = &kernels; }
+
+  void Reset();
+
+  // Filters |count| samples and writes one output per complete group of
+  // factor() inputs to |output|, which must have room for
+  // count / factor() + 1 samples. Returns the number written. Groups may
+  // span calls.
+  size_t Process(const float* input, size_t count, float* output);
+
+  size_t factor() const { return factor_; }
+  // How far the output lags the input, in input samples.
+  double delay() const {
+    return factor_ > 1
+               ? static_cast<double>(kTapsPerPhase * factor_ - 1) / 2.0
+               : 0.0;
+  }
+
+ private:
+  // Outputs buffered per pass, a multiple of the kLanes that
+  // FftKernels::fir32 computes at once.
+  static constexpr size_t kBlock = 64;
+  static constexpr size_t kLanes = 32;
+  // Each branch's row holds the kTapsPerPhase - 1 samples before the block,
+  // then the block's.
+  static constexpr size_t kRowSize = kTapsPerPhase - 1 + kBlock;
+
+  void Filter(float* output);
+
+  const FftKernels* kernels_ = &SelectFftKernels();
+  size_t factor_ = 1;
+  // Branch p's taps, oldest sample first: taps_[p * kTapsPerPhase + k] is
+  // tap (kTapsPerPhase - 1 - k) * factor_ + p of the prototype.
+  std::vector<float> taps_;
+  // Branch p receives the sample p places before the end of each group.
+  std::vector<float> rows_;
+  // Samples received of the current group, and groups completed in the
+  // block.
+  size_t fill_ = 0;
+  size_t groups_ = 0;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_POLYPHASE_DECIMATOR_H_
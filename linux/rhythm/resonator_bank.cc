@@ -0,0 +1,87 @@
+#include "resonator_bank.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Resonator states below this are flushed to zero between frames, so that
+// silence decays to exact zeros instead of denormals.
+const float kDenormalGuard = 1e-20f;
+
+}  // namespace
+
+void ResonatorBank::Configure(const BandMapper& mapper) {
+  const size_t bands = mapper.band_count();
+  const size_t padded = (bands + kLanes - 1) / kLanes * kLanes;
+  pole_re_.assign(padded, 0.0f);
+  pole_im_.assign(padded, 0.0f);
+  state_re_.assign(padded, 0.0f);
+  state_im_.assign(padded, 0.0f);
+  power_.assign(padded, 0.0f);
+  scale_.assign(padded, 0.0f);
+  magnitudes_.assign(bands, 0.0f);
+
+  const SpectrumGrid& grid = mapper.grid();
+  const double sample_rate = static_cast<double>(grid.sample_rate);
+  // Mean power of a Hann-windowed FFT bin of unit-variance white noise, and
+  // the mean magnitude of such (Rayleigh-distributed) bins relative to their
+  // RMS, which is what the FFT path's band averages converge to.
+  const double bin_power = 3.0 * static_cast<double>(grid.fft_size) / 8.0;
+  const double rayleigh_mean = std::sqrt(kPi) / 2.0;
+  for (size_t b = 0; b < bands; b++) {
+    // A complex one-pole resonator normalised to unit peak gain has an
+    // equivalent noise bandwidth of (1 - r) / (1 + r) of the sample rate.
+    const double width = std::clamp(
+        static_cast<double>(mapper.bandwidth(b)) / sample_rate, 1e-6, 0.5);
+    const double radius = (1.0 - width) / (1.0 + width);
+    const double omega =
+        2.0 * kPi * static_cast<double>(mapper.center_frequency(b)) /
+        sample_rate;
+    pole_re_[b] = static_cast<float>(radius * std::cos(omega));
+    pole_im_[b] = static_cast<float>(radius * std::sin(omega));
+    // Unit peak gain, then white noise at the FFT bins' level.
+    scale_[b] = static_cast<float>((1.0 - radius) * rayleigh_mean *
+                                   std::sqrt(bin_power / width));
+  }
+  samples_ = 0;
+}
+
+void ResonatorBank::Reset() {
+  std::fill(state_re_.begin(), state_re_.end(), 0.0f);
+  std::fill(state_im_.begin(), state_im_.end(), 0.0f);
+  std::fill(power_.begin(), power_.end(), 0.0f);
+  std::fill(magnitudes_.begin(), magnitudes_.end(), 0.0f);
+  samples_ = 0;
+}
+
+void ResonatorBank::PushSamples(const float* samples, size_t count) {
+  kernels_->resonate(samples, count, pole_re_.size(), pole_re_.data(),
+                     pole_im_.data(), state_re_.data(), state_im_.data(),
+                     power_.data());
+  samples_ += count;
+}
+
+void ResonatorBank::Update() {
+  if (samples_ == 0) return;
+  const float mean = 1.0f / static_cast<float>(samples_);
+  for (size_t b = 0; b < magnitudes_.size(); b++) {
+    magnitudes_[b] = scale_[b] * std::sqrt(power_[b] * mean);
+  }
+  for (size_t b = 0; b < power_.size(); b++) {
+    power_[b] = 0.0f;
+    if (std::fabs(state_re_[b]) + std::fabs(state_im_[b]) < kDenormalGuard) {
+      state_re_[b] = 0.0f;
+      state_im_[b] = 0.0f;
+    }
+  }
+  samples_ = 0;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
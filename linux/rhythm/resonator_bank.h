@@ -0,0 +1,75 @@
+#ifndef RHYTHM_RESONATOR_BANK_H_
+#define RHYTHM_RESONATOR_BANK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "band_mapper.h"
+#include "fft_kernels.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// One complex resonator per band, updated every sample.
+//
+// Each resonator is a sliding Goertzel filter with an exponential instead of
+// a rectangular window: y[n] = x[n] + r e^(jw) y[n-1], tuned to the band's
+// centre, with the pole radius r chosen so that its equivalent noise
+// bandwidth equals the band's BandMapper::bandwidth(). The power of y is
+// averaged between Update() calls. Band magnitudes are scaled so that white
+// noise gives the same values as the FFT path's weighted averages at the
+// mapper's FFT size, so band levels match when the engine switches between
+// the two.
+//
+// A sample costs a few multiply-adds per band, with no window, history or
+// bins, so for a handful of bands this is much cheaper than an FFT that
+// throws most of its bins away. Where the crossover lies depends on the
+// build and the CPU, so the engine times both (see
+// RhythmAnalyzer::MeasureFrameNs()) rather than predicting it.
+//
+// Configure() allocates; PushSamples() and Update() do not.
+class ResonatorBank {
+ public:
+  // Tunes one resonator to each band of |mapper|, which must be configured
+  // on a linear grid, and clears all state.
+  void Configure(const BandMapper& mapper);
+
+  // Overrides the automatically selected kernels (benchmarking only).
+  void SetKernels(const FftKernels& kernels) { kernels_ = &kernels; }
+
+  void Reset();
+
+  void PushSamples(const float* samples, size_t count);
+
+  // Turns the power gathered since the previous call into magnitudes();
+  // keeps the previous values if no samples arrived.
+  void Update();
+
+  // One weighted-average-like magnitude per band.
+  const float* magnitudes() const { return magnitudes_.data(); }
+  size_t band_count() const { return magnitudes_.size(); }
+
+ private:
+  // Resonators are padded to a multiple of this many, as
+  // FftKernels::resonate requires.
+  static constexpr size_t kLanes = 8;
+
+  const FftKernels* kernels_ = &SelectFftKernels();
+
+  // Per-resonator state and coefficients, padded to a multiple of kLanes;
+  // the padding resonators have zero coefficients and stay silent.
+  std::vector<float> pole_re_;
+  std::vector<float> pole_im_;
+  std::vector<float> state_re_;
+  std::vector<float> state_im_;
+  std::vector<float> power_;
+  std::vector<float> scale_;
+  size_t samples_ = 0;
+  std::vector<float> magnitudes_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_RESONATOR_BANK_H_
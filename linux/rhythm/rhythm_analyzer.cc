@@ -0,0 +1,381 @@
+#include "rhythm_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const char* const kModeNames[] = {"fft", "multires", "filterbank"};
+
+// Highest bin of an |fft_size|-point grid inside the passband of a decimator
+// by |factor|.
+size_t PassbandBin(size_t fft_size, size_t factor) {
+  return static_cast<size_t>(PolyphaseDecimator::kPassband *
+                             static_cast<double>(fft_size) /
+                             static_cast<double>(2 * factor));
+}
+
+// Appends to a mirrored ring of ring->size() / 2 samples, a power of two.
+void AppendMirrored(const float* samples, size_t count,
+                    std::vector<float>* ring, size_t* write_pos) {
+  const size_t size = ring->size() / 2;
+  while (count > 0) {
+    const size_t take = std::min(count, size - *write_pos);
+    float* slot = ring->data() + *write_pos;
+    std::copy(samples, samples + take, slot);
+    std::copy(samples, samples + take, slot + size);
+    *write_pos = (*write_pos + take) & (size - 1);
+    samples += take;
+    count -= take;
+  }
+}
+
+}  // namespace
+
+const char* AnalysisModeName(AnalysisMode mode) {
+  return kModeNames[static_cast<size_t>(mode)];
+}
+
+bool ParseAnalysisMode(const char* name, AnalysisMode* mode) {
+  for (size_t i = 0; i < sizeof(kModeNames) / sizeof(kModeNames[0]); i++) {
+    if (std::strcmp(name, kModeNames[i]) == 0) {
+      *mode = static_cast<AnalysisMode>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+RhythmAnalyzer::RhythmAnalyzer(size_t fft_size, size_t hop_size) {
+  if (!Configure(fft_size, hop_size)) Configure(kDefaultFftSize, 0);
+  SetBandLayout(BandLayout(), kDefaultSampleRate);
+}
+
+bool RhythmAnalyzer::IsValidConfig(size_t fft_size, size_t hop_size) {
+  return RealFftPlan::IsValidSize(fft_size) && hop_size <= fft_size;
+}
+
+bool RhythmAnalyzer::Configure(size_t fft_size, size_t hop_size) {
+  if (!IsValidConfig(fft_size, hop_size)) return false;
+  plan_.Reset(fft_size);
+  hop_size_ = hop_size ? hop_size : fft_size / 2;
+  history_.assign(2 * fft_size, 0.0f);
+  if (mapper_.band_count() > 0) Plan(mapper_.layout(), mapper_.sample_rate());
+  Reset();
+  return true;
+}
+
+void RhythmAnalyzer::SetMode(AnalysisMode mode) {
+  if (mode == mode_) return;
+  mode_ = mode;
+  if (mapper_.band_count() > 0) Plan(mapper_.layout(), mapper_.sample_rate());
+  Reset();
+}
+
+bool RhythmAnalyzer::SetDecimation(const Decimation& decimation) {
+  if (decimation.factor != 0 &&
+      !PolyphaseDecimator::IsValidFactor(decimation.factor)) {
+    return false;
+  }
+  if (decimation == decimation_) return true;
+  decimation_ = decimation;
+  if (mapper_.band_count() > 0) Plan(mapper_.layout(), mapper_.sample_rate());
+  return true;
+}
+
+size_t RhythmAnalyzer::DecimationFactor(const Decimation& decimation,
+                                        size_t fft_size, size_t hop_size,
+                                        uint32_t sample_rate) {
+  if (hop_size == 0) hop_size = fft_size / 2;
+  size_t factor = decimation.factor == 0 ? PolyphaseDecimator::kMaxFactor
+                                         : decimation.factor;
+  for (; factor > 1; factor /= 2) {
+    if (hop_size % factor != 0 ||
+        fft_size / factor < RealFftPlan::kMinSize) {
+      continue;
+    }
+    const double passband = PolyphaseDecimator::kPassband *
+                            static_cast<double>(sample_rate) /
+                            static_cast<double>(2 * factor);
+    if (decimation.factor == 0 && passband < kAutoDecimationHz) continue;
+    break;
+  }
+  return factor;
+}
+
+SpectrumGrid RhythmAnalyzer::GridFor(AnalysisMode mode, size_t fft_size,
+                                     uint32_t sample_rate,
+                                     const Decimation& decimation,
+                                     size_t hop_size) {
+  if (mode == AnalysisMode::kMultiResolution) {
+    return MultiResolutionSpectrum::GridFor(sample_rate);
+  }
+  SpectrumGrid grid = SpectrumGrid::Linear(fft_size, sample_rate);
+  if (mode == AnalysisMode::kFft && !decimation.treble) {
+    const size_t factor =
+        DecimationFactor(decimation, fft_size, hop_size, sample_rate);
+    if (factor > 1) {
+      grid.bin_count = static_cast<uint32_t>(PassbandBin(fft_size, factor) + 1);
+    }
+  }
+  return grid;
+}
+
+double RhythmAnalyzer::MeasureFrameNs(AnalysisMode mode, size_t fft_size,
+                                      size_t hop_size,
+                                      const Decimation& decimation,
+                                      const BandLayout& layout,
+                                      uint32_t sample_rate,
+                                      const FftKernels& kernels) {
+  constexpr int kRuns = 3;
+  constexpr size_t kFramesPerRun = 8;
+  RhythmAnalyzer analyzer(fft_size, hop_size);
+  analyzer.SetKernels(kernels);
+  analyzer.SetDecimation(decimation);
+  analyzer.SetBandLayout(layout, sample_rate);
+  analyzer.SetMode(mode);
+
+  // Enough noise to fill the window and then run every timed frame.
+  const size_t hop = analyzer.hop_size();
+  std::vector<float> noise(fft_size + kRuns * kFramesPerRun * hop);
+  uint32_t seed = 1;
+  for (float& sample : noise) {
+    seed = seed * 1664525u + 1013904223u;
+    sample = static_cast<float>(seed >> 8) / 16777216.0f - 0.5f;
+  }
+  analyzer.PushSamples(noise.data(), fft_size);
+
+  double best = 0.0;
+  const float* samples = noise.data() + fft_size;
+  for (int run = 0; run < kRuns; run++) {
+    const int64_t start = SteadyClockNowNs();
+    size_t frames = 0;
+    for (size_t i = 0; i < kFramesPerRun; i++, samples += hop) {
+      frames += analyzer.PushSamples(samples, hop);
+    }
+    const double ns = static_cast<double>(SteadyClockNowNs() - start) /
+                      static_cast<double>(std::max<size_t>(frames, 1));
+    if (run == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+bool RhythmAnalyzer::SetBandLayout(const BandLayout& layout,
+                                   uint32_t sample_rate) {
+  if (!BandMapper::IsValidLayout(layout) || sample_rate == 0) return false;
+  Plan(layout, sample_rate);
+  return true;
+}
+
+// Rebuilds the band weights and whatever the current mode analyses with for
+// |layout| at |sample_rate|. The multi-resolution spectrum and the resonator
+// bank start over when they are rebuilt, and everything does when the
+// decimation changes.
+void RhythmAnalyzer::Plan(const BandLayout& layout, uint32_t sample_rate) {
+  if (mode_ == AnalysisMode::kMultiResolution &&
+      (sample_rate != multi_resolution_.sample_rate() ||
+       hop_size_ != multi_resolution_.hop_size())) {
+    multi_resolution_.Configure(sample_rate, hop_size_);
+  }
+  const size_t factor =
+      mode_ == AnalysisMode::kFft
+          ? DecimationFactor(decimation_, plan_.size(), hop_size_,
+                             sample_rate)
+          : 1;
+  mapper_.Configure(layout, GridFor(mode_, plan_.size(), sample_rate,
+                                    decimation_, hop_size_));
+  if (mode_ == AnalysisMode::kFilterBank) resonators_.Configure(mapper_);
+  bands_.assign(layout.band_count, 0.0f);
+  const bool treble = factor > 1 && decimation_.treble;
+  if (factor != decimator_.factor() ||
+      treble != !treble_history_.empty() ||
+      spectrum_.size() != (factor > 1 ? mapper_.grid().bin_count : 0) ||
+      (factor > 1 && decimated_plan_.size() != plan_.size() / factor)) {
+    PlanDecimation(factor, treble);
+    Reset();
+  }
+}
+
+void RhythmAnalyzer::PlanDecimation(size_t factor, bool treble) {
+  decimator_.Configure(factor);
+  if (factor == 1) {
+    decimated_history_.clear();
+    treble_history_.clear();
+    spectrum_.clear();
+    return;
+  }
+  const size_t size = plan_.size() / factor;
+  decimated_plan_.Reset(size);
+  decimated_history_.assign(2 * size, 0.0f);
+  treble_history_.assign(treble ? 2 * size : 0, 0.0f);
+  spectrum_.assign(mapper_.grid().bin_count, 0.0f);
+}
+
+size_t RhythmAnalyzer::PushSamples(const float* mono, size_t count) {
+  const size_t fft_size = plan_.size();
+  // Outside FFT mode the factor is always 1.
+  const bool decimating = decimator_.factor() > 1;
+  const bool full_rate = mode_ == AnalysisMode::kFft && !decimating;
+  size_t analysed = 0;
+  while (count > 0) {
+    const size_t room = full_rate    ? fft_size - write_pos_
+                        : decimating ? kDecimationBlock
+                                     : count;
+    const size_t take = std::min({count, until_next_frame_, room});
+    if (full_rate) {
+      const auto pos = static_cast<std::ptrdiff_t>(write_pos_);
+      std::copy(mono, mono + take, history_.begin() + pos);
+      std::copy(mono, mono + take,
+                history_.begin() + pos +
+                    static_cast<std::ptrdiff_t>(fft_size));
+      write_pos_ = (write_pos_ + take) & (fft_size - 1);
+    } else {
+      const int64_t start = stats_ ? stats_->Now() : 0;
+      if (mode_ == AnalysisMode::kMultiResolution) {
+        multi_resolution_.PushSamples(mono, take);
+      } else if (mode_ == AnalysisMode::kFilterBank) {
+        resonators_.PushSamples(mono, take);
+      } else {
+        PushDecimated(mono, take);
+      }
+      if (start) transform_ns_ += SteadyClockNowNs() - start;
+    }
+    samples_pushed_ += take;
+    until_next_frame_ -= take;
+    mono += take;
+    count -= take;
+    if (until_next_frame_ == 0) {
+      if (full_rate) {
+        AnalyzeBlock(&history_[write_pos_]);
+      } else {
+        AnalyzeStreamed();
+      }
+      until_next_frame_ = hop_size_;
+      analysed++;
+    }
+  }
+  return analysed;
+}
+
+void RhythmAnalyzer::PushDecimated(const float* mono, size_t count) {
+  const size_t produced = decimator_.Process(mono, count, decimated_);
+  AppendMirrored(decimated_, produced, &decimated_history_, &decimated_pos_);
+  if (!treble_history_.empty()) {
+    AppendMirrored(mono, count, &treble_history_, &treble_pos_);
+  }
+}
+
+// Transforms the decimated history into the passband of spectrum_, and the
+// full-rate one, if kept, into the rest.
+const float* RhythmAnalyzer::TransformDecimated() {
+  // A D-times shorter transform of the same window duration: magnitudes
+  // are D times smaller for both tones and, since the decimator keeps only
+  // 1 / D of the noise power, for noise too.
+  const float factor = static_cast<float>(decimator_.factor());
+  const size_t passband = PassbandBin(plan_.size(), decimator_.factor());
+  decimated_plan_.TransformWindowed(&decimated_history_[decimated_pos_]);
+  const float* low = decimated_plan_.magnitudes();
+  for (size_t k = 0; k <= passband; k++) spectrum_[k] = factor * low[k];
+  if (treble_history_.empty()) return spectrum_.data();
+
+  // The full-rate treble keeps all its noise, so its bins, each D fine bins
+  // wide, are scaled to match noise, which dominates up there.
+  decimated_plan_.TransformWindowed(&treble_history_[treble_pos_]);
+  const float* high = decimated_plan_.magnitudes();
+  const float gain = std::sqrt(factor);
+  const size_t last = decimated_plan_.bin_count() - 1;
+  for (size_t k = passband + 1; k < spectrum_.size(); k++) {
+    const float position = static_cast<float>(k) / factor;
+    const size_t below = std::min(static_cast<size_t>(position), last - 1);
+    const float fraction = position - static_cast<float>(below);
+    spectrum_[k] =
+        gain * (high[below] + fraction * (high[below + 1] - high[below]));
+  }
+  return spectrum_.data();
+}
+
+// Completes a frame of the modes that analyse as the samples arrive. Their
+// time since the previous frame is added to the final step's.
+void RhythmAnalyzer::AnalyzeStreamed() {
+  int64_t start = stats_ ? stats_->Now() : 0;
+  const float* magnitudes;
+  if (mode_ == AnalysisMode::kMultiResolution) {
+    multi_resolution_.Update();
+    magnitudes = multi_resolution_.magnitudes();
+  } else if (mode_ == AnalysisMode::kFilterBank) {
+    resonators_.Update();
+    magnitudes = resonators_.magnitudes();
+  } else {
+    magnitudes = TransformDecimated();
+  }
+  if (start) {
+    const int64_t now_ns = SteadyClockNowNs();
+    stats_->fft().Record(transform_ns_ + now_ns - start);
+    start = now_ns;
+  }
+  transform_ns_ = 0;
+
+  if (mode_ == AnalysisMode::kFilterBank) {
+    // One resonator per band: the magnitudes already are the bands.
+    for (size_t b = 0; b < bands_.size(); b++) {
+      bands_[b] = magnitudes[b] * kLevelScale;
+    }
+    if (stats_) stats_->band_mapping().RecordSince(start);
+    return;
+  }
+  MapBands(magnitudes, start);
+}
+
+void RhythmAnalyzer::AnalyzeBlock(const float* block) {
+  int64_t start = stats_ ? stats_->Now() : 0;
+  plan_.TransformWindowed(block);
+  if (stats_) start = stats_->fft().RecordSince(start);
+#if RHYTHM_FIXED_POINT
+  // Integer band mapping straight from the fixed-point magnitudes.
+  mapper_.ApplyFixed<AnalysisFftPlan::Format>(
+      plan_.fixed_magnitudes(), plan_.magnitude_scale(), bands_.data());
+  ScaleBands(start);
+#else
+  MapBands(plan_.magnitudes(), start);
+#endif
+}
+
+void RhythmAnalyzer::MapBands(const float* magnitudes, int64_t start_ns) {
+  // Group into bands
+  mapper_.Apply(magnitudes, bands_.data());
+  ScaleBands(start_ns);
+}
+
+void RhythmAnalyzer::ScaleBands(int64_t start_ns) {
+  for (float& band : bands_) {
+    // Normalization (Roughly)
+    band *= kLevelScale;
+  }
+  if (stats_) stats_->band_mapping().RecordSince(start_ns);
+}
+
+void RhythmAnalyzer::ClearBands() {
+  std::fill(bands_.begin(), bands_.end(), 0.0f);
+}
+
+void RhythmAnalyzer::Reset() {
+  std::fill(history_.begin(), history_.end(), 0.0f);
+  write_pos_ = 0;
+  multi_resolution_.Reset();
+  resonators_.Reset();
+  decimator_.Reset();
+  std::fill(decimated_history_.begin(), decimated_history_.end(), 0.0f);
+  decimated_pos_ = 0;
+  std::fill(treble_history_.begin(), treble_history_.end(), 0.0f);
+  treble_pos_ = 0;
+  until_next_frame_ = window_size();
+  samples_pushed_ = 0;
+  ClearBands();
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,281 @@
+#ifndef RHYTHM_RHYTHM_ANALYZER_H_
+#define RHYTHM_RHYTHM_ANALYZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "band_mapper.h"
+#include "fft_plan.h"
+#include "fixed_fft_plan.h"
+#include "multi_resolution.h"
+#include "polyphase_decimator.h"
+#include "resonator_bank.h"
+#include "rhythm_stats.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// The FFT mode's plan: float, or fixed point in RHYTHM_FIXED_POINT builds
+// for targets without a fast FPU. The other modes always use float.
+#if RHYTHM_FIXED_POINT == 15
+using AnalysisFftPlan = FixedRealFftPlan<Q15>;
+#elif RHYTHM_FIXED_POINT == 31
+using AnalysisFftPlan = FixedRealFftPlan<Q31>;
+#elif RHYTHM_FIXED_POINT == 0
+using AnalysisFftPlan = RealFftPlan;
+#else
+#error "RHYTHM_FIXED_POINT must be 0, 15 or 31"
+#endif
+
+// How the analyser turns samples into a spectrum.
+enum class AnalysisMode : uint8_t {
+  // One fft_size()-point FFT per frame: linear bins, one window length.
+  kFft = 0,
+  // A MultiResolutionSpectrum: log-spaced bins with windows that lengthen
+  // towards the bass, for finer low-end resolution at the same hop.
+  kMultiResolution = 1,
+  // A ResonatorBank: one resonator per band updated every sample, with no
+  // spectrum in between; cheaper than an FFT for a few bands.
+  kFilterBank = 2,
+};
+
+// Returns the lower-case name ("fft", "multires", "filterbank").
+const char* AnalysisModeName(AnalysisMode mode);
+// Parses a name produced by AnalysisModeName(). Returns false if unknown.
+bool ParseAnalysisMode(const char* name, AnalysisMode* mode);
+
+// Downsampling of the FFT mode's input; see RhythmAnalyzer::SetDecimation().
+struct Decimation {
+  // 1 (none), 2, 4 or 8, or 0 for the largest factor that keeps
+  // RhythmAnalyzer::kAutoDecimationHz.
+  uint32_t factor = 1;
+  // Whether the bins above the decimated passband come from a full-rate FFT
+  // of the reduced size instead of being left out.
+  bool treble = false;
+
+  bool operator==(const Decimation& other) const {
+    return factor == other.factor && treble == other.treble;
+  }
+  bool operator!=(const Decimation& other) const { return !(*this == other); }
+};
+
+// Platform-neutral spectrum analyser behind the rhythm visualizer.
+//
+// Mono samples go into a circular history of fft_size() samples. Every
+// hop_size() samples the latest fft_size() samples are Hann-windowed,
+// transformed and grouped into band levels by a BandMapper, so
+// a hop of half or a quarter of the FFT size gives 50% or 75% overlap between
+// frames. The capture backends and the WAV-replay benchmark both feed audio
+// through this class. After construction (or Configure(), SetMode() or
+// SetBandLayout()) analysis does not allocate.
+//
+// With a Decimation the FFT mode filters and downsamples the samples by its
+// factor D into a history of fft_size() / D samples and transforms that
+// instead: the same window length in time and the same bin spacing, for a
+// D-times smaller FFT, but only up to the decimator's passband. The bins
+// above come either from a full-rate FFT of fft_size() / D samples, with D
+// times coarser bins interpolated onto the same grid, or are left out, in
+// which case grid() ends at the passband and the bands spread below it.
+//
+// In AnalysisMode::kMultiResolution the samples go to a
+// MultiResolutionSpectrum instead and every hop_size() samples its bins are
+// grouped into bands; fft_size() is then only remembered for switching back
+// and for the default hop. In AnalysisMode::kFilterBank they go to a
+// ResonatorBank tuned to the band layout, whose outputs are the bands and
+// also stand in for the magnitudes; band_mapper() keeps the FFT grid and
+// only supplies the band centres and widths.
+class RhythmAnalyzer {
+ public:
+  static constexpr size_t kDefaultFftSize = 1024;
+  static constexpr uint32_t kDefaultSampleRate = 48000;
+  // Applied to the weighted average magnitudes so that typical music gives
+  // band levels roughly in [0, 1].
+  static constexpr float kLevelScale = 10.0f;
+  // Decimation::factor 0 keeps at least this much of the spectrum.
+  static constexpr double kAutoDecimationHz = 4000.0;
+
+  // A |hop_size| of 0 selects 50% overlap.
+  explicit RhythmAnalyzer(size_t fft_size = kDefaultFftSize,
+                          size_t hop_size = 0);
+
+  // Re-plans for |fft_size| and |hop_size| (0 selects fft_size / 2) and drops
+  // the history. Returns false and keeps the current configuration when
+  // IsValidConfig() rejects the pair.
+  bool Configure(size_t fft_size, size_t hop_size);
+
+  // |fft_size| must be a valid RealFftPlan size; |hop_size| must be 0 or in
+  // [1, fft_size].
+  static bool IsValidConfig(size_t fft_size, size_t hop_size);
+
+  size_t fft_size() const { return plan_.size(); }
+  size_t hop_size() const { return hop_size_; }
+
+  // Switches the analysis mode, keeping the band layout, and drops the
+  // history.
+  void SetMode(AnalysisMode mode);
+  AnalysisMode mode() const { return mode_; }
+
+  // Length of the window behind the newest part of the spectrum: fft_size(),
+  // MultiResolutionSpectrum::kWindowSize, or for the resonators, whose
+  // memory is exponential, one hop.
+  size_t window_size() const {
+    switch (mode_) {
+      case AnalysisMode::kMultiResolution:
+        return MultiResolutionSpectrum::kWindowSize;
+      case AnalysisMode::kFilterBank:
+        return hop_size_;
+      case AnalysisMode::kFft:
+        break;
+    }
+    return plan_.size();
+  }
+
+  // Decimates the FFT mode's input as described above, dropping the history
+  // if that changes the factor in use. Returns false and keeps the current
+  // setting for an invalid factor.
+  bool SetDecimation(const Decimation& decimation);
+  const Decimation& decimation() const { return decimation_; }
+  // The factor in use: 1 outside FFT mode.
+  size_t decimation_factor() const { return decimator_.factor(); }
+
+  // The factor |decimation| gives in FFT mode: the requested one, or for 0
+  // the largest whose passband still reaches kAutoDecimationHz, lowered
+  // until it divides the hop and leaves at least a RealFftPlan::kMinSize
+  // -point FFT. A |hop_size| of 0 means fft_size / 2.
+  static size_t DecimationFactor(const Decimation& decimation,
+                                 size_t fft_size, size_t hop_size,
+                                 uint32_t sample_rate);
+
+  // Bins that |mode| produces at |fft_size| and |sample_rate|, with
+  // |decimation| and |hop_size| (0 for fft_size / 2) in FFT mode.
+  static SpectrumGrid GridFor(AnalysisMode mode, size_t fft_size,
+                              uint32_t sample_rate,
+                              const Decimation& decimation = Decimation(),
+                              size_t hop_size = 0);
+
+  // Best time per frame, in ns, to analyse |layout| at |sample_rate| in
+  // |mode| with these settings and |kernels|, over a few short runs on
+  // noise. Builds an analyser of its own, so it allocates and takes a
+  // fraction of a millisecond: it is for choosing between modes when the
+  // configuration changes, not for every frame.
+  static double MeasureFrameNs(AnalysisMode mode, size_t fft_size,
+                               size_t hop_size, const Decimation& decimation,
+                               const BandLayout& layout, uint32_t sample_rate,
+                               const FftKernels& kernels);
+
+  // Rebuilds the band weights for |layout| at |sample_rate| and clears the
+  // bands. Returns false and keeps the current layout when
+  // BandMapper::IsValidLayout() rejects it or |sample_rate| is 0.
+  bool SetBandLayout(const BandLayout& layout, uint32_t sample_rate);
+
+  const BandLayout& band_layout() const { return mapper_.layout(); }
+  uint32_t sample_rate() const { return mapper_.sample_rate(); }
+  const BandMapper& band_mapper() const { return mapper_; }
+  const SpectrumGrid& grid() const { return mapper_.grid(); }
+
+  // Times the FFT and band mapping of every frame into |stats|, which must
+  // outlive the analyser; null stops timing.
+  void SetStats(RhythmStats* stats) { stats_ = stats; }
+
+  // Overrides the automatically selected FFT kernels (benchmarking only).
+  void SetKernels(const FftKernels& kernels) {
+    plan_.SetKernels(kernels);
+    multi_resolution_.SetKernels(kernels);
+    resonators_.SetKernels(kernels);
+    decimator_.SetKernels(kernels);
+    decimated_plan_.SetKernels(kernels);
+  }
+  const FftKernels& kernels() const { return plan_.kernels(); }
+
+  // Appends mono samples and analyses a frame every hop_size() samples once
+  // the history holds a full window. Returns the number of frames analysed.
+  size_t PushSamples(const float* mono, size_t count);
+
+  // Number of samples PushSamples() still needs before the next analysis.
+  size_t samples_until_next_frame() const { return until_next_frame_; }
+
+  // Total samples pushed since the last Configure()/Reset(). After a frame
+  // has been analysed this is the stream position just past its window.
+  uint64_t samples_pushed() const { return samples_pushed_; }
+
+  // Analyses exactly fft_size() contiguous mono samples and updates bands().
+  // FFT mode without decimation only.
+  void AnalyzeBlock(const float* block);
+
+  // Resets the band output to silence without touching the history.
+  void ClearBands();
+
+  // Drops the history and clears the bands.
+  void Reset();
+
+  // Raw band levels, scaled so that typical music sits roughly in [0, 1] but
+  // not clamped; gain, clamping and smoothing are left to BandDynamics.
+  const std::vector<float>& bands() const { return bands_; }
+
+  // Magnitudes of the latest analysed frame: on grid() (DC through Nyquist
+  // or the decimated passband in FFT mode, log-spaced in multi-resolution
+  // mode), or one per band in filter-bank mode.
+  const float* magnitudes() const {
+    switch (mode_) {
+      case AnalysisMode::kMultiResolution:
+        return multi_resolution_.magnitudes();
+      case AnalysisMode::kFilterBank:
+        return resonators_.magnitudes();
+      case AnalysisMode::kFft:
+        break;
+    }
+    return decimator_.factor() > 1 ? spectrum_.data() : plan_.magnitudes();
+  }
+  size_t bin_count() const {
+    return mode_ == AnalysisMode::kFilterBank ? resonators_.band_count()
+                                              : mapper_.grid().bin_count;
+  }
+
+ private:
+  // Input samples decimated per step.
+  static constexpr size_t kDecimationBlock = 256;
+
+  void Plan(const BandLayout& layout, uint32_t sample_rate);
+  void PlanDecimation(size_t factor, bool treble);
+  void PushDecimated(const float* mono, size_t count);
+  const float* TransformDecimated();
+  void AnalyzeStreamed();
+  void MapBands(const float* magnitudes, int64_t start_ns);
+  void ScaleBands(int64_t start_ns);
+
+  AnalysisMode mode_ = AnalysisMode::kFft;
+  AnalysisFftPlan plan_;
+  MultiResolutionSpectrum multi_resolution_;
+  ResonatorBank resonators_;
+  BandMapper mapper_;
+  size_t hop_size_ = 0;
+  // Mirrored ring: sample i is stored at i and i + fft_size(), so the latest
+  // window is always contiguous at history_[write_pos_].
+  std::vector<float> history_;
+  size_t write_pos_ = 0;
+  size_t until_next_frame_ = 0;
+  uint64_t samples_pushed_ = 0;
+  std::vector<float> bands_;
+  // FFT mode with decimation: mirrored rings of the decimated input and, for
+  // the treble, of the full-rate input, both decimated_plan_.size() long;
+  // and the combined spectrum on grid().
+  Decimation decimation_;
+  PolyphaseDecimator decimator_;
+  AnalysisFftPlan decimated_plan_{AnalysisFftPlan::kMinSize};
+  std::vector<float> decimated_history_;
+  size_t decimated_pos_ = 0;
+  std::vector<float> treble_history_;
+  size_t treble_pos_ = 0;
+  std::vector<float> spectrum_;
+  float decimated_[kDecimationBlock] = {};
+  RhythmStats* stats_ = nullptr;
+  // Time spent analysing streamed samples since the last frame, while
+  // statistics are enabled.
+  int64_t transform_ns_ = 0;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_RHYTHM_ANALYZER_H_
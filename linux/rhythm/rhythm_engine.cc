@@ -0,0 +1,721 @@
+#include "rhythm_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+// Samples moved from the ring per read; at most one frame is completed per
+// read so that every analysed frame reaches the callback.
+const size_t kReadChunk = 2048;
+
+// Capture packets whose timestamps may be queued at once. Only the newest
+// one matters, so overrunning this ring is harmless.
+const size_t kAnchorCapacity = 64;
+
+// Beats waiting for the consumer; a few seconds' worth at any tempo.
+const size_t kBeatCapacity = 64;
+// Percussive onsets waiting for the consumer; a second's worth or more.
+const size_t kOnsetCapacity = 64;
+
+// Packets whose samples all stay below this level (about -100 dBFS) count
+// as silence.
+const float kSilenceLevel = 1e-5f;
+
+// Source of the zeros queued for silent packets before the timeout.
+const size_t kZeroChunk = 512;
+const float kZeros[kZeroChunk] = {};
+
+bool IsSilent(const float* mono, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (std::fabs(mono[i]) > kSilenceLevel) return false;
+  }
+  return true;
+}
+
+size_t WriteZeros(SpscRing<float>* ring, size_t count) {
+  size_t written = 0;
+  for (size_t done = 0; done < count; done += kZeroChunk) {
+    written += ring->Write(kZeros, std::min(count - done, kZeroChunk));
+  }
+  return written;
+}
+
+// The stereo and percussive bands take the main frame's gain instead of
+// finding their own, so they stay comparable with it and with each other.
+DynamicsConfig FollowingDynamics(DynamicsConfig config) {
+  config.auto_gain = false;
+  return config;
+}
+
+uint64_t PackConfig(size_t fft_size, size_t hop_size) {
+  return (static_cast<uint64_t>(fft_size) << 32) |
+         static_cast<uint64_t>(hop_size);
+}
+
+uint32_t PackLayout(const BandLayout& layout) {
+  return (static_cast<uint32_t>(layout.scale) << 16) | layout.band_count;
+}
+
+BandLayout UnpackLayout(uint32_t packed) {
+  BandLayout layout;
+  layout.scale = static_cast<BandScale>(packed >> 16);
+  layout.band_count = packed & 0xFFFFu;
+  return layout;
+}
+
+uint32_t PackDecimation(const Decimation& decimation) {
+  return (static_cast<uint32_t>(decimation.treble) << 16) | decimation.factor;
+}
+
+Decimation UnpackDecimation(uint32_t packed) {
+  Decimation decimation;
+  decimation.treble = (packed >> 16) != 0;
+  decimation.factor = packed & 0xFFFFu;
+  return decimation;
+}
+
+static_assert(RhythmFrame::kMaxBands == BandMapper::kMaxBands,
+              "RhythmFrame must hold the largest band layout");
+
+}  // namespace
+
+int64_t SteadyClockNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+RhythmEngine::RhythmEngine(size_t ring_capacity)
+    : ring_(ring_capacity),
+      side_ring_(ring_capacity),
+      anchors_(kAnchorCapacity),
+      scratch_(kReadChunk),
+      side_scratch_(kReadChunk),
+      left_scratch_(kReadChunk),
+      right_scratch_(kReadChunk),
+      beats_(kBeatCapacity),
+      percussive_onsets_(kOnsetCapacity),
+      requested_config_(PackConfig(RhythmAnalyzer::kDefaultFftSize, 0)),
+      requested_layout_(PackLayout(BandLayout())),
+      requested_decimation_(PackDecimation(Decimation())) {
+  analyzer_.SetStats(&stats_);
+  for (BandDynamics& dynamics : stereo_dynamics_) {
+    dynamics.SetConfig(FollowingDynamics(DynamicsConfig()));
+  }
+  percussive_dynamics_.SetConfig(FollowingDynamics(DynamicsConfig()));
+}
+
+RhythmEngine::~RhythmEngine() { Stop(); }
+
+void RhythmEngine::SetFrameCallback(FrameCallback callback) {
+  frame_callback_ = std::move(callback);
+}
+
+void RhythmEngine::Start() {
+  if (running_) return;
+  // Neither the producer nor the consumer is active yet.
+  ring_.Clear();
+  side_ring_.Clear();
+  anchors_.Clear();
+  analyzer_.Reset();
+  produced_ = 0;
+  silent_run_ = 0;
+  suspended_ = false;
+  suspend_pending_ = false;
+  consumed_ = 0;
+  anchor_ = TimeAnchor();
+  dynamics_.Reset();
+  beat_tracker_.Reset();
+  beats_.Clear();
+  tempo_.Store(TempoEstimate());
+  loudness_meter_.Reset();
+  loudness_active_ = false;
+  loudness_reset_ = false;
+  loudness_.Store(LoudnessReading());
+  for (SubscriberSlot& slot : subscribers_) slot.subscriber.Reset();
+  frame_ = RhythmFrame();
+  latest_frame_.Store(frame_);
+  stereo_analyzer_.Reset();
+  for (BandDynamics& dynamics : stereo_dynamics_) dynamics.Reset();
+  stereo_frame_ = StereoFrame();
+  latest_stereo_frame_.Store(stereo_frame_);
+  features_.Reset();
+  latest_features_.Store(SpectralFeatures());
+  chroma_tracker_.Reset();
+  chroma_.Store(ChromaReading());
+  percussive_.Reset();
+  percussive_dynamics_.Reset();
+  percussive_onsets_.Clear();
+  percussive_frame_ = RhythmFrame();
+  latest_percussive_frame_.Store(percussive_frame_);
+  running_ = true;
+  worker_ = std::thread(&RhythmEngine::WorkerLoop, this);
+}
+
+void RhythmEngine::Stop() {
+  if (!running_.exchange(false)) return;
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_cv_.notify_one();
+  }
+  if (worker_.joinable()) worker_.join();
+}
+
+void RhythmEngine::SetSampleRate(uint32_t sample_rate) {
+  if (sample_rate > 0) sample_rate_ = sample_rate;
+}
+
+void RhythmEngine::PushSamples(const float* mono, size_t count,
+                               int64_t capture_time_ns) {
+  stats_.CountPacket();
+  if (IsSilent(mono, count)) {
+    QueueSilence(count, capture_time_ns);
+    return;
+  }
+  silent_run_ = 0;
+  suspended_ = false;
+  WriteSamples(mono, nullptr, count, capture_time_ns);
+}
+
+void RhythmEngine::PushStereoSamples(const float* mid, const float* side,
+                                     size_t count, int64_t capture_time_ns) {
+  stats_.CountPacket();
+  if (IsSilent(mid, count) && IsSilent(side, count)) {
+    QueueSilence(count, capture_time_ns);
+    return;
+  }
+  silent_run_ = 0;
+  suspended_ = false;
+  WriteSamples(mid, side, count, capture_time_ns);
+}
+
+void RhythmEngine::PushSilence(size_t count, int64_t capture_time_ns) {
+  stats_.CountPacket();
+  QueueSilence(count, capture_time_ns);
+}
+
+// Queues zeros until the silence timeout, then suspends analysis.
+void RhythmEngine::QueueSilence(size_t count, int64_t capture_time_ns) {
+  silent_run_ += count;
+  const uint64_t timeout_samples =
+      static_cast<uint64_t>(silence_timeout_ms_.load()) * sample_rate_ / 1000;
+  if (silent_run_ <= timeout_samples) {
+    WriteSamples(nullptr, nullptr, count, capture_time_ns);
+    return;
+  }
+  if (!suspended_) {
+    suspended_ = true;
+    suspend_pending_.store(true, std::memory_order_release);
+    Wake();
+  }
+}
+
+// Queues |count| samples from |mono| and, with side input, |side|, or zeros
+// for either that is null.
+void RhythmEngine::WriteSamples(const float* mono, const float* side,
+                                size_t count, int64_t capture_time_ns) {
+  TimeAnchor anchor;
+  anchor.position = produced_;
+  anchor.time_ns = capture_time_ns == kCaptureTimeNow ? SteadyClockNowNs()
+                                                      : capture_time_ns;
+  anchors_.Write(&anchor, 1);
+
+  // Side first, and only as much mono as it took: every mono sample the
+  // worker can read then has its side sample queued, and ring_ always has
+  // room for what side_ring_ accepted since it is drained first.
+  if (side_input()) {
+    count = side ? side_ring_.Write(side, count)
+                 : WriteZeros(&side_ring_, count);
+  }
+  const size_t written =
+      mono ? ring_.Write(mono, count) : WriteZeros(&ring_, count);
+  produced_ += written;
+  samples_captured_.fetch_add(written, std::memory_order_relaxed);
+  Wake();
+}
+
+bool RhythmEngine::Configure(size_t fft_size, size_t hop_size) {
+  if (!RhythmAnalyzer::IsValidConfig(fft_size, hop_size)) return false;
+  requested_config_ = PackConfig(fft_size, hop_size);
+  return true;
+}
+
+bool RhythmEngine::SetDecimation(const Decimation& decimation) {
+  if (decimation.factor != 0 &&
+      !PolyphaseDecimator::IsValidFactor(decimation.factor)) {
+    return false;
+  }
+  requested_decimation_ = PackDecimation(decimation);
+  return true;
+}
+
+Decimation RhythmEngine::decimation() const {
+  return UnpackDecimation(requested_decimation_.load());
+}
+
+SpectrumGrid RhythmEngine::spectrum_grid() const {
+  const uint64_t config = requested_config_.load(std::memory_order_relaxed);
+  return RhythmAnalyzer::GridFor(
+      analysis_mode(), static_cast<size_t>(config >> 32), sample_rate(),
+      decimation(), static_cast<size_t>(config & 0xFFFFFFFFu));
+}
+
+bool RhythmEngine::SetBandLayout(const BandLayout& layout) {
+  if (!BandMapper::IsValidLayout(layout)) return false;
+  requested_layout_ = PackLayout(layout);
+  return true;
+}
+
+bool RhythmEngine::AddSubscriber(const SubscriberConfig& config,
+                                 size_t* id) {
+  if (!BandMapper::IsValidLayout(config.layout)) return false;
+  for (size_t i = 0; i < kMaxSubscribers; i++) {
+    SubscriberSlot& slot = subscribers_[i];
+    if (slot.in_use) continue;
+    SubscriberRequest request;
+    request.config = config;
+    request.generation = ++subscriber_generation_;
+    request.active = true;
+    slot.request.Store(request);
+    slot.in_use = true;
+    *id = i;
+    return true;
+  }
+  return false;
+}
+
+bool RhythmEngine::UpdateSubscriber(size_t id,
+                                    const SubscriberConfig& config) {
+  if (!has_subscriber(id) || !BandMapper::IsValidLayout(config.layout)) {
+    return false;
+  }
+  SubscriberSlot& slot = subscribers_[id];
+  SubscriberRequest request;
+  slot.request.Load(&request);
+  request.config = config;
+  slot.request.Store(request);
+  return true;
+}
+
+bool RhythmEngine::HasSubscribers() const {
+  for (const SubscriberSlot& slot : subscribers_) {
+    if (slot.in_use.load(std::memory_order_relaxed)) return true;
+  }
+  return false;
+}
+
+void RhythmEngine::RemoveSubscriber(size_t id) {
+  if (!has_subscriber(id)) return;
+  SubscriberSlot& slot = subscribers_[id];
+  slot.request.Store(SubscriberRequest());
+  slot.in_use = false;
+}
+
+size_t RhythmEngine::ProcessPending() {
+  const uint64_t config = requested_config_.load(std::memory_order_relaxed);
+  const size_t fft_size = static_cast<size_t>(config >> 32);
+  size_t hop_size = static_cast<size_t>(config & 0xFFFFFFFFu);
+  if (hop_size == 0) hop_size = fft_size / 2;
+  if (fft_size != analyzer_.fft_size() || hop_size != analyzer_.hop_size()) {
+    analyzer_.Configure(fft_size, hop_size);
+  }
+  const BandLayout layout = UnpackLayout(requested_layout_.load());
+  const Decimation decimation =
+      UnpackDecimation(requested_decimation_.load());
+  const uint32_t sample_rate = sample_rate_.load();
+  AnalysisMode mode = requested_mode_.load();
+  const bool chroma = chroma_enabled_.load();
+  const bool percussive = percussive_enabled_.load();
+  // The resonators only produce the main bands, so subscribers, chroma and
+  // percussive separation need the FFT.
+  if (mode == AnalysisMode::kFilterBank &&
+      (HasSubscribers() || chroma || percussive ||
+       !FilterBankIsFaster(layout, decimation, sample_rate))) {
+    mode = AnalysisMode::kFft;
+  }
+  analyzer_.SetMode(mode);
+  active_mode_.store(mode, std::memory_order_relaxed);
+  analyzer_.SetDecimation(decimation);
+  if (layout != analyzer_.band_layout() ||
+      sample_rate != analyzer_.sample_rate()) {
+    analyzer_.SetBandLayout(layout, sample_rate);
+  }
+  const double frame_period = static_cast<double>(analyzer_.hop_size()) /
+                              static_cast<double>(analyzer_.sample_rate());
+  const bool beats = beats_enabled_.load();
+  if (beats) {
+    if (!beats_active_) beat_tracker_.Reset();
+    if (beat_tracker_.bin_count() != analyzer_.bin_count() ||
+        beat_tracker_.frame_period() != frame_period) {
+      beat_tracker_.Configure(analyzer_.bin_count(), frame_period);
+    }
+  }
+  beats_active_ = beats;
+  const bool loudness = loudness_enabled_.load();
+  const bool reset_loudness = loudness_reset_.exchange(false);
+  if (loudness) {
+    const size_t channels = stereo_input_ ? 2 : 1;
+    if (sample_rate != loudness_meter_.sample_rate() ||
+        channels != loudness_meter_.channels()) {
+      loudness_meter_.Configure(sample_rate, channels);
+    } else if (reset_loudness || !loudness_active_) {
+      loudness_meter_.Reset();
+    }
+  }
+  loudness_active_ = loudness;
+  if (requested_dynamics_.version() != dynamics_version_) {
+    DynamicsConfig dynamics;
+    dynamics_version_ = requested_dynamics_.Load(&dynamics);
+    dynamics_.SetConfig(dynamics);
+    for (BandDynamics& stereo_dynamics : stereo_dynamics_) {
+      stereo_dynamics.SetConfig(FollowingDynamics(dynamics));
+    }
+    percussive_dynamics_.SetConfig(FollowingDynamics(dynamics));
+  }
+  if (stereo_) {
+    if (fft_size != stereo_analyzer_.fft_size() ||
+        layout != stereo_analyzer_.band_layout() ||
+        sample_rate != stereo_analyzer_.sample_rate()) {
+      stereo_analyzer_.Configure(fft_size, layout, sample_rate);
+    }
+    const StereoChannels channels = stereo_channels_.load();
+    if (channels != stereo_analyzer_.channels()) {
+      stereo_analyzer_.SetChannels(channels);
+      for (BandDynamics& dynamics : stereo_dynamics_) dynamics.Reset();
+    }
+  }
+  UpdateSubscribers();
+  const bool features = features_enabled_.load();
+  if (features) {
+    if (!features_active_ || !features_.IsConfiguredFor(analyzer_)) {
+      features_.Configure(analyzer_);
+    }
+    features_.SetMaxRate(features_rate_hz_.load());
+  }
+  features_active_ = features;
+  if (chroma) {
+    if (!chroma_active_) chroma_tracker_.Reset();
+    chroma_tracker_.Configure(analyzer_.grid(), frame_period);
+  }
+  chroma_active_ = chroma;
+  if (percussive) {
+    if (!percussive_active_) {
+      percussive_.Reset();
+      percussive_dynamics_.Reset();
+    }
+    percussive_.Configure(layout, analyzer_.grid(), frame_period);
+  }
+  percussive_active_ = percussive;
+
+  // Read before draining: every sample queued ahead of the suspension is
+  // then visible below and is analysed before the silent frame.
+  const bool suspend = suspend_pending_.exchange(false);
+
+  size_t frames = 0;
+  for (;;) {
+    // Every anchor queued so far describes samples that are already in the
+    // ring, and the newest one is the most accurate.
+    TimeAnchor anchor;
+    while (anchors_.Read(&anchor, 1) == 1) anchor_ = anchor;
+
+    // Chunks end on frame and loudness block boundaries so both are
+    // stamped with the exact capture time.
+    size_t wanted =
+        std::min(analyzer_.samples_until_next_frame(), scratch_.size());
+    if (loudness_active_) {
+      wanted = std::min(wanted, loudness_meter_.samples_until_next_block());
+    }
+    const size_t read = ring_.Read(scratch_.data(), wanted);
+    if (read == 0) break;
+    consumed_ += read;
+    if (side_input()) side_ring_.Read(side_scratch_.data(), read);
+    if (stereo_) {
+      stereo_analyzer_.PushSamples(scratch_.data(), side_scratch_.data(),
+                                   read);
+    }
+    if (features_active_) features_.PushSamples(scratch_.data(), read);
+    if (loudness_active_ && MeterLoudness(read)) {
+      LoudnessReading reading = loudness_meter_.reading();
+      reading.timestamp_ns = PositionToTime(consumed_);
+      loudness_.Store(reading);
+    }
+    if (analyzer_.PushSamples(scratch_.data(), read) > 0) {
+      frames++;
+      stats_.CountFrameAnalysed();
+      EmitFrame(analyzer_.bands());
+      if (beats_active_) TrackBeats();
+    }
+  }
+  if (suspend) EmitSilentFrame();
+  return frames;
+}
+
+void RhythmEngine::EmitFrame(const std::vector<float>& levels) {
+  const int64_t timestamp_ns = PositionToTime(consumed_);
+  // Smooth over the real time between frames, falling back to the nominal
+  // hop after a gap (the first frame, silence or a restart).
+  const double nominal_dt = static_cast<double>(analyzer_.hop_size()) /
+                            static_cast<double>(analyzer_.sample_rate());
+  double dt = static_cast<double>(timestamp_ns - frame_.timestamp_ns) * 1e-9;
+  if (frame_.sequence == 0 || dt <= 0.0 || dt > 4.0 * nominal_dt) {
+    dt = nominal_dt;
+  }
+
+  frame_.sequence++;
+  frame_.sample_position = consumed_;
+  frame_.timestamp_ns = timestamp_ns;
+  frame_.silent = false;
+  frame_.band_count = static_cast<uint32_t>(
+      std::min(levels.size(), RhythmFrame::kMaxBands));
+  dynamics_.Process(levels.data(), frame_.band_count, dt, frame_.bands,
+                    frame_.peaks);
+  frame_.gain = dynamics_.gain();
+  latest_frame_.Store(frame_);
+  // Ahead of the callback, so it can read the matching stereo frame,
+  // features, chroma and percussive frame.
+  if (stereo_) EmitStereoFrame(dt);
+  if (percussive_active_) EmitPercussiveFrame(dt);
+  if (features_active_ && features_.Process(analyzer_.magnitudes(), frame_)) {
+    latest_features_.Store(features_.features());
+  }
+  if (chroma_active_ &&
+      chroma_tracker_.Process(analyzer_.magnitudes(), frame_.timestamp_ns)) {
+    chroma_.Store(chroma_tracker_.reading());
+  }
+  if (frame_callback_) frame_callback_(frame_);
+
+  for (SubscriberSlot& slot : subscribers_) {
+    if (!slot.active) continue;
+    const int64_t start = stats_.Now();
+    const bool due =
+        slot.subscriber.Process(analyzer_.magnitudes(), frame_, dt);
+    stats_.band_mapping().RecordSince(start);
+    if (due) slot.frame.Store(slot.subscriber.frame());
+  }
+}
+
+// Whether the resonators analyse |layout| faster than the FFT at the
+// analyser's sizes, timing both whenever the configuration differs from the
+// one last measured.
+bool RhythmEngine::FilterBankIsFaster(const BandLayout& layout,
+                                      const Decimation& decimation,
+                                      uint32_t sample_rate) {
+  const size_t fft_size = analyzer_.fft_size();
+  const size_t hop_size = analyzer_.hop_size();
+  const FftKernels* kernels = &analyzer_.kernels();
+  if (fft_size != crossover_.fft_size || hop_size != crossover_.hop_size ||
+      layout != crossover_.layout || decimation != crossover_.decimation ||
+      sample_rate != crossover_.sample_rate ||
+      kernels != crossover_.kernels) {
+    crossover_ = {fft_size, hop_size, layout, decimation, sample_rate,
+                  kernels};
+    const double bank = RhythmAnalyzer::MeasureFrameNs(
+        AnalysisMode::kFilterBank, fft_size, hop_size, decimation, layout,
+        sample_rate, *kernels);
+    const double fft = RhythmAnalyzer::MeasureFrameNs(
+        AnalysisMode::kFft, fft_size, hop_size, decimation, layout,
+        sample_rate, *kernels);
+    filter_bank_faster_ = bank < fft;
+  }
+  return filter_bank_faster_;
+}
+
+// Feeds the last |count| samples read to the loudness meter: the mono
+// signal, or left and right as mid + side and mid - side. Returns true if a
+// block completed.
+bool RhythmEngine::MeterLoudness(size_t count) {
+  if (loudness_meter_.channels() == 1) {
+    return loudness_meter_.Process(scratch_.data(), count);
+  }
+  const float* mid = scratch_.data();
+  const float* side = side_scratch_.data();
+  float* left = left_scratch_.data();
+  float* right = right_scratch_.data();
+  for (size_t i = 0; i < count; i++) {
+    left[i] = mid[i] + side[i];
+    right[i] = mid[i] - side[i];
+  }
+  return loudness_meter_.Process(left, right, count);
+}
+
+// Analyses the stereo history, which ends where frame_'s window does.
+void RhythmEngine::EmitStereoFrame(double dt) {
+  stereo_analyzer_.Analyze();
+  stereo_frame_.sequence = frame_.sequence;
+  stereo_frame_.timestamp_ns = frame_.timestamp_ns;
+  stereo_frame_.channels =
+      static_cast<uint8_t>(stereo_analyzer_.channels());
+  stereo_frame_.silent = false;
+  stereo_frame_.correlation = stereo_analyzer_.correlation();
+  stereo_frame_.width = stereo_analyzer_.width();
+  stereo_frame_.band_count = static_cast<uint32_t>(
+      std::min(stereo_analyzer_.band_count(), StereoFrame::kMaxBands));
+  for (size_t c = 0; c < 2; c++) {
+    const float* levels = stereo_analyzer_.bands(c);
+    for (size_t i = 0; i < stereo_frame_.band_count; i++) {
+      stereo_levels_[i] = levels[i] * frame_.gain;
+    }
+    stereo_dynamics_[c].Process(stereo_levels_, stereo_frame_.band_count, dt,
+                                stereo_frame_.bands[c],
+                                stereo_frame_.peaks[c]);
+  }
+  latest_stereo_frame_.Store(stereo_frame_);
+}
+
+void RhythmEngine::EmitPercussiveFrame(double dt) {
+  PercussiveOnset onset;
+  if (percussive_.Process(analyzer_.magnitudes(),
+                          frame_.timestamp_ns - HalfWindowNs(), &onset)) {
+    percussive_onsets_.Write(&onset, 1);
+  }
+  percussive_frame_.sequence = frame_.sequence;
+  percussive_frame_.sample_position = frame_.sample_position;
+  percussive_frame_.timestamp_ns = frame_.timestamp_ns;
+  percussive_frame_.silent = false;
+  percussive_frame_.gain = frame_.gain;
+  percussive_frame_.band_count = static_cast<uint32_t>(
+      std::min(percussive_.band_count(), RhythmFrame::kMaxBands));
+  float levels[RhythmFrame::kMaxBands];
+  for (size_t i = 0; i < percussive_frame_.band_count; i++) {
+    levels[i] = percussive_.bands()[i] * frame_.gain;
+  }
+  percussive_dynamics_.Process(levels, percussive_frame_.band_count, dt,
+                               percussive_frame_.bands,
+                               percussive_frame_.peaks);
+  latest_percussive_frame_.Store(percussive_frame_);
+}
+
+void RhythmEngine::EmitSilentFrame() {
+  // Audio that resumes later starts from a clean history.
+  analyzer_.Reset();
+  dynamics_.Reset();
+  beat_tracker_.Reset();
+
+  frame_.sequence++;
+  frame_.sample_position = consumed_;
+  frame_.timestamp_ns = PositionToTime(consumed_);
+  frame_.silent = true;
+  frame_.gain = dynamics_.gain();
+  std::fill(frame_.bands, frame_.bands + RhythmFrame::kMaxBands, 0.0f);
+  std::fill(frame_.peaks, frame_.peaks + RhythmFrame::kMaxBands, 0.0f);
+  latest_frame_.Store(frame_);
+  if (stereo_) {
+    stereo_analyzer_.Reset();
+    for (BandDynamics& dynamics : stereo_dynamics_) dynamics.Reset();
+    const uint8_t channels = stereo_frame_.channels;
+    stereo_frame_ = StereoFrame();
+    stereo_frame_.sequence = frame_.sequence;
+    stereo_frame_.timestamp_ns = frame_.timestamp_ns;
+    stereo_frame_.band_count = frame_.band_count;
+    stereo_frame_.channels = channels;
+    stereo_frame_.silent = true;
+    latest_stereo_frame_.Store(stereo_frame_);
+  }
+  if (features_active_) {
+    features_.Silence(frame_);
+    latest_features_.Store(features_.features());
+  }
+  if (chroma_active_) {
+    chroma_tracker_.Silence(frame_.timestamp_ns);
+    chroma_.Store(chroma_tracker_.reading());
+  }
+  if (percussive_active_) {
+    percussive_.Reset();
+    percussive_dynamics_.Reset();
+    percussive_frame_ = frame_;
+    latest_percussive_frame_.Store(percussive_frame_);
+  }
+  if (frame_callback_) frame_callback_(frame_);
+
+  for (SubscriberSlot& slot : subscribers_) {
+    if (!slot.active) continue;
+    slot.subscriber.Silence(frame_);
+    slot.frame.Store(slot.subscriber.frame());
+  }
+}
+
+// Applies subscriber changes and follows the analyser's spectrum grid. Only
+// a changed subscriber is reconfigured, which allocates.
+void RhythmEngine::UpdateSubscribers() {
+  const SpectrumGrid& grid = analyzer_.grid();
+  for (SubscriberSlot& slot : subscribers_) {
+    BandSubscriber& subscriber = slot.subscriber;
+    if (slot.request.version() != slot.request_version) {
+      SubscriberRequest request;
+      slot.request_version = slot.request.Load(&request);
+      if (request.active &&
+          (!slot.active || request.generation != slot.generation)) {
+        subscriber.Reset();
+      }
+      slot.generation = request.generation;
+      slot.active =
+          request.active && subscriber.Configure(request.config, grid);
+    } else if (slot.active && subscriber.grid() != grid) {
+      subscriber.Configure(subscriber.config(), grid);
+    }
+  }
+}
+
+void RhythmEngine::TrackBeats() {
+  // Onsets are placed at the centre of the analysis window.
+  BeatEvent beat;
+  if (beat_tracker_.Process(analyzer_.magnitudes(),
+                            frame_.timestamp_ns - HalfWindowNs(), &beat)) {
+    beats_.Write(&beat, 1);
+  }
+  if (beat_tracker_.tempo_updated()) tempo_.Store(beat_tracker_.tempo());
+}
+
+int64_t RhythmEngine::HalfWindowNs() const {
+  return static_cast<int64_t>(analyzer_.window_size() * 500000000ull /
+                              analyzer_.sample_rate());
+}
+
+int64_t RhythmEngine::PositionToTime(uint64_t position) const {
+  const int64_t offset = static_cast<int64_t>(position) -
+                         static_cast<int64_t>(anchor_.position);
+  return anchor_.time_ns + offset * 1000000000 /
+                               static_cast<int64_t>(sample_rate_.load());
+}
+
+RingStats RhythmEngine::ring_stats() const {
+  RingStats stats;
+  stats.capacity = ring_.capacity();
+  stats.buffered = ring_.size();
+  stats.high_water = ring_.high_water();
+  stats.overruns = ring_.overruns() + side_ring_.overruns();
+  stats.samples_captured = samples_captured_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void RhythmEngine::Wake() {
+  // Only the first push after the worker went to sleep takes the mutex, and
+  // only long enough to notify.
+  if (wake_pending_.exchange(true, std::memory_order_acq_rel)) return;
+  std::lock_guard<std::mutex> lock(wake_mutex_);
+  wake_cv_.notify_one();
+}
+
+void RhythmEngine::WorkerLoop() {
+  while (running_) {
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      // No timeout: Wake() notifies under the mutex after setting the flag
+      // the predicate checks, so a wake-up cannot be missed.
+      wake_cv_.wait(lock, [this] {
+        return wake_pending_.load(std::memory_order_acquire) || !running_;
+      });
+    }
+    wake_pending_.store(false, std::memory_order_release);
+    ProcessPending();
+  }
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
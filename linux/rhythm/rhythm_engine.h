@@ -0,0 +1,520 @@
+#ifndef RHYTHM_RHYTHM_ENGINE_H_
+#define RHYTHM_RHYTHM_ENGINE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "band_dynamics.h"
+#include "band_subscriber.h"
+#include "beat_tracker.h"
+#include "chroma_tracker.h"
+#include "loudness_meter.h"
+#include "percussive_separator.h"
+#include "rhythm_analyzer.h"
+#include "rhythm_frame.h"
+#include "rhythm_stats.h"
+#include "seqlock.h"
+#include "spectral_features.h"
+#include "spsc_ring.h"
+#include "stereo_analyzer.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Health of the capture -> analysis hand-off.
+struct RingStats {
+  size_t capacity = 0;
+  size_t buffered = 0;
+  size_t high_water = 0;
+  uint64_t overruns = 0;
+  uint64_t samples_captured = 0;
+};
+
+// Decouples audio capture from analysis.
+//
+// The capture thread only downmixes and calls PushSamples(), which copies
+// into a lock-free SPSC ring and returns; it never waits on the FFT. A
+// dedicated worker thread drains the ring, runs the analyser and BandDynamics
+// (gain, smoothing and peak-hold) and reports each frame through the frame
+// callback. If analysis falls behind, the
+// ring overruns and drops samples instead of delaying capture.
+//
+// While beat tracking is enabled the same spectra drive a BeatTracker; beats
+// are queued for a single consumer and the tempo is published like the
+// frames. While loudness is enabled a LoudnessMeter measures the same
+// samples and its reading is published every 100 ms; with stereo input it
+// meters left and right, rebuilt from the mid and side rings, as separate
+// BS.1770 channels.
+//
+// Every frame is also published through a seqlock, so any number of native
+// consumers (such as the platform-channel emitter) can poll the latest frame
+// without locks and without ever stalling the worker.
+//
+// Consumers that want other bands register as subscribers. Each has its own
+// band layout, dynamics and rate limit and its own seqlock, but all of them
+// are projected from the one spectrum per hop that also drives the main
+// frames. That spectrum is an FFT or, in AnalysisMode::kMultiResolution, a
+// constant-Q spectrum with finer bass resolution. For a few main bands and
+// no subscribers a bank of per-band resonators can replace it.
+//
+// Silence is cheap: once the input has been silent for the silence timeout
+// the engine stops queueing samples, the worker publishes a single frame with
+// RhythmFrame::silent set and then sleeps until audible input returns. The
+// worker only ever wakes for queued work, never on a timer.
+//
+// The engine counts packets and frames and times each FFT and band mapping
+// into a RhythmStats, which the channel emitter adds its own measurements to.
+//
+// Each packet's capture time travels through a second small ring alongside
+// the samples, so every frame is stamped with the capture time of the end of
+// its window regardless of how late the worker gets to it.
+//
+// In stereo mode the capture thread also queues the side signal that goes
+// with its mono downmix, through a ring of its own kept in step with the
+// first. The main frames still come from the mono signal alone; each one is
+// followed by a StereoFrame from a StereoAnalyzer over the same window, with
+// per-channel bands under the main frame's gain, correlation and width.
+//
+// While enabled, the spectrum behind each frame is also reduced to
+// SpectralFeatures (centroid, rolloff, flatness, flux and zero-crossing
+// rate), published through a seqlock of their own at a rate of their own.
+// Likewise, a ChromaTracker can fold it into pitch classes and estimate the
+// key a few times a second, and a PercussiveSeparator can split off its
+// drums for percussive-only bands, under the main frame's gain, and onsets.
+class RhythmEngine {
+ public:
+  // Invoked on the worker thread for every analysed frame.
+  using FrameCallback = std::function<void(const RhythmFrame& frame)>;
+
+  // Passed to PushSamples() when the caller has no device timestamp.
+  static constexpr int64_t kCaptureTimeNow = -1;
+
+  // About 0.7 s of mono audio at 48 kHz.
+  static constexpr size_t kDefaultRingCapacity = 32768;
+
+  // Silence the bands get to decay over before analysis is suspended.
+  static constexpr uint32_t kDefaultSilenceTimeoutMs = 1000;
+
+  explicit RhythmEngine(size_t ring_capacity = kDefaultRingCapacity);
+  ~RhythmEngine();
+
+  RhythmEngine(const RhythmEngine&) = delete;
+  RhythmEngine& operator=(const RhythmEngine&) = delete;
+
+  // Must be set before Start().
+  void SetFrameCallback(FrameCallback callback);
+
+  // Overrides the automatically selected FFT kernels (benchmarking only).
+  // Must be called before Start().
+  void SetKernels(const FftKernels& kernels) {
+    analyzer_.SetKernels(kernels);
+    stereo_analyzer_.SetKernels(kernels);
+    features_.SetKernels(kernels);
+  }
+
+  // Must be set before Start(). Enables the side ring, PushStereoSamples()
+  // and the stereo frames.
+  void SetStereo(bool enabled) { stereo_ = enabled; }
+  bool stereo() const { return stereo_; }
+
+  // Must be set before Start(), to whether the source has left and right
+  // channels. Enables the side ring and PushStereoSamples() so that the
+  // loudness meter measures the two channels separately; without it, or for
+  // a mono source in stereo mode, the mono signal is metered as one channel.
+  void SetStereoInput(bool enabled) { stereo_input_ = enabled; }
+  // Whether the capture thread should call PushStereoSamples().
+  bool side_input() const { return stereo_ || stereo_input_; }
+
+  // Any thread. Which channels the stereo frames carry from the worker's
+  // next frame.
+  void SetStereoChannels(StereoChannels channels) {
+    stereo_channels_ = channels;
+  }
+  StereoChannels stereo_channels() const { return stereo_channels_.load(); }
+
+  // Starts the analysis worker; pending audio from a previous run is dropped.
+  void Start();
+  // Stops and joins the worker. Safe to call when not running.
+  void Stop();
+
+  // Any thread, before or during capture. Used to convert stream positions
+  // into timestamps and to place the bands; the worker rebuilds the band
+  // weights before its next frame when the rate changes.
+  void SetSampleRate(uint32_t sample_rate);
+  uint32_t sample_rate() const { return sample_rate_.load(); }
+
+  // Capture thread only. Queues mono samples for analysis; never blocks or
+  // allocates. |capture_time_ns| is the steady-clock time of the first
+  // sample, or kCaptureTimeNow to use the time of the call.
+  void PushSamples(const float* mono, size_t count,
+                   int64_t capture_time_ns = kCaptureTimeNow);
+
+  // Capture thread only, with side input (see side_input()). Same as
+  // PushSamples() for |mid|, and queues the matching |side| samples (see
+  // Downmixer) for the stereo frames and the loudness meter. Silence is
+  // judged on both.
+  void PushStereoSamples(const float* mid, const float* side, size_t count,
+                         int64_t capture_time_ns = kCaptureTimeNow);
+
+  // Capture thread only. Reports |count| samples of silence (for example a
+  // packet WASAPI flagged as silent). Until the silence timeout the samples
+  // are analysed as zeros so the bands fall smoothly; after it analysis is
+  // suspended. PushSamples() treats digitally silent packets the same way.
+  void PushSilence(size_t count, int64_t capture_time_ns = kCaptureTimeNow);
+
+  // Capture thread only. True while analysis is suspended for silence; the
+  // caller may poll for audio less often.
+  bool suspended() const { return suspended_; }
+
+  // Any thread. How long the input must stay silent before analysis is
+  // suspended; 0 suspends on the first silent packet.
+  void SetSilenceTimeout(uint32_t milliseconds) {
+    silence_timeout_ms_ = milliseconds;
+  }
+
+  // Any thread. The worker re-plans before its next frame. A |hop_size| of 0
+  // selects 50% overlap. Returns false for configurations
+  // RhythmAnalyzer::IsValidConfig() rejects.
+  bool Configure(size_t fft_size, size_t hop_size);
+  // The FFT size most recently requested through Configure().
+  size_t fft_size() const {
+    return static_cast<size_t>(requested_config_.load() >> 32);
+  }
+
+  // Any thread. The worker switches modes, dropping the history, before its
+  // next frame. Configure() still sets the hop in every mode.
+  //
+  // AnalysisMode::kFilterBank is only a preference: the worker uses the FFT
+  // instead while any subscriber is registered, while chroma or percussive
+  // separation is enabled and whenever the FFT is faster for the band
+  // layout, FFT size, hop and decimation, and switches back automatically
+  // once none of these holds. The worker times both paths the first time it
+  // meets each configuration (see RhythmAnalyzer::MeasureFrameNs()), so the
+  // choice follows this build and CPU rather than a fixed cost model.
+  void SetAnalysisMode(AnalysisMode mode) { requested_mode_ = mode; }
+  AnalysisMode analysis_mode() const { return requested_mode_.load(); }
+  // Any thread. The mode the worker analysed its latest frame with.
+  AnalysisMode active_analysis_mode() const {
+    return active_mode_.load(std::memory_order_relaxed);
+  }
+
+  // Any thread. The worker decimates the FFT mode's input before its next
+  // frame (see RhythmAnalyzer::SetDecimation()), dropping the history if the
+  // factor in use changes. Returns false for an invalid factor.
+  bool SetDecimation(const Decimation& decimation);
+  Decimation decimation() const;
+
+  // Any thread. The spectrum the requested mode, FFT size, decimation and
+  // sample rate produce, for placing bands without waiting for the worker.
+  SpectrumGrid spectrum_grid() const;
+
+  // Any thread. The worker rebuilds the band weights before its next frame.
+  // Returns false for layouts BandMapper::IsValidLayout() rejects.
+  bool SetBandLayout(const BandLayout& layout);
+
+  // One thread at a time. Takes effect from the worker's next frame without
+  // resetting the envelopes.
+  void SetDynamics(const DynamicsConfig& config) {
+    requested_dynamics_.Store(config);
+  }
+
+  // Most subscribers served at once, besides the main frames.
+  static constexpr size_t kMaxSubscribers = 8;
+
+  // One thread at a time, together with UpdateSubscriber() and
+  // RemoveSubscriber(). Registers a consumer of its own band frames, read
+  // through ReadSubscriberFrame(), and stores its id in |id|. Returns false
+  // if every slot is taken or the layout is invalid.
+  bool AddSubscriber(const SubscriberConfig& config, size_t* id);
+  // Changes a subscriber's settings from the worker's next frame, keeping
+  // its envelopes unless the band count changes.
+  bool UpdateSubscriber(size_t id, const SubscriberConfig& config);
+  // Frees the slot; the worker stops projecting it before its next frame.
+  void RemoveSubscriber(size_t id);
+  // Any thread.
+  bool has_subscriber(size_t id) const {
+    return id < kMaxSubscribers && subscribers_[id].in_use.load();
+  }
+
+  // Any thread. Same contract as ReadLatestFrame(), for subscriber |id|;
+  // the version changes at most at the subscriber's rate.
+  uint64_t ReadSubscriberFrame(size_t id, RhythmFrame* frame) const {
+    return id < kMaxSubscribers ? subscribers_[id].frame.Load(frame) : 0;
+  }
+  uint64_t subscriber_frame_version(size_t id) const {
+    return id < kMaxSubscribers ? subscribers_[id].frame.version() : 0;
+  }
+
+  // Drains the ring on the calling thread and returns the number of frames
+  // analysed. The worker runs this in its loop; the benchmark calls it
+  // directly to replay audio synchronously. Never call both concurrently.
+  size_t ProcessPending();
+
+  // Any thread. Copies the latest complete frame into |frame| and returns
+  // its version, which changes whenever a new frame is published.
+  uint64_t ReadLatestFrame(RhythmFrame* frame) const {
+    return latest_frame_.Load(frame);
+  }
+  uint64_t latest_frame_version() const { return latest_frame_.version(); }
+
+  // Any thread, in stereo mode. Same contract as ReadLatestFrame(); the
+  // version changes with every main frame.
+  uint64_t ReadStereoFrame(StereoFrame* frame) const {
+    return latest_stereo_frame_.Load(frame);
+  }
+  uint64_t stereo_frame_version() const {
+    return latest_stereo_frame_.version();
+  }
+
+  // One consumer thread. Moves up to |max_count| queued beats into |beats|
+  // and returns how many were read.
+  size_t ReadBeats(BeatEvent* beats, size_t max_count) {
+    return beats_.Read(beats, max_count);
+  }
+
+  // Any thread. From the worker's next frame, computes SpectralFeatures for
+  // every frame while |enabled| and publishes their mean at most
+  // |max_rate_hz| times a second (0: with every frame). Off by default.
+  void SetSpectralFeatures(bool enabled, float max_rate_hz = 0.0f) {
+    features_rate_hz_ = max_rate_hz;
+    features_enabled_ = enabled;
+  }
+  bool spectral_features() const { return features_enabled_.load(); }
+
+  // Any thread. Same contract as ReadLatestFrame(); the version changes at
+  // most at the rate given to SetSpectralFeatures().
+  uint64_t ReadSpectralFeatures(SpectralFeatures* features) const {
+    return latest_features_.Load(features);
+  }
+  uint64_t spectral_features_version() const {
+    return latest_features_.version();
+  }
+
+  // Any thread. From the worker's next frame, folds every frame's spectrum
+  // into a ChromaTracker while |enabled|. Off by default.
+  void SetChroma(bool enabled) { chroma_enabled_ = enabled; }
+  bool chroma() const { return chroma_enabled_.load(); }
+
+  // Any thread. Same contract as ReadLatestFrame(); the version changes
+  // every ChromaTracker::kIntervalSeconds of analysed audio while chroma is
+  // enabled.
+  uint64_t ReadChroma(ChromaReading* chroma) const {
+    return chroma_.Load(chroma);
+  }
+  uint64_t chroma_version() const { return chroma_.version(); }
+
+  // Any thread. From the worker's next frame, separates the percussive part
+  // of every frame's spectrum while |enabled|. Off by default.
+  void SetPercussive(bool enabled) { percussive_enabled_ = enabled; }
+  bool percussive() const { return percussive_enabled_.load(); }
+
+  // Any thread. Same contract as ReadLatestFrame(), for the percussive-only
+  // bands in the main layout; the version changes with every main frame
+  // while percussive separation is enabled.
+  uint64_t ReadPercussiveFrame(RhythmFrame* frame) const {
+    return latest_percussive_frame_.Load(frame);
+  }
+  uint64_t percussive_frame_version() const {
+    return latest_percussive_frame_.version();
+  }
+
+  // One consumer thread. Moves up to |max_count| queued percussive onsets
+  // into |onsets| and returns how many were read.
+  size_t ReadPercussiveOnsets(PercussiveOnset* onsets, size_t max_count) {
+    return percussive_onsets_.Read(onsets, max_count);
+  }
+
+  // Any thread. From the worker's next frame, feeds every frame's spectrum
+  // to the BeatTracker while |enabled|, starting from a clean history each
+  // time it is turned on. Off by default.
+  void SetBeatTracking(bool enabled) { beats_enabled_ = enabled; }
+  bool beat_tracking() const { return beats_enabled_.load(); }
+
+  // Any thread. Same contract as ReadLatestFrame(); the version changes
+  // about every BeatTracker::kTempoIntervalSeconds while beat tracking is
+  // enabled.
+  uint64_t ReadTempo(TempoEstimate* tempo) const {
+    return tempo_.Load(tempo);
+  }
+  uint64_t tempo_version() const { return tempo_.version(); }
+
+  // Any thread. From the worker's next chunk, measures loudness while
+  // |enabled|, starting from a clean history each time it is turned on. Off
+  // by default.
+  void SetLoudness(bool enabled) { loudness_enabled_ = enabled; }
+  bool loudness() const { return loudness_enabled_.load(); }
+
+  // Any thread. Same contract as ReadLatestFrame(); the version changes
+  // every LoudnessMeter::kBlockSeconds of analysed audio while loudness is
+  // enabled.
+  uint64_t ReadLoudness(LoudnessReading* loudness) const {
+    return loudness_.Load(loudness);
+  }
+  uint64_t loudness_version() const { return loudness_.version(); }
+
+  // Any thread. Restarts the integrated loudness and true-peak measurement
+  // before the worker's next block.
+  void ResetLoudness() { loudness_reset_ = true; }
+
+  RingStats ring_stats() const;
+
+  // Pipeline statistics, recorded while enabled. The engine records packets
+  // on the capture thread and analysis on the worker; the frame consumer
+  // records sends and latency from its own single thread.
+  RhythmStats& stats() { return stats_; }
+  const RhythmStats& stats() const { return stats_; }
+
+ private:
+  // Maps a stream position to capture time.
+  struct TimeAnchor {
+    uint64_t position = 0;
+    int64_t time_ns = 0;
+  };
+
+  // A subscriber's settings as handed from the registering thread to the
+  // worker.
+  struct SubscriberRequest {
+    SubscriberConfig config;
+    // Changes on every AddSubscriber(), so a slot that is freed and reused
+    // between two worker passes still starts from clean envelopes.
+    uint64_t generation = 0;
+    bool active = false;
+  };
+
+  struct SubscriberSlot {
+    // Registering thread.
+    std::atomic<bool> in_use{false};
+    SeqLock<SubscriberRequest> request;
+    // Worker only.
+    uint64_t request_version = 0;
+    uint64_t generation = 0;
+    bool active = false;
+    BandSubscriber subscriber;
+    // Published by the worker.
+    SeqLock<RhythmFrame> frame;
+  };
+
+  void WorkerLoop();
+  void Wake();
+  void QueueSilence(size_t count, int64_t capture_time_ns);
+  void WriteSamples(const float* mono, const float* side, size_t count,
+                    int64_t capture_time_ns);
+  void EmitFrame(const std::vector<float>& levels);
+  void EmitStereoFrame(double dt);
+  void EmitPercussiveFrame(double dt);
+  void EmitSilentFrame();
+  bool HasSubscribers() const;
+  void UpdateSubscribers();
+  void TrackBeats();
+  bool MeterLoudness(size_t count);
+  bool FilterBankIsFaster(const BandLayout& layout,
+                          const Decimation& decimation, uint32_t sample_rate);
+  // From the end of the analysis window to its centre.
+  int64_t HalfWindowNs() const;
+  int64_t PositionToTime(uint64_t position) const;
+
+  SpscRing<float> ring_;
+  // With side input only: the side samples of ring_'s, written first.
+  SpscRing<float> side_ring_;
+  SpscRing<TimeAnchor> anchors_;
+  RhythmAnalyzer analyzer_;
+  std::vector<float> scratch_;
+  std::vector<float> side_scratch_;
+  // Left and right rebuilt for the loudness meter.
+  std::vector<float> left_scratch_;
+  std::vector<float> right_scratch_;
+  bool stereo_ = false;
+  bool stereo_input_ = false;
+  FrameCallback frame_callback_;
+
+  // Producer side.
+  uint64_t produced_ = 0;
+  uint64_t silent_run_ = 0;
+  bool suspended_ = false;
+
+  // Consumer side.
+  uint64_t consumed_ = 0;
+  TimeAnchor anchor_;
+  BandDynamics dynamics_;
+  BeatTracker beat_tracker_;
+  bool beats_active_ = false;
+  uint64_t dynamics_version_ = 0;
+  RhythmFrame frame_;
+  SeqLock<RhythmFrame> latest_frame_;
+  SeqLock<DynamicsConfig> requested_dynamics_;
+  SpscRing<BeatEvent> beats_;
+  SeqLock<TempoEstimate> tempo_;
+  LoudnessMeter loudness_meter_;
+  bool loudness_active_ = false;
+  SeqLock<LoudnessReading> loudness_;
+  StereoAnalyzer stereo_analyzer_;
+  BandDynamics stereo_dynamics_[2];
+  float stereo_levels_[StereoFrame::kMaxBands] = {};
+  StereoFrame stereo_frame_;
+  SeqLock<StereoFrame> latest_stereo_frame_;
+  SpectralFeatureExtractor features_;
+  bool features_active_ = false;
+  SeqLock<SpectralFeatures> latest_features_;
+  ChromaTracker chroma_tracker_;
+  bool chroma_active_ = false;
+  SeqLock<ChromaReading> chroma_;
+  PercussiveSeparator percussive_;
+  bool percussive_active_ = false;
+  BandDynamics percussive_dynamics_;
+  RhythmFrame percussive_frame_;
+  SeqLock<RhythmFrame> latest_percussive_frame_;
+  SpscRing<PercussiveOnset> percussive_onsets_;
+  SubscriberSlot subscribers_[kMaxSubscribers];
+  // The configuration filter_bank_faster_ was measured for.
+  struct CrossoverConfig {
+    size_t fft_size = 0;
+    size_t hop_size = 0;
+    BandLayout layout;
+    Decimation decimation;
+    uint32_t sample_rate = 0;
+    const FftKernels* kernels = nullptr;
+  };
+  CrossoverConfig crossover_;
+  bool filter_bank_faster_ = false;
+  // Registering thread.
+  uint64_t subscriber_generation_ = 0;
+
+  // Packed as fft_size << 32 | hop_size so both change together.
+  std::atomic<uint64_t> requested_config_;
+  std::atomic<AnalysisMode> requested_mode_{AnalysisMode::kFft};
+  std::atomic<AnalysisMode> active_mode_{AnalysisMode::kFft};
+  std::atomic<StereoChannels> stereo_channels_{StereoChannels::kLeftRight};
+  // Packed as scale << 16 | band_count.
+  std::atomic<uint32_t> requested_layout_;
+  // Packed as treble << 16 | factor.
+  std::atomic<uint32_t> requested_decimation_;
+  std::atomic<uint32_t> sample_rate_{RhythmAnalyzer::kDefaultSampleRate};
+  std::atomic<uint32_t> silence_timeout_ms_{kDefaultSilenceTimeoutMs};
+  std::atomic<bool> suspend_pending_{false};
+  std::atomic<bool> loudness_reset_{false};
+  std::atomic<bool> loudness_enabled_{false};
+  std::atomic<bool> features_enabled_{false};
+  std::atomic<float> features_rate_hz_{0.0f};
+  std::atomic<bool> beats_enabled_{false};
+  std::atomic<bool> chroma_enabled_{false};
+  std::atomic<bool> percussive_enabled_{false};
+  std::atomic<uint64_t> samples_captured_{0};
+  RhythmStats stats_;
+
+  std::atomic<bool> running_{false};
+  std::thread worker_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  std::atomic<bool> wake_pending_{false};
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_RHYTHM_ENGINE_H_
@@ -0,0 +1,63 @@
+#ifndef RHYTHM_RHYTHM_FRAME_H_
+#define RHYTHM_RHYTHM_FRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// One analysed frame as handed to consumers. Fixed-size and trivially
+// copyable so it can be published without allocation.
+struct RhythmFrame {
+  // Matches BandMapper::kMaxBands.
+  static constexpr size_t kMaxBands = 128;
+
+  // Increments by one for every analysed frame since the engine started.
+  uint64_t sequence = 0;
+  // Stream position (in samples) just past the end of the analysis window.
+  uint64_t sample_position = 0;
+  // Capture time of that position on the steady clock, in nanoseconds.
+  int64_t timestamp_ns = 0;
+  uint32_t band_count = 0;
+  // Set on the single frame published when analysis is suspended for
+  // silence; its bands and peaks are all zero.
+  bool silent = false;
+  // Automatic gain applied to this frame's levels.
+  float gain = 1.0f;
+  // Display levels in [0, 1] after gain and attack/release smoothing.
+  float bands[kMaxBands] = {};
+  // Peak-hold markers for the same bands, never below |bands|.
+  float peaks[kMaxBands] = {};
+};
+
+// Stereo view of the same frame, published alongside it in stereo mode.
+struct StereoFrame {
+  static constexpr size_t kMaxBands = RhythmFrame::kMaxBands;
+
+  // The RhythmFrame::sequence and timestamp_ns of the matching frame.
+  uint64_t sequence = 0;
+  int64_t timestamp_ns = 0;
+  uint32_t band_count = 0;
+  // A StereoChannels value: which channels bands[0] and bands[1] hold,
+  // left and right or mid and side.
+  uint8_t channels = 0;
+  bool silent = false;
+  // Phase correlation of left and right in [-1, 1]; 0 for silence.
+  float correlation = 0.0f;
+  // Share of the energy in the side signal in [0, 1]; 0 for mono.
+  float width = 0.0f;
+  // Display levels and peak markers per channel, with the main frame's gain
+  // and dynamics.
+  float bands[2][kMaxBands] = {};
+  float peaks[2][kMaxBands] = {};
+};
+
+// Current time on the clock used for RhythmFrame::timestamp_ns. On Windows
+// this is QueryPerformanceCounter, matching WASAPI's QPC positions.
+int64_t SteadyClockNowNs();
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_RHYTHM_FRAME_H_
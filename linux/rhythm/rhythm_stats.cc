@@ -0,0 +1,60 @@
+#include "rhythm_stats.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+uint64_t HistogramSnapshot::Quantile(double q) const {
+  if (count == 0) return 0;
+  const double target = q * static_cast<double>(count);
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < kBuckets; bucket++) {
+    seen += buckets[bucket];
+    if (static_cast<double>(seen) >= target && seen > 0) {
+      return bucket + 1 < kBuckets ? uint64_t{1} << bucket : max_ns;
+    }
+  }
+  return max_ns;
+}
+
+void DurationHistogram::Record(int64_t duration_ns) {
+  const uint64_t ns =
+      duration_ns > 0 ? static_cast<uint64_t>(duration_ns) : 0;
+  // Bit width of |ns|: 0 for 0, b for [2^(b-1), 2^b).
+  size_t bucket = 0;
+  for (uint64_t rest = ns; rest != 0; rest >>= 1) bucket++;
+  if (bucket >= HistogramSnapshot::kBuckets) {
+    bucket = HistogramSnapshot::kBuckets - 1;
+  }
+  buckets_[bucket].Add();
+  count_.Add();
+  total_ns_.Add(ns);
+  if (ns > max_ns_.load(std::memory_order_relaxed)) {
+    max_ns_.store(ns, std::memory_order_relaxed);
+  }
+}
+
+void DurationHistogram::Snapshot(HistogramSnapshot* out) const {
+  // The fields are read one at a time while the writer runs, so they may
+  // disagree by the events recorded in between.
+  out->count = count_.value();
+  out->total_ns = total_ns_.value();
+  out->max_ns = max_ns_.load(std::memory_order_relaxed);
+  for (size_t bucket = 0; bucket < HistogramSnapshot::kBuckets; bucket++) {
+    out->buckets[bucket] = buckets_[bucket].value();
+  }
+}
+
+void RhythmStats::Snapshot(StatsSnapshot* out) const {
+  out->enabled = enabled();
+  out->packets_captured = packets_captured_.value();
+  out->frames_analysed = frames_analysed_.value();
+  out->frames_sent = frames_sent_.value();
+  out->frames_dropped = frames_dropped_.value();
+  fft_.Snapshot(&out->fft);
+  band_mapping_.Snapshot(&out->band_mapping);
+  capture_to_emit_.Snapshot(&out->capture_to_emit);
+  channel_send_.Snapshot(&out->channel_send);
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,159 @@
+#ifndef RHYTHM_RHYTHM_STATS_H_
+#define RHYTHM_RHYTHM_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "rhythm_frame.h"
+
+// Building with RHYTHM_STATS=0 removes all recording; the methods below then
+// compile to nothing and snapshots are empty.
+#ifndef RHYTHM_STATS
+#define RHYTHM_STATS 1
+#endif
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Copy of a DurationHistogram at one point in time.
+struct HistogramSnapshot {
+  static constexpr size_t kBuckets = 32;
+
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+  // Bucket 0 counts durations under 1 ns, bucket b those in
+  // [2^(b-1), 2^b) ns and the last bucket everything longer.
+  uint64_t buckets[kBuckets] = {};
+
+  double mean_ns() const {
+    return count ? static_cast<double>(total_ns) / static_cast<double>(count)
+                 : 0.0;
+  }
+  // Upper edge of the bucket that holds quantile |q| in [0, 1], which is
+  // within a factor of two of the true value; 0 when empty.
+  uint64_t Quantile(double q) const;
+};
+
+// Counter with a single writing thread. Add() is a relaxed load and store,
+// with no read-modify-write, so it costs no more than a plain increment;
+// any thread may read it.
+class StatsCounter {
+ public:
+  void Add(uint64_t count = 1) {
+    value_.store(value_.load(std::memory_order_relaxed) + count,
+                 std::memory_order_relaxed);
+  }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// Log2-bucketed histogram of durations with a single writing thread, on the
+// same terms as StatsCounter.
+class DurationHistogram {
+ public:
+  void Record(int64_t duration_ns);
+  // Records the time since |start_ns| from RhythmStats::Now(), or nothing if
+  // it is 0 because statistics were disabled. Returns the current time (or
+  // 0), which can start the next section without reading the clock again.
+  int64_t RecordSince(int64_t start_ns) {
+    if (start_ns == 0) return 0;
+    const int64_t now_ns = SteadyClockNowNs();
+    Record(now_ns - start_ns);
+    return now_ns;
+  }
+
+  void Snapshot(HistogramSnapshot* out) const;
+
+ private:
+  StatsCounter count_;
+  StatsCounter total_ns_;
+  std::atomic<uint64_t> max_ns_{0};
+  StatsCounter buckets_[HistogramSnapshot::kBuckets];
+};
+
+// Everything RhythmStats has counted, as returned by Snapshot().
+struct StatsSnapshot {
+  bool enabled = false;
+  uint64_t packets_captured = 0;
+  uint64_t frames_analysed = 0;
+  uint64_t frames_sent = 0;
+  // Frames analysed but never sent: skipped between two polls of the
+  // latest frame, or lost to a full batch queue.
+  uint64_t frames_dropped = 0;
+  // Windowing, FFT and magnitudes of one frame.
+  HistogramSnapshot fft;
+  // Mapping one frame's magnitudes onto one band layout: the main bands,
+  // or a subscriber's bands together with its dynamics.
+  HistogramSnapshot band_mapping;
+  // From the capture time of the end of a frame's window until it is handed
+  // to the platform channel.
+  HistogramSnapshot capture_to_emit;
+  // One platform-channel send.
+  HistogramSnapshot channel_send;
+};
+
+// Self-instrumentation of the capture -> analysis -> channel pipeline.
+//
+// Each counter and histogram is written by exactly one thread (the capture
+// thread or the analysis worker) and read lock-free by any. Recording is off
+// until SetEnabled(true); while off every call costs one relaxed load and a
+// branch, and no clock is read. Timed sections start with Now(), which
+// returns 0 while disabled, and end with DurationHistogram::RecordSince().
+class RhythmStats {
+ public:
+  static constexpr bool kCompiledIn = RHYTHM_STATS != 0;
+
+  // Any thread. Counts already recorded are kept.
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+  bool enabled() const {
+    return kCompiledIn && enabled_.load(std::memory_order_relaxed);
+  }
+
+  // Start of a timed section, or 0 while disabled.
+  int64_t Now() const { return enabled() ? SteadyClockNowNs() : 0; }
+
+  void CountPacket() {
+    if (enabled()) packets_captured_.Add();
+  }
+  void CountFrameAnalysed() {
+    if (enabled()) frames_analysed_.Add();
+  }
+  // |dropped| frames were skipped before this send of |sent| frames.
+  void CountFramesSent(uint64_t sent, uint64_t dropped) {
+    if (!enabled()) return;
+    frames_sent_.Add(sent);
+    if (dropped) frames_dropped_.Add(dropped);
+  }
+  void RecordCaptureToEmit(int64_t capture_time_ns) {
+    if (enabled()) {
+      capture_to_emit_.Record(SteadyClockNowNs() - capture_time_ns);
+    }
+  }
+
+  DurationHistogram& fft() { return fft_; }
+  DurationHistogram& band_mapping() { return band_mapping_; }
+  DurationHistogram& channel_send() { return channel_send_; }
+
+  // Any thread.
+  void Snapshot(StatsSnapshot* out) const;
+
+ private:
+  std::atomic<bool> enabled_{false};
+  StatsCounter packets_captured_;
+  StatsCounter frames_analysed_;
+  StatsCounter frames_sent_;
+  StatsCounter frames_dropped_;
+  DurationHistogram fft_;
+  DurationHistogram band_mapping_;
+  DurationHistogram capture_to_emit_;
+  DurationHistogram channel_send_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_RHYTHM_STATS_H_
@@ -0,0 +1,102 @@
+#include "running_median.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+void RunningMedian::Reset(size_t size, float value) {
+  size_ = static_cast<uint8_t>(IsValidSize(size) ? size : 1);
+  lower_size_ = static_cast<uint8_t>(size_ / 2 + 1);
+  oldest_ = 0;
+  for (size_t slot = 0; slot < size_; slot++) {
+    Place(slot, {value, static_cast<uint8_t>(slot)});
+  }
+}
+
+float RunningMedian::Push(float value) {
+  const uint8_t slot = oldest_;
+  oldest_ = static_cast<uint8_t>(oldest_ + 1 == size_ ? 0 : oldest_ + 1);
+  const size_t position = position_[slot];
+  const float old = heap_[position].value;
+  heap_[position].value = value;
+  if (position < lower_size_) {
+    if (value > old) {
+      SiftLowerUp(position);
+    } else {
+      SiftLowerDown(position);
+    }
+  } else if (value < old) {
+    SiftUpperUp(position - lower_size_);
+  } else {
+    SiftUpperDown(position - lower_size_);
+  }
+
+  // Only the changed value can have crossed the median, and only by one
+  // place: swapping the two tops restores the split.
+  if (size_ > 1 && heap_[0].value > heap_[lower_size_].value) {
+    const Entry lower = heap_[0];
+    Place(0, heap_[lower_size_]);
+    Place(lower_size_, lower);
+    SiftLowerDown(0);
+    SiftUpperDown(0);
+  }
+  return heap_[0].value;
+}
+
+void RunningMedian::SiftLowerUp(size_t position) {
+  const Entry entry = heap_[position];
+  while (position > 0) {
+    const size_t parent = (position - 1) / 2;
+    if (!(heap_[parent].value < entry.value)) break;
+    Place(position, heap_[parent]);
+    position = parent;
+  }
+  Place(position, entry);
+}
+
+void RunningMedian::SiftLowerDown(size_t position) {
+  const Entry entry = heap_[position];
+  const size_t count = lower_size_;
+  for (;;) {
+    size_t child = 2 * position + 1;
+    if (child >= count) break;
+    if (child + 1 < count && heap_[child + 1].value > heap_[child].value) {
+      child++;
+    }
+    if (!(heap_[child].value > entry.value)) break;
+    Place(position, heap_[child]);
+    position = child;
+  }
+  Place(position, entry);
+}
+
+void RunningMedian::SiftUpperUp(size_t position) {
+  Entry* heap = heap_ + lower_size_;
+  const Entry entry = heap[position];
+  while (position > 0) {
+    const size_t parent = (position - 1) / 2;
+    if (!(heap[parent].value > entry.value)) break;
+    Place(lower_size_ + position, heap[parent]);
+    position = parent;
+  }
+  Place(lower_size_ + position, entry);
+}
+
+void RunningMedian::SiftUpperDown(size_t position) {
+  Entry* heap = heap_ + lower_size_;
+  const Entry entry = heap[position];
+  const size_t count = size_ - lower_size_;
+  for (;;) {
+    size_t child = 2 * position + 1;
+    if (child >= count) break;
+    if (child + 1 < count && heap[child + 1].value < heap[child].value) {
+      child++;
+    }
+    if (!(heap[child].value < entry.value)) break;
+    Place(lower_size_ + position, heap[child]);
+    position = child;
+  }
+  Place(lower_size_ + position, entry);
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,67 @@
+#ifndef RHYTHM_RUNNING_MEDIAN_H_
+#define RHYTHM_RUNNING_MEDIAN_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Median of a sliding window of the last size() values.
+//
+// The window is split into a max-heap of its lower half, whose top is the
+// median, and a min-heap of the rest. Each heap entry carries its value and
+// the slot it arrived in, and each of the size() slots, reused in turn,
+// knows where in the heaps its entry lives. The oldest value is therefore
+// overwritten in place by the newest, sifted within its own heap and, if it
+// crossed the median, swapped across: O(log size()) per value with no
+// allocation, and no indirection when comparing.
+class RunningMedian {
+ public:
+  static constexpr size_t kMaxSize = 31;
+
+  // Whether |size| is odd and at most kMaxSize.
+  static bool IsValidSize(size_t size) {
+    return size % 2 == 1 && size <= kMaxSize;
+  }
+
+  // Sets the window to |size| values (see IsValidSize()), all |value|.
+  void Reset(size_t size, float value = 0.0f);
+
+  size_t size() const { return size_; }
+
+  // Replaces the oldest value with |value| and returns the new median.
+  float Push(float value);
+
+  float median() const { return heap_[0].value; }
+
+ private:
+  struct Entry {
+    float value;
+    uint8_t slot;
+  };
+
+  void Place(size_t position, Entry entry) {
+    heap_[position] = entry;
+    position_[entry.slot] = static_cast<uint8_t>(position);
+  }
+  // Restore the heap order around a changed entry; |position| is relative
+  // to the start of the heap.
+  void SiftLowerUp(size_t position);
+  void SiftLowerDown(size_t position);
+  void SiftUpperUp(size_t position);
+  void SiftUpperDown(size_t position);
+
+  // heap_[0, lower_size_) is the lower heap, the rest the upper one.
+  // position_ maps a slot to its entry in heap_.
+  Entry heap_[kMaxSize] = {};
+  uint8_t position_[kMaxSize] = {};
+  uint8_t size_ = 1;
+  uint8_t lower_size_ = 1;
+  uint8_t oldest_ = 0;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_RUNNING_MEDIAN_H_
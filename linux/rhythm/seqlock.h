@@ -0,0 +1,85 @@
+#ifndef RHYTHM_SEQLOCK_H_
+#define RHYTHM_SEQLOCK_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Publishes the latest value of a small trivially copyable type from exactly
+// one writer thread to any number of reader threads.
+//
+// Store() is wait-free and never waits for readers. Load() never blocks the
+// writer either: it copies optimistically and retries only if a Store()
+// overlapped the copy, so a reader always gets the latest complete value and
+// never a torn one. The value lives in relaxed atomic words, which keeps the
+// concurrent copies free of data races.
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock values are copied word by word");
+
+ public:
+  SeqLock() { Store(T()); }
+
+  SeqLock(const SeqLock&) = delete;
+  SeqLock& operator=(const SeqLock&) = delete;
+
+  // Writer only.
+  void Store(const T& value) {
+    uint64_t words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; i++) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Any thread. Copies the latest complete value into |out| and returns its
+  // version().
+  uint64_t Load(T* out) const {
+    uint64_t words[kWords];
+    uint64_t before;
+    for (;;) {
+      before = sequence_.load(std::memory_order_acquire);
+      if (before & 1) {
+        // The writer is mid-copy; it finishes within a few hundred cycles.
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < kWords; i++) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before) break;
+    }
+    std::memcpy(out, words, sizeof(T));
+    return before / 2;
+  }
+
+  // Any thread. Increments on every Store(), so readers can skip values they
+  // have already seen without copying them.
+  uint64_t version() const {
+    return sequence_.load(std::memory_order_acquire) / 2;
+  }
+
+ private:
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint64_t> sequence_{0};
+  std::atomic<uint64_t> words_[kWords];
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_SEQLOCK_H_
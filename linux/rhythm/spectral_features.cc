@@ -0,0 +1,136 @@
+#include "spectral_features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace cyrene_music {
+namespace rhythm {
+
+void SpectralFeatureExtractor::Configure(const RhythmAnalyzer& analyzer) {
+  mode_ = analyzer.mode();
+  grid_ = analyzer.grid();
+  layout_ = analyzer.band_layout();
+  const size_t count = analyzer.bin_count();
+  hz_.resize(count);
+  for (size_t k = 0; k < count; k++) {
+    hz_[k] = mode_ == AnalysisMode::kFilterBank
+                 ? analyzer.band_mapper().center_frequency(k)
+                 : static_cast<float>(grid_.Frequency(static_cast<double>(k)));
+  }
+  previous_.assign(count, 0.0f);
+  Reset();
+}
+
+bool SpectralFeatureExtractor::IsConfiguredFor(
+    const RhythmAnalyzer& analyzer) const {
+  return analyzer.mode() == mode_ && analyzer.grid() == grid_ &&
+         analyzer.band_layout() == layout_;
+}
+
+void SpectralFeatureExtractor::SetMaxRate(float max_rate_hz) {
+  interval_ns_ = max_rate_hz > 0.0f ? std::llround(1e9 / max_rate_hz) : 0;
+}
+
+void SpectralFeatureExtractor::Reset() {
+  has_previous_ = false;
+  negative_ = false;
+  crossings_ = 0;
+  samples_ = 0;
+  frames_ = 0;
+  centroid_sum_ = 0.0;
+  rolloff_sum_ = 0.0;
+  flatness_sum_ = 0.0;
+  flux_sum_ = 0.0;
+  published_ = false;
+}
+
+void SpectralFeatureExtractor::PushSamples(const float* samples,
+                                           size_t count) {
+  bool negative = negative_;
+  uint64_t crossings = 0;
+  for (size_t n = 0; n < count; n++) {
+    const bool sign = samples[n] < 0.0f;
+    crossings += sign != negative;
+    negative = sign;
+  }
+  negative_ = negative;
+  crossings_ += crossings;
+  samples_ += count;
+}
+
+bool SpectralFeatureExtractor::Process(const float* magnitudes,
+                                       const RhythmFrame& source) {
+  const size_t count = hz_.size();
+  std::fill(std::begin(sums_), std::end(sums_), 0.0f);
+  kernels_->spectral_sums(magnitudes, previous_.data(), hz_.data(), count,
+                          sums_);
+  double sum[kSpectralSumCount] = {};
+  for (size_t q = 0; q < kSpectralSumCount; q++) {
+    for (size_t lane = 0; lane < kSpectralSumLanes; lane++) {
+      sum[q] += sums_[kSpectralSumLanes * q + lane];
+    }
+  }
+
+  if (sum[kSumMagnitude] > 0.0 && count > 0) {
+    centroid_sum_ += sum[kSumWeightedHz] / sum[kSumMagnitude];
+    const double target = kRolloffFraction * sum[kSumMagnitude];
+    double cumulative = magnitudes[0];
+    size_t k = 0;
+    while (cumulative < target && k + 1 < count) cumulative += magnitudes[++k];
+    rolloff_sum_ += hz_[k];
+    // Both means are of the power, m^2, so the log mean is doubled.
+    const double n = static_cast<double>(count);
+    const double mean_power = sum[kSumPower] / n;
+    if (mean_power > 0.0) {
+      flatness_sum_ += std::min(
+          std::exp2(2.0 * sum[kSumLog] / n) / mean_power, 1.0);
+    }
+    if (has_previous_) flux_sum_ += sum[kSumFlux] / sum[kSumMagnitude];
+  }
+  has_previous_ = true;
+  frames_++;
+
+  if (interval_ns_ > 0) {
+    if (published_ && source.timestamp_ns < next_due_ns_) return false;
+    next_due_ns_ += interval_ns_;
+    // The first frame, or the first after a gap, starts a new schedule.
+    if (!published_ || next_due_ns_ <= source.timestamp_ns) {
+      next_due_ns_ = source.timestamp_ns + interval_ns_;
+    }
+  }
+  published_ = true;
+
+  const double frames = static_cast<double>(frames_);
+  features_.sequence = source.sequence;
+  features_.timestamp_ns = source.timestamp_ns;
+  features_.frame_count = frames_;
+  features_.silent = false;
+  features_.centroid_hz = static_cast<float>(centroid_sum_ / frames);
+  features_.rolloff_hz = static_cast<float>(rolloff_sum_ / frames);
+  features_.flatness = static_cast<float>(flatness_sum_ / frames);
+  features_.flux = static_cast<float>(flux_sum_ / frames);
+  features_.zero_crossing_rate =
+      samples_ > 0 ? static_cast<float>(static_cast<double>(crossings_) /
+                                        static_cast<double>(samples_))
+                   : 0.0f;
+  frames_ = 0;
+  centroid_sum_ = 0.0;
+  rolloff_sum_ = 0.0;
+  flatness_sum_ = 0.0;
+  flux_sum_ = 0.0;
+  crossings_ = 0;
+  samples_ = 0;
+  return true;
+}
+
+void SpectralFeatureExtractor::Silence(const RhythmFrame& source) {
+  Reset();
+  features_ = SpectralFeatures();
+  features_.sequence = source.sequence;
+  features_.timestamp_ns = source.timestamp_ns;
+  features_.silent = true;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
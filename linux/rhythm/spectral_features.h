@@ -0,0 +1,119 @@
+#ifndef RHYTHM_SPECTRAL_FEATURES_H_
+#define RHYTHM_SPECTRAL_FEATURES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "band_mapper.h"
+#include "fft_kernels.h"
+#include "rhythm_analyzer.h"
+#include "rhythm_frame.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Timbre of the recent audio, averaged over the frames since the previous
+// record.
+struct SpectralFeatures {
+  // The RhythmFrame::sequence and timestamp_ns of the latest frame averaged.
+  uint64_t sequence = 0;
+  int64_t timestamp_ns = 0;
+  // Frames behind this record.
+  uint32_t frame_count = 0;
+  // Set on the record published when analysis is suspended for silence;
+  // every feature is then 0.
+  bool silent = false;
+  // Magnitude-weighted mean frequency: the brightness.
+  float centroid_hz = 0.0f;
+  // Frequency below which kRolloffFraction of the magnitude lies.
+  float rolloff_hz = 0.0f;
+  // Geometric over arithmetic mean of the power spectrum, in [0, 1]: near 1
+  // for noise, near 0 for a few tones.
+  float flatness = 0.0f;
+  // Summed rise of the magnitudes since the previous frame relative to
+  // their sum: 0 for a steady spectrum, large at onsets.
+  float flux = 0.0f;
+  // Sign changes per sample of the time-domain signal, in [0, 1].
+  float zero_crossing_rate = 0.0f;
+};
+
+// Computes SpectralFeatures from the analyser's magnitudes.
+//
+// Each frame's spectrum is reduced in one pass by the
+// FftKernels::spectral_sums kernel, which yields the sums behind the
+// centroid, flatness and flux at once; only the rolloff needs a second,
+// early-exiting scan. The zero-crossing rate is counted from the samples
+// themselves. As with BandSubscriber, every frame is measured and records
+// are offered for publication at no more than the maximum rate, each the
+// mean of the frames since the previous one.
+//
+// In multi-resolution mode the bins are log-spaced, so the centroid and
+// rolloff lean towards the bass compared with a linear spectrum; in
+// filter-bank mode the "bins" are the bands at their centre frequencies.
+//
+// Configure() allocates; the rest does not.
+class SpectralFeatureExtractor {
+ public:
+  static constexpr float kRolloffFraction = 0.85f;
+
+  // Prepares for the magnitudes |analyzer| currently produces and forgets
+  // the previous spectrum.
+  void Configure(const RhythmAnalyzer& analyzer);
+  // Whether Configure() was last called for |analyzer|'s current mode,
+  // grid and band layout.
+  bool IsConfiguredFor(const RhythmAnalyzer& analyzer) const;
+
+  // Most records per second to publish; 0 publishes every frame.
+  void SetMaxRate(float max_rate_hz);
+
+  // Overrides the automatically selected kernels (benchmarking only).
+  void SetKernels(const FftKernels& kernels) { kernels_ = &kernels; }
+
+  // Forgets the previous spectrum, the averages and the rate limiter's
+  // schedule.
+  void Reset();
+
+  // Counts the zero crossings of |count| samples, which must be the
+  // analyser's input in order.
+  void PushSamples(const float* samples, size_t count);
+
+  // Measures one frame of |magnitudes|; |source| supplies its sequence and
+  // time. Returns true if features() holds a new record to publish.
+  bool Process(const float* magnitudes, const RhythmFrame& source);
+
+  // Resets and turns features() into a silent record for |source|, which is
+  // always due for publication.
+  void Silence(const RhythmFrame& source);
+
+  const SpectralFeatures& features() const { return features_; }
+
+ private:
+  const FftKernels* kernels_ = &SelectFftKernels();
+  AnalysisMode mode_ = AnalysisMode::kFft;
+  SpectrumGrid grid_;
+  BandLayout layout_;
+  // Frequency of every magnitude, and the previous frame's magnitudes.
+  std::vector<float> hz_;
+  std::vector<float> previous_;
+  bool has_previous_ = false;
+  float sums_[kSpectralSumCount * kSpectralSumLanes] = {};
+  // Since the last record.
+  bool negative_ = false;
+  uint64_t crossings_ = 0;
+  uint64_t samples_ = 0;
+  uint32_t frames_ = 0;
+  double centroid_sum_ = 0.0;
+  double rolloff_sum_ = 0.0;
+  double flatness_sum_ = 0.0;
+  double flux_sum_ = 0.0;
+  int64_t interval_ns_ = 0;
+  int64_t next_due_ns_ = 0;
+  bool published_ = false;
+  SpectralFeatures features_;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_SPECTRAL_FEATURES_H_
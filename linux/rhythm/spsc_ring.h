@@ -0,0 +1,118 @@
+#ifndef RHYTHM_SPSC_RING_H_
+#define RHYTHM_SPSC_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Fixed-capacity lock-free ring buffer for exactly one producer thread and
+// one consumer thread.
+//
+// Write() never blocks and never allocates: items that do not fit are dropped
+// and counted as overruns, so a slow consumer cannot stall the producer. The
+// producer also records the highest fill level it has seen.
+template <typename T>
+class SpscRing {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit SpscRing(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+    buffer_.resize(rounded);
+    mask_ = rounded - 1;
+  }
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  size_t capacity() const { return buffer_.size(); }
+
+  // Producer only. Copies up to |count| items and returns how many were
+  // written; the rest are dropped.
+  size_t Write(const T* data, size_t count) {
+    const size_t head = head_.value.load(std::memory_order_relaxed);
+    const size_t tail = tail_.value.load(std::memory_order_acquire);
+    const size_t used = head - tail;
+    const size_t writable = std::min(count, capacity() - used);
+
+    const size_t first = std::min(writable, capacity() - (head & mask_));
+    std::copy(data, data + first, buffer_.begin() + Offset(head));
+    std::copy(data + first, data + writable, buffer_.begin());
+    head_.value.store(head + writable, std::memory_order_release);
+
+    if (writable < count) {
+      overruns_.fetch_add(count - writable, std::memory_order_relaxed);
+    }
+    if (used + writable > high_water_.load(std::memory_order_relaxed)) {
+      high_water_.store(used + writable, std::memory_order_relaxed);
+    }
+    return writable;
+  }
+
+  // Consumer only. Moves up to |max_count| items into |out| and returns how
+  // many were read.
+  size_t Read(T* out, size_t max_count) {
+    const size_t tail = tail_.value.load(std::memory_order_relaxed);
+    const size_t head = head_.value.load(std::memory_order_acquire);
+    const size_t readable = std::min(max_count, head - tail);
+
+    const size_t first = std::min(readable, capacity() - (tail & mask_));
+    const auto start = buffer_.begin() + Offset(tail);
+    std::copy(start, start + static_cast<std::ptrdiff_t>(first), out);
+    std::copy(buffer_.begin(),
+              buffer_.begin() + static_cast<std::ptrdiff_t>(readable - first),
+              out + first);
+    tail_.value.store(tail + readable, std::memory_order_release);
+    return readable;
+  }
+
+  // Consumer only. Discards everything currently buffered.
+  void Clear() {
+    tail_.value.store(head_.value.load(std::memory_order_acquire),
+                      std::memory_order_release);
+  }
+
+  // Approximate number of buffered items; exact from either owning thread.
+  size_t size() const {
+    return head_.value.load(std::memory_order_acquire) -
+           tail_.value.load(std::memory_order_acquire);
+  }
+
+  // Total items dropped because the ring was full.
+  uint64_t overruns() const {
+    return overruns_.load(std::memory_order_relaxed);
+  }
+
+  // Highest fill level observed by the producer.
+  size_t high_water() const {
+    return high_water_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Keeps the producer- and consumer-owned indices on separate cache lines.
+  struct PaddedIndex {
+    std::atomic<size_t> value{0};
+    char padding[64 - sizeof(std::atomic<size_t>)];
+  };
+
+  std::ptrdiff_t Offset(size_t index) const {
+    return static_cast<std::ptrdiff_t>(index & mask_);
+  }
+
+  std::vector<T> buffer_;
+  size_t mask_ = 0;
+  PaddedIndex head_;
+  PaddedIndex tail_;
+  std::atomic<uint64_t> overruns_{0};
+  std::atomic<size_t> high_water_{0};
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_SPSC_RING_H_
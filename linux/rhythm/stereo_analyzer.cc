@@ -0,0 +1,170 @@
+#include "stereo_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "rhythm_analyzer.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+const char* const kChannelNames[] = {"lr", "ms"};
+
+}  // namespace
+
+const char* StereoChannelsName(StereoChannels channels) {
+  return kChannelNames[static_cast<size_t>(channels)];
+}
+
+bool ParseStereoChannels(const char* name, StereoChannels* channels) {
+  for (size_t i = 0; i < sizeof(kChannelNames) / sizeof(kChannelNames[0]);
+       i++) {
+    if (std::strcmp(name, kChannelNames[i]) == 0) {
+      *channels = static_cast<StereoChannels>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+StereoAnalyzer::StereoAnalyzer() {
+  Configure(RhythmAnalyzer::kDefaultFftSize, BandLayout(),
+            RhythmAnalyzer::kDefaultSampleRate);
+}
+
+bool StereoAnalyzer::Configure(size_t fft_size, const BandLayout& layout,
+                               uint32_t sample_rate) {
+  if (!FftPlan::IsValidSize(fft_size) || !BandMapper::IsValidLayout(layout)) {
+    return false;
+  }
+  plan_.Reset(fft_size);
+  mapper_.Configure(layout, fft_size, sample_rate);
+
+  window_.resize(fft_size);
+  for (size_t i = 0; i < fft_size; i++) {
+    window_[i] = static_cast<float>(
+        0.5 * (1.0 - std::cos(2.0 * kPi * static_cast<double>(i) /
+                              static_cast<double>(fft_size - 1))));
+  }
+  mid_history_.assign(2 * fft_size, 0.0f);
+  side_history_.assign(2 * fft_size, 0.0f);
+  z_re_.assign(fft_size, 0.0f);
+  z_im_.assign(fft_size, 0.0f);
+  const size_t bins = fft_size / 2 + 1;
+  for (size_t c = 0; c < 2; c++) {
+    x_re_[c].assign(bins, 0.0f);
+    x_im_[c].assign(bins, 0.0f);
+    bands_[c].assign(mapper_.band_count(), 0.0f);
+  }
+  magnitudes_.assign(bins, 0.0f);
+  Reset();
+  return true;
+}
+
+void StereoAnalyzer::Reset() {
+  std::fill(mid_history_.begin(), mid_history_.end(), 0.0f);
+  std::fill(side_history_.begin(), side_history_.end(), 0.0f);
+  write_pos_ = 0;
+  for (std::vector<float>& bands : bands_) {
+    std::fill(bands.begin(), bands.end(), 0.0f);
+  }
+  correlation_ = 0.0f;
+  width_ = 0.0f;
+}
+
+void StereoAnalyzer::PushSamples(const float* mid, const float* side,
+                                 size_t count) {
+  const size_t size = plan_.size();
+  while (count > 0) {
+    const size_t take = std::min(count, size - write_pos_);
+    float* mid_slot = mid_history_.data() + write_pos_;
+    float* side_slot = side_history_.data() + write_pos_;
+    std::copy(mid, mid + take, mid_slot);
+    std::copy(mid, mid + take, mid_slot + size);
+    std::copy(side, side + take, side_slot);
+    std::copy(side, side + take, side_slot + size);
+    write_pos_ = (write_pos_ + take) & (size - 1);
+    mid += take;
+    side += take;
+    count -= take;
+  }
+}
+
+void StereoAnalyzer::Analyze() {
+  const size_t size = plan_.size();
+  const size_t half = size / 2;
+  const float* mid = &mid_history_[write_pos_];
+  const float* side = &side_history_[write_pos_];
+  const uint32_t* reverse = plan_.bit_reverse().data();
+
+  // z = mid + i side, windowed and scattered into bit-reversed order. The
+  // windowed energies and cross term are summed on the way; by Parseval they
+  // are those of the spectra too.
+  double mid_energy = 0.0;
+  double side_energy = 0.0;
+  double cross = 0.0;
+  for (size_t n = 0; n < size; n++) {
+    const float m = mid[n] * window_[n];
+    const float s = side[n] * window_[n];
+    z_re_[reverse[n]] = m;
+    z_im_[reverse[n]] = s;
+    mid_energy += double{m} * m;
+    side_energy += double{s} * s;
+    cross += double{m} * s;
+  }
+  plan_.TransformBitReversed(z_re_.data(), z_im_.data());
+
+  // With a = Z[k] and b = Z[N - k], mid is (a + conj(b)) / 2 and side
+  // (a - conj(b)) / 2i; left and right are their sum and difference.
+  const bool left_right = channels_ == StereoChannels::kLeftRight;
+  float* re0 = x_re_[0].data();
+  float* im0 = x_im_[0].data();
+  float* re1 = x_re_[1].data();
+  float* im1 = x_im_[1].data();
+  for (size_t k = 0; k <= half; k++) {
+    const size_t mirror = (size - k) & (size - 1);
+    const float ar = z_re_[k], ai = z_im_[k];
+    const float br = z_re_[mirror], bi = z_im_[mirror];
+    const float mr = 0.5f * (ar + br), mi = 0.5f * (ai - bi);
+    const float sr = 0.5f * (ai + bi), si = 0.5f * (br - ar);
+    if (left_right) {
+      re0[k] = mr + sr;
+      im0[k] = mi + si;
+      re1[k] = mr - sr;
+      im1[k] = mi - si;
+    } else {
+      re0[k] = mr;
+      im0[k] = mi;
+      re1[k] = sr;
+      im1[k] = si;
+    }
+  }
+
+  const FftKernels& kernels = plan_.kernels();
+  for (size_t c = 0; c < 2; c++) {
+    kernels.magnitude(x_re_[c].data(), x_im_[c].data(), half + 1,
+                      magnitudes_.data());
+    mapper_.Apply(magnitudes_.data(), bands_[c].data());
+    for (float& band : bands_[c]) band *= RhythmAnalyzer::kLevelScale;
+  }
+
+  // sum(L * R) = sum(M^2 - S^2), and L, R = M +- S.
+  const double total = mid_energy + side_energy;
+  const double left_energy = total + 2.0 * cross;
+  const double right_energy = total - 2.0 * cross;
+  const double product = left_energy * right_energy;
+  correlation_ =
+      product > 0.0
+          ? static_cast<float>(std::clamp(
+                (mid_energy - side_energy) / std::sqrt(product), -1.0, 1.0))
+          : 0.0f;
+  width_ = total > 0.0 ? static_cast<float>(side_energy / total) : 0.0f;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,102 @@
+#ifndef RHYTHM_STEREO_ANALYZER_H_
+#define RHYTHM_STEREO_ANALYZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "band_mapper.h"
+#include "fft_kernels.h"
+#include "fft_plan.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// Which pair of channels StereoAnalyzer reports bands for.
+enum class StereoChannels : uint8_t {
+  kLeftRight = 0,
+  kMidSide = 1,
+};
+
+// Returns the lower-case name ("lr", "ms").
+const char* StereoChannelsName(StereoChannels channels);
+// Parses a name produced by StereoChannelsName(). Returns false if unknown.
+bool ParseStereoChannels(const char* name, StereoChannels* channels);
+
+// Per-channel bands, phase correlation and stereo width of a mid/side pair.
+//
+// Mid is the mono downmix the main analyser sees and side the matching
+// difference (Downmixer's side output), so left = mid + side and
+// right = mid - side. Both real signals are windowed and packed into one
+// complex FFT, mid as the real part and side as the imaginary part, and
+// separated again by conjugate symmetry: a stereo frame costs one fft_size
+// complex transform, the price of two real ones, and no more.
+//
+// correlation() is the normalised cross-correlation of left and right over
+// the window, from +1 (mono) through 0 (unrelated) to -1 (out of phase);
+// width() is the share of side in the total energy, 0 for mono, 0.5 for
+// unrelated channels and 1 for pure side. Both are summed over the windowed
+// samples while they are packed, so they cost no pass of their own.
+//
+// Configure() allocates; PushSamples() and Analyze() do not.
+class StereoAnalyzer {
+ public:
+  StereoAnalyzer();
+
+  // Plans |fft_size|-point transforms and bands of |layout| on their linear
+  // grid at |sample_rate|, and clears the history. Returns false, keeping
+  // the current configuration, for an invalid size or layout.
+  bool Configure(size_t fft_size, const BandLayout& layout,
+                 uint32_t sample_rate);
+
+  void SetChannels(StereoChannels channels) { channels_ = channels; }
+  StereoChannels channels() const { return channels_; }
+
+  // Overrides the automatically selected kernels (benchmarking only).
+  void SetKernels(const FftKernels& kernels) { plan_.SetKernels(kernels); }
+
+  // Clears the history and the latest results.
+  void Reset();
+
+  // Appends |count| samples of each signal to the history.
+  void PushSamples(const float* mid, const float* side, size_t count);
+
+  // Analyses the latest fft_size() samples of history.
+  void Analyze();
+
+  size_t fft_size() const { return plan_.size(); }
+  const BandLayout& band_layout() const { return mapper_.layout(); }
+  uint32_t sample_rate() const { return mapper_.sample_rate(); }
+  size_t band_count() const { return mapper_.band_count(); }
+
+  // Levels of the latest frame for channel 0 (left or mid) or 1 (right or
+  // side), on the main analyser's level scale.
+  const float* bands(size_t channel) const { return bands_[channel].data(); }
+  float correlation() const { return correlation_; }
+  float width() const { return width_; }
+
+ private:
+  StereoChannels channels_ = StereoChannels::kLeftRight;
+  FftPlan plan_;
+  BandMapper mapper_;
+  // Hann window, as RealFftPlan's.
+  std::vector<float> window_;
+  // Mirrored rings of fft_size() samples.
+  std::vector<float> mid_history_;
+  std::vector<float> side_history_;
+  size_t write_pos_ = 0;
+  std::vector<float> z_re_;
+  std::vector<float> z_im_;
+  // Spectra of the two reported channels, DC through Nyquist.
+  std::vector<float> x_re_[2];
+  std::vector<float> x_im_[2];
+  std::vector<float> magnitudes_;
+  std::vector<float> bands_[2];
+  float correlation_ = 0.0f;
+  float width_ = 0.0f;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_STEREO_ANALYZER_H_
@@ -0,0 +1,211 @@
+#include "track_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+uint32_t SamplesToMs(uint64_t samples, uint32_t sample_rate) {
+  return static_cast<uint32_t>(samples * 1000 / sample_rate);
+}
+
+// Median of |tempos| weighted by confidence; 0 if none has any.
+float WeightedMedianBpm(std::vector<TempoEstimate>* tempos) {
+  std::sort(tempos->begin(), tempos->end(),
+            [](const TempoEstimate& a, const TempoEstimate& b) {
+              return a.bpm < b.bpm;
+            });
+  double total = 0.0;
+  for (const TempoEstimate& tempo : *tempos) total += tempo.confidence;
+  if (total <= 0.0) return 0.0f;
+  double sum = 0.0;
+  for (const TempoEstimate& tempo : *tempos) {
+    sum += tempo.confidence;
+    if (sum >= 0.5 * total) return tempo.bpm;
+  }
+  return tempos->back().bpm;
+}
+
+}  // namespace
+
+TrackAnalyzer::TrackAnalyzer()
+    : beat_analyzer_(kBeatFftSize), chroma_analyzer_(kChromaFftSize),
+      mono_(kBlockFrames), side_(kBlockFrames), left_(kBlockFrames),
+      right_(kBlockFrames) {}
+
+bool TrackAnalyzer::Analyze(PcmSource* source, TrackAnalysis* out,
+                            std::string* error, PeakPyramidWriter* peaks) {
+  const AudioFormat& format = source->format();
+  if (format.sample_rate == 0 || !downmixer_.Configure(format)) {
+    *error = "unsupported audio format";
+    return false;
+  }
+  Prepare(format);
+  for (;;) {
+    size_t frames = 0;
+    if (!source->Read(block_.data(), kBlockFrames, &frames, error)) {
+      return false;
+    }
+    if (frames == 0) break;
+    DownmixBlock(frames);
+    ProcessMono(mono_.data(), frames);
+    if (peaks) peaks->Process(mono_.data(), frames);
+  }
+  out->source_size = source->source_size();
+  Finish(out);
+  return true;
+}
+
+void TrackAnalyzer::Prepare(const AudioFormat& format) {
+  block_.resize(kBlockFrames * format.block_align);
+  const size_t channels = format.channels >= 2 ? 2 : 1;
+  if (format.sample_rate != sample_rate_ ||
+      channels != loudness_meter_.channels()) {
+    loudness_meter_.Configure(format.sample_rate, channels);
+  }
+  if (format.sample_rate != sample_rate_) {
+    sample_rate_ = format.sample_rate;
+    beat_analyzer_.SetBandLayout(BandLayout(), sample_rate_);
+    chroma_analyzer_.SetBandLayout(BandLayout(), sample_rate_);
+    beat_tracker_.Configure(
+        beat_analyzer_.bin_count(),
+        static_cast<double>(beat_analyzer_.hop_size()) / sample_rate_);
+    chroma_tracker_.Configure(
+        chroma_analyzer_.grid(),
+        static_cast<double>(chroma_analyzer_.hop_size()) / sample_rate_);
+  }
+  beat_analyzer_.Reset();
+  chroma_analyzer_.Reset();
+  beat_tracker_.Reset();
+  chroma_tracker_.Reset();
+  loudness_meter_.Reset();
+  // Beats are placed at the centre of the analysis window, as live.
+  half_window_ns_ = static_cast<int64_t>(beat_analyzer_.window_size() *
+                                         500000000ull / sample_rate_);
+  position_ = 0;
+  first_loud_ = 0;
+  last_loud_ = 0;
+  heard_ = false;
+  tempos_.clear();
+  beats_ms_.clear();
+  std::fill(std::begin(key_chroma_), std::end(key_chroma_), 0.0);
+}
+
+// Downmixes the |count| frames in block_ into mono_ and meters their
+// loudness: the mono signal, or left and right as mono + side and
+// mono - side.
+void TrackAnalyzer::DownmixBlock(size_t count) {
+  if (loudness_meter_.channels() == 1) {
+    downmixer_.Process(block_.data(), count, mono_.data());
+    loudness_meter_.Process(mono_.data(), count);
+    return;
+  }
+  downmixer_.Process(block_.data(), count, mono_.data(), side_.data());
+  for (size_t i = 0; i < count; i++) {
+    left_[i] = mono_[i] + side_[i];
+    right_[i] = mono_[i] - side_[i];
+  }
+  loudness_meter_.Process(left_.data(), right_.data(), count);
+}
+
+void TrackAnalyzer::ProcessMono(const float* mono, size_t count) {
+  const float threshold = std::pow(10.0f, kSilenceDbfs / 20.0f);
+  for (size_t i = 0; i < count; i++) {
+    if (std::fabs(mono[i]) > threshold) {
+      if (!heard_) first_loud_ = position_ + i;
+      heard_ = true;
+      last_loud_ = position_ + i;
+    }
+  }
+
+  // Both analysers get chunks that end on their frame boundaries, so each
+  // frame is handled as it completes.
+  while (count > 0) {
+    const size_t chunk =
+        std::min({count, beat_analyzer_.samples_until_next_frame(),
+                  chroma_analyzer_.samples_until_next_frame()});
+    position_ += chunk;
+    const int64_t time_ns = static_cast<int64_t>(position_ * 1000000000ull /
+                                                 sample_rate_) -
+                            half_window_ns_;
+    if (beat_analyzer_.PushSamples(mono, chunk) > 0) {
+      BeatEvent beat;
+      if (beat_tracker_.Process(beat_analyzer_.magnitudes(), time_ns,
+                                &beat)) {
+        beats_ms_.push_back(
+            static_cast<uint32_t>(std::max<int64_t>(beat.timestamp_ns, 0) /
+                                  1000000));
+      }
+      if (beat_tracker_.tempo_updated() &&
+          beat_tracker_.tempo().confidence > 0.0f) {
+        tempos_.push_back(beat_tracker_.tempo());
+      }
+    }
+    if (chroma_analyzer_.PushSamples(mono, chunk) > 0 &&
+        chroma_tracker_.Process(chroma_analyzer_.magnitudes(), time_ns)) {
+      const ChromaReading& reading = chroma_tracker_.reading();
+      double total = 0.0;
+      for (float value : reading.chroma) total += value;
+      if (total > 0.0) {
+        for (size_t c = 0; c < ChromaReading::kPitchClasses; c++) {
+          key_chroma_[c] += reading.chroma[c] / total;
+        }
+      }
+    }
+    mono += chunk;
+    count -= chunk;
+  }
+}
+
+void TrackAnalyzer::Finish(TrackAnalysis* out) {
+  out->sample_rate = sample_rate_;
+  out->frame_count = position_;
+
+  out->bpm = WeightedMedianBpm(&tempos_);
+  double confidence = 0.0;
+  for (const TempoEstimate& tempo : tempos_) confidence += tempo.confidence;
+  if (!tempos_.empty()) confidence /= static_cast<double>(tempos_.size());
+  out->tempo_confidence = static_cast<float>(confidence);
+
+  const LoudnessReading& loudness = loudness_meter_.reading();
+  out->integrated_lufs = loudness.integrated_lufs;
+  out->true_peak_dbtp = loudness.true_peak_dbtp;
+
+  float chroma[ChromaReading::kPitchClasses];
+  for (size_t c = 0; c < ChromaReading::kPitchClasses; c++) {
+    chroma[c] = static_cast<float>(key_chroma_[c]);
+  }
+  ChromaReading key;
+  chroma_tracker_.MatchKey(chroma, &key);
+  out->tonic = key.tonic;
+  out->mode = key.mode;
+  out->key_confidence = key.confidence;
+
+  if (heard_) {
+    out->leading_silence_ms = SamplesToMs(first_loud_, sample_rate_);
+    out->trailing_silence_ms =
+        SamplesToMs(position_ - 1 - last_loud_, sample_rate_);
+  } else {
+    out->leading_silence_ms = SamplesToMs(position_, sample_rate_);
+    out->trailing_silence_ms = 0;
+  }
+
+  // The tracker keeps predicting beats through silence; the grid only
+  // covers the audible part.
+  const uint32_t end_ms = SamplesToMs(last_loud_ + 1, sample_rate_);
+  out->beats_ms.clear();
+  if (heard_) {
+    for (uint32_t beat : beats_ms_) {
+      if (beat >= out->leading_silence_ms && beat < end_ms) {
+        out->beats_ms.push_back(beat);
+      }
+    }
+  }
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,119 @@
+#ifndef RHYTHM_TRACK_ANALYZER_H_
+#define RHYTHM_TRACK_ANALYZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "beat_tracker.h"
+#include "chroma_tracker.h"
+#include "downmix.h"
+#include "loudness_meter.h"
+#include "pcm_source.h"
+#include "peak_pyramid.h"
+#include "rhythm_analyzer.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// What TrackAnalyzer finds in a whole track. Times count from the track's
+// first sample.
+struct TrackAnalysis {
+  uint32_t sample_rate = 0;
+  uint64_t frame_count = 0;
+  // PcmSource::source_size() of the analysed file.
+  uint64_t source_size = 0;
+  // Tempo over the whole track, and the mean confidence of the estimates
+  // it was chosen from.
+  float bpm = 0.0f;
+  float tempo_confidence = 0.0f;
+  // The beat grid: every beat the BeatTracker found or predicted between
+  // the leading and trailing silence, in ms.
+  std::vector<uint32_t> beats_ms;
+  // EBU R128 integrated loudness and true peak, with left and right (folded
+  // down from any other layout) as separate channels.
+  float integrated_lufs = -std::numeric_limits<float>::infinity();
+  float true_peak_dbtp = -std::numeric_limits<float>::infinity();
+  // Key of the whole track; tonic -1 if it has no pitched content.
+  int8_t tonic = -1;
+  KeyMode mode = KeyMode::kMajor;
+  float key_confidence = 0.0f;
+  // Silence before the first and after the last sample louder than
+  // TrackAnalyzer::kSilenceDbfs; a silent track is all leading silence.
+  uint32_t leading_silence_ms = 0;
+  uint32_t trailing_silence_ms = 0;
+
+  double duration_seconds() const {
+    return sample_rate ? static_cast<double>(frame_count) / sample_rate : 0.0;
+  }
+};
+
+// Beat grid, tempo, loudness, key and silence of a whole track, decoded
+// block by block from a PcmSource so that memory does not grow with the
+// track's length.
+//
+// The mono downmix runs through the same pieces as live capture: a
+// kBeatFftSize FFT with 50% overlap feeds a BeatTracker, and a separate
+// kChromaFftSize FFT, whose finer bins reach down into the bass, feeds a
+// ChromaTracker. A LoudnessMeter measures every sample, of left and right
+// for a source with more than one channel. Offline, nothing needs to be
+// causal or smoothed for display: the tempo is the confidence-weighted
+// median of the tracker's estimates over the track, and the key is matched
+// against the chroma of every reading summed with equal weight instead of
+// the live estimate's last few seconds.
+//
+// Each instance analyses one track at a time and keeps its buffers from
+// track to track; BatchAnalyzer gives every worker its own.
+class TrackAnalyzer {
+ public:
+  static constexpr size_t kBeatFftSize = RhythmAnalyzer::kDefaultFftSize;
+  static constexpr size_t kChromaFftSize = 8192;
+  static constexpr float kSilenceDbfs = -60.0f;
+  // Frames decoded per PcmSource::Read().
+  static constexpr size_t kBlockFrames = 4096;
+
+  TrackAnalyzer();
+
+  // Decodes |source| to the end and fills |out|. Returns false and fills
+  // |error| if decoding fails or the source's format cannot be downmixed.
+  // |peaks|, if not null, has been started with PeakPyramidWriter::Begin()
+  // and is fed the same mono downmix.
+  bool Analyze(PcmSource* source, TrackAnalysis* out, std::string* error,
+               PeakPyramidWriter* peaks = nullptr);
+
+ private:
+  void Prepare(const AudioFormat& format);
+  void DownmixBlock(size_t count);
+  void ProcessMono(const float* mono, size_t count);
+  void Finish(TrackAnalysis* out);
+
+  Downmixer downmixer_;
+  RhythmAnalyzer beat_analyzer_;
+  RhythmAnalyzer chroma_analyzer_;
+  BeatTracker beat_tracker_;
+  ChromaTracker chroma_tracker_;
+  LoudnessMeter loudness_meter_;
+  std::vector<uint8_t> block_;
+  std::vector<float> mono_;
+  // Side signal and the left and right rebuilt from it, for two channels.
+  std::vector<float> side_;
+  std::vector<float> left_;
+  std::vector<float> right_;
+  // Per-track state.
+  uint32_t sample_rate_ = 0;
+  uint64_t position_ = 0;
+  int64_t half_window_ns_ = 0;
+  uint64_t first_loud_ = 0;
+  uint64_t last_loud_ = 0;
+  bool heard_ = false;
+  std::vector<TempoEstimate> tempos_;
+  std::vector<uint32_t> beats_ms_;
+  double key_chroma_[ChromaReading::kPitchClasses] = {};
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_TRACK_ANALYZER_H_
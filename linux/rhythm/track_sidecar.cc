@@ -0,0 +1,158 @@
+#include "track_sidecar.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+const uint8_t kMagic[4] = {'C', 'Y', 'R', 'A'};
+
+void PutLe(uint64_t value, size_t bytes, uint8_t* out) {
+  for (size_t i = 0; i < bytes; i++) {
+    out[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint64_t GetLe(const uint8_t* in, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    value |= static_cast<uint64_t>(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+void PutFloat(float value, uint8_t* out) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  PutLe(bits, 4, out);
+}
+
+float GetFloat(const uint8_t* in) {
+  const uint32_t bits = static_cast<uint32_t>(GetLe(in, 4));
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+std::string SidecarPath(const std::string& directory,
+                        const std::string& cache_key,
+                        const char* extension) {
+  std::string path = directory;
+  if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+    path += '/';
+  }
+  return path + cache_key + extension;
+}
+
+void EncodeTrackAnalysis(const TrackAnalysis& analysis,
+                         std::vector<uint8_t>* out) {
+  const size_t beats = analysis.beats_ms.size();
+  out->assign(kSidecarHeaderBytes + 4 * beats, 0);
+  uint8_t* p = out->data();
+  std::memcpy(p, kMagic, sizeof(kMagic));
+  PutLe(kSidecarVersion, 2, p + 4);
+  PutLe(analysis.sample_rate, 4, p + 8);
+  PutLe(beats, 4, p + 12);
+  PutLe(analysis.frame_count, 8, p + 16);
+  PutLe(analysis.source_size, 8, p + 24);
+  PutFloat(analysis.bpm, p + 32);
+  PutFloat(analysis.tempo_confidence, p + 36);
+  PutFloat(analysis.integrated_lufs, p + 40);
+  PutFloat(analysis.true_peak_dbtp, p + 44);
+  p[48] = static_cast<uint8_t>(analysis.tonic);
+  p[49] = static_cast<uint8_t>(analysis.mode);
+  PutFloat(analysis.key_confidence, p + 52);
+  PutLe(analysis.leading_silence_ms, 4, p + 56);
+  PutLe(analysis.trailing_silence_ms, 4, p + 60);
+  for (size_t i = 0; i < beats; i++) {
+    PutLe(analysis.beats_ms[i], 4, p + kSidecarHeaderBytes + 4 * i);
+  }
+}
+
+bool DecodeTrackAnalysis(const uint8_t* data, size_t size,
+                         TrackAnalysis* analysis) {
+  if (size < kSidecarHeaderBytes ||
+      std::memcmp(data, kMagic, sizeof(kMagic)) != 0 ||
+      GetLe(data + 4, 2) != kSidecarVersion) {
+    return false;
+  }
+  const uint64_t beats = GetLe(data + 12, 4);
+  if ((size - kSidecarHeaderBytes) / 4 < beats) return false;
+  const int8_t tonic = static_cast<int8_t>(data[48]);
+  if (tonic < -1 || tonic >= 12 || data[49] > 1) return false;
+
+  analysis->sample_rate = static_cast<uint32_t>(GetLe(data + 8, 4));
+  analysis->frame_count = GetLe(data + 16, 8);
+  analysis->source_size = GetLe(data + 24, 8);
+  analysis->bpm = GetFloat(data + 32);
+  analysis->tempo_confidence = GetFloat(data + 36);
+  analysis->integrated_lufs = GetFloat(data + 40);
+  analysis->true_peak_dbtp = GetFloat(data + 44);
+  analysis->tonic = tonic;
+  analysis->mode = static_cast<KeyMode>(data[49]);
+  analysis->key_confidence = GetFloat(data + 52);
+  analysis->leading_silence_ms = static_cast<uint32_t>(GetLe(data + 56, 4));
+  analysis->trailing_silence_ms = static_cast<uint32_t>(GetLe(data + 60, 4));
+  analysis->beats_ms.resize(static_cast<size_t>(beats));
+  for (size_t i = 0; i < analysis->beats_ms.size(); i++) {
+    analysis->beats_ms[i] = static_cast<uint32_t>(
+        GetLe(data + kSidecarHeaderBytes + 4 * i, 4));
+  }
+  return true;
+}
+
+bool WriteTrackAnalysis(const std::string& path,
+                        const TrackAnalysis& analysis, std::string* error) {
+  std::vector<uint8_t> bytes;
+  EncodeTrackAnalysis(analysis, &bytes);
+  const std::filesystem::path target = std::filesystem::u8path(path);
+  std::filesystem::path temporary = target;
+  temporary += ".tmp";
+  std::error_code ignored;
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char*>(bytes.data()),
+                    static_cast<std::streamsize>(bytes.size()))) {
+      *error = "cannot write " + path + ".tmp";
+      file.close();
+      std::filesystem::remove(temporary, ignored);
+      return false;
+    }
+  }
+  // Replaces an existing record on Windows too.
+  std::error_code renamed;
+  std::filesystem::rename(temporary, target, renamed);
+  if (renamed) {
+    *error = "cannot replace " + path + ": " + renamed.message();
+    std::filesystem::remove(temporary, ignored);
+    return false;
+  }
+  return true;
+}
+
+bool ReadTrackAnalysis(const std::string& path, TrackAnalysis* analysis,
+                       std::string* error) {
+  std::ifstream file(std::filesystem::u8path(path), std::ios::binary);
+  if (!file) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)),
+                                   std::istreambuf_iterator<char>());
+  if (!DecodeTrackAnalysis(bytes.data(), bytes.size(), analysis)) {
+    *error = path + " is not a version " + std::to_string(kSidecarVersion) +
+             " analysis";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
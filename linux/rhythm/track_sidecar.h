@@ -0,0 +1,57 @@
+#ifndef RHYTHM_TRACK_SIDECAR_H_
+#define RHYTHM_TRACK_SIDECAR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "track_analyzer.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// A TrackAnalysis is stored next to the cached audio as <cache key>.rhythm,
+// a little-endian record of kSidecarHeaderBytes followed by the beat grid:
+//
+//   0  "CYRA" magic               4  u16 version, u16 0
+//   8  u32 sample rate           12  u32 beat count
+//  16  u64 frame count           24  u64 source size
+//  32  f32 bpm                   36  f32 tempo confidence
+//  40  f32 integrated LUFS       44  f32 true peak dBTP
+//  48  i8 tonic, u8 mode, u16 0  52  f32 key confidence
+//  56  u32 leading silence ms    60  u32 trailing silence ms
+//  64  u32 beat times in ms, one per beat
+//
+// A record of another version is rejected, so a format change only costs a
+// re-analysis.
+constexpr uint16_t kSidecarVersion = 1;
+constexpr size_t kSidecarHeaderBytes = 64;
+constexpr char kSidecarExtension[] = ".rhythm";
+
+// |directory|/|cache_key| followed by |extension|.
+std::string SidecarPath(const std::string& directory,
+                        const std::string& cache_key,
+                        const char* extension = kSidecarExtension);
+
+void EncodeTrackAnalysis(const TrackAnalysis& analysis,
+                         std::vector<uint8_t>* out);
+// Returns false for anything but a complete record of kSidecarVersion.
+bool DecodeTrackAnalysis(const uint8_t* data, size_t size,
+                         TrackAnalysis* analysis);
+
+// Paths are UTF-8.
+//
+// Writes through a temporary file renamed over |path|, so a reader never
+// sees half a record. Returns false and fills |error| on failure.
+bool WriteTrackAnalysis(const std::string& path,
+                        const TrackAnalysis& analysis, std::string* error);
+// Returns false and fills |error| if |path| is missing or not a record
+// DecodeTrackAnalysis() accepts.
+bool ReadTrackAnalysis(const std::string& path, TrackAnalysis* analysis,
+                       std::string* error);
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_TRACK_SIDECAR_H_
@@ -0,0 +1,116 @@
+#include "wav_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace cyrene_music {
+namespace rhythm {
+
+namespace {
+
+uint32_t ReadLe32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Largest fmt chunk body worth reading: WAVEFORMATEXTENSIBLE is 40 bytes.
+constexpr size_t kMaxFormatBytes = 64;
+
+}  // namespace
+
+bool ReadWavFile(const std::string& path, WavFile* out, std::string* error) {
+  WavFileSource source;
+  if (!source.Open(path, error)) return false;
+  out->format = source.format();
+  out->data.resize(static_cast<size_t>(source.frames_left()) *
+                   out->format.block_align);
+  size_t frames = 0;
+  if (!source.Read(out->data.data(), out->data.size() / out->format.block_align,
+                   &frames, error)) {
+    return false;
+  }
+  out->data.resize(frames * out->format.block_align);
+  return true;
+}
+
+bool WavFileSource::Open(const std::string& path, std::string* error) {
+  path_ = path;
+  file_.close();
+  file_.clear();
+  remaining_ = 0;
+  file_.open(std::filesystem::u8path(path), std::ios::binary | std::ios::ate);
+  if (!file_) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  file_size_ = static_cast<uint64_t>(file_.tellg());
+  file_.seekg(0);
+  uint8_t header[12];
+  if (!file_.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+      std::memcmp(header, "RIFF", 4) != 0 ||
+      std::memcmp(header + 8, "WAVE", 4) != 0) {
+    *error = path + " is not a RIFF/WAVE file";
+    return false;
+  }
+
+  bool have_format = false;
+  bool supported = false;
+  uint64_t pos = sizeof(header);
+  while (pos + 8 <= file_size_) {
+    uint8_t chunk[8];
+    file_.seekg(static_cast<std::streamoff>(pos));
+    if (!file_.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) break;
+    const uint64_t chunk_size = ReadLe32(chunk + 4);
+    const uint64_t body = pos + 8;
+    const uint64_t available = file_size_ - body;
+
+    if (std::memcmp(chunk, "fmt ", 4) == 0) {
+      if (chunk_size < 16 || available < 16) break;
+      uint8_t format[kMaxFormatBytes];
+      const size_t size = static_cast<size_t>(
+          std::min<uint64_t>({chunk_size, available, sizeof(format)}));
+      if (!file_.read(reinterpret_cast<char*>(format),
+                      static_cast<std::streamsize>(size))) {
+        break;
+      }
+      supported = ParseWaveFormat(format, size, &format_);
+      have_format = true;
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      if (!have_format) break;
+      if (!supported) {
+        *error = path + " uses an unsupported sample format";
+        return false;
+      }
+      // The stream is left at the start of the samples.
+      remaining_ = std::min(chunk_size, available);
+      return true;
+    }
+    pos = body + chunk_size + (chunk_size & 1);
+  }
+
+  *error = path + " has no usable fmt/data chunks";
+  return false;
+}
+
+bool WavFileSource::Read(void* data, size_t max_frames, size_t* frames,
+                         std::string* error) {
+  const size_t block_align = format_.block_align;
+  const uint64_t wanted =
+      std::min<uint64_t>(static_cast<uint64_t>(max_frames) * block_align,
+                         remaining_ - remaining_ % block_align);
+  file_.read(static_cast<char*>(data), static_cast<std::streamsize>(wanted));
+  const uint64_t read = static_cast<uint64_t>(file_.gcount());
+  if (read < wanted && file_.bad()) {
+    *error = "cannot read " + path_;
+    return false;
+  }
+  // A short read means the file ended early; what it held still counts.
+  remaining_ = read < wanted ? 0 : remaining_ - read;
+  *frames = static_cast<size_t>(read / block_align);
+  return true;
+}
+
+}  // namespace rhythm
+}  // namespace cyrene_music
@@ -0,0 +1,62 @@
+#ifndef RHYTHM_WAV_READER_H_
+#define RHYTHM_WAV_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "downmix.h"
+#include "pcm_source.h"
+
+namespace cyrene_music {
+namespace rhythm {
+
+// A WAV file loaded into memory, with its sample data still in the file's
+// encoding; Downmixer reads it directly.
+struct WavFile {
+  AudioFormat format;
+  std::vector<uint8_t> data;
+
+  size_t frame_count() const {
+    return format.block_align ? data.size() / format.block_align : 0;
+  }
+};
+
+// Loads |path| into |out|. Returns false and fills |error| when the file is
+// missing, truncated or uses a sample format the reader cannot convert.
+bool ReadWavFile(const std::string& path, WavFile* out, std::string* error);
+
+// A WAV file streamed from disk, so that offline analysis of a long track
+// holds only one block of it at a time.
+class WavFileSource : public PcmSource {
+ public:
+  // Opens |path| (UTF-8) and reads its headers up to the sample data.
+  // Returns false and fills |error| for the same files ReadWavFile()
+  // rejects.
+  bool Open(const std::string& path, std::string* error);
+
+  const AudioFormat& format() const override { return format_; }
+  bool Read(void* data, size_t max_frames, size_t* frames,
+            std::string* error) override;
+  uint64_t source_size() const override { return file_size_; }
+
+  // Frames left in the data chunk, as far as the file holds them.
+  uint64_t frames_left() const {
+    return format_.block_align ? remaining_ / format_.block_align : 0;
+  }
+
+ private:
+  std::ifstream file_;
+  std::string path_;
+  AudioFormat format_;
+  uint64_t file_size_ = 0;
+  // Bytes of the data chunk not read yet.
+  uint64_t remaining_ = 0;
+};
+
+}  // namespace rhythm
+}  // namespace cyrene_music
+
+#endif  // RHYTHM_WAV_READER_H_
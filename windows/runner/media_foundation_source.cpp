@@ -0,0 +1,177 @@
+#include "media_foundation_source.h"
+
+#include <mfapi.h>
+#include <mferror.h>
+#include <shlwapi.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#pragma comment(lib, "mfplat.lib")
+#pragma comment(lib, "mfreadwrite.lib")
+#pragma comment(lib, "mfuuid.lib")
+#pragma comment(lib, "shlwapi.lib")
+
+namespace cyrene_music {
+
+namespace {
+
+std::wstring Utf8ToWide(const std::string& text) {
+    if (text.empty()) return std::wstring();
+    const int length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    std::wstring wide(static_cast<size_t>(length), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), wide.data(), length);
+    return wide;
+}
+
+std::string HresultError(const char* what, HRESULT hr) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), " (0x%08lx)", static_cast<unsigned long>(hr));
+    return std::string(what) + buffer;
+}
+
+// Size of the file at |path| on disk, or 0 if it cannot be read.
+uint64_t FileSize(const std::string& path) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExW(Utf8ToWide(path).c_str(), GetFileExInfoStandard, &attributes)) return 0;
+    return (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+}
+
+}  // namespace
+
+MediaFoundationSource::MediaFoundationSource() {
+    // S_FALSE (already joined) must be balanced too; a thread already in a
+    // single-threaded apartment can still use Media Foundation.
+    com_initialized_ = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+    media_foundation_started_ = SUCCEEDED(MFStartup(MF_VERSION, MFSTARTUP_LITE));
+}
+
+MediaFoundationSource::~MediaFoundationSource() {
+    if (reader_) reader_->Release();
+    if (media_foundation_started_) MFShutdown();
+    if (com_initialized_) CoUninitialize();
+}
+
+bool MediaFoundationSource::OpenFile(const std::string& path, std::string* error) {
+    if (!media_foundation_started_) {
+        *error = "Media Foundation is unavailable";
+        return false;
+    }
+    source_size_ = FileSize(path);
+    const HRESULT hr = MFCreateSourceReaderFromURL(Utf8ToWide(path).c_str(), nullptr, &reader_);
+    if (FAILED(hr)) {
+        *error = HresultError(("cannot open " + path).c_str(), hr);
+        return false;
+    }
+    return SelectFloatOutput(error);
+}
+
+bool MediaFoundationSource::OpenMemory(const std::vector<uint8_t>& bytes, const std::string& path,
+                                       std::string* error) {
+    if (!media_foundation_started_) {
+        *error = "Media Foundation is unavailable";
+        return false;
+    }
+    source_size_ = FileSize(path);
+    IStream* stream = SHCreateMemStream(bytes.data(), static_cast<UINT>(bytes.size()));
+    if (!stream) {
+        *error = "out of memory";
+        return false;
+    }
+    IMFByteStream* byte_stream = nullptr;
+    HRESULT hr = MFCreateMFByteStreamOnStream(stream, &byte_stream);
+    stream->Release();
+    if (SUCCEEDED(hr)) {
+        hr = MFCreateSourceReaderFromByteStream(byte_stream, nullptr, &reader_);
+        byte_stream->Release();
+    }
+    if (FAILED(hr)) {
+        *error = HresultError("cannot decode the cached audio", hr);
+        return false;
+    }
+    return SelectFloatOutput(error);
+}
+
+bool MediaFoundationSource::SelectFloatOutput(std::string* error) {
+    const DWORD stream = static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM);
+    reader_->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_ALL_STREAMS), FALSE);
+    HRESULT hr = reader_->SetStreamSelection(stream, TRUE);
+    IMFMediaType* requested = nullptr;
+    if (SUCCEEDED(hr)) hr = MFCreateMediaType(&requested);
+    if (SUCCEEDED(hr)) {
+        requested->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio);
+        requested->SetGUID(MF_MT_SUBTYPE, MFAudioFormat_Float);
+        hr = reader_->SetCurrentMediaType(stream, nullptr, requested);
+        requested->Release();
+    }
+    IMFMediaType* actual = nullptr;
+    if (SUCCEEDED(hr)) hr = reader_->GetCurrentMediaType(stream, &actual);
+    WAVEFORMATEX* wave_format = nullptr;
+    UINT32 size = 0;
+    if (SUCCEEDED(hr)) {
+        hr = MFCreateWaveFormatExFromMFMediaType(actual, &wave_format, &size);
+        actual->Release();
+    }
+    if (FAILED(hr)) {
+        *error = HresultError("no decodable audio stream", hr);
+        return false;
+    }
+    const bool parsed = rhythm::ParseWaveFormat(reinterpret_cast<const uint8_t*>(wave_format), size, &format_);
+    CoTaskMemFree(wave_format);
+    if (!parsed || format_.block_align == 0) {
+        *error = "unsupported decoder output format";
+        return false;
+    }
+    return true;
+}
+
+bool MediaFoundationSource::Read(void* data, size_t max_frames, size_t* frames, std::string* error) {
+    uint8_t* out = static_cast<uint8_t*>(data);
+    const size_t block_align = format_.block_align;
+    const size_t wanted = max_frames * block_align;
+    size_t filled = 0;
+    while (filled < wanted) {
+        if (pending_offset_ < pending_.size()) {
+            const size_t count = std::min(wanted - filled, pending_.size() - pending_offset_);
+            std::memcpy(out + filled, pending_.data() + pending_offset_, count);
+            filled += count;
+            pending_offset_ += count;
+            continue;
+        }
+        if (ended_) break;
+
+        DWORD flags = 0;
+        IMFSample* sample = nullptr;
+        const HRESULT hr = reader_->ReadSample(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), 0, nullptr, &flags, nullptr, &sample);
+        if (FAILED(hr)) {
+            *error = HresultError("decoding failed", hr);
+            return false;
+        }
+        if (flags & MF_SOURCE_READERF_ENDOFSTREAM) ended_ = true;
+        if (flags & MF_SOURCE_READERF_CURRENTMEDIATYPECHANGED) {
+            if (sample) sample->Release();
+            *error = "the decoder changed format mid-stream";
+            return false;
+        }
+        if (!sample) continue;
+
+        IMFMediaBuffer* buffer = nullptr;
+        if (SUCCEEDED(sample->ConvertToContiguousBuffer(&buffer))) {
+            BYTE* bytes = nullptr;
+            DWORD length = 0;
+            if (SUCCEEDED(buffer->Lock(&bytes, nullptr, &length))) {
+                pending_.assign(bytes, bytes + length);
+                pending_offset_ = 0;
+                buffer->Unlock();
+            }
+            buffer->Release();
+        }
+        sample->Release();
+    }
+    // A partial frame at the very end is dropped.
+    *frames = filled / block_align;
+    return true;
+}
+
+}  // namespace cyrene_music
@@ -0,0 +1,61 @@
+#ifndef RUNNER_MEDIA_FOUNDATION_SOURCE_H_
+#define RUNNER_MEDIA_FOUNDATION_SOURCE_H_
+
+#include <windows.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pcm_source.h"
+
+namespace cyrene_music {
+
+// Decodes anything Media Foundation reads (MP3, AAC/M4A, FLAC, WAV, ...) to
+// float PCM for the offline rhythm analysis.
+//
+// Joins the multithreaded COM apartment and starts Media Foundation on the
+// thread that constructs it, and leaves both on destruction, so it must be
+// destroyed on the same thread; BatchAnalyzer opens and closes each source
+// on one worker.
+class MediaFoundationSource : public rhythm::PcmSource {
+ public:
+  MediaFoundationSource();
+  ~MediaFoundationSource() override;
+
+  MediaFoundationSource(const MediaFoundationSource&) = delete;
+  MediaFoundationSource& operator=(const MediaFoundationSource&) = delete;
+
+  // Opens the file at |path| (UTF-8).
+  bool OpenFile(const std::string& path, std::string* error);
+  // Opens an encoded file held in memory, such as ReadCyreneAudio() returns.
+  // The bytes are copied. |path| is the file they were read from; like
+  // OpenFile(), source_size() reports its size on disk.
+  bool OpenMemory(const std::vector<uint8_t>& bytes, const std::string& path,
+                  std::string* error);
+
+  const rhythm::AudioFormat& format() const override { return format_; }
+  bool Read(void* data, size_t max_frames, size_t* frames,
+            std::string* error) override;
+  uint64_t source_size() const override { return source_size_; }
+
+ private:
+  // Asks the reader for float output and reads back the format it chose.
+  bool SelectFloatOutput(std::string* error);
+
+  bool com_initialized_ = false;
+  bool media_foundation_started_ = false;
+  IMFSourceReader* reader_ = nullptr;
+  rhythm::AudioFormat format_;
+  uint64_t source_size_ = 0;
+  // Decoded bytes of the latest sample not yet returned by Read().
+  std::vector<uint8_t> pending_;
+  size_t pending_offset_ = 0;
+  bool ended_ = false;
+};
+
+}  // namespace cyrene_music
+
+#endif  // RUNNER_MEDIA_FOUNDATION_SOURCE_H_
@@ -5,55 +5,231 @@
 #include <endpointvolume.h>
 #include <functiondiscoverykeys_devpkey.h>
 #include <iostream>
-#include <cmath>
 #include <algorithm>
-#include <complex>
+#include <filesystem>
+#include <string>
+
+#include "cyrene_cache.h"
+#include "media_foundation_source.h"
+#include "peak_pyramid.h"
+#include "track_sidecar.h"
 
 #pragma comment(lib, "Ole32.lib")
 
 namespace cyrene_music {
 
 namespace {
-    const int FFT_SIZE = 1024;
-    const int BANDS_COUNT = 16;
-    const float PI = 3.14159265358979323846f;
-
-    // Simple FFT implementation
-    void fft(std::vector<std::complex<float>>& a) {
-        size_t n = a.size();
-        for (size_t i = 1, j = 0; i < n; i++) {
-            size_t bit = n >> 1;
-            for (; j & bit; bit >>= 1) j ^= bit;
-            j ^= bit;
-            if (i < j) std::swap(a[i], a[j]);
-        }
-        for (int len = 2; len <= n; len <<= 1) {
-            float ang = 2 * PI / len;
-            std::complex<float> wlen(std::cos(ang), std::sin(ang));
-            for (int i = 0; i < n; i += len) {
-                std::complex<float> w(1);
-                for (int j = 0; j < len / 2; j++) {
-                    std::complex<float> u = a[i + j], v = a[i + j + len / 2] * w;
-                    a[i + j] = u + v;
-                    a[i + j + len / 2] = u - v;
-                    w *= wlen;
-                }
-            }
-        }
+
+// Upper bound for setFrameBatching; the queue holds two full batches.
+constexpr int kMaxBatchFrames = 32;
+constexpr size_t kFrameQueueCapacity = 2 * kMaxBatchFrames;
+
+// Polling interval while audio plays, and while the engine has suspended
+// analysis for silence. The loopback buffer is sized to outlast the longer.
+constexpr DWORD kPollIntervalMs = 16;
+constexpr DWORD kSuspendedPollIntervalMs = 100;
+constexpr REFERENCE_TIME kLoopbackBufferDuration = 2000000;  // 200 ms
+
+// Interval of the stats event while statistics are enabled.
+constexpr int64_t kStatsIntervalNs = 1000000000;
+
+// Upper bound for queryWaveform's columns.
+constexpr int64_t kMaxWaveformColumns = 16384;
+
+// Reads an integer argument, accepting both codec encodings of Dart ints.
+bool GetIntArgument(const flutter::EncodableMap& arguments, const char* key,
+                    int64_t* value) {
+  auto it = arguments.find(flutter::EncodableValue(key));
+  if (it == arguments.end()) return false;
+  if (const auto* v32 = std::get_if<int32_t>(&it->second)) {
+    *value = *v32;
+    return true;
+  }
+  if (const auto* v64 = std::get_if<int64_t>(&it->second)) {
+    *value = *v64;
+    return true;
+  }
+  return false;
+}
+
+// Reads a numeric argument as a float, accepting ints as well as doubles.
+bool GetFloatArgument(const flutter::EncodableMap& arguments, const char* key,
+                      float* value) {
+  auto it = arguments.find(flutter::EncodableValue(key));
+  if (it == arguments.end()) return false;
+  if (const auto* d = std::get_if<double>(&it->second)) {
+    *value = static_cast<float>(*d);
+    return true;
+  }
+  int64_t integer = 0;
+  if (GetIntArgument(arguments, key, &integer)) {
+    *value = static_cast<float>(integer);
+    return true;
+  }
+  return false;
+}
+
+bool GetBoolArgument(const flutter::EncodableMap& arguments, const char* key,
+                     bool* value) {
+  auto it = arguments.find(flutter::EncodableValue(key));
+  if (it == arguments.end()) return false;
+  if (const auto* b = std::get_if<bool>(&it->second)) {
+    *value = *b;
+    return true;
+  }
+  return false;
+}
+
+bool GetStringArgument(const flutter::EncodableMap& arguments, const char* key,
+                       std::string* value) {
+  auto it = arguments.find(flutter::EncodableValue(key));
+  if (it == arguments.end()) return false;
+  if (const auto* s = std::get_if<std::string>(&it->second)) {
+    *value = *s;
+    return true;
+  }
+  return false;
+}
+
+// Overrides |config| with whichever of {attackMs, releaseMs, peakHoldMs,
+// peakFallPerSec, autoGain} are present. Returns false if any is negative.
+bool GetDynamicsArguments(const flutter::EncodableMap& arguments,
+                          rhythm::DynamicsConfig* config) {
+  GetFloatArgument(arguments, "attackMs", &config->attack_ms);
+  GetFloatArgument(arguments, "releaseMs", &config->release_ms);
+  GetFloatArgument(arguments, "peakHoldMs", &config->peak_hold_ms);
+  GetFloatArgument(arguments, "peakFallPerSec", &config->peak_fall_per_s);
+  GetBoolArgument(arguments, "autoGain", &config->auto_gain);
+  return config->attack_ms >= 0 && config->release_ms >= 0 &&
+         config->peak_hold_ms >= 0 && config->peak_fall_per_s >= 0;
+}
+
+// Overrides |config| with whichever of {scale, count, maxRate} and the
+// dynamics keys are present. Returns false if any is out of range.
+bool GetSubscriberArguments(const flutter::EncodableMap& arguments,
+                            rhythm::SubscriberConfig* config) {
+  std::string scaleName;
+  if (GetStringArgument(arguments, "scale", &scaleName) &&
+      !rhythm::ParseBandScale(scaleName.c_str(), &config->layout.scale)) {
+    return false;
+  }
+  int64_t count = 0;
+  if (GetIntArgument(arguments, "count", &count)) {
+    if (count < static_cast<int64_t>(rhythm::BandMapper::kMinBands) ||
+        count > static_cast<int64_t>(rhythm::BandMapper::kMaxBands)) {
+      return false;
+    }
+    config->layout.band_count = static_cast<uint32_t>(count);
+  }
+  GetFloatArgument(arguments, "maxRate", &config->max_rate_hz);
+  return config->max_rate_hz >= 0 &&
+         GetDynamicsArguments(arguments, &config->dynamics);
+}
+
+// {count, meanUs, p50Us, p99Us, maxUs} of a duration histogram. The
+// quantiles are bucket upper edges, so within a factor of two.
+flutter::EncodableValue HistogramToValue(const rhythm::HistogramSnapshot& histogram) {
+  flutter::EncodableMap map;
+  map[flutter::EncodableValue("count")] = flutter::EncodableValue(static_cast<int64_t>(histogram.count));
+  map[flutter::EncodableValue("meanUs")] = flutter::EncodableValue(histogram.mean_ns() / 1000.0);
+  map[flutter::EncodableValue("p50Us")] = flutter::EncodableValue(static_cast<double>(histogram.Quantile(0.5)) / 1000.0);
+  map[flutter::EncodableValue("p99Us")] = flutter::EncodableValue(static_cast<double>(histogram.Quantile(0.99)) / 1000.0);
+  map[flutter::EncodableValue("maxUs")] = flutter::EncodableValue(static_cast<double>(histogram.max_ns) / 1000.0);
+  return flutter::EncodableValue(map);
+}
+
+// Centre frequency in Hz of each band of |layout| on |grid|.
+flutter::EncodableValue BandCenters(const rhythm::BandLayout& layout,
+                                    const rhythm::SpectrumGrid& grid) {
+  rhythm::BandMapper mapper;
+  mapper.Configure(layout, grid);
+  std::vector<float> centers(mapper.band_count());
+  for (size_t i = 0; i < centers.size(); i++) {
+    centers[i] = mapper.center_frequency(i);
+  }
+  return flutter::EncodableValue(std::move(centers));
+}
+
+// {sampleRate, durationMs, sourceSize, bpm, tempoConfidence, beatsMs,
+// integratedLufs, truePeakDbtp, tonic, mode, keyConfidence,
+// leadingSilenceMs, trailingSilenceMs} of a stored track analysis; beatsMs
+// is an Int32List, tonic -1 when the key is unknown and the levels -infinity
+// for silence.
+flutter::EncodableValue TrackAnalysisToValue(const rhythm::TrackAnalysis& analysis) {
+  std::vector<int32_t> beats(analysis.beats_ms.begin(), analysis.beats_ms.end());
+  flutter::EncodableMap map;
+  map[flutter::EncodableValue("sampleRate")] = flutter::EncodableValue(static_cast<int64_t>(analysis.sample_rate));
+  map[flutter::EncodableValue("durationMs")] = flutter::EncodableValue(static_cast<int64_t>(analysis.duration_seconds() * 1000.0));
+  map[flutter::EncodableValue("sourceSize")] = flutter::EncodableValue(static_cast<int64_t>(analysis.source_size));
+  map[flutter::EncodableValue("bpm")] = flutter::EncodableValue(static_cast<double>(analysis.bpm));
+  map[flutter::EncodableValue("tempoConfidence")] = flutter::EncodableValue(static_cast<double>(analysis.tempo_confidence));
+  map[flutter::EncodableValue("beatsMs")] = flutter::EncodableValue(std::move(beats));
+  map[flutter::EncodableValue("integratedLufs")] = flutter::EncodableValue(static_cast<double>(analysis.integrated_lufs));
+  map[flutter::EncodableValue("truePeakDbtp")] = flutter::EncodableValue(static_cast<double>(analysis.true_peak_dbtp));
+  map[flutter::EncodableValue("tonic")] = flutter::EncodableValue(static_cast<int32_t>(analysis.tonic));
+  map[flutter::EncodableValue("mode")] = flutter::EncodableValue(rhythm::KeyModeName(analysis.mode));
+  map[flutter::EncodableValue("keyConfidence")] = flutter::EncodableValue(static_cast<double>(analysis.key_confidence));
+  map[flutter::EncodableValue("leadingSilenceMs")] = flutter::EncodableValue(static_cast<int64_t>(analysis.leading_silence_ms));
+  map[flutter::EncodableValue("trailingSilenceMs")] = flutter::EncodableValue(static_cast<int64_t>(analysis.trailing_silence_ms));
+  return flutter::EncodableValue(map);
+}
+
+// Splits frames [start_ms, end_ms) of the waveform pyramid at path into
+// columns, end_ms <= 0 meaning the end of the track, and returns a
+// Float32List of every column's minimum, then every maximum, then every RMS;
+// null if there is no pyramid in the current format. The file is mapped
+// rather than read, so a query only touches the pages of the level it uses.
+flutter::EncodableValue QueryWaveform(const std::string& path, int64_t start_ms, int64_t end_ms, size_t columns) {
+  const HANDLE file = CreateFileW(std::filesystem::u8path(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return flutter::EncodableValue();
+  LARGE_INTEGER size = {};
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  }
+  // The mapping keeps the file open, and the view the mapping.
+  CloseHandle(file);
+  if (!mapping) return flutter::EncodableValue();
+  const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!view) return flutter::EncodableValue();
+
+  flutter::EncodableValue value;
+  rhythm::PeakPyramid pyramid;
+  if (pyramid.Open(static_cast<const uint8_t*>(view), static_cast<size_t>(size.QuadPart))) {
+    const uint64_t rate = pyramid.sample_rate();
+    const uint64_t begin = static_cast<uint64_t>(std::max<int64_t>(start_ms, 0)) * rate / 1000;
+    const uint64_t end = end_ms > 0 ? static_cast<uint64_t>(end_ms) * rate / 1000 : pyramid.frame_count();
+    std::vector<rhythm::PeakColumn> peaks(columns);
+    const size_t filled = pyramid.Query(begin, end, columns, peaks.data());
+    std::vector<float> payload(3 * filled);
+    for (size_t i = 0; i < filled; i++) {
+      payload[i] = peaks[i].min;
+      payload[filled + i] = peaks[i].max;
+      payload[2 * filled + i] = peaks[i].rms;
     }
+    value = flutter::EncodableValue(std::move(payload));
+  }
+  UnmapViewOfFile(view);
+  return value;
 }
 
+}  // namespace
+
 void RhythmPlugin::RegisterWithRegistrar(
     FlutterDesktopPluginRegistrarRef registrar_ref) {
   auto registrar =
       flutter::PluginRegistrarManager::GetInstance()
           ->GetRegistrar<flutter::PluginRegistrarWindows>(registrar_ref);
 
-  auto plugin = std::make_unique<RhythmPlugin>(registrar->messenger());
+  auto plugin = std::make_unique<RhythmPlugin>(registrar);
   registrar->AddPlugin(std::move(plugin));
 }
 
-RhythmPlugin::RhythmPlugin(flutter::BinaryMessenger* messenger) {
+RhythmPlugin::RhythmPlugin(flutter::PluginRegistrarWindows* registrar)
+    : frame_queue_(kFrameQueueCapacity), batch_scratch_(kFrameQueueCapacity),
+      registrar_(registrar) {
+  flutter::BinaryMessenger* messenger = registrar->messenger();
   method_channel_ = std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
       messenger, "com.cyrene.music/rhythm_method",
       &flutter::StandardMethodCodec::GetInstance());
@@ -67,14 +243,61 @@ RhythmPlugin::RhythmPlugin(flutter::BinaryMessenger* messenger) {
         HandleMethodCall(call, std::move(result));
       });
 
-  auto handler = std::make_unique<RhythmStreamHandler>(this);
+  auto handler = std::make_unique<RhythmStreamHandler>(
+      &event_sink_, &sink_mutex_, [this] { OnListenersChanged(); });
   event_channel_->SetStreamHandler(std::move(handler));
 
-  fft_magnitudes_.resize(BANDS_COUNT, 0.0f);
+  // Beats and tempo go out on their own channel so beat-reactive widgets do
+  // not have to decode band frames.
+  beat_channel_ = std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+      messenger, "com.cyrene.music/rhythm_beat",
+      &flutter::StandardMethodCodec::GetInstance());
+  beat_channel_->SetStreamHandler(std::make_unique<RhythmStreamHandler>(
+      &beat_sink_, &sink_mutex_, [this] { OnListenersChanged(); }));
+
+  // Runs on the analysis worker; only queues, never waits on the emitter.
+  engine_.SetFrameCallback([this](const rhythm::RhythmFrame& frame) {
+    if (batch_frames_.load(std::memory_order_relaxed) > 0) {
+      frame_queue_.Write(&frame, 1);
+    }
+  });
+
+  task_message_ = RegisterWindowMessageW(L"CyreneRhythmPluginTask");
+  window_proc_id_ = registrar_->RegisterTopLevelWindowProcDelegate(
+      [this](HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
+        return HandleWindowProc(hwnd, message, wparam, lparam);
+      });
 }
 
 RhythmPlugin::~RhythmPlugin() {
   StopCapture();
+  registrar_->UnregisterTopLevelWindowProcDelegate(window_proc_id_);
+}
+
+void RhythmPlugin::PostToPlatformThread(std::function<void()> task) {
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    wake = tasks_.empty();
+    tasks_.push_back(std::move(task));
+  }
+  // One message drains everything queued before it is handled.
+  if (wake) {
+    PostMessageW(GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT),
+                 task_message_, 0, 0);
+  }
+}
+
+std::optional<LRESULT> RhythmPlugin::HandleWindowProc(HWND hwnd, UINT message,
+                                                      WPARAM wparam, LPARAM lparam) {
+  if (message != task_message_) return std::nullopt;
+  std::vector<std::function<void()>> tasks;
+  {
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    tasks.swap(tasks_);
+  }
+  for (auto& task : tasks) task();
+  return 0;
 }
 
 void RhythmPlugin::HandleMethodCall(
@@ -86,6 +309,358 @@ void RhythmPlugin::HandleMethodCall(
   } else if (method_call.method_name() == "stop") {
     StopCapture();
     result->Success(flutter::EncodableValue(true));
+  } else if (method_call.method_name() == "setFftSize") {
+    // Picked up by the analysis worker, which re-plans before its next frame.
+    // 'hop' is optional; omitting it (or 0) selects 50% overlap.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    int64_t size = 0;
+    int64_t hop = 0;
+    if (arguments && GetIntArgument(*arguments, "size", &size) && size > 0) {
+      GetIntArgument(*arguments, "hop", &hop);
+      if (hop >= 0 &&
+          engine_.Configure(static_cast<size_t>(size), static_cast<size_t>(hop))) {
+        result->Success(flutter::EncodableValue(true));
+        return;
+      }
+    }
+    result->Error("INVALID_ARGUMENT",
+                  "'size' must be a power of two between 32 and 16384 and "
+                  "'hop' between 1 and 'size'");
+  } else if (method_call.method_name() == "setAnalysisMode") {
+    // {mode: fft|multires|filterbank}. The worker switches before its next
+    // frame; band centres move, so callers re-send their layouts to learn the
+    // new ones. filterbank falls back to the FFT while band subscribers are
+    // attached or whenever the FFT is faster for the band count, which the
+    // worker times on this machine when the configuration changes.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    std::string modeName;
+    rhythm::AnalysisMode mode = rhythm::AnalysisMode::kFft;
+    if (arguments && GetStringArgument(*arguments, "mode", &modeName) &&
+        rhythm::ParseAnalysisMode(modeName.c_str(), &mode)) {
+      engine_.SetAnalysisMode(mode);
+      result->Success(flutter::EncodableValue(true));
+      return;
+    }
+    result->Error("INVALID_ARGUMENT", "'mode' must be fft, multires or filterbank");
+  } else if (method_call.method_name() == "setDecimation") {
+    // {factor: 0|1|2|4|8, treble?: bool}. Downsamples the FFT mode's input
+    // by |factor| (0 picks one from the device rate) before a smaller FFT;
+    // with treble the bins above the decimated passband come from a
+    // full-rate FFT, otherwise the bands only reach the passband. Band
+    // centres may move, so callers re-send their layouts to learn the new
+    // ones.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    int64_t factor = 0;
+    rhythm::Decimation decimation;
+    if (arguments && GetIntArgument(*arguments, "factor", &factor) && factor >= 0 && factor <= 8) {
+      decimation.factor = static_cast<uint32_t>(factor);
+      GetBoolArgument(*arguments, "treble", &decimation.treble);
+      if (engine_.SetDecimation(decimation)) {
+        result->Success(flutter::EncodableValue(true));
+        return;
+      }
+    }
+    result->Error("INVALID_ARGUMENT", "'factor' must be 0, 1, 2, 4 or 8");
+  } else if (method_call.method_name() == "setStereo") {
+    // {enabled, channels?: lr|ms}. Stereo mode also captures the side signal
+    // and sends a stereo event per frame with bands for left and right (or
+    // mid and side), the phase correlation and the stereo width. The main
+    // frames are unchanged. Switching it while capturing restarts capture,
+    // which resets the tempo and loudness; 'channels' alone applies from the
+    // next frame.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    bool enabled = false;
+    std::string channelsName;
+    rhythm::StereoChannels channels = engine_.stereo_channels();
+    if (!arguments || !GetBoolArgument(*arguments, "enabled", &enabled) ||
+        (GetStringArgument(*arguments, "channels", &channelsName) &&
+         !rhythm::ParseStereoChannels(channelsName.c_str(), &channels))) {
+      result->Error("INVALID_ARGUMENT", "Expected 'enabled' and 'channels' of lr or ms");
+      return;
+    }
+    engine_.SetStereoChannels(channels);
+    if (enabled != engine_.stereo()) {
+      const bool capturing = is_capturing_;
+      StopCapture();
+      engine_.SetStereo(enabled);
+      if (capturing) StartCapture();
+    }
+    result->Success(flutter::EncodableValue(true));
+  } else if (method_call.method_name() == "setBandLayout") {
+    // {scale: linear|log|mel|bark, count: 4..128}. Replies with each band's
+    // centre frequency in Hz for the current analysis mode, FFT size,
+    // decimation and sample rate; the
+    // worker rebuilds its weights before the next frame.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    std::string scaleName;
+    int64_t count = 0;
+    rhythm::BandLayout layout;
+    if (arguments && GetStringArgument(*arguments, "scale", &scaleName) &&
+        GetIntArgument(*arguments, "count", &count) &&
+        rhythm::ParseBandScale(scaleName.c_str(), &layout.scale) &&
+        count >= static_cast<int64_t>(rhythm::BandMapper::kMinBands) &&
+        count <= static_cast<int64_t>(rhythm::BandMapper::kMaxBands)) {
+      layout.band_count = static_cast<uint32_t>(count);
+      if (engine_.SetBandLayout(layout)) {
+        result->Success(BandCenters(layout, engine_.spectrum_grid()));
+        return;
+      }
+    }
+    result->Error("INVALID_ARGUMENT",
+                  "'scale' must be linear, log, mel or bark and 'count' between 4 and 128");
+  } else if (method_call.method_name() == "setDynamics") {
+    // Any subset of {attackMs, releaseMs, peakHoldMs, peakFallPerSec,
+    // autoGain}; omitted keys keep their current values. Applied by the
+    // analysis worker from its next frame.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Error("INVALID_ARGUMENT", "Expected a map of dynamics settings");
+      return;
+    }
+    rhythm::DynamicsConfig config = dynamics_;
+    if (!GetDynamicsArguments(*arguments, &config)) {
+      result->Error("INVALID_ARGUMENT", "Dynamics settings must not be negative");
+      return;
+    }
+    dynamics_ = config;
+    engine_.SetDynamics(config);
+    result->Success(flutter::EncodableValue(true));
+  } else if (method_call.method_name() == "subscribe" ||
+             method_call.method_name() == "updateSubscription") {
+    // subscribe takes {scale, count, maxRate} plus any setDynamics keys and
+    // replies {id, centers}; omitted keys take the defaults (16 linear
+    // bands, every frame). updateSubscription takes the same keys plus 'id'
+    // and keeps omitted ones. Frames arrive on the bands event channel.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const bool update = method_call.method_name() == "updateSubscription";
+    int64_t id = 0;
+    if (!arguments ||
+        (update && (!GetIntArgument(*arguments, "id", &id) || id < 0 ||
+                    !engine_.has_subscriber(static_cast<size_t>(id))))) {
+      result->Error("INVALID_ARGUMENT", "Unknown subscription");
+      return;
+    }
+    rhythm::SubscriberConfig config =
+        update ? subscribers_[static_cast<size_t>(id)] : rhythm::SubscriberConfig();
+    if (!GetSubscriberArguments(*arguments, &config)) {
+      result->Error("INVALID_ARGUMENT",
+                    "'scale' must be linear, log, mel or bark, 'count' between 4 and 128 "
+                    "and 'maxRate' and the dynamics settings must not be negative");
+      return;
+    }
+    size_t slot = static_cast<size_t>(id);
+    if (update) {
+      engine_.UpdateSubscriber(slot, config);
+    } else if (!engine_.AddSubscriber(config, &slot)) {
+      result->Error("UNAVAILABLE", "Too many subscriptions");
+      return;
+    }
+    subscribers_[slot] = config;
+    flutter::EncodableMap reply;
+    reply[flutter::EncodableValue("id")] = flutter::EncodableValue(static_cast<int32_t>(slot));
+    reply[flutter::EncodableValue("centers")] =
+        BandCenters(config.layout, engine_.spectrum_grid());
+    result->Success(flutter::EncodableValue(reply));
+  } else if (method_call.method_name() == "unsubscribe") {
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    int64_t id = 0;
+    if (arguments && GetIntArgument(*arguments, "id", &id) && id >= 0) {
+      engine_.RemoveSubscriber(static_cast<size_t>(id));
+    }
+    result->Success(flutter::EncodableValue(true));
+  } else if (method_call.method_name() == "setFrameBatching") {
+    // 0 sends the latest frame per tick; N > 0 sends every frame, N per event.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    int64_t frames = 0;
+    if (arguments && GetIntArgument(*arguments, "frames", &frames) &&
+        frames >= 0 && frames <= kMaxBatchFrames) {
+      batch_frames_ = static_cast<int>(frames);
+      result->Success(flutter::EncodableValue(true));
+      return;
+    }
+    result->Error("INVALID_ARGUMENT", "'frames' must be between 0 and 32");
+  } else if (method_call.method_name() == "setSilenceTimeout") {
+    // {ms}: how long the output must stay silent before analysis suspends
+    // until audio resumes.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    int64_t ms = 0;
+    if (arguments && GetIntArgument(*arguments, "ms", &ms) && ms >= 0 &&
+        ms <= 60000) {
+      engine_.SetSilenceTimeout(static_cast<uint32_t>(ms));
+      result->Success(flutter::EncodableValue(true));
+      return;
+    }
+    result->Error("INVALID_ARGUMENT", "'ms' must be between 0 and 60000");
+  } else if (method_call.method_name() == "setSpectralFeatures") {
+    // {enabled, maxRate?}: sends a features event with the spectral
+    // centroid, rolloff, flatness, flux and zero-crossing rate, averaged over
+    // the frames since the previous one, at most maxRate times a second (0,
+    // the default, with every frame).
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    bool enabled = false;
+    float maxRate = 0.0f;
+    if (arguments && GetBoolArgument(*arguments, "enabled", &enabled)) {
+      GetFloatArgument(*arguments, "maxRate", &maxRate);
+      if (maxRate >= 0) {
+        engine_.SetSpectralFeatures(enabled, maxRate);
+        result->Success(flutter::EncodableValue(true));
+        return;
+      }
+    }
+    result->Error("INVALID_ARGUMENT", "Expected 'enabled' and a 'maxRate' that is not negative");
+  } else if (method_call.method_name() == "setChroma") {
+    // {enabled}: sends a chroma event about four times a second with the
+    // 12-bin pitch-class profile and the estimated key. Chroma needs a
+    // spectrum, so it keeps the filter-bank mode on the FFT while enabled.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    bool enabled = false;
+    if (arguments && GetBoolArgument(*arguments, "enabled", &enabled)) {
+      engine_.SetChroma(enabled);
+      result->Success(flutter::EncodableValue(true));
+      return;
+    }
+    result->Error("INVALID_ARGUMENT", "Expected 'enabled'");
+  } else if (method_call.method_name() == "setPercussive") {
+    // {enabled}: separates the drums from sustained sounds, sending a
+    // percussive event with every frame with the percussive-only bands and
+    // an onset event on the beat channel for each drum hit. Like chroma it
+    // keeps the filter-bank mode on the FFT while enabled.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    bool enabled = false;
+    if (arguments && GetBoolArgument(*arguments, "enabled", &enabled)) {
+      engine_.SetPercussive(enabled);
+      result->Success(flutter::EncodableValue(true));
+      return;
+    }
+    result->Error("INVALID_ARGUMENT", "Expected 'enabled'");
+  } else if (method_call.method_name() == "setLoudness") {
+    // {enabled}: meters EBU R128 loudness and true peak, sending a loudness
+    // event every 100 ms. Dart turns it on while the loudness stream has a
+    // listener; each time it is turned on the measurement starts afresh.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    bool enabled = false;
+    if (arguments && GetBoolArgument(*arguments, "enabled", &enabled)) {
+      engine_.SetLoudness(enabled);
+      result->Success(flutter::EncodableValue(true));
+      return;
+    }
+    result->Error("INVALID_ARGUMENT", "Expected 'enabled'");
+  } else if (method_call.method_name() == "resetLoudness") {
+    // Restarts the integrated loudness and true peak, e.g. on a track change.
+    engine_.ResetLoudness();
+    result->Success(flutter::EncodableValue(true));
+  } else if (method_call.method_name() == "getBufferStats") {
+    const rhythm::RingStats stats = engine_.ring_stats();
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("capacity")] = flutter::EncodableValue(static_cast<int64_t>(stats.capacity));
+    map[flutter::EncodableValue("buffered")] = flutter::EncodableValue(static_cast<int64_t>(stats.buffered));
+    map[flutter::EncodableValue("highWater")] = flutter::EncodableValue(static_cast<int64_t>(stats.high_water));
+    map[flutter::EncodableValue("overruns")] = flutter::EncodableValue(static_cast<int64_t>(stats.overruns));
+    map[flutter::EncodableValue("samplesCaptured")] = flutter::EncodableValue(static_cast<int64_t>(stats.samples_captured));
+    result->Success(flutter::EncodableValue(map));
+  } else if (method_call.method_name() == "setStatsEnabled") {
+    // {enabled}: starts or pauses recording; counts so far are kept. While
+    // enabled a stats event goes out on the bands channel every second.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    bool enabled = false;
+    if (!arguments || !GetBoolArgument(*arguments, "enabled", &enabled)) {
+      result->Error("INVALID_ARGUMENT", "Expected 'enabled'");
+      return;
+    }
+    engine_.stats().SetEnabled(enabled);
+    result->Success(flutter::EncodableValue(rhythm::RhythmStats::kCompiledIn));
+  } else if (method_call.method_name() == "getStats") {
+    result->Success(flutter::EncodableValue(BuildStats()));
+  } else if (method_call.method_name() == "analyzeTrack") {
+    // {path, directory, cacheKey, encryptionKey?}: decodes the whole track
+    // at path on a background worker, independent of capture, and stores
+    // its beat grid, tempo, loudness, key and silence as
+    // <directory>/<cacheKey>.rhythm and its waveform (see queryWaveform) as
+    // <directory>/<cacheKey>.peaks. With encryptionKey path is a .cyrene
+    // cache entry; otherwise any file Media Foundation reads. Completes
+    // with the analysis (see TrackAnalysisToValue) once the track is done,
+    // or with an ANALYSIS_FAILED error; several tracks run in parallel.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    std::string path;
+    std::string directory;
+    std::string cacheKey;
+    if (!arguments || !GetStringArgument(*arguments, "path", &path) ||
+        !GetStringArgument(*arguments, "directory", &directory) ||
+        !GetStringArgument(*arguments, "cacheKey", &cacheKey) || cacheKey.empty()) {
+      result->Error("INVALID_ARGUMENT", "Expected 'path', 'directory' and 'cacheKey'");
+      return;
+    }
+    std::string encryptionKey;
+    GetStringArgument(*arguments, "encryptionKey", &encryptionKey);
+    rhythm::TrackJob job;
+    job.open = [path, encryptionKey](std::string* error) -> std::unique_ptr<rhythm::PcmSource> {
+      auto source = std::make_unique<MediaFoundationSource>();
+      bool opened = false;
+      if (encryptionKey.empty()) {
+        opened = source->OpenFile(path, error);
+      } else {
+        std::vector<uint8_t> audio;
+        opened = rhythm::ReadCyreneAudio(path, encryptionKey, &audio, error) &&
+                 source->OpenMemory(audio, path, error);
+      }
+      if (!opened) return nullptr;
+      return source;
+    };
+    job.sidecar_path = rhythm::SidecarPath(directory, cacheKey);
+    job.peaks_path = rhythm::SidecarPath(directory, cacheKey, rhythm::kPeakExtension);
+    std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> pending(std::move(result));
+    // Runs on an analyzer worker; the result is completed on the platform
+    // thread like every other method call.
+    job.done = [this, pending](const rhythm::TrackAnalysis* analysis, const std::string& error) {
+      if (analysis) {
+        PostToPlatformThread([pending, value = TrackAnalysisToValue(*analysis)] {
+          pending->Success(value);
+        });
+      } else {
+        PostToPlatformThread([pending, error] { pending->Error("ANALYSIS_FAILED", error); });
+      }
+    };
+    track_analyzer_.Submit(std::move(job));
+  } else if (method_call.method_name() == "readTrackAnalysis") {
+    // {directory, cacheKey}: the analysis analyzeTrack stored for cacheKey,
+    // or null if there is none in the current format.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    std::string directory;
+    std::string cacheKey;
+    if (!arguments || !GetStringArgument(*arguments, "directory", &directory) ||
+        !GetStringArgument(*arguments, "cacheKey", &cacheKey) || cacheKey.empty()) {
+      result->Error("INVALID_ARGUMENT", "Expected 'directory' and 'cacheKey'");
+      return;
+    }
+    rhythm::TrackAnalysis analysis;
+    std::string error;
+    if (rhythm::ReadTrackAnalysis(rhythm::SidecarPath(directory, cacheKey), &analysis, &error)) {
+      result->Success(TrackAnalysisToValue(analysis));
+    } else {
+      result->Success();
+    }
+  } else if (method_call.method_name() == "queryWaveform") {
+    // {directory, cacheKey, columns, startMs?, endMs?}: the waveform
+    // analyzeTrack stored for cacheKey over [startMs, endMs), the whole
+    // track by default, as columns min/max/RMS columns (see QueryWaveform);
+    // null if there is none. Takes time in columns, not in the range.
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    std::string directory;
+    std::string cacheKey;
+    int64_t columns = 0;
+    if (!arguments || !GetStringArgument(*arguments, "directory", &directory) ||
+        !GetStringArgument(*arguments, "cacheKey", &cacheKey) || cacheKey.empty() ||
+        !GetIntArgument(*arguments, "columns", &columns) ||
+        columns < 1 || columns > kMaxWaveformColumns) {
+      result->Error("INVALID_ARGUMENT", "Expected 'directory', 'cacheKey' and 'columns' (1-16384)");
+      return;
+    }
+    int64_t startMs = 0;
+    int64_t endMs = 0;
+    GetIntArgument(*arguments, "startMs", &startMs);
+    GetIntArgument(*arguments, "endMs", &endMs);
+    result->Success(QueryWaveform(rhythm::SidecarPath(directory, cacheKey, rhythm::kPeakExtension),
+                                  startMs, endMs, static_cast<size_t>(columns)));
   } else {
     result->NotImplemented();
   }
@@ -94,14 +669,32 @@ void RhythmPlugin::HandleMethodCall(
 void RhythmPlugin::StartCapture() {
   if (is_capturing_) return;
   is_capturing_ = true;
+  // The capture thread starts the engine once it knows the mix format.
   capture_thread_ = std::thread(&RhythmPlugin::CaptureThread, this);
 }
 
 void RhythmPlugin::StopCapture() {
-  is_capturing_ = false;
+  {
+    std::lock_guard<std::mutex> lock(listen_mutex_);
+    is_capturing_ = false;
+  }
+  listen_cv_.notify_all();
   if (capture_thread_.joinable()) {
     capture_thread_.join();
   }
+  engine_.Stop();
+}
+
+// Runs on the platform thread whenever Dart subscribes to or cancels one of
+// the event channels. Beats are only tracked while the beat channel has a
+// listener.
+void RhythmPlugin::OnListenersChanged() {
+  engine_.SetBeatTracking(beat_sink_ != nullptr);
+  {
+    std::lock_guard<std::mutex> lock(listen_mutex_);
+    has_listeners_ = event_sink_ != nullptr || beat_sink_ != nullptr;
+  }
+  listen_cv_.notify_all();
 }
 
 void RhythmPlugin::CaptureThread() {
@@ -124,20 +717,70 @@ void RhythmPlugin::CaptureThread() {
     hr = audioClient->GetMixFormat(&pwfx);
     if (FAILED(hr)) { audioClient->Release(); device->Release(); enumerator->Release(); CoUninitialize(); return; }
 
-    hr = audioClient->Initialize(AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_LOOPBACK, 0, 0, pwfx, NULL);
+    hr = audioClient->Initialize(AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_LOOPBACK, kLoopbackBufferDuration, 0, pwfx, NULL);
     if (FAILED(hr)) { CoTaskMemFree(pwfx); audioClient->Release(); device->Release(); enumerator->Release(); CoUninitialize(); return; }
 
     IAudioCaptureClient* captureClient = NULL;
     hr = audioClient->GetService(__uuidof(IAudioCaptureClient), (void**)&captureClient);
     if (FAILED(hr)) { CoTaskMemFree(pwfx); audioClient->Release(); device->Release(); enumerator->Release(); CoUninitialize(); return; }
 
+    // The downmix reads the mix format as it is (float, 16/24/32-bit PCM,
+    // any channel layout) rather than assuming 32-bit float.
+    rhythm::AudioFormat format;
+    rhythm::Downmixer downmixer;
+    if (!rhythm::ParseWaveFormat(reinterpret_cast<const uint8_t*>(pwfx),
+                                 sizeof(WAVEFORMATEX) + pwfx->cbSize, &format) ||
+        !downmixer.Configure(format)) {
+        captureClient->Release(); CoTaskMemFree(pwfx); audioClient->Release(); device->Release(); enumerator->Release(); CoUninitialize(); return;
+    }
+
+    // The loudness meter measures left and right separately, so the side
+    // signal goes along whenever the mix has two or more channels.
+    engine_.SetStereoInput(format.channels >= 2);
+    engine_.Start();
+
     hr = audioClient->Start();
     if (FAILED(hr)) { captureClient->Release(); CoTaskMemFree(pwfx); audioClient->Release(); device->Release(); enumerator->Release(); CoUninitialize(); return; }
 
-    std::vector<float> pcm_buffer;
-    pcm_buffer.reserve(FFT_SIZE);
+    // Size the downmix buffer for the largest packet up front so the capture
+    // loop does not allocate.
+    UINT32 bufferFrames = 0;
+    audioClient->GetBufferSize(&bufferFrames);
+    std::vector<float> mono_buffer(bufferFrames);
+    const bool stereo = engine_.stereo();
+    const bool sideInput = engine_.side_input();
+    std::vector<float> side_buffer(sideInput ? bufferFrames : 0);
+    engine_.SetSampleRate(pwfx->nSamplesPerSec);
+
+    uint64_t sentVersion = engine_.latest_frame_version();
+    uint64_t sentTempoVersion = engine_.tempo_version();
+    uint64_t sentLoudnessVersion = engine_.loudness_version();
+    uint64_t sentStereoVersion = engine_.stereo_frame_version();
+    uint64_t sentFeaturesVersion = engine_.spectral_features_version();
+    uint64_t sentChromaVersion = engine_.chroma_version();
+    uint64_t sentPercussiveVersion = engine_.percussive_frame_version();
+    int64_t lastStatsNs = rhythm::SteadyClockNowNs();
+    sent_sequence_ = 0;
+    uint64_t sentSubscriberVersions[rhythm::RhythmEngine::kMaxSubscribers];
+    for (size_t i = 0; i < rhythm::RhythmEngine::kMaxSubscribers; i++) {
+        sentSubscriberVersions[i] = engine_.subscriber_frame_version(i);
+    }
 
     while (is_capturing_) {
+        // Nobody is listening: stop the loopback stream and sleep until a
+        // stream is subscribed again, so neither WASAPI nor the engine runs.
+        if (!has_listeners_) {
+            audioClient->Stop();
+            {
+                std::unique_lock<std::mutex> lock(listen_mutex_);
+                listen_cv_.wait(lock, [this] { return has_listeners_ || !is_capturing_; });
+            }
+            if (!is_capturing_) break;
+            // Drop whatever was buffered before the pause
+            audioClient->Reset();
+            if (FAILED(audioClient->Start())) break;
+        }
+
         UINT32 nextPacketSize = 0;
         hr = captureClient->GetNextPacketSize(&nextPacketSize);
         if (FAILED(hr)) break;
@@ -146,31 +789,33 @@ void RhythmPlugin::CaptureThread() {
             BYTE* data = NULL;
             UINT32 framesAvailable = 0;
             DWORD flags = 0;
+            UINT64 qpcPosition = 0;
 
-            hr = captureClient->GetBuffer(&data, &framesAvailable, &flags, NULL, NULL);
+            hr = captureClient->GetBuffer(&data, &framesAvailable, &flags, NULL, &qpcPosition);
             if (FAILED(hr)) break;
 
+            // The QPC position is in 100 ns units on the same clock as
+            // SteadyClockNowNs(); it is unreliable on a timestamp error.
+            const int64_t captureTimeNs =
+                (flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR)
+                    ? rhythm::RhythmEngine::kCaptureTimeNow
+                    : static_cast<int64_t>(qpcPosition) * 100;
             if (!(flags & AUDCLNT_BUFFERFLAGS_SILENT)) {
-                // Assuming float-32 format from GetMixFormat loopback
-                float* fData = (float*)data;
-                for (UINT32 i = 0; i < framesAvailable; i++) {
-                    // Mono mix
-                    float sample = 0;
-                    for (int c = 0; c < pwfx->nChannels; c++) {
-                        sample += fData[i * pwfx->nChannels + c];
-                    }
-                    sample /= pwfx->nChannels;
-                    pcm_buffer.push_back(sample);
-
-                    if (pcm_buffer.size() >= FFT_SIZE) {
-                        ProcessAudioData(pcm_buffer.data(), FFT_SIZE, 1);
-                        pcm_buffer.clear();
-                    }
+                if (mono_buffer.size() < framesAvailable) {
+                    mono_buffer.resize(framesAvailable);
+                    if (sideInput) side_buffer.resize(framesAvailable);
+                }
+                // Only queues the samples; analysis runs on the engine's worker.
+                if (sideInput) {
+                    downmixer.Process(data, framesAvailable, mono_buffer.data(), side_buffer.data());
+                    engine_.PushStereoSamples(mono_buffer.data(), side_buffer.data(), framesAvailable, captureTimeNs);
+                } else {
+                    downmixer.Process(data, framesAvailable, mono_buffer.data());
+                    engine_.PushSamples(mono_buffer.data(), framesAvailable, captureTimeNs);
                 }
             } else {
-                // Silent buffer, clear FFT
-                std::lock_guard<std::mutex> lock(magnitude_mutex_);
-                std::fill(fft_magnitudes_.begin(), fft_magnitudes_.end(), 0.0f);
+                // Silent buffer: lets the bands decay, then suspends analysis
+                engine_.PushSilence(framesAvailable, captureTimeNs);
             }
 
             hr = captureClient->ReleaseBuffer(framesAvailable);
@@ -180,17 +825,38 @@ void RhythmPlugin::CaptureThread() {
             if (FAILED(hr)) break;
         }
 
-        // Send data to Flutter
+        // Send data to Flutter. Reading frames never waits on the worker, and
+        // a slow send never delays analysis. The sinks stay locked until the
+        // last send so a cancel cannot free one in between.
+        std::unique_lock<std::mutex> sinkLock(sink_mutex_);
         if (event_sink_) {
-            std::lock_guard<std::mutex> lock(magnitude_mutex_);
-            flutter::EncodableList bands;
-            for (float m : fft_magnitudes_) {
-                bands.push_back(flutter::EncodableValue(static_cast<double>(m)));
+            if (batch_frames_ > 0) {
+                SendFrameBatches();
+            } else {
+                frame_queue_.Clear();
+                batch_pending_ = 0;
+                SendLatestFrame(&sentVersion);
+            }
+            SendSubscriberFrames(sentSubscriberVersions);
+            SendLoudness(&sentLoudnessVersion);
+            if (stereo) SendStereo(&sentStereoVersion);
+            SendFeatures(&sentFeaturesVersion);
+            SendChroma(&sentChromaVersion);
+            SendPercussive(&sentPercussiveVersion);
+            if (engine_.stats().enabled() &&
+                rhythm::SteadyClockNowNs() - lastStatsNs >= kStatsIntervalNs) {
+                lastStatsNs = rhythm::SteadyClockNowNs();
+                flutter::EncodableMap event = BuildStats();
+                event[flutter::EncodableValue("type")] = flutter::EncodableValue("stats");
+                Emit(event_sink_, flutter::EncodableValue(event));
             }
-            event_sink_->Success(flutter::EncodableValue(bands));
         }
+        SendBeats(&sentTempoVersion);
+        SendOnsets();
+        sinkLock.unlock();
 
-        Sleep(16); // ~60fps
+        // ~60fps while audio plays; slower while the engine is suspended
+        Sleep(engine_.suspended() ? kSuspendedPollIntervalMs : kPollIntervalMs);
     }
 
     audioClient->Stop();
@@ -202,32 +868,280 @@ void RhythmPlugin::CaptureThread() {
     CoUninitialize();
 }
 
-void RhythmPlugin::ProcessAudioData(float* buffer, uint32_t frames, uint32_t channels) {
-    std::vector<std::complex<float>> data(FFT_SIZE);
-    for (int i = 0; i < FFT_SIZE; i++) {
-        // Hanning window
-        float window = 0.5f * (1 - std::cos(2 * PI * i / (FFT_SIZE - 1)));
-        data[i] = std::complex<float>(buffer[i] * window, 0);
-    }
+// Sends the latest frame as a bare Float32List of its bands followed by its
+// peak markers if the worker published a new one since |sent_version|.
+void RhythmPlugin::SendLatestFrame(uint64_t* sent_version) {
+    if (engine_.latest_frame_version() == *sent_version) return;
+    rhythm::RhythmFrame frame;
+    *sent_version = engine_.ReadLatestFrame(&frame);
+    std::vector<float> payload;
+    payload.reserve(2 * frame.band_count);
+    payload.insert(payload.end(), frame.bands, frame.bands + frame.band_count);
+    payload.insert(payload.end(), frame.peaks, frame.peaks + frame.band_count);
+    CountSentFrames(frame, frame, 1);
+    Emit(event_sink_, flutter::EncodableValue(std::move(payload)));
+}
 
-    fft(data);
+// Sends queued frames batch_frames_ at a time, as {bandCount: int,
+// timestampsUs: Int64List, bands: Float32List, peaks: Float32List} with the
+// frames' values concatenated in order. Frames short of a full batch wait in
+// batch_scratch_ until it fills. A change of band count ends a batch early,
+// so the frames before it go out as a shorter batch.
+void RhythmPlugin::SendFrameBatches() {
+    const size_t batchFrames = static_cast<size_t>(batch_frames_.load());
+    rhythm::RhythmFrame* frames = batch_scratch_.data();
+    const size_t count = batch_pending_ +
+        frame_queue_.Read(frames + batch_pending_, batch_scratch_.size() - batch_pending_);
+    size_t first = 0;
+    while (first < count) {
+        const uint32_t bandCount = frames[first].band_count;
+        size_t end = first;
+        while (end < count && end - first < batchFrames &&
+               frames[end].band_count == bandCount) {
+            end++;
+        }
+        // Not full, and the next frame may still have the same band count.
+        if (end - first < batchFrames && end == count) break;
 
-    std::lock_guard<std::mutex> lock(magnitude_mutex_);
-    
-    // Group into bands
-    int samplesPerBand = (FFT_SIZE / 2) / BANDS_COUNT;
-    for (int b = 0; b < BANDS_COUNT; b++) {
-        float sum = 0;
-        for (int i = 0; i < samplesPerBand; i++) {
-            sum += std::abs(data[b * samplesPerBand + i]);
+        std::vector<int64_t> timestamps;
+        std::vector<float> bands;
+        std::vector<float> peaks;
+        timestamps.reserve(end - first);
+        bands.reserve((end - first) * bandCount);
+        peaks.reserve((end - first) * bandCount);
+        for (size_t i = first; i < end; i++) {
+            timestamps.push_back(frames[i].timestamp_ns / 1000);
+            bands.insert(bands.end(), frames[i].bands, frames[i].bands + bandCount);
+            peaks.insert(peaks.end(), frames[i].peaks, frames[i].peaks + bandCount);
         }
-        float avg = sum / samplesPerBand;
-        
-        // Logarithmic scale & Normalization (Roughly)
-        float normalized = std::clamp(avg * 10.0f, 0.0f, 1.0f);
-        
-        // Decay for smoothness if needed, or let Flutter handle it
-        fft_magnitudes_[b] = normalized;
+
+        flutter::EncodableMap event;
+        event[flutter::EncodableValue("bandCount")] = flutter::EncodableValue(static_cast<int32_t>(bandCount));
+        event[flutter::EncodableValue("timestampsUs")] = flutter::EncodableValue(std::move(timestamps));
+        event[flutter::EncodableValue("bands")] = flutter::EncodableValue(std::move(bands));
+        event[flutter::EncodableValue("peaks")] = flutter::EncodableValue(std::move(peaks));
+        CountSentFrames(frames[first], frames[end - 1], end - first);
+        Emit(event_sink_, flutter::EncodableValue(event));
+        first = end;
+    }
+    std::copy(frames + first, frames + count, frames);
+    batch_pending_ = count - first;
+}
+
+// Records the capture-to-emit latency of |last| and counts the frames in
+// [first, last] as sent and any skipped since the previous send as dropped.
+void RhythmPlugin::CountSentFrames(const rhythm::RhythmFrame& first,
+                                   const rhythm::RhythmFrame& last, size_t count) {
+    rhythm::RhythmStats& stats = engine_.stats();
+    if (!stats.enabled()) {
+        sent_sequence_ = last.sequence;
+        return;
+    }
+    const uint64_t dropped = sent_sequence_ != 0 && first.sequence > sent_sequence_ + 1
+                                 ? first.sequence - sent_sequence_ - 1
+                                 : 0;
+    sent_sequence_ = last.sequence;
+    stats.CountFramesSent(count, dropped);
+    if (!last.silent) stats.RecordCaptureToEmit(last.timestamp_ns);
+}
+
+// Sends |value| on |sink|, timing the send. Called with sink_mutex_ held.
+void RhythmPlugin::Emit(const Sink& sink, flutter::EncodableValue value) {
+    const int64_t start = engine_.stats().Now();
+    sink->Success(value);
+    engine_.stats().channel_send().RecordSince(start);
+}
+
+// Counters, ring state and timings as a map for getStats and the stats
+// event: {enabled, compiledIn, packetsCaptured, framesAnalysed, framesSent,
+// framesDropped, samplesDropped, bufferHighWater, fft, bandMapping,
+// captureToEmit, channelSend}, the last four as {count, meanUs, p50Us,
+// p99Us, maxUs}.
+flutter::EncodableMap RhythmPlugin::BuildStats() const {
+    rhythm::StatsSnapshot stats;
+    engine_.stats().Snapshot(&stats);
+    const rhythm::RingStats ring = engine_.ring_stats();
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("enabled")] = flutter::EncodableValue(stats.enabled);
+    map[flutter::EncodableValue("compiledIn")] = flutter::EncodableValue(rhythm::RhythmStats::kCompiledIn);
+    map[flutter::EncodableValue("packetsCaptured")] = flutter::EncodableValue(static_cast<int64_t>(stats.packets_captured));
+    map[flutter::EncodableValue("framesAnalysed")] = flutter::EncodableValue(static_cast<int64_t>(stats.frames_analysed));
+    map[flutter::EncodableValue("framesSent")] = flutter::EncodableValue(static_cast<int64_t>(stats.frames_sent));
+    map[flutter::EncodableValue("framesDropped")] = flutter::EncodableValue(static_cast<int64_t>(stats.frames_dropped));
+    map[flutter::EncodableValue("samplesDropped")] = flutter::EncodableValue(static_cast<int64_t>(ring.overruns));
+    map[flutter::EncodableValue("bufferHighWater")] = flutter::EncodableValue(static_cast<int64_t>(ring.high_water));
+    map[flutter::EncodableValue("fft")] = HistogramToValue(stats.fft);
+    map[flutter::EncodableValue("bandMapping")] = HistogramToValue(stats.band_mapping);
+    map[flutter::EncodableValue("captureToEmit")] = HistogramToValue(stats.capture_to_emit);
+    map[flutter::EncodableValue("channelSend")] = HistogramToValue(stats.channel_send);
+    return map;
+}
+
+// Sends each queued beat as {type: 'beat', timestampUs, strength, confidence,
+// bpm} and, when the tracker has updated it, the running tempo as
+// {type: 'tempo', bpm, confidence}. Beats are drained even with no listener
+// so a late subscriber does not receive stale ones.
+void RhythmPlugin::SendBeats(uint64_t* sent_tempo_version) {
+    rhythm::BeatEvent beat;
+    while (engine_.ReadBeats(&beat, 1) == 1) {
+        if (!beat_sink_) continue;
+        flutter::EncodableMap event;
+        event[flutter::EncodableValue("type")] = flutter::EncodableValue("beat");
+        event[flutter::EncodableValue("timestampUs")] = flutter::EncodableValue(beat.timestamp_ns / 1000);
+        event[flutter::EncodableValue("strength")] = flutter::EncodableValue(static_cast<double>(beat.strength));
+        event[flutter::EncodableValue("confidence")] = flutter::EncodableValue(static_cast<double>(beat.confidence));
+        event[flutter::EncodableValue("bpm")] = flutter::EncodableValue(static_cast<double>(beat.bpm));
+        Emit(beat_sink_, flutter::EncodableValue(event));
+    }
+
+    if (!beat_sink_ || engine_.tempo_version() == *sent_tempo_version) return;
+    rhythm::TempoEstimate tempo;
+    *sent_tempo_version = engine_.ReadTempo(&tempo);
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("type")] = flutter::EncodableValue("tempo");
+    event[flutter::EncodableValue("bpm")] = flutter::EncodableValue(static_cast<double>(tempo.bpm));
+    event[flutter::EncodableValue("confidence")] = flutter::EncodableValue(static_cast<double>(tempo.confidence));
+    Emit(beat_sink_, flutter::EncodableValue(event));
+}
+
+// Sends each subscriber's latest frame, if it published one since
+// |sent_versions[id]|, as {type: 'subscriber', id, timestampUs,
+// bands: Float32List, peaks: Float32List}.
+void RhythmPlugin::SendSubscriberFrames(uint64_t* sent_versions) {
+    for (size_t id = 0; id < rhythm::RhythmEngine::kMaxSubscribers; id++) {
+        if (engine_.subscriber_frame_version(id) == sent_versions[id]) continue;
+        rhythm::RhythmFrame frame;
+        sent_versions[id] = engine_.ReadSubscriberFrame(id, &frame);
+        if (!engine_.has_subscriber(id)) continue;
+        flutter::EncodableMap event;
+        event[flutter::EncodableValue("type")] = flutter::EncodableValue("subscriber");
+        event[flutter::EncodableValue("id")] = flutter::EncodableValue(static_cast<int32_t>(id));
+        event[flutter::EncodableValue("timestampUs")] = flutter::EncodableValue(frame.timestamp_ns / 1000);
+        event[flutter::EncodableValue("bands")] = flutter::EncodableValue(
+            std::vector<float>(frame.bands, frame.bands + frame.band_count));
+        event[flutter::EncodableValue("peaks")] = flutter::EncodableValue(
+            std::vector<float>(frame.peaks, frame.peaks + frame.band_count));
+        Emit(event_sink_, flutter::EncodableValue(event));
+    }
+}
+
+// Sends the meter reading as {type: 'loudness', timestampUs, momentary,
+// shortTerm, integrated, truePeak} each time a 100 ms block completes while
+// loudness is enabled. Levels are in LUFS and dBTP and are -infinity until
+// measured.
+void RhythmPlugin::SendLoudness(uint64_t* sent_version) {
+    if (engine_.loudness_version() == *sent_version) return;
+    rhythm::LoudnessReading reading;
+    *sent_version = engine_.ReadLoudness(&reading);
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("type")] = flutter::EncodableValue("loudness");
+    event[flutter::EncodableValue("timestampUs")] = flutter::EncodableValue(reading.timestamp_ns / 1000);
+    event[flutter::EncodableValue("momentary")] = flutter::EncodableValue(static_cast<double>(reading.momentary_lufs));
+    event[flutter::EncodableValue("shortTerm")] = flutter::EncodableValue(static_cast<double>(reading.short_term_lufs));
+    event[flutter::EncodableValue("integrated")] = flutter::EncodableValue(static_cast<double>(reading.integrated_lufs));
+    event[flutter::EncodableValue("truePeak")] = flutter::EncodableValue(static_cast<double>(reading.true_peak_dbtp));
+    Emit(event_sink_, flutter::EncodableValue(event));
+}
+
+// Sends the latest stereo frame, if one was published since |sent_version|,
+// as {type: 'stereo', timestampUs, channels: 'lr'|'ms', correlation, width,
+// bandCount, bands: Float32List, peaks: Float32List}, with the left (or mid)
+// channel's values followed by the right (or side) channel's.
+void RhythmPlugin::SendStereo(uint64_t* sent_version) {
+    if (engine_.stereo_frame_version() == *sent_version) return;
+    rhythm::StereoFrame frame;
+    *sent_version = engine_.ReadStereoFrame(&frame);
+    std::vector<float> bands;
+    std::vector<float> peaks;
+    bands.reserve(2 * frame.band_count);
+    peaks.reserve(2 * frame.band_count);
+    for (size_t c = 0; c < 2; c++) {
+        bands.insert(bands.end(), frame.bands[c], frame.bands[c] + frame.band_count);
+        peaks.insert(peaks.end(), frame.peaks[c], frame.peaks[c] + frame.band_count);
+    }
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("type")] = flutter::EncodableValue("stereo");
+    event[flutter::EncodableValue("timestampUs")] = flutter::EncodableValue(frame.timestamp_ns / 1000);
+    event[flutter::EncodableValue("channels")] = flutter::EncodableValue(
+        rhythm::StereoChannelsName(static_cast<rhythm::StereoChannels>(frame.channels)));
+    event[flutter::EncodableValue("correlation")] = flutter::EncodableValue(static_cast<double>(frame.correlation));
+    event[flutter::EncodableValue("width")] = flutter::EncodableValue(static_cast<double>(frame.width));
+    event[flutter::EncodableValue("bandCount")] = flutter::EncodableValue(static_cast<int32_t>(frame.band_count));
+    event[flutter::EncodableValue("bands")] = flutter::EncodableValue(std::move(bands));
+    event[flutter::EncodableValue("peaks")] = flutter::EncodableValue(std::move(peaks));
+    Emit(event_sink_, flutter::EncodableValue(event));
+}
+
+// Sends the latest spectral features, if they were published since
+// |sent_version|, as {type: 'features', timestampUs, silent, centroid,
+// rolloff, flatness, flux, zeroCrossingRate}, with the centroid and rolloff
+// in Hz and the rest as SpectralFeatures has them.
+void RhythmPlugin::SendFeatures(uint64_t* sent_version) {
+    if (engine_.spectral_features_version() == *sent_version) return;
+    rhythm::SpectralFeatures features;
+    *sent_version = engine_.ReadSpectralFeatures(&features);
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("type")] = flutter::EncodableValue("features");
+    event[flutter::EncodableValue("timestampUs")] = flutter::EncodableValue(features.timestamp_ns / 1000);
+    event[flutter::EncodableValue("silent")] = flutter::EncodableValue(features.silent);
+    event[flutter::EncodableValue("centroid")] = flutter::EncodableValue(static_cast<double>(features.centroid_hz));
+    event[flutter::EncodableValue("rolloff")] = flutter::EncodableValue(static_cast<double>(features.rolloff_hz));
+    event[flutter::EncodableValue("flatness")] = flutter::EncodableValue(static_cast<double>(features.flatness));
+    event[flutter::EncodableValue("flux")] = flutter::EncodableValue(static_cast<double>(features.flux));
+    event[flutter::EncodableValue("zeroCrossingRate")] = flutter::EncodableValue(static_cast<double>(features.zero_crossing_rate));
+    Emit(event_sink_, flutter::EncodableValue(event));
+}
+
+// Sends the latest chroma and key estimate, if one was published since
+// |sent_version|, as {type: 'chroma', timestampUs, silent,
+// chroma: Float32List, tonic, mode, confidence}. The tonic is a pitch class
+// from 0 (C), or -1 while the key is unknown.
+void RhythmPlugin::SendChroma(uint64_t* sent_version) {
+    if (engine_.chroma_version() == *sent_version) return;
+    rhythm::ChromaReading reading;
+    *sent_version = engine_.ReadChroma(&reading);
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("type")] = flutter::EncodableValue("chroma");
+    event[flutter::EncodableValue("timestampUs")] = flutter::EncodableValue(reading.timestamp_ns / 1000);
+    event[flutter::EncodableValue("silent")] = flutter::EncodableValue(reading.silent);
+    event[flutter::EncodableValue("chroma")] = flutter::EncodableValue(
+        std::vector<float>(reading.chroma, reading.chroma + rhythm::ChromaReading::kPitchClasses));
+    event[flutter::EncodableValue("tonic")] = flutter::EncodableValue(static_cast<int32_t>(reading.tonic));
+    event[flutter::EncodableValue("mode")] = flutter::EncodableValue(rhythm::KeyModeName(reading.mode));
+    event[flutter::EncodableValue("confidence")] = flutter::EncodableValue(static_cast<double>(reading.confidence));
+    Emit(event_sink_, flutter::EncodableValue(event));
+}
+
+// Sends the latest percussive frame, if one was published since
+// |sent_version| while separation is enabled, as {type: 'percussive',
+// timestampUs, silent, bands: Float32List, peaks: Float32List}.
+void RhythmPlugin::SendPercussive(uint64_t* sent_version) {
+    if (engine_.percussive_frame_version() == *sent_version) return;
+    rhythm::RhythmFrame frame;
+    *sent_version = engine_.ReadPercussiveFrame(&frame);
+    if (!engine_.percussive()) return;
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("type")] = flutter::EncodableValue("percussive");
+    event[flutter::EncodableValue("timestampUs")] = flutter::EncodableValue(frame.timestamp_ns / 1000);
+    event[flutter::EncodableValue("silent")] = flutter::EncodableValue(frame.silent);
+    event[flutter::EncodableValue("bands")] = flutter::EncodableValue(
+        std::vector<float>(frame.bands, frame.bands + frame.band_count));
+    event[flutter::EncodableValue("peaks")] = flutter::EncodableValue(
+        std::vector<float>(frame.peaks, frame.peaks + frame.band_count));
+    Emit(event_sink_, flutter::EncodableValue(event));
+}
+
+// Sends each queued percussive onset as {type: 'onset', timestampUs,
+// strength} on the beat channel, draining them like the beats.
+void RhythmPlugin::SendOnsets() {
+    rhythm::PercussiveOnset onset;
+    while (engine_.ReadPercussiveOnsets(&onset, 1) == 1) {
+        if (!beat_sink_) continue;
+        flutter::EncodableMap event;
+        event[flutter::EncodableValue("type")] = flutter::EncodableValue("onset");
+        event[flutter::EncodableValue("timestampUs")] = flutter::EncodableValue(onset.timestamp_ns / 1000);
+        event[flutter::EncodableValue("strength")] = flutter::EncodableValue(static_cast<double>(onset.strength));
+        Emit(beat_sink_, flutter::EncodableValue(event));
     }
 }
 
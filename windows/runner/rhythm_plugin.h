@@ -5,69 +5,152 @@
 #include <flutter/event_channel.h>
 #include <flutter/plugin_registrar_windows.h>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <mutex>
 
 #include <mmdeviceapi.h>
 #include <audioclient.h>
 
+#include "batch_analyzer.h"
+#include "downmix.h"
+#include "rhythm_engine.h"
+#include "spsc_ring.h"
+
 namespace cyrene_music {
 
 class RhythmPlugin : public flutter::Plugin {
  public:
   static void RegisterWithRegistrar(FlutterDesktopPluginRegistrarRef registrar);
 
-  RhythmPlugin(flutter::BinaryMessenger* messenger);
+  RhythmPlugin(flutter::PluginRegistrarWindows* registrar);
   virtual ~RhythmPlugin();
 
-  friend class RhythmStreamHandler;
-
  private:
+  // Queues |task| for the platform thread and wakes it with task_message_.
+  // Safe to call from any thread.
+  void PostToPlatformThread(std::function<void()> task);
+  std::optional<LRESULT> HandleWindowProc(HWND hwnd, UINT message,
+                                          WPARAM wparam, LPARAM lparam);
   void HandleMethodCall(
       const flutter::MethodCall<flutter::EncodableValue> &method_call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
   void StartCapture();
   void StopCapture();
+  void OnListenersChanged();
   void CaptureThread();
-
-  // Audio Capture Implementation
-  void ProcessAudioData(float* buffer, uint32_t frames, uint32_t channels);
+  void SendLatestFrame(uint64_t* sent_version);
+  void SendFrameBatches();
+  void SendBeats(uint64_t* sent_tempo_version);
+  void SendSubscriberFrames(uint64_t* sent_versions);
+  void SendLoudness(uint64_t* sent_version);
+  void SendStereo(uint64_t* sent_version);
+  void SendFeatures(uint64_t* sent_version);
+  void SendChroma(uint64_t* sent_version);
+  void SendPercussive(uint64_t* sent_version);
+  void SendOnsets();
+
+  using Sink = std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>;
+  void CountSentFrames(const rhythm::RhythmFrame& first,
+                       const rhythm::RhythmFrame& last, size_t count);
+  void Emit(const Sink& sink, flutter::EncodableValue value);
+  flutter::EncodableMap BuildStats() const;
 
   std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> method_channel_;
   std::unique_ptr<flutter::EventChannel<flutter::EncodableValue>> event_channel_;
   std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> event_sink_;
+  std::unique_ptr<flutter::EventChannel<flutter::EncodableValue>> beat_channel_;
+  std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> beat_sink_;
+  // Guards event_sink_ and beat_sink_, which the platform thread replaces on
+  // each listen and cancel. CaptureThread holds it across its checks of a
+  // sink and the sends on it, so a sink is never freed mid-send
+  std::mutex sink_mutex_;
 
   std::thread capture_thread_;
   std::atomic<bool> is_capturing_{false};
-  
-  // FFT state
-  std::vector<float> fft_magnitudes_;
-  std::mutex magnitude_mutex_;
+
+  // Whether Dart listens on either event channel. With no listener the
+  // capture thread stops the loopback stream and waits on listen_cv_
+  std::mutex listen_mutex_;
+  std::condition_variable listen_cv_;
+  std::atomic<bool> has_listeners_{false};
+
+  // Ring buffer + analysis worker fed by CaptureThread; frames are read back
+  // lock-free through engine_.ReadLatestFrame()
+  rhythm::RhythmEngine engine_;
+
+  // Batched delivery: the engine's worker queues every frame here while
+  // batch_frames_ > 0 and CaptureThread sends them batch_frames_ at a time
+  rhythm::SpscRing<rhythm::RhythmFrame> frame_queue_;
+  std::atomic<int> batch_frames_{0};
+  std::vector<rhythm::RhythmFrame> batch_scratch_;
+  // Frames at the front of batch_scratch_ still short of a batch;
+  // CaptureThread only
+  size_t batch_pending_ = 0;
+  // Sequence of the last main frame sent; CaptureThread only
+  uint64_t sent_sequence_ = 0;
+
+  // Last settings passed to setDynamics; platform thread only
+  rhythm::DynamicsConfig dynamics_;
+
+  // Settings of each subscription by id, so updateSubscription can change
+  // some keys and keep the rest; platform thread only
+  rhythm::SubscriberConfig subscribers_[rhythm::RhythmEngine::kMaxSubscribers];
+
+  // Work handed to the platform thread by PostToPlatformThread; run and
+  // cleared when the top-level window receives task_message_
+  flutter::PluginRegistrarWindows* registrar_;
+  int window_proc_id_ = -1;
+  UINT task_message_ = 0;
+  std::mutex task_mutex_;
+  std::vector<std::function<void()>> tasks_;
+
+  // Offline analysis for analyzeTrack. Its workers post their method results
+  // to the platform thread. Declared last so that it is destroyed, and its
+  // workers joined, first
+  rhythm::BatchAnalyzer track_analyzer_;
 };
 
+// Stores the sink of one of the plugin's event channels, under |mutex|, while
+// Dart listens and reports each subscribe and cancel through |on_change|.
 class RhythmStreamHandler : public flutter::StreamHandler<flutter::EncodableValue> {
  public:
-  RhythmStreamHandler(RhythmPlugin* plugin) : plugin_(plugin) {}
+  using Sink = std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>;
+
+  RhythmStreamHandler(Sink* sink, std::mutex* mutex, std::function<void()> on_change)
+      : sink_(sink), mutex_(mutex), on_change_(std::move(on_change)) {}
   
  protected:
   std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> OnListenInternal(
       const flutter::EncodableValue* arguments,
       std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events) override {
-    plugin_->event_sink_ = std::move(events);
+    {
+      std::lock_guard<std::mutex> lock(*mutex_);
+      *sink_ = std::move(events);
+    }
+    on_change_();
     return nullptr;
   }
 
   std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> OnCancelInternal(
       const flutter::EncodableValue* arguments) override {
-    plugin_->event_sink_ = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(*mutex_);
+      *sink_ = nullptr;
+    }
+    on_change_();
     return nullptr;
   }
 
  private:
-  RhythmPlugin* plugin_;
+  Sink* sink_;
+  std::mutex* mutex_;
+  std::function<void()> on_change_;
 };
 
 }  // namespace cyrene_music